@@ -36,6 +36,9 @@ OTHER DEALINGS IN THE SOFTWARE.
 #include "disk_filesystem.h"
 #include "compile_options.h"
 #include "resource_registry.h"
+#include "null_file.h"
+#include "shader.h"
+#include "array.h"
 #include <inttypes.h>
 
 namespace crown
@@ -60,8 +63,11 @@ bool BundleCompiler::compile(const char* type, const char* name, Platform::Enum
 	CE_LOGI("%s <= %s.%s", out_name, name, type);
 
 	File* outf = _bundle_fs.open(out_name, FOM_WRITE);
-	CompileOptions opts(_source_fs, outf, platform);
-	resource_on_compile(id.type, path, opts);
+	{
+		// Options must be destroyed before closing the file to flush the writes
+		CompileOptions opts(_source_fs, outf, platform);
+		resource_on_compile(id.type, path, opts);
+	}
 	_bundle_fs.close(outf);
 }
 
@@ -82,6 +88,21 @@ bool BundleCompiler::compile_all(Platform::Enum platform)
 	_source_fs.close(src);
 	_bundle_fs.close(dst);
 
+	// Run shaderc for all the shaders missing from the cache at once,
+	// compile() below then finds them in the cache
+	{
+		Array<const char*> shaders(default_allocator());
+		for (uint32_t i = 0; i < vector::size(files); i++)
+		{
+			if (files[i].ends_with(".shader"))
+				array::push_back(shaders, files[i].c_str());
+		}
+
+		NullFile null_file(FOM_WRITE);
+		CompileOptions opts(_source_fs, &null_file, platform);
+		shader_resource::precompile(array::begin(shaders), array::size(shaders), opts);
+	}
+
 	// Compile all resources
 	for (uint32_t i = 0; i < vector::size(files); i++)
 	{
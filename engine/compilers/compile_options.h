@@ -86,6 +86,16 @@ struct CompileOptions
 		return _bw;
 	}
 
+	/// Writes all the items of @a data as raw memory.
+	template <typename T>
+	BinaryWriter& write(const Array<T>& data)
+	{
+		if (array::size(data))
+			_bw.write(array::begin(data), sizeof(T) * array::size(data));
+
+		return _bw;
+	}
+
 	Platform::Enum platform() const
 	{
 		return _platform;
@@ -50,6 +50,10 @@ OTHER DEALINGS IN THE SOFTWARE.
 	#define CE_MAX_UNITS 65000 // Per world
 #endif // CE_MAX_UNITS
 
+#ifndef CE_MAX_UNIT_TEMPLATES
+	#define CE_MAX_UNIT_TEMPLATES 256 // Per world
+#endif // CE_MAX_UNIT_TEMPLATES
+
 #ifndef CE_MAX_CAMERAS
 	#define CE_MAX_CAMERAS 16 // Per world
 #endif // CE_MAX_CAMERAS
@@ -74,6 +78,10 @@ OTHER DEALINGS IN THE SOFTWARE.
 	#define CE_MAX_SOUND_INSTANCES 64 // Per world
 #endif // CE_MAX
 
+#ifndef CE_MAX_ANIMATIONS
+	#define CE_MAX_ANIMATIONS 1024 // Per world
+#endif // CE_MAX
+
 #ifndef CE_MAX_RAYCASTS
 	#define CE_MAX_RAYCASTS 8 // Per World
 #endif // CE_MAX
@@ -122,8 +130,32 @@ OTHER DEALINGS IN THE SOFTWARE.
 	#define CE_MAX_GUI_TEXTS 64 // Per Gui
 #endif // CE_MAX
 
-#ifndef CE_MAX_DEBUG_LINES
-	#define CE_MAX_DEBUG_LINES 2 * 1024 // Per DebugLine
+#ifndef CE_TEXTURE_MEMORY_BUDGET
+	#define CE_TEXTURE_MEMORY_BUDGET (256 * 1024 * 1024) // Bytes of streamed texture mips
+#endif // CE_TEXTURE_MEMORY_BUDGET
+
+#ifndef CE_TEXTURE_STREAMING_MIN_SIZE
+	#define CE_TEXTURE_STREAMING_MIN_SIZE 64 // Mips up to this size are always resident
+#endif // CE_TEXTURE_STREAMING_MIN_SIZE
+
+#ifndef CE_LEVEL_STREAMING_BUDGET
+	#define CE_LEVEL_STREAMING_BUDGET 0.002f // Seconds per frame spent spawning and destroying level units
+#endif // CE_LEVEL_STREAMING_BUDGET
+
+#ifndef CE_SHADER_CACHE_DIR
+	#define CE_SHADER_CACHE_DIR ".shader_cache" // Relative to the source directory
+#endif // CE_SHADER_CACHE_DIR
+
+#ifndef CE_SHADER_INCLUDE_DIR
+	#define CE_SHADER_INCLUDE_DIR "" // Relative to the source directory, searched by shader #includes, "" for none
+#endif // CE_SHADER_INCLUDE_DIR
+
+#ifndef CE_MAX_COMPILER_THREADS
+	#define CE_MAX_COMPILER_THREADS 4 // Worker threads used by a resource compiler
+#endif // CE_MAX
+
+#ifndef CE_MAX_DEBUG_LINE_THREADS
+	#define CE_MAX_DEBUG_LINE_THREADS 16 // Per DebugLine
 #endif // CE_MAX
 
 #ifndef CE_MAX_LUA_VECTOR2
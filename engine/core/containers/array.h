@@ -85,6 +85,9 @@ namespace array
 	/// the number of items in the array.
 	template <typename T> void clear(Array<T>& a);
 
+	/// Swaps the items of the arrays @a a and @a b without copying them.
+	template <typename T> void swap(Array<T>& a, Array<T>& b);
+
 	template <typename T> T* begin(Array<T>& a);
 	template <typename T> const T* begin(const Array<T>& a);
 	template <typename T> T* end(Array<T>& a);
@@ -225,6 +228,25 @@ namespace array
 		a._size = 0;
 	}
 
+	template <typename T>
+	inline void swap(Array<T>& a, Array<T>& b)
+	{
+		Allocator* allocator = a._allocator;
+		const uint32_t capacity = a._capacity;
+		const uint32_t size = a._size;
+		T* items = a._array;
+
+		a._allocator = b._allocator;
+		a._capacity = b._capacity;
+		a._size = b._size;
+		a._array = b._array;
+
+		b._allocator = allocator;
+		b._capacity = capacity;
+		b._size = size;
+		b._array = items;
+	}
+
 	template <typename T>
 	inline const T* begin(const Array<T>& a)
 	{
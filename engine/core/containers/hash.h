@@ -168,13 +168,24 @@ namespace crown {
 				return;
 			}
 
-			h._data[fr.data_i] = h._data[array::size(h._data) - 1];
-			FindResult last = find(h, h._data[fr.data_i].key);
-
-			if (last.data_prev != END_OF_LIST)
-				h._data[last.data_prev].next = fr.data_i;
+			// Move the last entry in the hole and relink it
+			const uint32_t last = array::size(h._data) - 1;
+			h._data[fr.data_i] = h._data[last];
+
+			const uint32_t hash_i = h._data[fr.data_i].key % array::size(h._hash);
+			if (h._hash[hash_i] == last)
+			{
+				h._hash[hash_i] = fr.data_i;
+			}
 			else
-				h._hash[last.hash_i] = fr.data_i;
+			{
+				uint32_t i = h._hash[hash_i];
+				while (h._data[i].next != last)
+					i = h._data[i].next;
+				h._data[i].next = fr.data_i;
+			}
+
+			array::pop_back(h._data);
 		}
 
 		template<typename T> uint32_t find_or_fail(const Hash<T> &h, uint64_t key)
@@ -219,7 +230,7 @@ namespace crown {
 
 		template<typename T> void rehash(Hash<T> &h, uint32_t new_size)
 		{
-			Hash<T> nh(*h._hash.m_allocator);
+			Hash<T> nh(*h._hash._allocator);
 			array::resize(nh._hash, new_size);
 			array::reserve(nh._data, array::size(h._data));
 			for (uint32_t i=0; i<new_size; ++i)
@@ -229,7 +240,7 @@ namespace crown {
 				multi_hash::insert(nh, e.key, e.value);
 			}
 
-			Hash<T> empty(*h._hash.m_allocator);
+			Hash<T> empty(*h._hash._allocator);
 			h.~Hash<T>();
 			memcpy(&h, &nh, sizeof(Hash<T>));
 			memcpy(&nh, &empty, sizeof(Hash<T>));
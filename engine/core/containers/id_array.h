@@ -54,6 +54,9 @@ struct IdArray
 	uint16_t _next_id;
 	uint16_t _size;
 
+	// Number of ids reserved but not inserted yet
+	uint16_t _num_reserved;
+
 	// The last valid id is reserved and cannot be used to
 	// refer to Ids from the outside
 	Id _sparse[MAX];
@@ -70,6 +73,18 @@ namespace id_array
 	/// Creates a new @a object in the array @a a and returns its id.
 	template <uint32_t MAX, typename T> Id create(IdArray<MAX, T>& a, const T& object);
 
+	/// Returns a new id without creating any object for it.
+	/// The object must be added later with id_array::insert().
+	template <uint32_t MAX, typename T> Id reserve(IdArray<MAX, T>& a);
+
+	/// Reserves the given @a id, which must not be in use, so that an object
+	/// can be inserted with it later with id_array::insert().
+	/// Used to recreate objects with the ids they had before.
+	template <uint32_t MAX, typename T> void reserve(IdArray<MAX, T>& a, Id id);
+
+	/// Inserts the @a object with the @a id previously returned by id_array::reserve().
+	template <uint32_t MAX, typename T> void insert(IdArray<MAX, T>& a, Id id, const T& object);
+
 	/// Destroys the object with the given @a id.
 	template <uint32_t MAX, typename T> void destroy(IdArray<MAX, T>& a, Id id);
 
@@ -93,7 +108,15 @@ namespace id_array
 	template <uint32_t MAX, typename T>
 	inline Id create(IdArray<MAX, T>& a, const T& object)
 	{
-		CE_ASSERT(a._size < MAX, "Object list full");
+		const Id id = reserve(a);
+		insert(a, id, object);
+		return id;
+	}
+
+	template <uint32_t MAX, typename T>
+	inline Id reserve(IdArray<MAX, T>& a)
+	{
+		CE_ASSERT(a._size + a._num_reserved < MAX, "Object list full");
 
 		// Obtain a new id
 		Id id;
@@ -107,16 +130,62 @@ namespace id_array
 		}
 		else
 		{
-			id.index = a._size;
+			// Without free slots every index below this one is either used or reserved
+			id.index = a._size + a._num_reserved;
 		}
 
+		a._num_reserved++;
+		return id;
+	}
+
+	template <uint32_t MAX, typename T>
+	inline void reserve(IdArray<MAX, T>& a, Id id)
+	{
+		CE_ASSERT(a._size + a._num_reserved < MAX, "Object list full");
+		CE_ASSERT(id.index < MAX, "Index out of bounds");
+
+		uint32_t num_free = 0;
+		uint16_t* slot = &a._freelist;
+		while (*slot != INVALID_ID && *slot != id.index)
+		{
+			slot = &a._sparse[*slot].index;
+			num_free++;
+		}
+
+		if (*slot == id.index)
+		{
+			// Unlink the slot from the free list
+			*slot = a._sparse[id.index].index;
+		}
+		else
+		{
+			// Every index below this one is either used, reserved or free,
+			// put the ones up to id.index in the free list
+			const uint32_t first = a._size + a._num_reserved + num_free;
+			CE_ASSERT(id.index >= first, "Id already in use");
+
+			for (uint32_t i = first; i < id.index; i++)
+			{
+				a._sparse[i].index = a._freelist;
+				a._freelist = i;
+			}
+		}
+
+		a._num_reserved++;
+	}
+
+	template <uint32_t MAX, typename T>
+	inline void insert(IdArray<MAX, T>& a, Id id, const T& object)
+	{
+		CE_ASSERT(a._num_reserved > 0, "No ids reserved");
+		CE_ASSERT(a._sparse[id.index].id == INVALID_ID, "Id already inserted");
+
 		a._sparse[id.index] = id;
 		a._sparse_to_dense[id.index] = a._size;
 		a._dense_to_sparse[a._size] = id.index;
 		a._objects[a._size] = object;
 		a._size++;
-
-		return id;
+		a._num_reserved--;
 	}
 
 	template <uint32_t MAX, typename T>
@@ -191,6 +260,7 @@ inline IdArray<MAX, T>::IdArray()
 	: _freelist(INVALID_ID)
 	, _next_id(0)
 	, _size(0)
+	, _num_reserved(0)
 {
 	for (uint32_t i = 0; i < MAX; i++)
 	{
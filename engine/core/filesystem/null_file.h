@@ -105,17 +105,17 @@ public:
 	/// @copydoc File::can_read()
 	/// @note
 	///	Returns always true
-	bool can_read() { return true; }
+	bool can_read() const { return true; }
 
 	/// @copydoc File::can_write()
 	/// @note
 	///	Returns always true
-	bool can_write() { return true; }
+	bool can_write() const { return true; }
 
 	/// @copydoc File::can_seek()
 	/// @note
 	///	Returns always true
-	bool can_seek() { return true; }
+	bool can_seek() const { return true; }
 };
 
 } // namespace crown
@@ -28,6 +28,7 @@ OTHER DEALINGS IN THE SOFTWARE.
 
 #include "types.h"
 #include "file.h"
+#include <cstring>
 
 namespace crown
 {
@@ -101,33 +102,74 @@ private:
 };
 
 /// A writer that offers a convenient way to write to a File
+/// @note
+/// Data is accumulated into an internal buffer and passed to the file
+/// in blocks, call flush() or destroy the writer to complete the writes.
 ///
 /// @ingroup Filesystem
 class BinaryWriter
 {
 public:
 
-	BinaryWriter(File& file) : m_file(file) {}
+	BinaryWriter(File& file) : m_file(file), m_size(0) {}
+
+	~BinaryWriter()
+	{
+		flush();
+	}
 
 	void write(const void* data, size_t size)
 	{
-		m_file.write(data, size);
+		if (m_size + size > BUFFER_SIZE)
+		{
+			flush();
+		}
+
+		if (size > BUFFER_SIZE)
+		{
+			m_file.write(data, size);
+			return;
+		}
+
+		memcpy(m_buffer + m_size, data, size);
+		m_size += size;
 	}
 
 	template <typename T>
 	void write(const T& data)
 	{
-		m_file.write(&data, sizeof(T));
+		write(&data, sizeof(T));
 	}
 
 	void skip(size_t bytes)
 	{
+		flush();
 		m_file.skip(bytes);
 	}
 
+	/// Writes the buffered data to the file.
+	void flush()
+	{
+		if (m_size > 0)
+		{
+			m_file.write(m_buffer, m_size);
+			m_size = 0;
+		}
+	}
+
 private:
 
+	static const size_t BUFFER_SIZE = 4096;
+
 	File& m_file;
+	size_t m_size;
+	char m_buffer[BUFFER_SIZE];
+
+private:
+
+	// Disable copying
+	BinaryWriter(const BinaryWriter&);
+	BinaryWriter& operator=(const BinaryWriter&);
 };
 
 /// A reader that offers a convenient way to read from a File
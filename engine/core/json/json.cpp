@@ -29,6 +29,7 @@ OTHER DEALINGS IN THE SOFTWARE.
 #include "string_utils.h"
 #include "dynamic_string.h"
 #include "map.h"
+#include "temp_allocator.h"
 
 namespace crown
 {
@@ -283,7 +284,9 @@ namespace json
 
 		const char* ch = s;
 
-	 	Array<char> str(default_allocator());
+		// Usual numbers fit in the temp buffer, longer ones spill to the heap
+		TempAllocator64 alloc;
+		Array<char> str(alloc);
 
 		if ((*ch) == '-')
 		{
@@ -28,49 +28,198 @@ OTHER DEALINGS IN THE SOFTWARE.
 #include "json.h"
 #include "temp_allocator.h"
 #include "string_utils.h"
+#include "array.h"
 #include "vector.h"
-#include "map.h"
 #include "vector2.h"
 #include "vector3.h"
 #include "vector4.h"
 #include "quaternion.h"
 #include "matrix4x4.h"
 #include "file.h"
+#include <algorithm>
 
 namespace crown
 {
 
+static const uint32_t NO_NODE = 0xFFFFFFFFu;
+
+namespace json_parser_internal
+{
+	static const char* skip_whites(const char* s)
+	{
+		while ((*s) && (*s) <= ' ') s++;
+		return s;
+	}
+
+	static const char* skip_string(const char* s)
+	{
+		CE_ASSERT(*s == '"', "Bad string");
+
+		const char* ch = s + 1;
+		while (*ch && *ch != '"')
+		{
+			if (*ch == '\\' && *(ch + 1)) ch++;
+			ch++;
+		}
+
+		CE_ASSERT(*ch == '"', "Bad string");
+		return *ch ? ch + 1 : ch;
+	}
+
+	static const char* skip_number(const char* s)
+	{
+		const char* ch = s;
+		while ((*ch >= '0' && *ch <= '9') || *ch == '-' || *ch == '.' ||
+			*ch == '+' || *ch == 'e' || *ch == 'E')
+		{
+			ch++;
+		}
+
+		CE_ASSERT(ch != s, "Bad number");
+		return ch;
+	}
+
+	static const char* skip_literal(const char* s, const char* literal)
+	{
+		const size_t len = string::strlen(literal);
+		CE_ASSERT(string::strncmp(s, literal, len) == 0, "Expected '%s'", literal);
+		CE_UNUSED(len);
+
+		const char* ch = s;
+		while (*literal && *ch == *literal)
+		{
+			ch++;
+			literal++;
+		}
+
+		return ch;
+	}
+
+	/// Returns the murmur2_32 of the key string which spans [begin, end).
+	static StringId32 key_id(const char* begin, const char* end)
+	{
+		const char* ch = begin + 1;
+		while (ch < end - 1 && *ch != '\\') ch++;
+
+		if (ch == end - 1)
+			return string::murmur2_32(begin + 1, end - begin - 2);
+
+		// Escaped keys are hashed in their decoded form
+		DynamicString str;
+		json::parse_string(begin, str);
+		return str.to_string_id();
+	}
+
+	static bool key_equals(const char* key, const char* k, size_t len)
+	{
+		if (string::strncmp(key + 1, k, len) == 0 && key[len + 1] == '"')
+			return true;
+
+		DynamicString str;
+		json::parse_string(key, str);
+		return str == k;
+	}
+
+	struct KeyIdCompare
+	{
+		KeyIdCompare(const JSONNode* nodes) : nodes(nodes) {}
+
+		bool operator()(uint32_t a, uint32_t b) const
+		{
+			// Nodes are created in order of appearance, so ties keep that order
+			return nodes[a].key_id < nodes[b].key_id
+				|| (nodes[a].key_id == nodes[b].key_id && a < b);
+		}
+
+		const JSONNode* nodes;
+	};
+} // namespace json_parser_internal
+
 JSONElement::JSONElement()
-	: m_at(NULL)
+	: m_parser(NULL)
+	, m_node(0)
 {
 }
 
-JSONElement::JSONElement(const char* at)
-	: m_at(at)
+JSONElement::JSONElement(const JSONParser& parser, uint32_t node)
+	: m_parser(&parser)
+	, m_node(node)
 {
 }
 
 JSONElement::JSONElement(const JSONElement& other)
-	: m_at(other.m_at)
+	: m_parser(other.m_parser)
+	, m_node(other.m_node)
 {
 }
 
 JSONElement& JSONElement::operator=(const JSONElement& other)
 {
-	// Our begin is the other's at
-	m_at = other.m_at;
+	m_parser = other.m_parser;
+	m_node = other.m_node;
 	return *this;
 }
 
-JSONElement JSONElement::operator[](uint32_t i)
+const JSONNode& JSONElement::node() const
+{
+	CE_ASSERT_NOT_NULL(m_parser);
+	return m_parser->m_nodes[m_node];
+}
+
+const char* JSONElement::child(uint32_t i) const
 {
-	Array<const char*> array(default_allocator());
+	const JSONNode& n = node();
+	CE_ASSERT(i < n.size, "Index out of bounds");
+	return m_parser->m_nodes[m_parser->m_children[n.first + i]].at;
+}
+
+uint32_t JSONElement::find(const char* k) const
+{
+	using namespace json_parser_internal;
+
+	const JSONNode& n = node();
+	CE_ASSERT(n.type == JSONType::OBJECT, "Not an object");
 
-	json::parse_array(m_at, array);
+	const size_t len = string::strlen(k);
+	const StringId32 id = string::murmur2_32(k, len);
 
-	CE_ASSERT(i < array::size(array), "Index out of bounds");
+	// Sorted slots follow the slots in order of appearance
+	const uint32_t* first = array::begin(m_parser->m_children) + n.first + n.size;
+	const JSONNode* nodes = array::begin(m_parser->m_nodes);
 
-	return JSONElement(array[i]);
+	// Find the first slot past the key id and walk back, so that the
+	// last key in order of appearance wins
+	const uint32_t* it = first;
+	uint32_t count = n.size;
+	while (count > 0)
+	{
+		const uint32_t step = count / 2;
+		if (nodes[it[step]].key_id <= id)
+		{
+			it += step + 1;
+			count -= step + 1;
+		}
+		else
+			count = step;
+	}
+
+	while (it != first && nodes[*(it - 1)].key_id == id)
+	{
+		--it;
+		if (key_equals(nodes[*it].key, k, len))
+			return *it;
+	}
+
+	return NO_NODE;
+}
+
+JSONElement JSONElement::operator[](uint32_t i)
+{
+	const JSONNode& n = node();
+	CE_ASSERT(n.type == JSONType::ARRAY, "Not an array");
+	CE_ASSERT(i < n.size, "Index out of bounds");
+
+	return JSONElement(*m_parser, m_parser->m_children[n.first + i]);
 }
 
 JSONElement JSONElement::index(uint32_t i)
@@ -80,18 +229,17 @@ JSONElement JSONElement::index(uint32_t i)
 
 JSONElement JSONElement::index_or_nil(uint32_t i)
 {
-	if (m_at != NULL)
+	if (m_parser != NULL)
 	{
-		Array<const char*> array(default_allocator());
-
-		json::parse_array(m_at, array);
+		const JSONNode& n = node();
+		CE_ASSERT(n.type == JSONType::ARRAY, "Not an array");
 
-		if (i >= array::size(array))
+		if (i >= n.size)
 		{
 			return JSONElement();
 		}
 
-		return JSONElement(array[i]);
+		return JSONElement(*m_parser, m_parser->m_children[n.first + i]);
 	}
 
 	return JSONElement();
@@ -99,26 +247,20 @@ JSONElement JSONElement::index_or_nil(uint32_t i)
 
 JSONElement JSONElement::key(const char* k)
 {
-	Map<DynamicString, const char*> object(default_allocator());
-	json::parse_object(m_at, object);
+	const uint32_t value = find(k);
+	CE_ASSERT(value != NO_NODE, "Key not found: '%s'", k);
 
-	const char* value = map::get(object, DynamicString(k), (const char*) NULL);
-	CE_ASSERT(value != NULL, "Key not found: '%s'", k);
-
-	return JSONElement(value);
+	return JSONElement(*m_parser, value);
 }
 
 JSONElement JSONElement::key_or_nil(const char* k)
 {
-	if (m_at != NULL)
+	if (m_parser != NULL)
 	{
-		Map<DynamicString, const char*> object(default_allocator());
-		json::parse_object(m_at, object);
-
-		const char* value = map::get(object, DynamicString(k), (const char*) NULL);
+		const uint32_t value = find(k);
 
-		if (value)
-			return JSONElement(value);
+		if (value != NO_NODE)
+			return JSONElement(*m_parser, value);
 	}
 
 	return JSONElement();
@@ -126,25 +268,22 @@ JSONElement JSONElement::key_or_nil(const char* k)
 
 bool JSONElement::has_key(const char* k) const
 {
-	Map<DynamicString, const char*> object(default_allocator());
-	json::parse_object(m_at, object);
-
-	return map::has(object, DynamicString(k));
+	return find(k) != NO_NODE;
 }
 
 bool JSONElement::to_bool(bool def) const
 {
-	return is_nil() ? def : json::parse_bool(m_at);
+	return is_nil() ? def : json::parse_bool(node().at);
 }
 
 int32_t JSONElement::to_int(int32_t def) const
 {
-	return is_nil() ? def : json::parse_int(m_at);
+	return is_nil() ? def : json::parse_int(node().at);
 }
 
 float JSONElement::to_float(float def) const
 {
-	return is_nil() ? def : json::parse_float(m_at);
+	return is_nil() ? def : json::parse_float(node().at);
 }
 
 void JSONElement::to_string(DynamicString& str, const char* def) const
@@ -152,7 +291,7 @@ void JSONElement::to_string(DynamicString& str, const char* def) const
 	if (is_nil())
 		str = def;
 	else
-		json::parse_string(m_at, str);
+		json::parse_string(node().at, str);
 }
 
 Vector2 JSONElement::to_vector2(const Vector2& def) const
@@ -160,12 +299,8 @@ Vector2 JSONElement::to_vector2(const Vector2& def) const
 	if (is_nil())
 		return def;
 
-	TempAllocator64 alloc;
-	Array<const char*> array(alloc);
-	json::parse_array(m_at, array);
-
-	return Vector2(json::parse_float(array[0]),
-					json::parse_float(array[1]));
+	return Vector2(json::parse_float(child(0)),
+					json::parse_float(child(1)));
 }
 
 Vector3 JSONElement::to_vector3(const Vector3& def) const
@@ -173,13 +308,9 @@ Vector3 JSONElement::to_vector3(const Vector3& def) const
 	if (is_nil())
 		return def;
 
-	TempAllocator64 alloc;
-	Array<const char*> array(alloc);
-	json::parse_array(m_at, array);
-
-	return Vector3(json::parse_float(array[0]),
-					json::parse_float(array[1]),
-					json::parse_float(array[2]));
+	return Vector3(json::parse_float(child(0)),
+					json::parse_float(child(1)),
+					json::parse_float(child(2)));
 }
 
 Vector4 JSONElement::to_vector4(const Vector4& def) const
@@ -187,14 +318,10 @@ Vector4 JSONElement::to_vector4(const Vector4& def) const
 	if (is_nil())
 		return def;
 
-	TempAllocator64 alloc;
-	Array<const char*> array(alloc);
-	json::parse_array(m_at, array);
-
-	return Vector4(json::parse_float(array[0]),
-					json::parse_float(array[1]),
-					json::parse_float(array[2]),
-					json::parse_float(array[3]));
+	return Vector4(json::parse_float(child(0)),
+					json::parse_float(child(1)),
+					json::parse_float(child(2)),
+					json::parse_float(child(3)));
 }
 
 Quaternion JSONElement::to_quaternion(const Quaternion& def) const
@@ -202,14 +329,10 @@ Quaternion JSONElement::to_quaternion(const Quaternion& def) const
 	if (is_nil())
 		return def;
 
-	TempAllocator64 alloc;
-	Array<const char*> array(alloc);
-	json::parse_array(m_at, array);
-
-	return Quaternion(json::parse_float(array[0]),
-					json::parse_float(array[1]),
-					json::parse_float(array[2]),
-					json::parse_float(array[3]));
+	return Quaternion(json::parse_float(child(0)),
+					json::parse_float(child(1)),
+					json::parse_float(child(2)),
+					json::parse_float(child(3)));
 }
 
 Matrix4x4 JSONElement::to_matrix4x4(const Matrix4x4& def) const
@@ -231,123 +354,107 @@ StringId32 JSONElement::to_string_id(const StringId32 def) const
 
 	TempAllocator1024 alloc;
 	DynamicString str(alloc);
-	json::parse_string(m_at, str);
+	json::parse_string(node().at, str);
 	return str.to_string_id();
 }
 
 ResourceId JSONElement::to_resource_id(const char* type) const
 {
 	CE_ASSERT_NOT_NULL(type);
-	// TempAllocator1024 alloc;
-	DynamicString str(default_allocator());
-	json::parse_string(m_at, str);
+	TempAllocator1024 alloc;
+	DynamicString str(alloc);
+	json::parse_string(node().at, str);
 	return ResourceId(type, str.c_str());
 }
 
 void JSONElement::to_array(Array<bool>& array) const
 {
-	Array<const char*> temp(default_allocator());
-
-	json::parse_array(m_at, temp);
-
-	for (uint32_t i = 0; i < array::size(temp); i++)
+	const uint32_t num = size();
+	for (uint32_t i = 0; i < num; i++)
 	{
-		array::push_back(array, json::parse_bool(temp[i]));
+		array::push_back(array, json::parse_bool(child(i)));
 	}
 }
 
 void JSONElement::to_array(Array<int16_t>& array) const
 {
-	Array<const char*> temp(default_allocator());
-
-	json::parse_array(m_at, temp);
-
-	for (uint32_t i = 0; i < array::size(temp); i++)
+	const uint32_t num = size();
+	for (uint32_t i = 0; i < num; i++)
 	{
-		array::push_back(array, (int16_t)json::parse_int(temp[i]));
+		array::push_back(array, (int16_t)json::parse_int(child(i)));
 	}
 }
 
 void JSONElement::to_array(Array<uint16_t>& array) const
 {
-	Array<const char*> temp(default_allocator());
-
-	json::parse_array(m_at, temp);
-
-	for (uint32_t i = 0; i < array::size(temp); i++)
+	const uint32_t num = size();
+	for (uint32_t i = 0; i < num; i++)
 	{
-		array::push_back(array, (uint16_t)json::parse_int(temp[i]));
+		array::push_back(array, (uint16_t)json::parse_int(child(i)));
 	}
 }
 
 void JSONElement::to_array(Array<int32_t>& array) const
 {
-	Array<const char*> temp(default_allocator());
-
-	json::parse_array(m_at, temp);
-
-	for (uint32_t i = 0; i < array::size(temp); i++)
+	const uint32_t num = size();
+	for (uint32_t i = 0; i < num; i++)
 	{
-		array::push_back(array, (int32_t)json::parse_int(temp[i]));
+		array::push_back(array, (int32_t)json::parse_int(child(i)));
 	}
 }
 
 void JSONElement::to_array(Array<uint32_t>& array) const
 {
-	Array<const char*> temp(default_allocator());
-
-	json::parse_array(m_at, temp);
-
-	for (uint32_t i = 0; i < array::size(temp); i++)
+	const uint32_t num = size();
+	for (uint32_t i = 0; i < num; i++)
 	{
-		array::push_back(array, (uint32_t)json::parse_int(temp[i]));
+		array::push_back(array, (uint32_t)json::parse_int(child(i)));
 	}
 }
 
 void JSONElement::to_array(Array<float>& array) const
 {
-	Array<const char*> temp(default_allocator());
-
-	json::parse_array(m_at, temp);
-
-	for (uint32_t i = 0; i < array::size(temp); i++)
+	const uint32_t num = size();
+	for (uint32_t i = 0; i < num; i++)
 	{
-		array::push_back(array, json::parse_float(temp[i]));
+		array::push_back(array, json::parse_float(child(i)));
 	}
 }
 
 void JSONElement::to_array(Vector<DynamicString>& array) const
 {
-	Array<const char*> temp(default_allocator());
-
-	json::parse_array(m_at, temp);
-
-	for (uint32_t i = 0; i < array::size(temp); i++)
+	const uint32_t num = size();
+	for (uint32_t i = 0; i < num; i++)
 	{
 		DynamicString str;
-		json::parse_string(temp[i], str);
+		json::parse_string(child(i), str);
 		vector::push_back(array, str);
 	}
 }
 
 void JSONElement::to_keys(Vector<DynamicString>& keys) const
 {
-	Map<DynamicString, const char*> object(default_allocator());
-	json::parse_object(m_at, object);
+	const JSONNode& n = node();
+	CE_ASSERT(n.type == JSONType::OBJECT, "Not an object");
 
-	const Map<DynamicString, const char*>::Node* it = map::begin(object);
-	while (it != map::end(object))
+	for (uint32_t i = 0; i < n.size; i++)
 	{
-		vector::push_back(keys, (*it).key);
-		it++;
+		const uint32_t value = m_parser->m_children[n.first + i];
+
+		DynamicString key;
+		json::parse_string(m_parser->m_nodes[value].key, key);
+
+		// Duplicated keys are reported once, as key() does
+		if (find(key.c_str()) == value)
+			vector::push_back(keys, key);
 	}
 }
 
 bool JSONElement::is_nil() const
 {
-	if (m_at != NULL)
+	if (m_parser != NULL)
 	{
-		return json::type(m_at) == JSONType::NIL;
+		return node().type == JSONType::NIL;
 	}
 
 	return true;
@@ -355,9 +462,9 @@ bool JSONElement::is_nil() const
 
 bool JSONElement::is_bool() const
 {
-	if (m_at != NULL)
+	if (m_parser != NULL)
 	{
-		return json::type(m_at) == JSONType::BOOL;
+		return node().type == JSONType::BOOL;
 	}
 
 	return false;
@@ -365,9 +472,9 @@ bool JSONElement::is_bool() const
 
 bool JSONElement::is_number() const
 {
-	if (m_at != NULL)
+	if (m_parser != NULL)
 	{
-		return json::type(m_at) == JSONType::NUMBER;
+		return node().type == JSONType::NUMBER;
 	}
 
 	return false;
@@ -375,9 +482,9 @@ bool JSONElement::is_number() const
 
 bool JSONElement::is_string() const
 {
-	if (m_at != NULL)
+	if (m_parser != NULL)
 	{
-		return json::type(m_at) == JSONType::STRING;
+		return node().type == JSONType::STRING;
 	}
 
 	return false;
@@ -385,9 +492,9 @@ bool JSONElement::is_string() const
 
 bool JSONElement::is_array() const
 {
-	if (m_at != NULL)
+	if (m_parser != NULL)
 	{
-		return json::type(m_at) == JSONType::ARRAY;
+		return node().type == JSONType::ARRAY;
 	}
 
 	return false;
@@ -395,9 +502,9 @@ bool JSONElement::is_array() const
 
 bool JSONElement::is_object() const
 {
-	if (m_at != NULL)
+	if (m_parser != NULL)
 	{
-		return json::type(m_at) == JSONType::OBJECT;
+		return node().type == JSONType::OBJECT;
 	}
 
 	return false;
@@ -405,33 +512,28 @@ bool JSONElement::is_object() const
 
 uint32_t JSONElement::size() const
 {
-	if (m_at == NULL)
+	if (m_parser == NULL)
 	{
 		return 0;
 	}
 
-	switch(json::type(m_at))
+	const JSONNode& n = node();
+
+	switch(n.type)
 	{
 		case JSONType::NIL:
 		{
 			return 1;
 		}
 		case JSONType::OBJECT:
-		{
-			Map<DynamicString, const char*> object(default_allocator());
-			json::parse_object(m_at, object);
-			return map::size(object);
-		}
 		case JSONType::ARRAY:
 		{
-			Array<const char*> array(default_allocator());
-			json::parse_array(m_at, array);
-			return array::size(array);
+			return n.size;
 		}
 		case JSONType::STRING:
 		{
 			DynamicString string;
-			json::parse_string(m_at, string);
+			json::parse_string(n.at, string);
 			return string.length();
 		}
 		case JSONType::NUMBER:
@@ -453,18 +555,29 @@ uint32_t JSONElement::size() const
 JSONParser::JSONParser(const char* s)
 	: m_file(false)
 	, m_document(s)
+	, m_nodes(default_allocator())
+	, m_children(default_allocator())
+	, m_stack(default_allocator())
 {
 	CE_ASSERT_NOT_NULL(s);
+
+	parse_value(json_parser_internal::skip_whites(m_document), NULL, 0);
 }
 
 JSONParser::JSONParser(File& f)
 	: m_file(true)
 	, m_document(NULL)
+	, m_nodes(default_allocator())
+	, m_children(default_allocator())
+	, m_stack(default_allocator())
 {
 	const size_t size = f.size();
-	char* doc = (char*) default_allocator().allocate(size);
+	char* doc = (char*) default_allocator().allocate(size + 1);
 	f.read(doc, size);
+	doc[size] = '\0';
 	m_document = doc;
+
+	parse_value(json_parser_internal::skip_whites(m_document), NULL, 0);
 }
 
 JSONParser::~JSONParser()
@@ -477,10 +590,111 @@ JSONParser::~JSONParser()
 
 JSONElement JSONParser::root()
 {
-	const char* ch = m_document;
-	while ((*ch) && (*ch) <= ' ') ch++;
+	return JSONElement(*this, 0);
+}
+
+const char* JSONParser::parse_value(const char* s, const char* key, StringId32 key_id)
+{
+	using namespace json_parser_internal;
+
+	JSONNode n;
+	n.at = s;
+	n.key = key;
+	n.key_id = key_id;
+	n.type = json::type(s);
+	n.size = 0;
+	n.first = 0;
+
+	const uint32_t node = array::size(m_nodes);
+	array::push_back(m_nodes, n);
+	array::push_back(m_stack, node);
+
+	switch (n.type)
+	{
+		case JSONType::OBJECT: return parse_object(s, node);
+		case JSONType::ARRAY: return parse_array(s, node);
+		case JSONType::STRING: return skip_string(s);
+		case JSONType::NUMBER: return skip_number(s);
+		case JSONType::NIL: return skip_literal(s, "null");
+		case JSONType::BOOL: return skip_literal(s, *s == 't' ? "true" : "false");
+		default: CE_FATAL("Oops, unknown value type"); return s;
+	}
+}
+
+const char* JSONParser::parse_array(const char* s, uint32_t node)
+{
+	using namespace json_parser_internal;
+
+	const uint32_t mark = array::size(m_stack);
+	const char* ch = skip_whites(s + 1);
+
+	while (*ch && *ch != ']')
+	{
+		ch = parse_value(ch, NULL, 0);
+		ch = skip_whites(ch);
+
+		if (*ch == ']')
+			break;
+
+		CE_ASSERT(*ch == ',', "Bad array");
+		ch = skip_whites(ch + 1);
+	}
+
+	CE_ASSERT(*ch == ']', "Bad array");
+	close_container(node, mark, false);
+	return *ch ? ch + 1 : ch;
+}
+
+const char* JSONParser::parse_object(const char* s, uint32_t node)
+{
+	using namespace json_parser_internal;
+
+	const uint32_t mark = array::size(m_stack);
+	const char* ch = skip_whites(s + 1);
+
+	while (*ch && *ch != '}')
+	{
+		const char* key = ch;
+		ch = skip_string(ch);
+		const StringId32 id = key_id(key, ch);
+
+		ch = skip_whites(ch);
+		CE_ASSERT(*ch == ':', "Bad object");
+		ch = skip_whites(*ch ? ch + 1 : ch);
+
+		ch = parse_value(ch, key, id);
+		ch = skip_whites(ch);
+
+		if (*ch == '}')
+			break;
+
+		CE_ASSERT(*ch == ',', "Bad object");
+		ch = skip_whites(*ch ? ch + 1 : ch);
+	}
+
+	CE_ASSERT(*ch == '}', "Bad object");
+	close_container(node, mark, true);
+	return *ch ? ch + 1 : ch;
+}
+
+void JSONParser::close_container(uint32_t node, uint32_t mark, bool sort)
+{
+	const uint32_t num = array::size(m_stack) - mark;
+	const uint32_t first = array::size(m_children);
+
+	array::push(m_children, array::begin(m_stack) + mark, num);
+
+	if (sort)
+	{
+		array::push(m_children, array::begin(m_stack) + mark, num);
+		std::sort(array::begin(m_children) + first + num, array::end(m_children),
+			json_parser_internal::KeyIdCompare(array::begin(m_nodes)));
+	}
+
+	array::resize(m_stack, mark);
 
-	return JSONElement(ch);
+	m_nodes[node].size = num;
+	m_nodes[node].first = first;
 }
 
 } //namespace crown
@@ -41,6 +41,19 @@ class JSONParser;
 class DynamicString;
 class File;
 
+/// Entry of the document index built by JSONParser.
+///
+/// @ingroup JSON
+struct JSONNode
+{
+	const char* at;		// Start of the value in the document
+	const char* key;	// Start of the key string if the value is a member of an object, NULL otherwise
+	StringId32 key_id;	// Key hashed with string::murmur2_32()
+	uint32_t type;		// JSONType::Enum
+	uint32_t size;		// Number of items (arrays) or keys (objects), 0 otherwise
+	uint32_t first;		// First child slot in JSONParser::m_children
+};
+
 /// Represents a JSON element.
 /// The objects of this class are valid until the parser
 /// which has generated them, will exist.
@@ -54,7 +67,6 @@ public:
 	/// Used to forward-instantiate elements or as a special
 	/// nil element.
 	JSONElement();
-	explicit JSONElement(const char* at);
 	JSONElement(const JSONElement& other);
 
 	JSONElement& operator=(const JSONElement& other);
@@ -179,12 +191,31 @@ public:
 
 private:
 
-	const char* m_at;
+	JSONElement(const JSONParser& parser, uint32_t node);
+
+	const JSONNode& node() const;
+
+	/// Returns the @a i -th child value of the current array or object
+	/// in order of appearance.
+	const char* child(uint32_t i) const;
+
+	/// Returns the node index of the value of key @a k or an
+	/// invalid index if the current object has no such key.
+	uint32_t find(const char* k) const;
+
+private:
+
+	const JSONParser* m_parser;
+	uint32_t m_node;
 
 	friend class JSONParser;
 };
 
 /// Parses JSON documents.
+/// The document is scanned once at construction time and indexed into
+/// an array of JSONNode where the children of every array and object are
+/// stored contiguously, so that accessing items by index is O(1) and
+/// accessing values by key is O(log n) in the number of keys of the object.
 ///
 /// @ingroup JSON
 class JSONParser
@@ -205,10 +236,26 @@ public:
 	/// Returns the root element of the JSON document.
 	JSONElement root();
 
+private:
+
+	const char* parse_value(const char* s, const char* key, StringId32 key_id);
+	const char* parse_array(const char* s, uint32_t node);
+	const char* parse_object(const char* s, uint32_t node);
+
+	/// Moves the children of @a node from the scratch stack to m_children.
+	/// Objects store their children twice: in order of appearance followed
+	/// by the same slots sorted by key id.
+	void close_container(uint32_t node, uint32_t mark, bool sort);
+
 private:
 
 	bool m_file;
 	const char* m_document;
+	Array<JSONNode> m_nodes;
+	Array<uint32_t> m_children;
+	Array<uint32_t> m_stack;
+
+	friend class JSONElement;
 
 private:
 
@@ -0,0 +1,114 @@
+/*
+Copyright (c) 2013 Daniele Bartolini, Michele Rossi
+Copyright (c) 2012 Daniele Bartolini, Simone Boscaratto
+
+Permission is hereby granted, free of charge, to any person
+obtaining a copy of this software and associated documentation
+files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use,
+copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following
+conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "json_schema.h"
+#include "array.h"
+#include "vector2.h"
+#include "vector3.h"
+#include "vector4.h"
+#include "quaternion.h"
+#include "matrix4x4.h"
+#include <cstring>
+
+namespace crown
+{
+namespace json_schema
+{
+	static const uint32_t FIELD_SIZE[] =
+	{
+		sizeof(bool),		// BOOL
+		sizeof(int32_t),	// INT32
+		sizeof(uint32_t),	// UINT32
+		sizeof(float),		// FLOAT
+		sizeof(Vector2),	// VECTOR2
+		sizeof(Vector3),	// VECTOR3
+		sizeof(Vector4),	// VECTOR4
+		sizeof(Quaternion),	// QUATERNION
+		sizeof(Matrix4x4),	// MATRIX4X4
+		sizeof(StringId32),	// STRING_ID32
+		sizeof(StringId64),	// RESOURCE_NAME
+		0					// PADDING
+	};
+
+	void validate(const JSONSchema& schema)
+	{
+		CE_ASSERT(CE_COUNTOF(FIELD_SIZE) == JSONFieldType::COUNT, "Field size table out of date");
+
+		uint32_t end = 0;
+		for (uint32_t i = 0; i < schema.num_fields; i++)
+		{
+			const JSONField& f = schema.fields[i];
+
+			CE_ASSERT(f.type < JSONFieldType::COUNT, "Unknown field type: %d", f.type);
+			CE_ASSERT(f.offset == end, "Field %d is not contiguous (offset = %d, expected = %d)", i, f.offset, end);
+			CE_ASSERT(f.type == JSONFieldType::PADDING || f.key != NULL, "Field %d has no key", i);
+			CE_ASSERT(f.type == JSONFieldType::PADDING || f.size == FIELD_SIZE[f.type], "Field '%s' size mismatch", f.key);
+			CE_ASSERT(f.type != JSONFieldType::RESOURCE_NAME || f.resource_type != NULL, "Field '%s' has no resource type", f.key);
+
+			end = f.offset + f.size;
+		}
+
+		CE_ASSERT(end == schema.size, "Fields do not cover the structure (size = %d, expected = %d)", end, schema.size);
+		CE_UNUSED(end);
+	}
+
+	void read(const JSONSchema& schema, JSONElement e, void* out)
+	{
+		CE_ASSERT_NOT_NULL(out);
+		CE_ASSERT(e.is_object(), "Not an object");
+
+		for (uint32_t i = 0; i < schema.num_fields; i++)
+		{
+			const JSONField& f = schema.fields[i];
+			char* dst = (char*) out + f.offset;
+
+			if (f.type == JSONFieldType::PADDING)
+			{
+				memset(dst, 0, f.size);
+				continue;
+			}
+
+			JSONElement value = e.key(f.key);
+
+			switch (f.type)
+			{
+				case JSONFieldType::BOOL: *(bool*) dst = value.to_bool(); break;
+				case JSONFieldType::INT32: *(int32_t*) dst = value.to_int(); break;
+				case JSONFieldType::UINT32: *(uint32_t*) dst = (uint32_t) value.to_int(); break;
+				case JSONFieldType::FLOAT: *(float*) dst = value.to_float(); break;
+				case JSONFieldType::VECTOR2: *(Vector2*) dst = value.to_vector2(); break;
+				case JSONFieldType::VECTOR3: *(Vector3*) dst = value.to_vector3(); break;
+				case JSONFieldType::VECTOR4: *(Vector4*) dst = value.to_vector4(); break;
+				case JSONFieldType::QUATERNION: *(Quaternion*) dst = value.to_quaternion(); break;
+				case JSONFieldType::MATRIX4X4: *(Matrix4x4*) dst = value.to_matrix4x4(); break;
+				case JSONFieldType::STRING_ID32: *(StringId32*) dst = value.to_string_id(); break;
+				case JSONFieldType::RESOURCE_NAME: *(StringId64*) dst = value.to_resource_id(f.resource_type).name; break;
+				default: CE_FATAL("Oops, unknown field type"); break;
+			}
+		}
+	}
+} // namespace json_schema
+} // namespace crown
@@ -0,0 +1,132 @@
+/*
+Copyright (c) 2013 Daniele Bartolini, Michele Rossi
+Copyright (c) 2012 Daniele Bartolini, Simone Boscaratto
+
+Permission is hereby granted, free of charge, to any person
+obtaining a copy of this software and associated documentation
+files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use,
+copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following
+conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+
+#include "types.h"
+#include "macros.h"
+#include "container_types.h"
+#include "json_parser.h"
+
+namespace crown
+{
+
+/// Enumerates the types of the fields of a JSONSchema.
+///
+/// @ingroup JSON
+struct JSONFieldType
+{
+	enum Enum
+	{
+		BOOL,
+		INT32,
+		UINT32,
+		FLOAT,
+		VECTOR2,
+		VECTOR3,
+		VECTOR4,
+		QUATERNION,
+		MATRIX4X4,
+		STRING_ID32,	// String hashed to StringId32
+		RESOURCE_NAME,	// Resource name hashed to StringId64
+		PADDING,		// Not read from JSON, filled with zeroes
+
+		COUNT
+	};
+};
+
+/// Maps a JSON key to a member of a structure.
+///
+/// @ingroup JSON
+struct JSONField
+{
+	const char* key;
+	uint32_t type;				// JSONFieldType::Enum
+	uint32_t offset;
+	uint32_t size;
+	const char* resource_type;	// Only used by RESOURCE_NAME fields
+};
+
+/// Describes how to read a structure from a JSON object.
+/// Fields have to be declared in order of offset and have to cover
+/// the whole structure, including padding, so that arrays of the structure
+/// can be written in bulk as raw memory.
+///
+/// @ingroup JSON
+struct JSONSchema
+{
+	uint32_t size;
+	uint32_t num_fields;
+	const JSONField* fields;
+};
+
+#define CE_JSON_FIELD(type, member, field_type, key) \
+	{ key, JSONFieldType::field_type, uint32_t(CE_OFFSETOF(type, member)), uint32_t(sizeof(((type*) 0)->member)), NULL }
+
+#define CE_JSON_RESOURCE(type, member, key, resource_type) \
+	{ key, JSONFieldType::RESOURCE_NAME, uint32_t(CE_OFFSETOF(type, member)), uint32_t(sizeof(((type*) 0)->member)), resource_type }
+
+#define CE_JSON_PADDING(type, member) \
+	{ NULL, JSONFieldType::PADDING, uint32_t(CE_OFFSETOF(type, member)), uint32_t(sizeof(((type*) 0)->member)), NULL }
+
+#define CE_JSON_SCHEMA(type, fields) \
+	{ uint32_t(sizeof(type)), uint32_t(CE_COUNTOF(fields)), fields }
+
+/// Functions to read structures from JSON documents by means of a JSONSchema.
+///
+/// @ingroup JSON
+namespace json_schema
+{
+	/// Asserts that the fields of @a schema match their types, do not overlap
+	/// and cover the whole structure.
+	void validate(const JSONSchema& schema);
+
+	/// Reads the object @a e into the structure pointed by @a out.
+	/// Every key of the schema must be present in @a e.
+	void read(const JSONSchema& schema, JSONElement e, void* out);
+
+	/// Reads all the objects in the array @a e and appends them to @a out.
+	template <typename T> void read_array(const JSONSchema& schema, JSONElement e, Array<T>& out);
+} // namespace json_schema
+
+namespace json_schema
+{
+	template <typename T>
+	inline void read_array(const JSONSchema& schema, JSONElement e, Array<T>& out)
+	{
+		CE_ASSERT(sizeof(T) == schema.size, "Schema size mismatch");
+
+		const uint32_t first = array::size(out);
+		const uint32_t num = e.size();
+		array::resize(out, first + num);
+
+		for (uint32_t i = 0; i < num; i++)
+		{
+			read(schema, e[i], &out[first + i]);
+		}
+	}
+} // namespace json_schema
+} // namespace crown
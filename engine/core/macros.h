@@ -41,3 +41,5 @@ OTHER DEALINGS IN THE SOFTWARE.
 #endif
 
 #define CE_UNUSED(x) do { (void)(x); } while (0)
+#define CE_COUNTOF(arr) (sizeof(arr) / sizeof(arr[0]))
+#define CE_OFFSETOF(type, member) ((size_t) &(((type*) 0)->member))
@@ -281,5 +281,27 @@ namespace math
 		return true;
 	}
 
+	void frustum_spheres_intersection(const Frustum& f, uint32_t num, const float* x, const float* y, const float* z,
+		const float* radius, uint8_t* visible)
+	{
+		for (uint32_t i = 0; i < num; i++)
+		{
+			visible[i] = 1;
+		}
+
+		// One plane at a time so that the inner loop is a straight pass over the arrays
+		const Plane* planes = &f.left;
+		for (uint32_t p = 0; p < 6; p++)
+		{
+			const Plane& pl = planes[p];
+
+			for (uint32_t i = 0; i < num; i++)
+			{
+				const float dist = pl.n.x * x[i] + pl.n.y * y[i] + pl.n.z * z[i] + pl.d;
+				visible[i] &= (uint8_t) (dist >= -radius[i]);
+			}
+		}
+	}
+
 } // namespace math
 } // namespace crown
@@ -48,5 +48,10 @@ namespace math
 	bool plane_3_intersection(const Plane& p1, const Plane& p2, const Plane& p3, Vector3& ip);
 	bool frustum_sphere_intersection(const Frustum& f, const Sphere& s);
 	bool frustum_box_intersection(const Frustum& f, const AABB& b);
+
+	/// Tests @a num spheres, given as separate arrays of center coordinates and radii,
+	/// against the frustum @a f and writes 1 to @a visible for the ones intersecting it, 0 otherwise.
+	void frustum_spheres_intersection(const Frustum& f, uint32_t num, const float* x, const float* y, const float* z,
+		const float* radius, uint8_t* visible);
 } // namespace math
 } // namespace crown
@@ -31,6 +31,7 @@ OTHER DEALINGS IN THE SOFTWARE.
 #include "quaternion.h"
 #include "vector4.h"
 #include "types.h"
+#include "simd.h"
 
 namespace crown
 {
@@ -134,6 +135,14 @@ namespace matrix4x4
 
 	/// Returns the rotation portion of the matrix @a m as a Quaternion.
 	Quaternion to_quaternion(const Matrix4x4& m);
+
+	/// Multiplies @a count pairs of matrices, @a out[i] = @a a[i] * @a b[i].
+	/// @a out may alias @a a or @a b.
+	void multiply(const Matrix4x4* a, const Matrix4x4* b, Matrix4x4* out, uint32_t count);
+
+	/// Transforms @a count @a points by the matrix @a m and stores the results in @a out.
+	/// @a out may alias @a points.
+	void transform_points(const Matrix4x4& m, const Vector3* points, Vector3* out, uint32_t count);
 } // namespace matrix4x4
 
 inline Matrix4x4 operator+(Matrix4x4 a, const Matrix4x4& b)
@@ -181,10 +190,19 @@ inline Vector4 operator*(const Matrix4x4& a, const Vector4& v)
 {
 	Vector4 tmp;
 
+#if CROWN_SIMD_SSE
+	const __m128 r = simd::mul(simd::load(a), _mm_loadu_ps(&v.x));
+	_mm_storeu_ps(&tmp.x, r);
+#elif CROWN_SIMD_NEON
+	const float32x4_t r = simd::mul(simd::load(a), vld1q_f32(&v.x));
+	vst1q_f32(&tmp.x, r);
+#else
+
 	tmp.x = a.x.x * v.x + a.y.x * v.y + a.z.x * v.z + a.t.x * v.w;
 	tmp.y = a.x.y * v.x + a.y.y * v.y + a.z.y * v.z + a.t.y * v.w;
 	tmp.z = a.x.z * v.x + a.y.z * v.y + a.z.z * v.z + a.t.z * v.w;
 	tmp.w = a.x.w * v.x + a.y.w * v.y + a.z.w * v.z + a.t.w * v.w;
+#endif // CROWN_SIMD_SSE
 
 	return tmp;
 }
@@ -209,7 +227,7 @@ namespace matrix4x4
 		m.x.z = rot.x.z;
 		m.y.x = rot.y.x;
 		m.y.y = rot.y.y;
-		m.y.y = rot.y.z;
+		m.y.z = rot.y.z;
 		m.z.x = rot.z.x;
 		m.z.y = rot.z.y;
 		m.z.z = rot.z.z;
@@ -238,6 +256,23 @@ namespace matrix4x4
 
 	inline Matrix4x4& transpose(Matrix4x4& m)
 	{
+#if CROWN_SIMD_SSE
+		__m128 x = _mm_loadu_ps(&m.x.x);
+		__m128 y = _mm_loadu_ps(&m.y.x);
+		__m128 z = _mm_loadu_ps(&m.z.x);
+		__m128 t = _mm_loadu_ps(&m.t.x);
+		_MM_TRANSPOSE4_PS(x, y, z, t);
+		_mm_storeu_ps(&m.x.x, x);
+		_mm_storeu_ps(&m.y.x, y);
+		_mm_storeu_ps(&m.z.x, z);
+		_mm_storeu_ps(&m.t.x, t);
+#elif CROWN_SIMD_NEON
+		const float32x4x4_t rows = vld4q_f32(&m.x.x);
+		vst1q_f32(&m.x.x, rows.val[0]);
+		vst1q_f32(&m.y.x, rows.val[1]);
+		vst1q_f32(&m.z.x, rows.val[2]);
+		vst1q_f32(&m.t.x, rows.val[3]);
+#else
 		float tmp;
 
 		tmp = m.x.y;
@@ -263,6 +298,7 @@ namespace matrix4x4
 		tmp = m.z.w;
 		m.z.w = m.t.z;
 		m.t.z = tmp;
+#endif // CROWN_SIMD_SSE
 
 		return m;
 	}
@@ -318,6 +354,9 @@ namespace matrix4x4
 
 	inline Matrix4x4& invert(Matrix4x4& m)
 	{
+#if CROWN_SIMD_SSE
+		simd::store(m, simd::inverse(simd::load(m)));
+#else
 		Matrix4x4 mat;
 
 		const float m01m06_m05m02 = m.x.y * m.y.z - m.y.y * m.x.z;
@@ -375,6 +414,7 @@ namespace matrix4x4
 		m.t.y = + mat.t.y * inv_det;
 		m.t.z = - mat.t.z * inv_det;
 		m.t.w = + mat.t.w * inv_det;
+#endif // CROWN_SIMD_SSE
 
 		return m;
 	}
@@ -460,6 +500,51 @@ namespace matrix4x4
 	{
 		return matrix3x3::to_quaternion(to_matrix3x3(m));
 	}
+
+	inline void multiply(const Matrix4x4* a, const Matrix4x4* b, Matrix4x4* out, uint32_t count)
+	{
+#if CROWN_SIMD_SSE || CROWN_SIMD_NEON
+		for (uint32_t i = 0; i < count; i++)
+		{
+			simd::store(out[i], simd::mul(simd::load(a[i]), simd::load(b[i])));
+		}
+#else
+		for (uint32_t i = 0; i < count; i++)
+		{
+			out[i] = a[i] * b[i];
+		}
+#endif // CROWN_SIMD_SSE || CROWN_SIMD_NEON
+	}
+
+	inline void transform_points(const Matrix4x4& m, const Vector3* points, Vector3* out, uint32_t count)
+	{
+#if CROWN_SIMD_SSE
+		const simd::Matrix sm = simd::load(m);
+		for (uint32_t i = 0; i < count; i++)
+		{
+			const Vector3& p = points[i];
+			const __m128 r = simd::mul(sm, _mm_setr_ps(p.x, p.y, p.z, 1.0f));
+			float tmp[4];
+			_mm_storeu_ps(tmp, r);
+			out[i] = Vector3(tmp[0], tmp[1], tmp[2]);
+		}
+#elif CROWN_SIMD_NEON
+		const simd::Matrix sm = simd::load(m);
+		for (uint32_t i = 0; i < count; i++)
+		{
+			const Vector3& p = points[i];
+			const float tmp_in[4] = { p.x, p.y, p.z, 1.0f };
+			float tmp[4];
+			vst1q_f32(tmp, simd::mul(sm, vld1q_f32(tmp_in)));
+			out[i] = Vector3(tmp[0], tmp[1], tmp[2]);
+		}
+#else
+		for (uint32_t i = 0; i < count; i++)
+		{
+			out[i] = m * points[i];
+		}
+#endif // CROWN_SIMD_SSE
+	}
 } // namespace matrix4x4
 
 inline Matrix4x4::Matrix4x4()
@@ -565,6 +650,9 @@ inline Matrix4x4& Matrix4x4::operator/=(float k)
 
 inline Matrix4x4& Matrix4x4::operator*=(const Matrix4x4& a)
 {
+#if CROWN_SIMD_SSE || CROWN_SIMD_NEON
+	simd::store(*this, simd::mul(simd::load(*this), simd::load(a)));
+#else
 	Matrix4x4 tmp;
 
 	tmp.x.x = x.x * a.x.x + y.x * a.x.y + z.x * a.x.z + t.x * a.x.w;
@@ -588,6 +676,7 @@ inline Matrix4x4& Matrix4x4::operator*=(const Matrix4x4& a)
 	tmp.t.w = x.w * a.t.x + y.w * a.t.y + z.w * a.t.z + t.w * a.t.w;
 
 	*this = tmp;
+#endif // CROWN_SIMD_SSE || CROWN_SIMD_NEON
 
 	return *this;
 }
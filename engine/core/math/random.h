@@ -50,7 +50,7 @@ public:
 
 private:
 
-	int32_t		m_seed;
+	uint32_t	m_seed;
 };
 
 inline Random::Random(int32_t seed) : m_seed(seed)
@@ -59,9 +59,10 @@ inline Random::Random(int32_t seed) : m_seed(seed)
 
 inline int32_t Random::integer()
 {
-	m_seed = 214013 * m_seed + 13737667;
+	// Unsigned, signed overflow is undefined
+	m_seed = 214013u * m_seed + 13737667u;
 
-	return (m_seed >> 16) & 0x7FFF;
+	return int32_t((m_seed >> 16) & 0x7FFF);
 }
 
 inline int32_t Random::integer(int32_t max)
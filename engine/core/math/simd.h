@@ -0,0 +1,224 @@
+/*
+Copyright (c) 2013 Daniele Bartolini, Michele Rossi
+Copyright (c) 2012 Daniele Bartolini, Simone Boscaratto
+
+Permission is hereby granted, free of charge, to any person
+obtaining a copy of this software and associated documentation
+files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use,
+copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following
+conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#pragma once
+
+#include "platform.h"
+#include "math_types.h"
+
+/// Selects the SIMD instruction set used by the math library at compile time.
+/// Define CROWN_SIMD_NONE to force the scalar code paths.
+/// The NEON paths have not been compiled nor run on ARM yet, so they are
+/// only used if CROWN_SIMD_NEON_UNVERIFIED is defined.
+#define CROWN_SIMD_SSE 0
+#define CROWN_SIMD_NEON 0
+
+#if !defined(CROWN_SIMD_NONE)
+	#if CROWN_CPU_X86 && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+		#undef CROWN_SIMD_SSE
+		#define CROWN_SIMD_SSE 1
+	#elif CROWN_CPU_ARM && defined(CROWN_SIMD_NEON_UNVERIFIED) && (defined(__ARM_NEON__) || defined(__ARM_NEON))
+		#undef CROWN_SIMD_NEON
+		#define CROWN_SIMD_NEON 1
+	#endif
+#endif // CROWN_SIMD_NONE
+
+#if CROWN_SIMD_SSE
+	#include <emmintrin.h>
+#elif CROWN_SIMD_NEON
+	#include <arm_neon.h>
+#endif
+
+namespace crown
+{
+
+/// Thin wrappers over the SIMD instruction set selected at compile time.
+/// Matrices are loaded and stored with unaligned accesses, so
+/// Matrix4x4 does not need any special alignment.
+///
+/// @ingroup Math
+namespace simd
+{
+#if CROWN_SIMD_SSE
+	struct Matrix { __m128 x, y, z, t; };
+
+	inline Matrix load(const Matrix4x4& m)
+	{
+		Matrix r;
+		r.x = _mm_loadu_ps(&m.x.x);
+		r.y = _mm_loadu_ps(&m.y.x);
+		r.z = _mm_loadu_ps(&m.z.x);
+		r.t = _mm_loadu_ps(&m.t.x);
+		return r;
+	}
+
+	inline void store(Matrix4x4& m, const Matrix& a)
+	{
+		_mm_storeu_ps(&m.x.x, a.x);
+		_mm_storeu_ps(&m.y.x, a.y);
+		_mm_storeu_ps(&m.z.x, a.z);
+		_mm_storeu_ps(&m.t.x, a.t);
+	}
+
+	/// Returns @a a * @a v.
+	inline __m128 mul(const Matrix& a, __m128 v)
+	{
+		__m128 r = _mm_mul_ps(a.x, _mm_shuffle_ps(v, v, _MM_SHUFFLE(0, 0, 0, 0)));
+		r = _mm_add_ps(r, _mm_mul_ps(a.y, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 1, 1))));
+		r = _mm_add_ps(r, _mm_mul_ps(a.z, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 2, 2, 2))));
+		r = _mm_add_ps(r, _mm_mul_ps(a.t, _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 3, 3))));
+		return r;
+	}
+
+	/// Returns @a a * @a b.
+	inline Matrix mul(const Matrix& a, const Matrix& b)
+	{
+		Matrix r;
+		r.x = mul(a, b.x);
+		r.y = mul(a, b.y);
+		r.z = mul(a, b.z);
+		r.t = mul(a, b.t);
+		return r;
+	}
+
+	// 2x2 matrices are stored in a single register as (m00, m01, m10, m11)
+
+	/// Returns @a a * @a b.
+	inline __m128 mul2(__m128 a, __m128 b)
+	{
+		return _mm_add_ps(_mm_mul_ps(a, _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 0, 3, 0))),
+			_mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(2, 3, 0, 1)), _mm_shuffle_ps(b, b, _MM_SHUFFLE(1, 2, 1, 2))));
+	}
+
+	/// Returns adjugate(@a a) * @a b.
+	inline __m128 adj_mul2(__m128 a, __m128 b)
+	{
+		return _mm_sub_ps(_mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(0, 0, 3, 3)), b),
+			_mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(2, 2, 1, 1)), _mm_shuffle_ps(b, b, _MM_SHUFFLE(1, 0, 3, 2))));
+	}
+
+	/// Returns @a a * adjugate(@a b).
+	inline __m128 mul_adj2(__m128 a, __m128 b)
+	{
+		return _mm_sub_ps(_mm_mul_ps(a, _mm_shuffle_ps(b, b, _MM_SHUFFLE(0, 3, 0, 3))),
+			_mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(2, 3, 0, 1)), _mm_shuffle_ps(b, b, _MM_SHUFFLE(1, 2, 1, 2))));
+	}
+
+	/// Returns the inverse of @a m computed with the 2x2 block method.
+	/// Since inverse(transpose(m)) == transpose(inverse(m)) it works the same
+	/// whether the registers hold rows or columns.
+	inline Matrix inverse(const Matrix& m)
+	{
+		const __m128 a = _mm_movelh_ps(m.x, m.y);
+		const __m128 b = _mm_movehl_ps(m.y, m.x);
+		const __m128 c = _mm_movelh_ps(m.z, m.t);
+		const __m128 d = _mm_movehl_ps(m.t, m.z);
+
+		// (|A|, |B|, |C|, |D|)
+		const __m128 det_sub = _mm_sub_ps(
+			_mm_mul_ps(_mm_shuffle_ps(m.x, m.z, _MM_SHUFFLE(2, 0, 2, 0)), _mm_shuffle_ps(m.y, m.t, _MM_SHUFFLE(3, 1, 3, 1))),
+			_mm_mul_ps(_mm_shuffle_ps(m.x, m.z, _MM_SHUFFLE(3, 1, 3, 1)), _mm_shuffle_ps(m.y, m.t, _MM_SHUFFLE(2, 0, 2, 0))));
+		const __m128 det_a = _mm_shuffle_ps(det_sub, det_sub, _MM_SHUFFLE(0, 0, 0, 0));
+		const __m128 det_b = _mm_shuffle_ps(det_sub, det_sub, _MM_SHUFFLE(1, 1, 1, 1));
+		const __m128 det_c = _mm_shuffle_ps(det_sub, det_sub, _MM_SHUFFLE(2, 2, 2, 2));
+		const __m128 det_d = _mm_shuffle_ps(det_sub, det_sub, _MM_SHUFFLE(3, 3, 3, 3));
+
+		const __m128 d_c = adj_mul2(d, c);
+		const __m128 a_b = adj_mul2(a, b);
+
+		__m128 x_ = _mm_sub_ps(_mm_mul_ps(det_d, a), mul2(b, d_c));
+		__m128 w_ = _mm_sub_ps(_mm_mul_ps(det_a, d), mul2(c, a_b));
+		__m128 y_ = _mm_sub_ps(_mm_mul_ps(det_b, c), mul_adj2(d, a_b));
+		__m128 z_ = _mm_sub_ps(_mm_mul_ps(det_c, b), mul_adj2(a, d_c));
+
+		// |M| = |A|*|D| + |B|*|C| - tr((A#B)(D#C))
+		__m128 tr = _mm_mul_ps(a_b, _mm_shuffle_ps(d_c, d_c, _MM_SHUFFLE(3, 1, 2, 0)));
+		tr = _mm_add_ps(tr, _mm_shuffle_ps(tr, tr, _MM_SHUFFLE(2, 3, 0, 1)));
+		tr = _mm_add_ps(tr, _mm_shuffle_ps(tr, tr, _MM_SHUFFLE(1, 0, 3, 2)));
+
+		const __m128 det_m = _mm_sub_ps(_mm_add_ps(_mm_mul_ps(det_a, det_d), _mm_mul_ps(det_b, det_c)), tr);
+		const __m128 r_det_m = _mm_div_ps(_mm_setr_ps(1.0f, -1.0f, -1.0f, 1.0f), det_m);
+
+		x_ = _mm_mul_ps(x_, r_det_m);
+		y_ = _mm_mul_ps(y_, r_det_m);
+		z_ = _mm_mul_ps(z_, r_det_m);
+		w_ = _mm_mul_ps(w_, r_det_m);
+
+		Matrix r;
+		r.x = _mm_shuffle_ps(x_, y_, _MM_SHUFFLE(1, 3, 1, 3));
+		r.y = _mm_shuffle_ps(x_, y_, _MM_SHUFFLE(0, 2, 0, 2));
+		r.z = _mm_shuffle_ps(z_, w_, _MM_SHUFFLE(1, 3, 1, 3));
+		r.t = _mm_shuffle_ps(z_, w_, _MM_SHUFFLE(0, 2, 0, 2));
+		return r;
+	}
+#elif CROWN_SIMD_NEON
+	struct Matrix { float32x4_t x, y, z, t; };
+
+	inline Matrix load(const Matrix4x4& m)
+	{
+		Matrix r;
+		r.x = vld1q_f32(&m.x.x);
+		r.y = vld1q_f32(&m.y.x);
+		r.z = vld1q_f32(&m.z.x);
+		r.t = vld1q_f32(&m.t.x);
+		return r;
+	}
+
+	inline void store(Matrix4x4& m, const Matrix& a)
+	{
+		vst1q_f32(&m.x.x, a.x);
+		vst1q_f32(&m.y.x, a.y);
+		vst1q_f32(&m.z.x, a.z);
+		vst1q_f32(&m.t.x, a.t);
+	}
+
+	/// Returns @a a * @a v.
+	inline float32x4_t mul(const Matrix& a, float32x4_t v)
+	{
+		const float32x2_t lo = vget_low_f32(v);
+		const float32x2_t hi = vget_high_f32(v);
+		float32x4_t r = vmulq_lane_f32(a.x, lo, 0);
+		r = vmlaq_lane_f32(r, a.y, lo, 1);
+		r = vmlaq_lane_f32(r, a.z, hi, 0);
+		r = vmlaq_lane_f32(r, a.t, hi, 1);
+		return r;
+	}
+
+	/// Returns @a a * @a b.
+	inline Matrix mul(const Matrix& a, const Matrix& b)
+	{
+		Matrix r;
+		r.x = mul(a, b.x);
+		r.y = mul(a, b.y);
+		r.z = mul(a, b.z);
+		r.t = mul(a, b.t);
+		return r;
+	}
+#endif // CROWN_SIMD_SSE
+} // namespace simd
+
+} // namespace crown
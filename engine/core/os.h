@@ -172,6 +172,25 @@ namespace os
 #endif
 	}
 
+	/// Returns the last modification time of the file at @a path.
+	inline uint64_t mtime(const char* path)
+	{
+#if CROWN_PLATFORM_POSIX
+		struct stat info;
+		memset(&info, 0, sizeof(struct stat));
+		int err = ::stat(path, &info);
+		CE_ASSERT(err == 0, "stat: errno = %d", errno);
+		CE_UNUSED(err);
+		return info.st_mtime;
+#elif CROWN_PLATFORM_WINDOWS
+		WIN32_FILE_ATTRIBUTE_DATA data;
+		BOOL err = GetFileAttributesEx(path, GetFileExInfoStandard, &data);
+		CE_ASSERT(err != 0, "GetFileAttributesEx: GetLastError = %d", GetLastError());
+		CE_UNUSED(err);
+		return (uint64_t(data.ftLastWriteTime.dwHighDateTime) << 32) | data.ftLastWriteTime.dwLowDateTime;
+#endif
+	}
+
 	/// Creates a regular file.
 	inline void create_file(const char* path)
 	{
@@ -201,6 +220,21 @@ namespace os
 #endif
 	}
 
+	/// Renames the file @a old_path to @a new_path, replacing @a new_path if it exists.
+	/// The replacement is atomic where the platform supports it.
+	inline void rename_file(const char* old_path, const char* new_path)
+	{
+#if CROWN_PLATFORM_POSIX
+		int err = ::rename(old_path, new_path);
+		CE_ASSERT(err == 0, "rename: errno = %d", errno);
+		CE_UNUSED(err);
+#elif CROWN_PLATFORM_WINDOWS
+		BOOL err = MoveFileEx(old_path, new_path, MOVEFILE_REPLACE_EXISTING);
+		CE_ASSERT(err != 0, "MoveFileEx: GetLastError = %d", GetLastError());
+		CE_UNUSED(err);
+#endif
+	}
+
 	/// Creates a directory.
 	inline void create_directory(const char* path)
 	{
@@ -407,22 +441,25 @@ namespace os
 	/// @a args[0] is the path to the program executable,
 	/// @a args[1, 2, ..., n-1] is a list of arguments to pass to the executable,
 	/// @a args[n] is NULL.
-	inline void execute_process(const char* args[])
+	/// Returns the exit code of the process.
+	inline int32_t execute_process(const char* args[])
 	{
 #if CROWN_PLATFORM_POSIX
 		pid_t pid = fork();
 		CE_ASSERT(pid != -1, "fork: errno = %d", errno);
 		if (pid)
 		{
-			int32_t dummy;
-			wait(&dummy);
+			// Wait for this child only so processes can be spawned from many threads
+			int status;
+			waitpid(pid, &status, 0);
+			return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
 		}
 		else
 		{
 			int err = execv(args[0], (char* const*)args);
 			CE_ASSERT(err != -1, "execv: errno = %d", errno);
 			CE_UNUSED(err);
-			exit(EXIT_SUCCESS);
+			exit(EXIT_FAILURE);
 		}
 #elif CROWN_PLATFORM_WINDOWS
 		STARTUPINFO info;
@@ -449,8 +486,11 @@ namespace os
 		CE_UNUSED(err);
 
 		::WaitForSingleObject(process.hProcess, INFINITE);
+		DWORD exit_code = 1;
+		GetExitCodeProcess(process.hProcess, &exit_code);
 		CloseHandle(process.hProcess);
 		CloseHandle(process.hThread);
+		return (int32_t) exit_code;
 #endif
 	}
 } // namespace os
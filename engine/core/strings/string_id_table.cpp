@@ -0,0 +1,125 @@
+/*
+Copyright (c) 2013 Daniele Bartolini, Michele Rossi
+Copyright (c) 2012 Daniele Bartolini, Simone Boscaratto
+
+Permission is hereby granted, free of charge, to any person
+obtaining a copy of this software and associated documentation
+files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use,
+copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following
+conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "string_id_table.h"
+
+#ifdef CROWN_DEBUG
+
+#include "mutex.h"
+#include <cstring>
+
+namespace crown
+{
+namespace string_id_table
+{
+	static const uint32_t MAX_ENTRIES = 8192; // Power of two
+	static const uint32_t MAX_CHARS = 256 * 1024;
+
+	struct Entry
+	{
+		uint64_t id;
+		uint32_t offset;
+		uint32_t used;
+	};
+
+	struct Table
+	{
+		Entry entries[MAX_ENTRIES];
+	};
+
+	static Mutex s_mutex;
+	static Table s_table32;
+	static Table s_table64;
+	static char s_chars[MAX_CHARS];
+	static uint32_t s_num_chars = 0;
+	static uint32_t s_num_entries = 0;
+
+	static void add(Table& t, uint64_t id, const char* s)
+	{
+		ScopedMutex sm(s_mutex);
+
+		uint32_t i = uint32_t(id) & (MAX_ENTRIES - 1);
+		while (t.entries[i].used)
+		{
+			if (t.entries[i].id == id)
+				return;
+
+			i = (i + 1) & (MAX_ENTRIES - 1);
+		}
+
+		const uint32_t len = uint32_t(strlen(s)) + 1;
+
+		// Never fill the table completely, lookups rely on empty slots
+		if (s_num_entries == MAX_ENTRIES - 1 || s_num_chars + len > MAX_CHARS)
+			return;
+
+		memcpy(s_chars + s_num_chars, s, len);
+		t.entries[i].id = id;
+		t.entries[i].offset = s_num_chars;
+		t.entries[i].used = 1;
+		s_num_chars += len;
+		s_num_entries++;
+	}
+
+	static const char* lookup(Table& t, uint64_t id)
+	{
+		ScopedMutex sm(s_mutex);
+
+		uint32_t i = uint32_t(id) & (MAX_ENTRIES - 1);
+		while (t.entries[i].used)
+		{
+			if (t.entries[i].id == id)
+				return s_chars + t.entries[i].offset;
+
+			i = (i + 1) & (MAX_ENTRIES - 1);
+		}
+
+		return NULL;
+	}
+
+	void add(StringId32 id, const char* s)
+	{
+		add(s_table32, id, s);
+	}
+
+	void add(StringId64 id, const char* s)
+	{
+		add(s_table64, id, s);
+	}
+
+	const char* lookup(StringId32 id)
+	{
+		return lookup(s_table32, id);
+	}
+
+	const char* lookup(StringId64 id)
+	{
+		return lookup(s_table64, id);
+	}
+} // namespace string_id_table
+} // namespace crown
+
+#endif // CROWN_DEBUG
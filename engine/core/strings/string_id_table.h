@@ -0,0 +1,63 @@
+/*
+Copyright (c) 2013 Daniele Bartolini, Michele Rossi
+Copyright (c) 2012 Daniele Bartolini, Simone Boscaratto
+
+Permission is hereby granted, free of charge, to any person
+obtaining a copy of this software and associated documentation
+files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use,
+copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following
+conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+
+#include "types.h"
+#include "config.h"
+
+namespace crown
+{
+
+/// Debug-only table mapping string ids back to the strings they have
+/// been hashed from, so that logs can print names instead of numbers.
+/// In release builds nothing is recorded and lookups always fail.
+namespace string_id_table
+{
+	/// Records that @a id is the hash of the string @a s.
+	void add(StringId32 id, const char* s);
+
+	/// @copydoc string_id_table::add(StringId32, const char*)
+	void add(StringId64 id, const char* s);
+
+	/// Returns the string which @a id is the hash of or NULL if unknown.
+	const char* lookup(StringId32 id);
+
+	/// @copydoc string_id_table::lookup(StringId32)
+	const char* lookup(StringId64 id);
+} // namespace string_id_table
+
+#ifndef CROWN_DEBUG
+namespace string_id_table
+{
+	inline void add(StringId32 /*id*/, const char* /*s*/) {}
+	inline void add(StringId64 /*id*/, const char* /*s*/) {}
+	inline const char* lookup(StringId32 /*id*/) { return NULL; }
+	inline const char* lookup(StringId64 /*id*/) { return NULL; }
+} // namespace string_id_table
+#endif // CROWN_DEBUG
+
+} // namespace crown
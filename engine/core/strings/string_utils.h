@@ -33,6 +33,7 @@ OTHER DEALINGS IN THE SOFTWARE.
 #include "types.h"
 #include "config.h"
 #include "macros.h"
+#include "string_id_table.h"
 
 namespace crown
 {
@@ -324,16 +325,21 @@ inline uint64_t murmur2_64(const void* key, int len, uint64_t seed = 0)
 	return h;
 }
 
+/// HASH32() and HASH64() return @a value, the precomputed hash of the
+/// string literal @a s, so that ids of literals are compile-time constants.
+/// Debug builds verify the hash and record it into string_id_table.
 #ifdef CROWN_DEBUG
 	inline uint32_t HASH32(const char *s, uint32_t value)
 	{
 		CE_ASSERT(murmur2_32(s, string::strlen(s), 0) == value, "Hash mismatch");
+		string_id_table::add(StringId32(value), s);
 		return value;
 	}
 
 	inline uint64_t HASH64(const char* s, uint64_t value)
 	{
 		CE_ASSERT(murmur2_64(s, string::strlen(s), 0) == value, "Hash mismatch");
+		string_id_table::add(StringId64(value), s);
 		return value;
 	}
 #else
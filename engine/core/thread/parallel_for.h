@@ -0,0 +1,98 @@
+/*
+Copyright (c) 2013 Daniele Bartolini, Michele Rossi
+Copyright (c) 2012 Daniele Bartolini, Simone Boscaratto
+
+Permission is hereby granted, free of charge, to any person
+obtaining a copy of this software and associated documentation
+files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use,
+copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following
+conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#pragma once
+
+#include "types.h"
+#include "config.h"
+#include "thread.h"
+#include "math_utils.h"
+
+namespace crown
+{
+
+/// Function called by parallel_for() on the range [begin, end).
+typedef void (*ParallelForFunction)(uint32_t begin, uint32_t end, void* data);
+
+namespace parallel_for_internal
+{
+	struct Job
+	{
+		ParallelForFunction func;
+		void* data;
+		uint32_t begin;
+		uint32_t end;
+	};
+
+	inline int32_t run(void* data)
+	{
+		Job* job = (Job*) data;
+		job->func(job->begin, job->end, job->data);
+		return 0;
+	}
+} // namespace parallel_for_internal
+
+/// Splits [0, count) in up to CE_MAX_COMPILER_THREADS contiguous ranges
+/// and calls @a func on each of them from a different thread.
+/// Returns when all the ranges have been processed.
+inline void parallel_for(uint32_t count, ParallelForFunction func, void* data)
+{
+	using namespace parallel_for_internal;
+
+	const uint32_t num_jobs = math::min(count, (uint32_t) CE_MAX_COMPILER_THREADS);
+	if (num_jobs <= 1)
+	{
+		func(0, count, data);
+		return;
+	}
+
+	Job jobs[CE_MAX_COMPILER_THREADS];
+	Thread threads[CE_MAX_COMPILER_THREADS];
+
+	for (uint32_t i = 0; i < num_jobs; i++)
+	{
+		jobs[i].func = func;
+		jobs[i].data = data;
+		jobs[i].begin = count * i / num_jobs;
+		jobs[i].end = count * (i + 1) / num_jobs;
+	}
+
+	// The calling thread takes the first range
+	for (uint32_t i = 1; i < num_jobs; i++)
+	{
+		threads[i].start(run, &jobs[i]);
+	}
+
+	run(&jobs[0]);
+
+	for (uint32_t i = 1; i < num_jobs; i++)
+	{
+		threads[i].stop();
+	}
+}
+
+} // namespace crown
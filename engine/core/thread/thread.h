@@ -124,6 +124,16 @@ struct Thread
 		return m_is_running;
 	}
 
+	/// Returns an identifier of the calling thread.
+	static uint64_t current_id()
+	{
+#if CROWN_PLATFORM_POSIX
+		return (uint64_t) (uintptr_t) pthread_self();
+#elif CROWN_PLATFORM_WINDOWS
+		return (uint64_t) GetCurrentThreadId();
+#endif
+	}
+
 private:
 
 	int32_t run()
@@ -195,6 +195,11 @@ void Device::update()
 	if (!_is_paused)
 	{
 		_resource_manager->complete_requests();
+
+		// Materials cache texture handles
+		if (_resource_manager->texture_streamer()->update())
+			material_manager::get()->reload_materials();
+
 		_lua_environment->call_global("update", 1, ARGUMENT_FLOAT, last_delta_time());
 	}
 
@@ -235,6 +240,8 @@ void Device::destroy_resource_package(ResourcePackage* package)
 
 void Device::reload(const char* , const char* )
 {
+	// Materials cache shader and texture handles
+	material_manager::get()->reload_materials();
 }
 
 namespace device_globals
@@ -36,21 +36,24 @@ namespace crown
 static int debug_line_add_line(lua_State* L)
 {
 	LuaStack stack(L);
-	stack.get_debug_line(1)->add_line(Color4::RED, stack.get_vector3(2), stack.get_vector3(3));
+	const float duration = stack.num_args() > 3 ? stack.get_float(4) : 0.0f;
+	stack.get_debug_line(1)->add_line(Color4::RED, stack.get_vector3(2), stack.get_vector3(3), duration);
 	return 0;
 }
 
 static int debug_line_add_sphere(lua_State* L)
 {
 	LuaStack stack(L);
-	stack.get_debug_line(1)->add_sphere(Color4::RED, stack.get_vector3(2), stack.get_float(3));
+	const float duration = stack.num_args() > 3 ? stack.get_float(4) : 0.0f;
+	stack.get_debug_line(1)->add_sphere(Color4::RED, stack.get_vector3(2), stack.get_float(3), duration);
 	return 0;
 }
 
 static int debug_line_add_obb(lua_State* L)
 {
 	LuaStack stack(L);
-	stack.get_debug_line(1)->add_obb(Color4::RED, stack.get_matrix4x4(2), stack.get_vector3(3));
+	const float duration = stack.num_args() > 3 ? stack.get_float(4) : 0.0f;
+	stack.get_debug_line(1)->add_obb(Color4::RED, stack.get_matrix4x4(2), stack.get_vector3(3), duration);
 	return 0;
 }
 
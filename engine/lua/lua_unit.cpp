@@ -38,6 +38,18 @@ static int unit_node(lua_State* L)
 	return 1;
 }
 
+static int unit_nodes(lua_State* L)
+{
+	LuaStack stack(L);
+	Unit* unit = stack.get_unit(1);
+	const int32_t num = stack.num_args();
+
+	for (int32_t i = 2; i <= num; i++)
+		stack.push_int32(unit->node(stack.get_string(i)));
+
+	return num - 1;
+}
+
 static int unit_has_node(lua_State* L)
 {
 	LuaStack stack(L);
@@ -238,6 +250,28 @@ static int unit_stop_sprite_animation(lua_State* L)
 	return 0;
 }
 
+static int unit_play_animation(lua_State* L)
+{
+	LuaStack stack(L);
+	const float blend_time = stack.num_args() > 3 ? stack.get_float(4) : 0.0f;
+	stack.get_unit(1)->play_animation(stack.get_string(2), stack.get_bool(3), blend_time);
+	return 0;
+}
+
+static int unit_stop_animation(lua_State* L)
+{
+	LuaStack stack(L);
+	stack.get_unit(1)->stop_animation();
+	return 0;
+}
+
+static int unit_set_animation_speed(lua_State* L)
+{
+	LuaStack stack(L);
+	stack.get_unit(1)->set_animation_speed(stack.get_float(2));
+	return 0;
+}
+
 static int unit_has_key(lua_State* L)
 {
 	LuaStack stack(L);
@@ -310,6 +344,7 @@ static int unit_set_key(lua_State* L)
 void load_unit(LuaEnvironment& env)
 {
 	env.load_module_function("Unit", "node",                  unit_node);
+	env.load_module_function("Unit", "nodes",                 unit_nodes);
 	env.load_module_function("Unit", "has_node",              unit_has_node);
 	env.load_module_function("Unit", "num_nodes",             unit_num_nodes);
 	env.load_module_function("Unit", "local_position",        unit_local_position);
@@ -332,6 +367,9 @@ void load_unit(LuaEnvironment& env)
 	env.load_module_function("Unit", "is_a",                  unit_is_a);
 	env.load_module_function("Unit", "play_sprite_animation", unit_play_sprite_animation);
 	env.load_module_function("Unit", "stop_sprite_animation", unit_stop_sprite_animation);
+	env.load_module_function("Unit", "play_animation",        unit_play_animation);
+	env.load_module_function("Unit", "stop_animation",        unit_stop_animation);
+	env.load_module_function("Unit", "set_animation_speed",   unit_set_animation_speed);
 	env.load_module_function("Unit", "has_key",               unit_has_key);
 	env.load_module_function("Unit", "get_key",               unit_get_key);
 	env.load_module_function("Unit", "set_key",               unit_set_key);
@@ -35,6 +35,17 @@ OTHER DEALINGS IN THE SOFTWARE.
 namespace crown
 {
 
+static void push_units(LuaStack& stack, World* world, const Array<UnitId>& units)
+{
+	stack.push_table();
+	for (uint32_t i = 0; i < array::size(units); i++)
+	{
+		stack.push_key_begin((int32_t) i + 1);
+		stack.push_unit(world->get_unit(units[i]));
+		stack.push_key_end();
+	}
+}
+
 static int world_spawn_unit(lua_State* L)
 {
 	LuaStack stack(L);
@@ -72,14 +83,60 @@ static int world_units(lua_State* L)
 	Array<UnitId> all_units(alloc);
 	world->units(all_units);
 
-	stack.push_table();
-	for (uint32_t i = 0; i < array::size(all_units); i++)
-	{
-		stack.push_key_begin((int32_t) i + 1);
-		stack.push_unit(world->get_unit(all_units[i]));
-		stack.push_key_end();
-	}
+	push_units(stack, world, all_units);
+	return 1;
+}
+
+static int world_set_spatial_index_type(lua_State* L)
+{
+	LuaStack stack(L);
+	const char* type = stack.get_string(2);
+
+	SpatialIndexType::Enum sit = SpatialIndexType::COUNT;
+	if (string::strcmp(type, "grid") == 0) sit = SpatialIndexType::GRID;
+	else if (string::strcmp(type, "octree") == 0) sit = SpatialIndexType::OCTREE;
+
+	LUA_ASSERT(sit != SpatialIndexType::COUNT, stack, "Unknown spatial index type: '%s'", type);
+	stack.get_world(1)->set_spatial_index_type(sit);
+	return 0;
+}
+
+static int world_query_sphere(lua_State* L)
+{
+	LuaStack stack(L);
+
+	World* world = stack.get_world(1);
+	TempAllocator1024 alloc;
+	Array<UnitId> units(alloc);
+	world->query_sphere(stack.get_vector3(2), stack.get_float(3), units);
+
+	push_units(stack, world, units);
+	return 1;
+}
+
+static int world_query_box(lua_State* L)
+{
+	LuaStack stack(L);
+
+	World* world = stack.get_world(1);
+	TempAllocator1024 alloc;
+	Array<UnitId> units(alloc);
+	world->query_box(AABB(stack.get_vector3(2), stack.get_vector3(3)), units);
+
+	push_units(stack, world, units);
+	return 1;
+}
+
+static int world_query_nearest(lua_State* L)
+{
+	LuaStack stack(L);
 
+	World* world = stack.get_world(1);
+	TempAllocator1024 alloc;
+	Array<UnitId> units(alloc);
+	world->query_nearest(stack.get_vector3(2), stack.get_int(3), units);
+
+	push_units(stack, world, units);
 	return 1;
 }
 
@@ -204,6 +261,48 @@ static int world_load_level(lua_State* L)
 	return 0;
 }
 
+static int world_stream_level(lua_State* L)
+{
+	LuaStack stack(L);
+	stack.get_world(1)->stream_level(stack.get_string(2));
+	return 0;
+}
+
+static int world_set_streaming_focus(lua_State* L)
+{
+	LuaStack stack(L);
+	stack.get_world(1)->level_streamer()->set_focus(stack.get_vector3(2));
+	return 0;
+}
+
+static int world_set_streaming_radius(lua_State* L)
+{
+	LuaStack stack(L);
+	stack.get_world(1)->level_streamer()->set_radius(stack.get_float(2), stack.get_float(3));
+	return 0;
+}
+
+static int world_set_streaming_budget(lua_State* L)
+{
+	LuaStack stack(L);
+	stack.get_world(1)->level_streamer()->set_budget(stack.get_float(2));
+	return 0;
+}
+
+static int world_streaming_progress(lua_State* L)
+{
+	LuaStack stack(L);
+	stack.push_float(stack.get_world(1)->level_streamer()->progress());
+	return 1;
+}
+
+static int world_streaming_time(lua_State* L)
+{
+	LuaStack stack(L);
+	stack.push_float(stack.get_world(1)->level_streamer()->last_update_time());
+	return 1;
+}
+
 static int world_physics_world(lua_State* L)
 {
 	LuaStack stack(L);
@@ -232,6 +331,10 @@ void load_world(LuaEnvironment& env)
 	env.load_module_function("World", "destroy_unit",       world_destroy_unit);
 	env.load_module_function("World", "num_units",          world_num_units);
 	env.load_module_function("World", "units",              world_units);
+	env.load_module_function("World", "set_spatial_index_type", world_set_spatial_index_type);
+	env.load_module_function("World", "query_sphere",       world_query_sphere);
+	env.load_module_function("World", "query_box",          world_query_box);
+	env.load_module_function("World", "query_nearest",      world_query_nearest);
 	env.load_module_function("World", "update_animations",  world_update_animations);
 	env.load_module_function("World", "update_scene",       world_update_scene);
 	env.load_module_function("World", "update",             world_update);
@@ -247,6 +350,12 @@ void load_world(LuaEnvironment& env)
 	env.load_module_function("World", "create_debug_line",  world_create_debug_line);
 	env.load_module_function("World", "destroy_debug_line", world_destroy_debug_line);
 	env.load_module_function("World", "load_level",         world_load_level);
+	env.load_module_function("World", "stream_level",       world_stream_level);
+	env.load_module_function("World", "set_streaming_focus",  world_set_streaming_focus);
+	env.load_module_function("World", "set_streaming_radius", world_set_streaming_radius);
+	env.load_module_function("World", "set_streaming_budget", world_set_streaming_budget);
+	env.load_module_function("World", "streaming_progress", world_streaming_progress);
+	env.load_module_function("World", "streaming_time",     world_streaming_time);
 	env.load_module_function("World", "physics_world",      world_physics_world);
 	env.load_module_function("World", "sound_world",        world_sound_world);
 	env.load_module_function("World", "__index",            "World");
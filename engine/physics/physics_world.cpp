@@ -228,7 +228,6 @@ namespace physics_globals
 			}
 
 			line.commit();
-			line.clear();
 		}
 	#endif
 } // namespace physics_globals
@@ -277,7 +276,7 @@ PhysicsWorld::PhysicsWorld(World& world)
 	m_controller_manager = PxCreateControllerManager(*m_scene);
 	CE_ASSERT(m_controller_manager != NULL, "Failed to create PhysX controller manager");
 
-	m_resource = (PhysicsConfigResource*) device()->resource_manager()->get("physics_config", "global");
+	m_resource = (PhysicsConfigResource*) device()->resource_manager()->get(PHYSICS_CONFIG_TYPE, string::HASH64("global", 0x0b2f08fe66e395c0));
 
 	#if defined(CROWN_DEBUG)
 		m_scene->setVisualizationParameter(PxVisualizationParameter::eSCALE, 1);
@@ -30,6 +30,9 @@ OTHER DEALINGS IN THE SOFTWARE.
 #include "vector3.h"
 #include "matrix4x4.h"
 #include "config.h"
+#include "array.h"
+#include "device.h"
+#include "thread.h"
 #include <string.h>
 #include <bgfx.h>
 
@@ -122,6 +125,14 @@ namespace debug_line
 	static bgfx::VertexDecl s_decl;
 	static bgfx::ProgramHandle s_prog;
 
+	// Unit circle used to draw spheres
+	static const uint32_t NUM_SEGMENTS = 24;
+	static float s_cos[NUM_SEGMENTS + 1];
+	static float s_sin[NUM_SEGMENTS + 1];
+
+	// Upper bound on the transient memory used by a single draw
+	static const uint32_t MAX_LINES_PER_DRAW = 65536 / 2;
+
 	void init()
 	{
 		s_decl
@@ -136,6 +147,13 @@ namespace debug_line
 		 	bgfx::makeRef(fs_h, sizeof(fs_h)));
 
 		s_prog = bgfx::createProgram(vs, fs, true);
+
+		for (uint32_t i = 0; i <= NUM_SEGMENTS; i++)
+		{
+			const float rad = math::TWO_PI * i / NUM_SEGMENTS;
+			s_cos[i] = math::cos(rad);
+			s_sin[i] = math::sin(rad);
+		}
 	}
 
 	void shutdown()
@@ -147,55 +165,82 @@ namespace debug_line
 
 DebugLine::DebugLine(bool depth_test)
 	: m_depth_test(depth_test)
-	, m_num_lines(0)
+	, m_num_threads(0)
+	, m_free_chunks(NULL)
+	, m_persistent(default_allocator())
+	, m_expire_time(default_allocator())
+	, m_merged(default_allocator())
 {
 }
 
-void DebugLine::add_line(const Color4& color, const Vector3& start, const Vector3& end)
+DebugLine::~DebugLine()
 {
-	if (m_num_lines >= CE_MAX_DEBUG_LINES)
-		 return;
+	clear();
 
-	m_lines[m_num_lines].p0[0] = start.x;
-	m_lines[m_num_lines].p0[1] = start.y;
-	m_lines[m_num_lines].p0[2] = start.z;
-	m_lines[m_num_lines].c0    = color4::to_abgr(color);
+	while (m_free_chunks != NULL)
+	{
+		Chunk* next = m_free_chunks->next;
+		CE_DELETE(default_allocator(), m_free_chunks);
+		m_free_chunks = next;
+	}
+}
 
-	m_lines[m_num_lines].p1[0] = end.x;
-	m_lines[m_num_lines].p1[1] = end.y;
-	m_lines[m_num_lines].p1[2] = end.z;
-	m_lines[m_num_lines].c1    = color4::to_abgr(color);
+void DebugLine::add_line(const Color4& color, const Vector3& start, const Vector3& end, float duration)
+{
+	Line line;
+	line.p0[0] = start.x;
+	line.p0[1] = start.y;
+	line.p0[2] = start.z;
+	line.c0    = color4::to_abgr(color);
+	line.p1[0] = end.x;
+	line.p1[1] = end.y;
+	line.p1[2] = end.z;
+	line.c1    = line.c0;
+
+	if (duration > 0.0f)
+	{
+		add_persistent(line, duration);
+		return;
+	}
 
-	m_num_lines++;
+	ThreadBuffer& tb = thread_buffer();
+
+	if (tb.last == NULL || tb.last->num == Chunk::SIZE)
+	{
+		Chunk* chunk = allocate_chunk();
+		if (tb.last != NULL)
+			tb.last->next = chunk;
+		else
+			tb.first = chunk;
+		tb.last = chunk;
+	}
+
+	tb.last->lines[tb.last->num++] = line;
 }
 
-void DebugLine::add_sphere(const Color4& color, const Vector3& center, const float radius)
+void DebugLine::add_sphere(const Color4& color, const Vector3& center, const float radius, float duration)
 {
-	const uint32_t deg_step = 15;
+	using namespace debug_line;
 
-	for (uint32_t deg = 0; deg < 360; deg += deg_step)
+	for (uint32_t i = 0; i < NUM_SEGMENTS; i++)
 	{
-		const float rad0 = math::to_rad((float) deg);
-		const float rad1 = math::to_rad((float) deg + deg_step);
+		const float c0 = s_cos[i] * radius;
+		const float s0 = s_sin[i] * radius;
+		const float c1 = s_cos[i + 1] * radius;
+		const float s1 = s_sin[i + 1] * radius;
 
 		// XZ plane
-		const Vector3 start0(math::cos(rad0) * radius, 0, -math::sin(rad0) * radius);
-		const Vector3 end0  (math::cos(rad1) * radius, 0, -math::sin(rad1) * radius);
-		add_line(color, center + start0, center + end0);
+		add_line(color, center + Vector3(c0, 0, -s0), center + Vector3(c1, 0, -s1), duration);
 
 		// XY plane
-		const Vector3 start1(math::cos(rad0) * radius, math::sin(rad0) * radius, 0);
-		const Vector3 end1  (math::cos(rad1) * radius, math::sin(rad1) * radius, 0);
-		add_line(color, center + start1, center + end1);
+		add_line(color, center + Vector3(c0, s0, 0), center + Vector3(c1, s1, 0), duration);
 
 		// YZ plane
-		const Vector3 start2(0, math::sin(rad0) * radius, -math::cos(rad0) * radius);
-		const Vector3 end2  (0, math::sin(rad1) * radius, -math::cos(rad1) * radius);
-		add_line(color, center + start2, center + end2);
+		add_line(color, center + Vector3(0, s0, -c0), center + Vector3(0, s1, -c1), duration);
 	}
 }
 
-void DebugLine::add_obb(const Color4& color, const Matrix4x4& tm, const Vector3& extents)
+void DebugLine::add_obb(const Color4& color, const Matrix4x4& tm, const Vector3& extents, float duration)
 {
 	const Vector3 o = Vector3(tm.t.x, tm.t.y, tm.t.z);
 	const Vector3 x = Vector3(tm.x.x, tm.x.y, tm.x.z) * (extents.x * 0.5);
@@ -203,47 +248,161 @@ void DebugLine::add_obb(const Color4& color, const Matrix4x4& tm, const Vector3&
 	const Vector3 z = Vector3(tm.z.x, tm.z.y, tm.z.z) * (extents.z * 0.5);
 
 	// Back face
-	add_line(color, o - x - y - z, o + x - y - z);
-	add_line(color, o + x - y - z, o + x + y - z);
-	add_line(color, o + x + y - z, o - x + y - z);
-	add_line(color, o - x + y - z, o - x - y - z);
-
-	add_line(color, o - x - y + z, o + x - y + z);
-	add_line(color, o + x - y + z, o + x + y + z);
-	add_line(color, o + x + y + z, o - x + y + z);
-	add_line(color, o - x + y + z, o - x - y + z);
-
-	add_line(color, o - x - y - z, o - x - y + z);
-	add_line(color, o + x - y - z, o + x - y + z);
-	add_line(color, o + x + y - z, o + x + y + z);
-	add_line(color, o - x + y - z, o - x + y + z);
+	add_line(color, o - x - y - z, o + x - y - z, duration);
+	add_line(color, o + x - y - z, o + x + y - z, duration);
+	add_line(color, o + x + y - z, o - x + y - z, duration);
+	add_line(color, o - x + y - z, o - x - y - z, duration);
+
+	add_line(color, o - x - y + z, o + x - y + z, duration);
+	add_line(color, o + x - y + z, o + x + y + z, duration);
+	add_line(color, o + x + y + z, o - x + y + z, duration);
+	add_line(color, o - x + y + z, o - x - y + z, duration);
+
+	add_line(color, o - x - y - z, o - x - y + z, duration);
+	add_line(color, o + x - y - z, o + x - y + z, duration);
+	add_line(color, o + x + y - z, o + x + y + z, duration);
+	add_line(color, o - x + y - z, o - x + y + z, duration);
 }
 
 void DebugLine::clear()
 {
-	m_num_lines = 0;
+	const uint32_t num_threads = m_num_threads.load();
+	for (uint32_t i = 0; i < num_threads; i++)
+	{
+		ThreadBuffer& tb = m_threads[i];
+		if (tb.last != NULL)
+		{
+			tb.last->next = m_free_chunks;
+			m_free_chunks = tb.first;
+		}
+		tb.first = NULL;
+		tb.last = NULL;
+	}
+
+	array::clear(m_persistent);
+	array::clear(m_expire_time);
 }
 
 void DebugLine::commit()
 {
-	if (!m_num_lines)
-		return;
+	// Drop expired persistent lines
+	const double now = device()->time_since_start();
+	for (uint32_t i = 0; i < array::size(m_persistent); )
+	{
+		if (m_expire_time[i] <= now)
+		{
+			m_persistent[i] = array::back(m_persistent);
+			m_expire_time[i] = array::back(m_expire_time);
+			array::pop_back(m_persistent);
+			array::pop_back(m_expire_time);
+			continue;
+		}
+		i++;
+	}
+
+	// Merge the lines recorded by each thread and recycle their chunks
+	array::clear(m_merged);
+	const uint32_t num_threads = m_num_threads.load();
+	for (uint32_t i = 0; i < num_threads; i++)
+	{
+		ThreadBuffer& tb = m_threads[i];
+		for (Chunk* c = tb.first; c != NULL; c = c->next)
+		{
+			array::push(m_merged, c->lines, c->num);
+		}
+
+		if (tb.last != NULL)
+		{
+			tb.last->next = m_free_chunks;
+			m_free_chunks = tb.first;
+		}
+		tb.first = NULL;
+		tb.last = NULL;
+	}
 
-	bgfx::TransientVertexBuffer tvb;
-	bgfx::allocTransientVertexBuffer(&tvb, CE_MAX_DEBUG_LINES * 2, debug_line::s_decl);
+	submit(array::begin(m_merged), array::size(m_merged));
+	submit(array::begin(m_persistent), array::size(m_persistent));
+}
 
-	memcpy(tvb.data, m_lines, sizeof(Line) * m_num_lines);
+DebugLine::ThreadBuffer& DebugLine::thread_buffer()
+{
+	const uint64_t id = Thread::current_id();
 
-	bgfx::setState(BGFX_STATE_PT_LINES
+	// Slots are only appended, so registered ones can be read without locking
+	const uint32_t num_threads = m_num_threads.load();
+	for (uint32_t i = 0; i < num_threads; i++)
+	{
+		if (m_threads[i].thread_id == id)
+			return m_threads[i];
+	}
+
+	ScopedMutex sm(m_mutex);
+	const uint32_t num = m_num_threads.load();
+	CE_ASSERT(num < CE_MAX_DEBUG_LINE_THREADS, "Too many threads recording debug lines");
+
+	ThreadBuffer& tb = m_threads[num];
+	tb.thread_id = id;
+	tb.first = NULL;
+	tb.last = NULL;
+	m_num_threads.store(num + 1);
+	return tb;
+}
+
+DebugLine::Chunk* DebugLine::allocate_chunk()
+{
+	Chunk* chunk = NULL;
+
+	{
+		ScopedMutex sm(m_mutex);
+		if (m_free_chunks != NULL)
+		{
+			chunk = m_free_chunks;
+			m_free_chunks = chunk->next;
+		}
+	}
+
+	if (chunk == NULL)
+		chunk = CE_NEW(default_allocator(), Chunk);
+
+	chunk->next = NULL;
+	chunk->num = 0;
+	return chunk;
+}
+
+void DebugLine::add_persistent(const Line& line, float duration)
+{
+	ScopedMutex sm(m_mutex);
+	array::push_back(m_persistent, line);
+	array::push_back(m_expire_time, device()->time_since_start() + duration);
+}
+
+void DebugLine::submit(const Line* lines, uint32_t num)
+{
+	using namespace debug_line;
+
+	const uint64_t state = BGFX_STATE_PT_LINES
 		| BGFX_STATE_RGB_WRITE
 		| BGFX_STATE_DEPTH_WRITE
 		| (m_depth_test ? BGFX_STATE_DEPTH_TEST_LESS
 			: BGFX_STATE_DEPTH_TEST_ALWAYS)
-		| BGFX_STATE_CULL_CW);
+		| BGFX_STATE_CULL_CW;
+
+	for (uint32_t first = 0; first < num; first += MAX_LINES_PER_DRAW)
+	{
+		const uint32_t num_lines = math::min(num - first, MAX_LINES_PER_DRAW);
 
-	bgfx::setProgram(debug_line::s_prog);
-	bgfx::setVertexBuffer(&tvb, 0, m_num_lines * 2);
-	bgfx::submit(0);
+		if (!bgfx::checkAvailTransientVertexBuffer(num_lines * 2, s_decl))
+			return;
+
+		bgfx::TransientVertexBuffer tvb;
+		bgfx::allocTransientVertexBuffer(&tvb, num_lines * 2, s_decl);
+		memcpy(tvb.data, lines + first, sizeof(Line) * num_lines);
+
+		bgfx::setState(state);
+		bgfx::setProgram(s_prog);
+		bgfx::setVertexBuffer(&tvb, 0, num_lines * 2);
+		bgfx::submit(0);
+	}
 }
 
 } // namespace crown
@@ -30,6 +30,9 @@ OTHER DEALINGS IN THE SOFTWARE.
 #include "config.h"
 #include "math_types.h"
 #include "color4.h"
+#include "container_types.h"
+#include "mutex.h"
+#include "atomic_int.h"
 
 namespace crown
 {
@@ -41,25 +44,35 @@ namespace debug_line
 	void shutdown();
 } // namespace debug_line
 
+/// Records debug lines and draws them.
+///
+/// Lines can be added from any number of threads at the same time: each
+/// thread records into its own chunked buffer, which commit() merges.
+/// commit() and clear() must not run concurrently with the add_* functions.
 struct DebugLine
 {
 	/// Whether to enable @a depth_test
 	DebugLine(bool depth_test);
+	~DebugLine();
 
 	/// Adds a line from @a start to @a end with the given @a color.
-	void add_line(const Color4& color, const Vector3& start, const Vector3& end);
+	/// If @a duration is greater than zero, the line is drawn by every
+	/// commit() during the next @a duration seconds, otherwise it is
+	/// drawn by the next commit() only.
+	void add_line(const Color4& color, const Vector3& start, const Vector3& end, float duration = 0.0f);
 
 	/// Adds a sphere at @a center with the given @a radius and @a color.
-	void add_sphere(const Color4& color, const Vector3& center, const float radius);
+	void add_sphere(const Color4& color, const Vector3& center, const float radius, float duration = 0.0f);
 
 	/// Adds an orientd bounding box. @a tm describes the position and orientation of
 	/// the box. @a extents describes the size of the box along the axis.
-	void add_obb(const Color4& color, const Matrix4x4& tm, const Vector3& extents);
+	void add_obb(const Color4& color, const Matrix4x4& tm, const Vector3& extents, float duration = 0.0f);
 
-	/// Clears all the lines.
+	/// Clears all the lines, persistent ones included.
 	void clear();
 
 	/// Sends the lines to renderer for drawing.
+	/// Lines added without a duration are discarded once sent.
 	void commit();
 
 private:
@@ -72,9 +85,48 @@ private:
 		uint32_t c1;
 	};
 
+	struct Chunk
+	{
+		enum { SIZE = 1024 };
+
+		Chunk* next;
+		uint32_t num;
+		Line lines[SIZE];
+	};
+
+	struct ThreadBuffer
+	{
+		uint64_t thread_id;
+		Chunk* first;
+		Chunk* last;
+	};
+
+	/// Returns the buffer of the calling thread.
+	ThreadBuffer& thread_buffer();
+
+	/// Returns a chunk from the free list or a new one.
+	Chunk* allocate_chunk();
+
+	void add_persistent(const Line& line, float duration);
+
+	/// Submits @a num lines from @a lines in as many draws as needed.
+	void submit(const Line* lines, uint32_t num);
+
+private:
+
 	bool m_depth_test;
-	uint32_t m_num_lines;
-	Line m_lines[CE_MAX_DEBUG_LINES];
+
+	Mutex m_mutex;
+	AtomicInt m_num_threads;
+	ThreadBuffer m_threads[CE_MAX_DEBUG_LINE_THREADS];
+	Chunk* m_free_chunks;
+
+	// Lines with a duration, and the time at which they expire
+	Array<Line> m_persistent;
+	Array<double> m_expire_time;
+
+	// Lines merged by commit()
+	Array<Line> m_merged;
 };
 
 } // namespace crown
@@ -32,6 +32,13 @@ OTHER DEALINGS IN THE SOFTWARE.
 #include "vector2.h"
 #include "vector3.h"
 #include "matrix4x4.h"
+#include "render_bucket.h"
+#include "array.h"
+#include "device.h"
+#include "resource_manager.h"
+#include "string_utils.h"
+#include "log.h"
+#include <algorithm>
 #include <bgfx.h>
 
 namespace crown
@@ -39,20 +46,6 @@ namespace crown
 
 using namespace matrix4x4;
 
-struct VertexData
-{
-	float x;
-	float y;
-	float u;
-	float v;
-};
-
-struct IndexData
-{
-	uint16_t a;
-	uint16_t b;
-};
-
 #define UTF8_ACCEPT 0
 
 static const uint8_t s_utf8d[364] =
@@ -88,34 +81,45 @@ static uint32_t utf8_decode(uint32_t* state, uint32_t* code_point, uint8_t chara
 	return *state;
 }
 
-bgfx::VertexDecl Gui::s_pos_col;
-bgfx::VertexDecl Gui::s_pos_col_tex;
+// Indices are 16 bit
+static const uint32_t MAX_QUADS_PER_FLUSH = 65536 / 4;
 
-void Gui::init()
+// Higher values of pos.z are drawn later
+static uint8_t gui_layer(float z)
 {
-	Gui::s_pos_col
-		.begin()
-		.add(bgfx::Attrib::Position, 2, bgfx::AttribType::Float)
-		.add(bgfx::Attrib::Color0,   4, bgfx::AttribType::Uint8, true)
-		.end();
-
-	Gui::s_pos_col_tex
-		.begin()
-		.add(bgfx::Attrib::Position, 2, bgfx::AttribType::Float)
-		.add(bgfx::Attrib::TexCoord0, 2, bgfx::AttribType::Float, true)
-		.add(bgfx::Attrib::Color0,   4, bgfx::AttribType::Uint8, true)
-		.end();
+	return (uint8_t) math::clamp(0.0f, 255.0f, z);
 }
 
-Gui::Gui(uint16_t width, uint16_t height, const char* material)
-	: m_width(width)
+Gui::Gui(RenderBucket& bucket, uint8_t view, uint16_t width, uint16_t height, const char* material)
+	: m_bucket(bucket)
+	, m_view(view)
+	, m_width(width)
 	, m_height(height)
 	, m_pose(matrix4x4::IDENTITY)
+	, m_vertices(default_allocator())
+	, m_quads(default_allocator())
+	, m_materials(default_allocator())
+	, m_fonts(default_allocator())
+	, m_glyph_font(NULL)
 {
 	set_orthographic_rh(m_projection, 0, width, 0, height, -0.01f, 100.0f);
 
-	ResourceId id("material", material);
-	m_material = material_manager::get()->create_material(id.name);
+	m_decl
+		.begin()
+		.add(bgfx::Attrib::Position, 2, bgfx::AttribType::Float)
+		.add(bgfx::Attrib::TexCoord0, 2, bgfx::AttribType::Float)
+		.add(bgfx::Attrib::Color0, 4, bgfx::AttribType::Uint8, true)
+		.end();
+
+	m_material = this->material(material);
+}
+
+Gui::~Gui()
+{
+	for (uint32_t i = 0; i < array::size(m_materials); i++)
+	{
+		material_manager::get()->destroy_material(m_materials[i].id);
+	}
 }
 
 const GuiId Gui::id() const
@@ -146,36 +150,7 @@ Vector2 Gui::screen_to_gui(const Vector2& pos)
 
 void Gui::draw_rectangle(const Vector3& pos, const Vector2& size, const Color4& color)
 {
-	bgfx::TransientVertexBuffer tvb;
-	bgfx::TransientIndexBuffer tib;
-	bgfx::allocTransientVertexBuffer(&tvb, 4, Gui::s_pos_col);
-	bgfx::allocTransientIndexBuffer(&tib, 6);
-
-	float* verts = (float*) tvb.data;
-	verts[0] = pos.x;
-	verts[1] = pos.y;
-	verts[2] = pos.x + size.x;
-	verts[3] = pos.y;
-	verts[4] = pos.x + size.x;
-	verts[5] = pos.y + size.y;
-	verts[6] = pos.x;
-	verts[7] = pos.y + size.y;
-
-	uint16_t* inds = (uint16_t*) tib.data;
-	inds[0] = 0;
-	inds[1] = 1;
-	inds[2] = 2;
-	inds[3] = 0;
-	inds[4] = 2;
-	inds[5] = 3;
-
-	material_manager::get()->lookup_material(m_material)->bind();
-	bgfx::setViewTransform(1, matrix4x4::to_float_ptr(matrix4x4::IDENTITY), matrix4x4::to_float_ptr(m_projection));
-	bgfx::setViewRect(1, 0, 0, m_width, m_height);
-	bgfx::setState(BGFX_STATE_DEFAULT);
-	bgfx::setVertexBuffer(&tvb);
-	bgfx::setIndexBuffer(&tib);
-	bgfx::submit(1, (int32_t) pos.z);
+	add_quad(m_material, pos.z, pos.x, pos.y, pos.x + size.x, pos.y + size.y, 0.0f, 0.0f, 1.0f, 1.0f, color4::to_abgr(color));
 }
 
 void Gui::draw_image(const char* material, const Vector3& pos, const Vector2& size, const Color4& color)
@@ -185,176 +160,216 @@ void Gui::draw_image(const char* material, const Vector3& pos, const Vector2& si
 
 void Gui::draw_image_uv(const char* material, const Vector3& pos, const Vector2& size, const Vector2& uv0, const Vector2& uv1, const Color4& color)
 {
-	bgfx::TransientVertexBuffer tvb;
-	bgfx::TransientIndexBuffer tib;
-	bgfx::allocTransientVertexBuffer(&tvb, 4, Gui::s_pos_col_tex);
-	bgfx::allocTransientIndexBuffer(&tib, 6);
-
-	float* verts = (float*) tvb.data;
-	verts[0] = pos.x;
-	verts[1] = pos.y;
-	verts[2] = uv0.x;
-	verts[3] = uv0.y;
-
-	verts[4] = pos.x + size.x;
-	verts[5] = pos.y;
-	verts[6] = uv1.x;
-	verts[7] = uv0.y;
-
-	verts[8] = pos.x + size.x;
-	verts[9] = pos.y + size.y;
-	verts[10] = uv1.x;
-	verts[11] = uv1.y;
-
-	verts[12] = pos.x;
-	verts[13] = pos.y + size.y;
-	verts[14] = uv0.x;
-	verts[15] = uv1.y;
-
-	uint16_t* inds = (uint16_t*) tib.data;
-	inds[0] = 0;
-	inds[1] = 1;
-	inds[2] = 2;
-	inds[3] = 0;
-	inds[4] = 2;
-	inds[5] = 3;
-
-/*	ResourceId res_id("material", material);
-	Material* mat = material_manager::get()->lookup_material(res_id.name);
-	mat->bind();*/
-
-	bgfx::setViewTransform(1, matrix4x4::to_float_ptr(matrix4x4::IDENTITY), matrix4x4::to_float_ptr(m_projection));
-	bgfx::setViewRect(1, 0, 0, m_width, m_height);
-	bgfx::setState(BGFX_STATE_DEFAULT);
-	bgfx::setVertexBuffer(&tvb);
-	bgfx::setIndexBuffer(&tib);
-	bgfx::submit(1, (int32_t) pos.z);
+	add_quad(this->material(material), pos.z, pos.x, pos.y, pos.x + size.x, pos.y + size.y, uv0.x, uv0.y, uv1.x, uv1.y, color4::to_abgr(color));
 }
 
 void Gui::draw_text(const char* str, const char* font, uint32_t font_size, const Vector3& pos, const Color4& color)
 {
-	// Renderer* r = device()->renderer();
-
-	// const FontResource* resource = (FontResource*) device()->resource_manager()->get("font", font);
-	// Vector2 m_pen;
-
-	// const float scale = ((float)font_size / (float)resource->font_size());
-	// const uint32_t str_len = string::strlen(str);
-
-	// TransientVertexBuffer vb;
-	// TransientIndexBuffer ib;
-
-	// r->reserve_transient_vertex_buffer(&vb, 4 * str_len, VertexFormat::P2_T2);
-	// r->reserve_transient_index_buffer(&ib, 6 * str_len);
-
-	// uint16_t index = 0;
-	// float x_pen_advance = 0.0f;
-	// float y_pen_advance = 0.0f;
-
-	// uint32_t state = 0;
-	// uint32_t code_point = 0;
-	// for (uint32_t i = 0; i < str_len; i++)
-	// {
-	// 	switch (str[i])
-	// 	{
-	// 		case '\n':
-	// 		{
-	// 			x_pen_advance = 0.0f;
-	// 			y_pen_advance -= resource->font_size();
-	// 			continue;
-	// 		}
-	// 		case '\t':
-	// 		{
-	// 			x_pen_advance += font_size * 4;
-	// 			continue;
-	// 		}
-	// 	}
-		
-	// 	if (utf8_decode(&state, &code_point, str[i]) == UTF8_ACCEPT)
-	// 	{
-	// 		FontGlyphData g = resource->get_glyph(code_point);
-
-	// 		const float baseline = g.height - g.y_offset;
-
-	// 		// Set pen position
-	// 		m_pen.x = pos.x + g.x_offset;
-	// 		m_pen.y = pos.y - baseline;
-
-	// 		// Position coords
-	// 		const float x0 = (m_pen.x + x_pen_advance) * scale;
-	// 		const float y0 = (m_pen.y + y_pen_advance) * scale;
-	// 		const float x1 = (m_pen.x + g.width + x_pen_advance) * scale;
-	// 		const float y1 = (m_pen.y + g.height + y_pen_advance) * scale;
-
-	// 		// Texture coords
-	// 		const float u0 = (float) g.x / 512;
-	// 		const float v0 = (float) g.y / 512;
-	// 		const float u1 = u0 + ((float) g.width) / 512;
-	// 		const float v1 = v0 - ((float) g.height) / 512;
-
-	// 		// Fill vertex buffer
-	// 		(*(VertexData*)(vb.data)).x		= x0;
-	// 		(*(VertexData*)(vb.data)).y		= y0;
-	// 		(*(VertexData*)(vb.data)).u		= u0;
-	// 		(*(VertexData*)(vb.data)).v		= v1;
-	// 		vb.data += sizeof(VertexData);
-
-	// 		(*(VertexData*)(vb.data)).x		= x1;
-	// 		(*(VertexData*)(vb.data)).y		= y0;
-	// 		(*(VertexData*)(vb.data)).u		= u1;
-	// 		(*(VertexData*)(vb.data)).v		= v1;
-	// 		vb.data += sizeof(VertexData);
-
-	// 		(*(VertexData*)(vb.data)).x		= x1;
-	// 		(*(VertexData*)(vb.data)).y		= y1;
-	// 		(*(VertexData*)(vb.data)).u		= u1;
-	// 		(*(VertexData*)(vb.data)).v		= v0;
-	// 		vb.data += sizeof(VertexData);
-
-	// 		(*(VertexData*)(vb.data)).x		= x0;
-	// 		(*(VertexData*)(vb.data)).y		= y1;
-	// 		(*(VertexData*)(vb.data)).u		= u0;
-	// 		(*(VertexData*)(vb.data)).v		= v0;
-	// 		vb.data += sizeof(VertexData);
-
-	// 		// Fill index buffer
-	// 		(*(IndexData*)(ib.data)).a		= index;
-	// 		(*(IndexData*)(ib.data)).b		= index + 1;
-	// 		ib.data += sizeof(IndexData);
-
-	// 		(*(IndexData*)(ib.data)).a		= index + 2;
-	// 		(*(IndexData*)(ib.data)).b		= index;
-	// 		ib.data += sizeof(IndexData);
-
-	// 		(*(IndexData*)(ib.data)).a		= index + 2;
-	// 		(*(IndexData*)(ib.data)).b		= index + 3;
-	// 		ib.data += sizeof(IndexData);
-
-	// 		// Advance pen position
-	// 		x_pen_advance += g.x_advance;
-
-	// 		index += 4;
-	// 	}
-	// }
-
-	// const MaterialResource* mr = (MaterialResource*) device()->resource_manager()->get(resource->material());
-	// const TextureResource* tr = (TextureResource*) device()->resource_manager()->get(mr->get_texture_layer(0));
-
-	// r->set_layer_view(1, matrix4x4::IDENTITY);
-	// r->set_layer_projection(1, m_projection);
-	// r->set_layer_viewport(1, 0, 0, 1000, 625);
-	// r->set_state(STATE_COLOR_WRITE
-	// 				| STATE_CULL_CW
-	// 				| STATE_BLEND_EQUATION_ADD 
-	// 				| STATE_BLEND_FUNC(STATE_BLEND_FUNC_SRC_ALPHA, STATE_BLEND_FUNC_ONE_MINUS_SRC_ALPHA));
-	// r->set_pose(m_pose);
-	// r->set_program(render_world_globals::default_font_program());
-	// r->set_texture(0, render_world_globals::default_font_uniform(), tr->texture(),
-	// 				TEXTURE_FILTER_LINEAR | TEXTURE_WRAP_U_CLAMP_REPEAT | TEXTURE_WRAP_V_CLAMP_REPEAT);
-	// r->set_uniform(render_world_globals::default_color_uniform(), UniformType::FLOAT_4, color4::to_float_ptr(color), 1);
-	// r->set_vertex_buffer(vb);
-	// r->set_index_buffer(ib);
-	// r->commit(1, (int32_t) pos.z);
+	const FontEntry& fe = this->font(font);
+	const FontResource* fr = fe.resource;
+	const MaterialId mat = fe.material;
+
+	const float scale = (float) font_size / (float) font_resource::font_size(fr);
+	const float inv_tex_size = 1.0f / (float) font_resource::texture_size(fr);
+	const uint32_t abgr = color4::to_abgr(color);
+
+	float pen_x = 0.0f;
+	float pen_y = 0.0f;
+
+	uint32_t state = 0;
+	uint32_t code_point = 0;
+	for (const char* ch = str; *ch != '\0'; ch++)
+	{
+		switch (*ch)
+		{
+			case '\n':
+			{
+				pen_x = 0.0f;
+				pen_y -= font_resource::font_size(fr);
+				continue;
+			}
+			case '\t':
+			{
+				const FontGlyphData* space = glyph(fr, ' ');
+				pen_x += 4 * (space != NULL ? space->x_advance : font_resource::font_size(fr));
+				continue;
+			}
+		}
+
+		if (utf8_decode(&state, &code_point, *ch) != UTF8_ACCEPT)
+			continue;
+
+		const FontGlyphData* g = glyph(fr, code_point);
+		if (g == NULL)
+			continue;
+
+		const float x0 = pos.x + (pen_x + g->x_offset) * scale;
+		const float y0 = pos.y + (pen_y + g->y_offset - g->height) * scale;
+		const float x1 = x0 + g->width * scale;
+		const float y1 = y0 + g->height * scale;
+
+		// Atlas rows grow downwards
+		const float u0 = g->x * inv_tex_size;
+		const float v0 = (g->y + g->height) * inv_tex_size;
+		const float u1 = (g->x + g->width) * inv_tex_size;
+		const float v1 = g->y * inv_tex_size;
+
+		add_quad(mat, pos.z, x0, y0, x1, y1, u0, v0, u1, v1, abgr);
+
+		pen_x += g->x_advance;
+	}
+}
+
+void Gui::flush()
+{
+	const uint32_t num = array::size(m_quads);
+	if (num == 0)
+		return;
+
+	// Keep the drawing order of quads sharing layer and material
+	std::stable_sort(array::begin(m_quads), array::end(m_quads));
+
+	bgfx::setViewTransform(m_view, matrix4x4::to_float_ptr(matrix4x4::IDENTITY), matrix4x4::to_float_ptr(m_projection));
+	bgfx::setViewRect(m_view, 0, 0, m_width, m_height);
+
+	uint32_t batch_size = MAX_QUADS_PER_FLUSH;
+	uint32_t first = 0;
+	while (first < num)
+	{
+		const uint32_t num_quads = math::min(num - first, batch_size);
+
+		if (!bgfx::checkAvailTransientVertexBuffer(num_quads * 4, m_decl)
+			|| !bgfx::checkAvailTransientIndexBuffer(num_quads * 6))
+		{
+			// Out of transient memory, retry the remaining quads in smaller batches
+			if (num_quads > 1)
+			{
+				CE_LOGW("Gui: out of transient memory for %u quads, retrying with %u", num_quads, num_quads / 2);
+				batch_size = num_quads / 2;
+				continue;
+			}
+
+			CE_LOGW("Gui: out of transient memory, dropping %u quads", num - first);
+			break;
+		}
+
+		bgfx::TransientVertexBuffer tvb;
+		bgfx::TransientIndexBuffer tib;
+		bgfx::allocTransientVertexBuffer(&tvb, num_quads * 4, m_decl);
+		bgfx::allocTransientIndexBuffer(&tib, num_quads * 6);
+
+		Vertex* verts = (Vertex*) tvb.data;
+		uint16_t* inds = (uint16_t*) tib.data;
+
+		uint32_t run = 0;
+		for (uint32_t i = 0; i < num_quads; i++)
+		{
+			const Quad& q = m_quads[first + i];
+			memcpy(verts, &m_vertices[q.first_vertex], sizeof(Vertex) * 4);
+			verts += 4;
+
+			const uint16_t base = uint16_t(i * 4);
+			*inds++ = base;
+			*inds++ = base + 1;
+			*inds++ = base + 2;
+			*inds++ = base;
+			*inds++ = base + 2;
+			*inds++ = base + 3;
+
+			// Record a draw for each run of quads sharing layer and material
+			const bool last = i + 1 == num_quads;
+			if (last || m_quads[first + i + 1].key != q.key)
+			{
+				RenderCommand cmd;
+				cmd.material = q.material.id != INVALID_ID ? material_manager::get()->lookup_material(q.material) : NULL;
+				cmd.state = BGFX_STATE_DEFAULT;
+				cmd.set_buffers(tvb, tib, run * 6, (i + 1 - run) * 6);
+
+				// Gui has no view depth, use it to keep the runs of a
+				// layer in the order they have been sorted above
+				const uint8_t layer = uint8_t(q.key >> 16);
+				const float depth = 1.0f - float(first + run) / float(num);
+				m_bucket.add(render_key::translucent(m_view, layer, depth, render_key::material_bits(cmd.material), 0), cmd, &m_pose);
+
+				run = i + 1;
+			}
+		}
+
+		first += num_quads;
+	}
+
+	array::clear(m_vertices);
+	array::clear(m_quads);
+}
+
+MaterialId Gui::material(const char* name)
+{
+	const StringId64 id = ResourceId("material", name).name;
+
+	for (uint32_t i = 0; i < array::size(m_materials); i++)
+	{
+		if (m_materials[i].name == id)
+			return m_materials[i].id;
+	}
+
+	MaterialEntry e;
+	e.name = id;
+	e.id = material_manager::get()->create_material(id);
+	array::push_back(m_materials, e);
+	return e.id;
+}
+
+const Gui::FontEntry& Gui::font(const char* name)
+{
+	const StringId64 id = ResourceId("font", name).name;
+
+	for (uint32_t i = 0; i < array::size(m_fonts); i++)
+	{
+		if (m_fonts[i].name == id)
+			return m_fonts[i];
+	}
+
+	FontEntry e;
+	e.name = id;
+	e.resource = (const FontResource*) device()->resource_manager()->get("font", name);
+	e.material = material(name);
+	array::push_back(m_fonts, e);
+	return array::back(m_fonts);
+}
+
+const FontGlyphData* Gui::glyph(const FontResource* fr, uint32_t code_point)
+{
+	if (fr != m_glyph_font)
+	{
+		memset(m_glyph_cache, 0, sizeof(m_glyph_cache));
+		m_glyph_font = fr;
+	}
+
+	if (code_point >= CE_COUNTOF(m_glyph_cache))
+		return font_resource::get_glyph(fr, code_point);
+
+	if (m_glyph_cache[code_point] == NULL)
+		m_glyph_cache[code_point] = font_resource::get_glyph(fr, code_point);
+
+	return m_glyph_cache[code_point];
+}
+
+void Gui::add_quad(MaterialId material, float z, float x0, float y0, float x1, float y1, float u0, float v0, float u1, float v1, uint32_t abgr)
+{
+	Quad q;
+	q.key = (uint32_t(gui_layer(z)) << 16) | material.index;
+	q.first_vertex = array::size(m_vertices);
+	q.material = material;
+	array::push_back(m_quads, q);
+
+	Vertex v[4] =
+	{
+		{ x0, y0, u0, v0, abgr },
+		{ x1, y0, u1, v0, abgr },
+		{ x1, y1, u1, v1, abgr },
+		{ x0, y1, u0, v1, abgr }
+	};
+	array::push(m_vertices, v, 4);
 }
 
 } // namespace crown
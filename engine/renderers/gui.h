@@ -29,6 +29,7 @@ OTHER DEALINGS IN THE SOFTWARE.
 #include "math_types.h"
 #include "color4.h"
 #include "render_world_types.h"
+#include "container_types.h"
 #include "material.h"
 #include <bgfx.h>
 
@@ -36,13 +37,24 @@ namespace crown
 {
 
 class RenderWorld;
+class RenderBucket;
+struct FontResource;
+struct FontGlyphData;
+typedef Id MaterialId;
 
 /// Manages the rendering of GUI objects.
 ///
+/// Primitives are accumulated into per-frame vertex arrays and recorded
+/// by flush() as a few draw calls, one for each run of primitives
+/// sharing the same layer and material.
+///
 /// @ingroup Graphics
 struct Gui
 {
-	Gui(uint16_t width, uint16_t height, const char* material);
+	/// Draws made through the gui are recorded into @a bucket for the bgfx @a view.
+	/// Each gui needs its own view since the view holds its projection.
+	Gui(RenderBucket& bucket, uint8_t view, uint16_t width, uint16_t height, const char* material);
+	~Gui();
 
 	const GuiId id() const;
 	void set_id(const GuiId id);
@@ -65,25 +77,85 @@ struct Gui
 	void draw_image_uv(const char* material, const Vector3& pos, const Vector2& size, const Vector2& uv0, const Vector2& uv1, const Color4& color = Color4::WHITE);
 
 	/// Draws the text @a str with the given @a font and @a font_size.
+	/// The glyphs are textured with the material named as the @a font.
 	/// @note Higher values of pos.z make the object appear in front of other objects.
 	void draw_text(const char* str, const char* font, uint32_t font_size, const Vector3& pos, const Color4& color = Color4::WHITE);
 
+	/// Records the primitives drawn since the last call into the render
+	/// bucket and clears them.
+	void flush();
+
+private:
+
+	/// Returns the instance of the material @a name, creating it the first time.
+	MaterialId material(const char* name);
+
+	struct FontEntry;
+
+	/// Returns the font @a name and its material, resolving them the first time.
+	const FontEntry& font(const char* name);
+
+	/// Returns the glyph of @a code_point in @a fr or NULL if the font does not have it.
+	const FontGlyphData* glyph(const FontResource* fr, uint32_t code_point);
+
+	void add_quad(MaterialId material, float z, float x0, float y0, float x1, float y1, float u0, float v0, float u1, float v1, uint32_t abgr);
+
 public:
 
+	RenderBucket& m_bucket;
+	uint8_t m_view;
 	GuiId m_id;
 	uint16_t m_width;
 	uint16_t m_height;
-	typedef Id MaterialId;
 	MaterialId m_material;
 	Matrix4x4 m_projection;
 	Matrix4x4 m_pose;
 
-	static void init();
-
 private:
 
-	static bgfx::VertexDecl s_pos_col;
-	static bgfx::VertexDecl s_pos_col_tex;
+	struct Vertex
+	{
+		float x;
+		float y;
+		float u;
+		float v;
+		uint32_t abgr;
+	};
+
+	struct Quad
+	{
+		uint32_t key;
+		uint32_t first_vertex;
+		MaterialId material;
+
+		bool operator<(const Quad& other) const
+		{
+			return key < other.key;
+		}
+	};
+
+	struct MaterialEntry
+	{
+		StringId64 name;
+		MaterialId id;
+	};
+
+	struct FontEntry
+	{
+		StringId64 name;
+		const FontResource* resource;
+		MaterialId material;
+	};
+
+	bgfx::VertexDecl m_decl;
+	Array<Vertex> m_vertices;
+	Array<Quad> m_quads;
+	Array<MaterialEntry> m_materials;
+	Array<FontEntry> m_fonts;
+
+	// Direct lookup for the ASCII glyphs of the last font used
+	const FontResource* m_glyph_font;
+	const FontGlyphData* m_glyph_cache[128];
 };
 
 } // namespace crown
@@ -30,8 +30,10 @@ OTHER DEALINGS IN THE SOFTWARE.
 #include "device.h"
 #include "resource_manager.h"
 #include "texture_resource.h"
+#include "texture_streamer.h"
 #include "material_manager.h"
 #include "shader.h"
+#include "string_utils.h"
 #include <bgfx.h>
 
 namespace crown
@@ -47,6 +49,8 @@ void Material::create(const MaterialResource* mr, MaterialManager& mm)
 	data = (char*) default_allocator().allocate(size);
 	memcpy(data, base, size);
 	resource = mr;
+
+	resolve();
 }
 
 void Material::destroy() const
@@ -54,27 +58,45 @@ void Material::destroy() const
 	default_allocator().deallocate(data);
 }
 
-void Material::bind() const
+void Material::resolve()
 {
-	Shader* shader = (Shader*) device()->resource_manager()->get(SHADER_TYPE, material_resource::shader(resource));
-	bgfx::setProgram(shader->program);
+	ResourceManager* rm = device()->resource_manager();
+
+	Shader* shader = (Shader*) rm->get(SHADER_TYPE, material_resource::shader(resource));
+	program = shader->program;
+	instanced_program = shader->instanced_program;
 
-	// Set samplers
 	for (uint32_t i = 0; i < num_textures(resource); i++)
 	{
 		TextureData* td = get_texture_data(resource, i);
 		TextureHandle* th = get_texture_handle(resource, i, data);
 
+		TextureResource* teximg = (TextureResource*) rm->get(TEXTURE_TYPE, td->id);
+		th->texture_handle = teximg->handle.idx;
+	}
+}
+
+void Material::bind(const Material* prev, bool instanced) const
+{
+	bgfx::setProgram(instanced ? instanced_program : program);
+
+	// Set samplers
+	for (uint32_t i = 0; i < num_textures(resource); i++)
+	{
+		TextureHandle* th = get_texture_handle(resource, i, data);
+
 		bgfx::UniformHandle sampler;
 		bgfx::TextureHandle texture;
 		sampler.idx = th->sampler_handle;
-
-		TextureResource* teximg = (TextureResource*) device()->resource_manager()->get(TEXTURE_TYPE, td->id);
-		texture.idx = teximg->handle.idx;
+		texture.idx = th->texture_handle;
 
 		bgfx::setTexture(i, sampler, texture);
 	}
 
+	// Uniforms still hold the values set by the previous draw
+	if (prev != NULL && equals(*prev))
+		return;
+
 	// Set uniforms
 	for (uint32_t i = 0; i < num_uniforms(resource); i++)
 	{
@@ -86,6 +108,36 @@ void Material::bind() const
 	}
 }
 
+bool Material::has_instanced_program() const
+{
+	return instanced_program.idx != bgfx::invalidHandle;
+}
+
+void Material::record_texture_usage(TextureStreamer& ts, float size) const
+{
+	for (uint32_t i = 0; i < num_textures(resource); i++)
+	{
+		TextureHandle* th = get_texture_handle(resource, i, data);
+		ts.record_usage(th->texture_handle, size);
+	}
+}
+
+uint64_t Material::sort_key() const
+{
+	const uint32_t res = string::murmur2_32(&resource, sizeof(resource), 0);
+	const uint32_t params = string::murmur2_32(data, dynamic_data_size(resource), 0);
+	return (uint64_t(res) << 32) | params;
+}
+
+bool Material::equals(const Material& other) const
+{
+	if (this == &other)
+		return true;
+
+	return resource == other.resource
+		&& memcmp(data, other.data, dynamic_data_size(resource)) == 0;
+}
+
 void Material::set_float(const char* name, float val)
 {
 	char* p = (char*) get_uniform_handle_by_string(resource, name, data);
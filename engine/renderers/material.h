@@ -34,12 +34,39 @@ namespace crown
 
 struct MaterialManager;
 struct MaterialResource;
+class TextureStreamer;
 
 struct Material
 {
 	void create(const MaterialResource* mr, MaterialManager& mm);
 	void destroy() const;
-	void bind() const;
+
+	/// Looks up the shader program and the textures used by the material
+	/// and caches their handles. Must be called again whenever one
+	/// of them is reloaded.
+	void resolve();
+
+	/// Binds the program, the textures and the uniforms of the material.
+	/// @a prev is the material bound by the previous draw, if any: when it
+	/// holds the same parameter values the uniforms are not set again,
+	/// because bgfx keeps uniform values across draw calls.
+	/// If @a instanced is true the instanced variant of the program is bound.
+	void bind(const Material* prev = NULL, bool instanced = false) const;
+
+	/// Returns whether the shader of the material has an instanced variant.
+	bool has_instanced_program() const;
+
+	/// Records to @a ts that the textures of the material are
+	/// being drawn @a size pixels wide.
+	void record_texture_usage(TextureStreamer& ts, float size) const;
+
+	/// Returns a key which is the same for materials sharing
+	/// the same resource and the same parameter values.
+	uint64_t sort_key() const;
+
+	/// Returns whether the material has the same resource and the
+	/// same parameter values as @a other.
+	bool equals(const Material& other) const;
 
 	void set_float(const char* name, float val);
 	void set_vector2(const char* name, const Vector2& val);
@@ -47,6 +74,8 @@ struct Material
 
 	const MaterialResource* resource;
 	char* data;
+	bgfx::ProgramHandle program;
+	bgfx::ProgramHandle instanced_program;
 };
 
 } // namespace crown
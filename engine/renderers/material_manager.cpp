@@ -57,9 +57,14 @@ MaterialManager::MaterialManager()
 }
 
 MaterialId MaterialManager::create_material(StringId64 id)
+{
+	return create_material((MaterialResource*) device()->resource_manager()->get(MATERIAL_TYPE, id));
+}
+
+MaterialId MaterialManager::create_material(const MaterialResource* mr)
 {
 	MaterialId new_id = id_table::create(_materials_ids);
-	_materials[new_id.index].create((MaterialResource*) device()->resource_manager()->get(MATERIAL_TYPE, id), *this);
+	_materials[new_id.index].create(mr, *this);
 	return new_id;
 }
 
@@ -74,4 +79,14 @@ Material* MaterialManager::lookup_material(MaterialId id)
 	return &_materials[id.index];
 }
 
+void MaterialManager::reload_materials()
+{
+	const Id* ids = id_table::begin(_materials_ids);
+	for (uint32_t i = 0; i < CE_COUNTOF(_materials); i++)
+	{
+		if (ids[i].id != INVALID_ID)
+			_materials[i].resolve();
+	}
+}
+
 } // namespace crown
@@ -44,9 +44,16 @@ struct MaterialManager
 	MaterialManager();
 
 	MaterialId create_material(StringId64 id);
+
+	/// Creates a new material from the already loaded resource @a mr.
+	MaterialId create_material(const MaterialResource* mr);
 	void destroy_material(MaterialId id);
 	Material* lookup_material(MaterialId id);
 
+	/// Resolves again the handles of all the materials.
+	/// Call after shaders or textures have been reloaded.
+	void reload_materials();
+
 private:
 
 	IdTable<512> _materials_ids;
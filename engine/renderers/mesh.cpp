@@ -31,6 +31,9 @@ OTHER DEALINGS IN THE SOFTWARE.
 #include "quaternion.h"
 #include "unit.h"
 #include "scene_graph.h"
+#include "material.h"
+#include "material_manager.h"
+#include "render_bucket.h"
 
 namespace crown
 {
@@ -40,6 +43,7 @@ Mesh::Mesh(SceneGraph& sg, int32_t node, const MeshResource* mr)
 	, m_node(node)
 	, m_resource(mr)
 {
+	m_material.id = INVALID_ID;
 }
 
 Vector3 Mesh::local_position() const
@@ -87,4 +91,21 @@ void Mesh::set_local_pose(Unit* unit, const Matrix4x4& pose)
 	unit->set_local_pose(m_node, pose);
 }
 
+void Mesh::set_material(MaterialId id)
+{
+	m_material = id;
+}
+
+void Mesh::render(RenderBucket& bucket, uint8_t view, float depth)
+{
+	RenderCommand cmd;
+	cmd.material = m_material.id != INVALID_ID ? material_manager::get()->lookup_material(m_material) : NULL;
+	cmd.state = MESH_RENDER_STATE;
+	cmd.set_buffers(m_resource->vertex_buffer(), m_resource->index_buffer());
+
+	const Matrix4x4 pose = world_pose();
+	const uint64_t key = render_key::opaque(view, 0, render_key::material_bits(cmd.material), render_key::mesh_bits(m_resource), depth);
+	bucket.add(key, cmd, &pose);
+}
+
 } // namespace crown
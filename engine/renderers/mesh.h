@@ -27,15 +27,22 @@ OTHER DEALINGS IN THE SOFTWARE.
 #pragma once
 
 #include "matrix4x4.h"
+#include "render_world_types.h"
+#include <bgfx.h>
 
 namespace crown
 {
 
+class RenderBucket;
 struct SceneGraph;
 struct MeshResource;
 struct Quaternion;
 struct Unit;
 struct Vector3;
+typedef Id MaterialId;
+
+/// Render state used to draw meshes.
+const uint64_t MESH_RENDER_STATE = BGFX_STATE_DEFAULT;
 
 struct Mesh
 {
@@ -68,11 +75,18 @@ struct Mesh
 	/// Sets the local pose of the mesh.
 	void set_local_pose(Unit* unit, const Matrix4x4& pose);
 
+	void set_material(MaterialId id);
+
+	/// Records a draw of the mesh into @a bucket for @a view.
+	/// @a depth is the view depth of the mesh in [0, 1] and orders the draws front to back.
+	void render(RenderBucket& bucket, uint8_t view, float depth);
+
 public:
 
 	SceneGraph& m_scene_graph;
 	int32_t m_node;
 	const MeshResource* m_resource;
+	MaterialId m_material;
 };
 
 } // namespace crown
@@ -0,0 +1,182 @@
+/*
+Copyright (c) 2013 Daniele Bartolini, Michele Rossi
+Copyright (c) 2012 Daniele Bartolini, Simone Boscaratto
+
+Permission is hereby granted, free of charge, to any person
+obtaining a copy of this software and associated documentation
+files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use,
+copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following
+conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "mesh_batcher.h"
+#include "mesh.h"
+#include "mesh_resource.h"
+#include "material.h"
+#include "material_manager.h"
+#include "matrix4x4.h"
+#include "array.h"
+#include "render_bucket.h"
+#include "string_utils.h"
+#include <algorithm>
+#include <string.h>
+#include <bgfx.h>
+
+namespace crown
+{
+
+namespace mesh_batcher_internal
+{
+	static const Material* material(const Mesh& m)
+	{
+		return m.m_material.id != INVALID_ID ? material_manager::get()->lookup_material(m.m_material) : NULL;
+	}
+
+	// Meshes sharing the same resource and an equivalent material
+	// end up next to each other once sorted
+	static uint64_t sort_key(const Mesh& m)
+	{
+		const Material* mat = material(m);
+		const uint64_t mat_key = mat != NULL ? mat->sort_key() : 0;
+		const uint32_t res = string::murmur2_32(&m.m_resource, sizeof(m.m_resource), 0);
+		const uint32_t params = string::murmur2_32(&mat_key, sizeof(mat_key), 0);
+		return (uint64_t(res) << 32) | params;
+	}
+
+	static bool can_instance(const Mesh& a, const Mesh& b)
+	{
+		if (a.m_resource != b.m_resource)
+			return false;
+
+		const Material* ma = material(a);
+		const Material* mb = material(b);
+
+		if (ma == NULL || mb == NULL)
+			return ma == mb;
+
+		return ma->equals(*mb);
+	}
+} // namespace mesh_batcher_internal
+
+// Upper bound on the instance data allocated by a single draw call
+static const uint32_t MAX_INSTANCES_PER_BATCH = 4096;
+
+MeshBatcher::MeshBatcher(Allocator& a)
+	: m_items(a)
+	, m_num_batches(0)
+{
+}
+
+void MeshBatcher::begin()
+{
+	array::clear(m_items);
+}
+
+void MeshBatcher::add(const Mesh& m, float depth)
+{
+	Item item;
+	item.key = mesh_batcher_internal::sort_key(m);
+	item.depth = depth;
+	item.mesh = &m;
+	array::push_back(m_items, item);
+}
+
+void MeshBatcher::submit(RenderBucket& bucket, uint8_t view)
+{
+	using namespace mesh_batcher_internal;
+
+	m_num_batches = 0;
+
+	const uint32_t num = array::size(m_items);
+	if (num == 0)
+		return;
+
+	std::sort(array::begin(m_items), array::end(m_items));
+
+	uint32_t first = 0;
+
+	for (uint32_t i = 1; i <= num; i++)
+	{
+		const bool flush = i == num
+			|| m_items[i].key != m_items[first].key
+			|| !can_instance(*m_items[i].mesh, *m_items[first].mesh)
+			|| i - first == MAX_INSTANCES_PER_BATCH;
+
+		if (flush)
+		{
+			submit_batch(bucket, view, first, i);
+			first = i;
+		}
+	}
+}
+
+uint32_t MeshBatcher::num_batches() const
+{
+	return m_num_batches;
+}
+
+void MeshBatcher::submit_batch(RenderBucket& bucket, uint8_t view, uint32_t begin, uint32_t end)
+{
+	const uint32_t num_instances = end - begin;
+	const uint16_t stride = sizeof(Matrix4x4);
+
+	const Material* mat = mesh_batcher_internal::material(*m_items[begin].mesh);
+
+	// Only shaders written for it can read the poses from the instance data
+	const bool instancing = num_instances > 1
+		&& mat != NULL
+		&& mat->has_instanced_program()
+		&& (bgfx::getCaps()->supported & BGFX_CAPS_INSTANCING) != 0;
+
+	if (!instancing
+		|| !bgfx::checkAvailInstanceDataBuffer(num_instances, stride))
+	{
+		for (uint32_t i = begin; i < end; i++)
+		{
+			const_cast<Mesh*>(m_items[i].mesh)->render(bucket, view, m_items[i].depth);
+		}
+		m_num_batches += num_instances;
+		return;
+	}
+
+	const bgfx::InstanceDataBuffer* idb = bgfx::allocInstanceDataBuffer(num_instances, stride);
+
+	uint8_t* data = idb->data;
+	for (uint32_t i = 0; i < num_instances; i++)
+	{
+		const Matrix4x4 pose = m_items[begin + i].mesh->world_pose();
+		memcpy(data, matrix4x4::to_float_ptr(pose), stride);
+		data += stride;
+	}
+
+	const Mesh& first = *m_items[begin].mesh;
+
+	RenderCommand cmd;
+	cmd.material = mat;
+	cmd.state = MESH_RENDER_STATE;
+	cmd.instances = idb;
+	cmd.set_buffers(first.m_resource->vertex_buffer(), first.m_resource->index_buffer());
+
+	// The batch is sorted by the nearest of its meshes
+	bucket.add(render_key::opaque(view, 0, render_key::material_bits(cmd.material), render_key::mesh_bits(first.m_resource), m_items[begin].depth), cmd);
+
+	m_num_batches++;
+}
+
+} // namespace crown
@@ -0,0 +1,90 @@
+/*
+Copyright (c) 2013 Daniele Bartolini, Michele Rossi
+Copyright (c) 2012 Daniele Bartolini, Simone Boscaratto
+
+Permission is hereby granted, free of charge, to any person
+obtaining a copy of this software and associated documentation
+files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use,
+copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following
+conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#pragma once
+
+#include "types.h"
+#include "container_types.h"
+#include "memory_types.h"
+
+namespace crown
+{
+
+class RenderBucket;
+struct Mesh;
+
+/// Draws meshes sharing the same MeshResource and material with a single
+/// instanced draw call, when the shader of the material declares an
+/// instanced variant ("instanced_vs_code"). World poses are streamed through
+/// bgfx instance data buffers, from which the instanced variant reads the
+/// model matrix as i_data0..3. Otherwise, or when instancing is not
+/// available, each mesh is drawn on its own with its model matrix.
+///
+/// @ingroup Graphics
+class MeshBatcher
+{
+public:
+
+	MeshBatcher(Allocator& a);
+
+	/// Starts collecting meshes for a new frame.
+	void begin();
+
+	/// Adds the mesh @a m with the view @a depth in [0, 1] to the current batch list.
+	void add(const Mesh& m, float depth);
+
+	/// Sorts the collected meshes by resource and material and records them into @a bucket for @a view.
+	void submit(RenderBucket& bucket, uint8_t view);
+
+	/// Returns the number of draw calls recorded by the last submit().
+	uint32_t num_batches() const;
+
+private:
+
+	/// Records the meshes in [begin, end) of m_items as a single draw call.
+	void submit_batch(RenderBucket& bucket, uint8_t view, uint32_t begin, uint32_t end);
+
+private:
+
+	struct Item
+	{
+		uint64_t key;
+		float depth;
+		const Mesh* mesh;
+
+		// Front to back within the same resource and material
+		bool operator<(const Item& other) const
+		{
+			return key != other.key ? key < other.key : depth < other.depth;
+		}
+	};
+
+	Array<Item> m_items;
+	uint32_t m_num_batches;
+};
+
+} // namespace crown
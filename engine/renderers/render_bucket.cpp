@@ -0,0 +1,264 @@
+/*
+Copyright (c) 2013 Daniele Bartolini, Michele Rossi
+Copyright (c) 2012 Daniele Bartolini, Simone Boscaratto
+
+Permission is hereby granted, free of charge, to any person
+obtaining a copy of this software and associated documentation
+files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use,
+copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following
+conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "render_bucket.h"
+#include "material.h"
+#include "matrix4x4.h"
+#include "array.h"
+#include "math_utils.h"
+#include "string_utils.h"
+
+namespace crown
+{
+
+static const uint32_t NO_TRANSFORM = UINT32_MAX;
+
+RenderCommand::RenderCommand()
+	: material(NULL)
+	, state(BGFX_STATE_DEFAULT)
+	, instances(NULL)
+	, transform(NO_TRANSFORM)
+	, transient(false)
+	, start_index(0)
+	, num_indices(UINT32_MAX)
+{
+	vb.idx = bgfx::invalidHandle;
+	ib.idx = bgfx::invalidHandle;
+}
+
+void RenderCommand::set_buffers(bgfx::VertexBufferHandle vb_, bgfx::IndexBufferHandle ib_, uint32_t start, uint32_t num)
+{
+	transient = false;
+	vb = vb_;
+	ib = ib_;
+	start_index = start;
+	num_indices = num;
+}
+
+void RenderCommand::set_buffers(const bgfx::TransientVertexBuffer& tvb_, const bgfx::TransientIndexBuffer& tib_, uint32_t start, uint32_t num)
+{
+	transient = true;
+	tvb = tvb_;
+	tib = tib_;
+	start_index = start;
+	num_indices = num;
+}
+
+namespace render_key
+{
+	static const uint32_t VIEW_SHIFT = 56;
+	static const uint32_t LAYER_SHIFT = 48;
+	static const uint32_t TRANSLUCENT_SHIFT = 47;
+	static const uint32_t DEPTH_BITS = 15;
+	static const uint64_t DEPTH_MASK = (UINT64_C(1) << DEPTH_BITS) - 1;
+
+	static uint64_t quantize_depth(float depth)
+	{
+		return uint64_t(math::clamp(0.0f, 1.0f, depth) * DEPTH_MASK);
+	}
+
+	uint64_t opaque(uint8_t view, uint8_t layer, uint16_t material, uint16_t mesh, float depth)
+	{
+		return (uint64_t(view) << VIEW_SHIFT)
+			| (uint64_t(layer) << LAYER_SHIFT)
+			| (uint64_t(material) << (DEPTH_BITS + 16))
+			| (uint64_t(mesh) << DEPTH_BITS)
+			| quantize_depth(depth);
+	}
+
+	uint64_t translucent(uint8_t view, uint8_t layer, float depth, uint16_t material, uint16_t mesh)
+	{
+		return (uint64_t(view) << VIEW_SHIFT)
+			| (uint64_t(layer) << LAYER_SHIFT)
+			| (UINT64_C(1) << TRANSLUCENT_SHIFT)
+			| ((DEPTH_MASK - quantize_depth(depth)) << 32)
+			| (uint64_t(material) << 16)
+			| uint64_t(mesh);
+	}
+
+	uint8_t view(uint64_t key)
+	{
+		return uint8_t(key >> VIEW_SHIFT);
+	}
+
+	uint16_t material_bits(const Material* m)
+	{
+		if (m == NULL)
+			return 0;
+
+		const uint64_t k = m->sort_key();
+		return uint16_t(k ^ (k >> 16) ^ (k >> 32) ^ (k >> 48));
+	}
+
+	uint16_t mesh_bits(const void* ptr)
+	{
+		const uint32_t h = string::murmur2_32(&ptr, sizeof(ptr), 0);
+		return uint16_t(h ^ (h >> 16));
+	}
+} // namespace render_key
+
+namespace render_bucket_internal
+{
+	/// Sorts @a num keys in @a keys using @a tmp as scratch space.
+	/// This is a LSD radix sort with 8 bits digits: passes where all the
+	/// keys share the same digit are skipped, so that only the bits which
+	/// actually vary across the bucket cost time.
+	template <typename T>
+	void radix_sort(T* keys, T* tmp, uint32_t num)
+	{
+		const uint32_t RADIX_BITS = 8;
+		const uint32_t RADIX = 1 << RADIX_BITS;
+		const uint32_t NUM_PASSES = 64 / RADIX_BITS;
+
+		T* src = keys;
+		T* dst = tmp;
+
+		for (uint32_t pass = 0; pass < NUM_PASSES; pass++)
+		{
+			const uint32_t shift = pass * RADIX_BITS;
+
+			uint32_t histogram[RADIX];
+			for (uint32_t i = 0; i < RADIX; i++)
+				histogram[i] = 0;
+
+			for (uint32_t i = 0; i < num; i++)
+				histogram[(src[i].key >> shift) & (RADIX - 1)]++;
+
+			// All keys share this digit
+			if (histogram[(src[0].key >> shift) & (RADIX - 1)] == num)
+				continue;
+
+			uint32_t offset = 0;
+			for (uint32_t i = 0; i < RADIX; i++)
+			{
+				const uint32_t count = histogram[i];
+				histogram[i] = offset;
+				offset += count;
+			}
+
+			for (uint32_t i = 0; i < num; i++)
+			{
+				const uint32_t digit = (src[i].key >> shift) & (RADIX - 1);
+				dst[histogram[digit]++] = src[i];
+			}
+
+			T* t = src;
+			src = dst;
+			dst = t;
+		}
+
+		if (src != keys)
+		{
+			for (uint32_t i = 0; i < num; i++)
+				keys[i] = src[i];
+		}
+	}
+} // namespace render_bucket_internal
+
+RenderBucket::RenderBucket(Allocator& a)
+	: m_keys(a)
+	, m_keys_tmp(a)
+	, m_commands(a)
+	, m_transforms(a)
+	, m_num_submitted(0)
+{
+}
+
+void RenderBucket::add(uint64_t key, const RenderCommand& cmd, const Matrix4x4* transform)
+{
+	ScopedMutex sm(m_mutex);
+
+	Key k;
+	k.key = key;
+	k.index = array::size(m_commands);
+	array::push_back(m_keys, k);
+	array::push_back(m_commands, cmd);
+
+	if (transform != NULL)
+	{
+		array::back(m_commands).transform = array::size(m_transforms);
+		array::push_back(m_transforms, *transform);
+	}
+}
+
+void RenderBucket::submit()
+{
+	ScopedMutex sm(m_mutex);
+
+	const uint32_t num = array::size(m_keys);
+	m_num_submitted = num;
+
+	if (num == 0)
+		return;
+
+	array::resize(m_keys_tmp, num);
+	render_bucket_internal::radix_sort(array::begin(m_keys), array::begin(m_keys_tmp), num);
+
+	const Material* prev = NULL;
+
+	for (uint32_t i = 0; i < num; i++)
+	{
+		const RenderCommand& cmd = m_commands[m_keys[i].index];
+
+		if (cmd.material != NULL)
+		{
+			cmd.material->bind(prev, cmd.instances != NULL);
+			prev = cmd.material;
+		}
+
+		if (cmd.transform != NO_TRANSFORM)
+			bgfx::setTransform(matrix4x4::to_float_ptr(m_transforms[cmd.transform]));
+
+		if (cmd.instances != NULL)
+			bgfx::setInstanceDataBuffer(cmd.instances);
+
+		if (cmd.transient)
+		{
+			bgfx::setVertexBuffer(&cmd.tvb);
+			bgfx::setIndexBuffer(&cmd.tib, cmd.start_index, cmd.num_indices);
+		}
+		else
+		{
+			bgfx::setVertexBuffer(cmd.vb);
+			bgfx::setIndexBuffer(cmd.ib, cmd.start_index, cmd.num_indices);
+		}
+
+		bgfx::setState(cmd.state);
+		bgfx::submit(render_key::view(m_keys[i].key));
+	}
+
+	array::clear(m_keys);
+	array::clear(m_commands);
+	array::clear(m_transforms);
+}
+
+uint32_t RenderBucket::num_submitted() const
+{
+	return m_num_submitted;
+}
+
+} // namespace crown
@@ -0,0 +1,136 @@
+/*
+Copyright (c) 2013 Daniele Bartolini, Michele Rossi
+Copyright (c) 2012 Daniele Bartolini, Simone Boscaratto
+
+Permission is hereby granted, free of charge, to any person
+obtaining a copy of this software and associated documentation
+files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use,
+copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following
+conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#pragma once
+
+#include "types.h"
+#include "container_types.h"
+#include "memory_types.h"
+#include "math_types.h"
+#include "mutex.h"
+#include <bgfx.h>
+
+namespace crown
+{
+
+struct Material;
+
+/// A single draw call recorded into a RenderBucket.
+///
+/// @ingroup Graphics
+struct RenderCommand
+{
+	RenderCommand();
+
+	/// Draws [start_index, start_index + num_indices) of the static buffers @a vb and @a ib.
+	void set_buffers(bgfx::VertexBufferHandle vb, bgfx::IndexBufferHandle ib, uint32_t start_index = 0, uint32_t num_indices = UINT32_MAX);
+
+	/// Draws [start_index, start_index + num_indices) of the transient buffers @a tvb and @a tib.
+	void set_buffers(const bgfx::TransientVertexBuffer& tvb, const bgfx::TransientIndexBuffer& tib, uint32_t start_index = 0, uint32_t num_indices = UINT32_MAX);
+
+public:
+
+	const Material* material;
+	uint64_t state;
+	const bgfx::InstanceDataBuffer* instances; // If not NULL the instanced program of the material is used
+	uint32_t transform;
+	bool transient;
+	bgfx::VertexBufferHandle vb;
+	bgfx::IndexBufferHandle ib;
+	bgfx::TransientVertexBuffer tvb;
+	bgfx::TransientIndexBuffer tib;
+	uint32_t start_index;
+	uint32_t num_indices;
+};
+
+/// Functions to build RenderCommand sort keys.
+///
+/// Keys are laid out, from the most significant bit, as:
+/// view (8) | layer (8) | translucent (1) | 47 bits of payload.
+/// Opaque commands use material (16) | mesh (16) | depth (15) so that
+/// state changes are minimized and commands within the same state are
+/// drawn front to back. Translucent commands use inverted depth (15) |
+/// material (16) | mesh (16) so that they are drawn back to front.
+///
+/// @ingroup Graphics
+namespace render_key
+{
+	/// Returns the key of an opaque command. @a depth is in [0, 1].
+	uint64_t opaque(uint8_t view, uint8_t layer, uint16_t material, uint16_t mesh, float depth);
+
+	/// Returns the key of a translucent command. @a depth is in [0, 1].
+	uint64_t translucent(uint8_t view, uint8_t layer, float depth, uint16_t material, uint16_t mesh);
+
+	/// Returns the view encoded in @a key.
+	uint8_t view(uint64_t key);
+
+	/// Returns the 16 bits material identifier of @a m, which may be NULL.
+	uint16_t material_bits(const Material* m);
+
+	/// Returns the 16 bits identifier of the mesh or buffer @a ptr.
+	uint16_t mesh_bits(const void* ptr);
+} // namespace render_key
+
+/// Collects draw calls as RenderCommands and submits them to bgfx
+/// sorted by their 64 bits key.
+/// Commands can be added from multiple threads; sorting and submission
+/// happen on the thread which calls submit().
+///
+/// @ingroup Graphics
+class RenderBucket
+{
+public:
+
+	RenderBucket(Allocator& a);
+
+	/// Adds the command @a cmd with the given sort @a key.
+	/// If @a transform is not NULL it is used as the model matrix of the draw.
+	void add(uint64_t key, const RenderCommand& cmd, const Matrix4x4* transform = NULL);
+
+	/// Sorts the commands by key, submits them to bgfx and clears the bucket.
+	void submit();
+
+	/// Returns the number of commands submitted by the last submit().
+	uint32_t num_submitted() const;
+
+private:
+
+	struct Key
+	{
+		uint64_t key;
+		uint32_t index;
+	};
+
+	Mutex m_mutex;
+	Array<Key> m_keys;
+	Array<Key> m_keys_tmp;
+	Array<RenderCommand> m_commands;
+	Array<Matrix4x4> m_transforms;
+	uint32_t m_num_submitted;
+};
+
+} // namespace crown
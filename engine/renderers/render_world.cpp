@@ -36,49 +36,232 @@ OTHER DEALINGS IN THE SOFTWARE.
 #include "material.h"
 #include "config.h"
 #include "gui.h"
+#include "frustum.h"
+#include "intersection.h"
+#include "aabb.h"
+#include "vector3.h"
+#include "array.h"
+#include "render_bucket.h"
+#include "mesh_resource.h"
+#include "material_manager.h"
+#include "resource_manager.h"
+#include "texture_streamer.h"
+#include "vector4.h"
+#include "matrix4x4.h"
+#include <cfloat>
 #include <bgfx.h>
 
 namespace crown
 {
 
+RenderWorld::BoundsData::BoundsData(Allocator& a)
+	: x(a)
+	, y(a)
+	, z(a)
+	, radius(a)
+	, depth(a)
+	, visible(a)
+{
+}
+
+void RenderWorld::BoundsData::resize(uint32_t num)
+{
+	array::resize(x, num);
+	array::resize(y, num);
+	array::resize(z, num);
+	array::resize(radius, num);
+	array::resize(depth, num);
+	array::resize(visible, num);
+}
+
+void RenderWorld::BoundsData::set(uint32_t i, const AABB& aabb, const Matrix4x4& pose)
+{
+	const Vector3 scale(vector3::length(matrix4x4::x(pose)), vector3::length(matrix4x4::y(pose)), vector3::length(matrix4x4::z(pose)));
+	const float max_scale = math::max(scale.x, math::max(scale.y, scale.z));
+	const Vector3 center = pose * aabb::center(aabb);
+
+	x[i] = center.x;
+	y[i] = center.y;
+	z[i] = center.z;
+	radius[i] = aabb::radius(aabb) * max_scale;
+}
+
+float RenderWorld::BoundsData::screen_size(uint32_t i, const Matrix4x4& view_proj, float scale) const
+{
+	const float w = (view_proj * Vector4(x[i], y[i], z[i], 1.0f)).w;
+	return 2.0f * radius[i] * scale / math::max(w, 0.01f);
+}
+
+uint32_t RenderWorld::BoundsData::cull(const Frustum& f)
+{
+	const uint32_t num = array::size(x);
+	if (num == 0)
+		return 0;
+
+	math::frustum_spheres_intersection(f, num, array::begin(x), array::begin(y), array::begin(z), array::begin(radius), array::begin(visible));
+
+	uint32_t num_visible = 0;
+	for (uint32_t i = 0; i < num; i++)
+	{
+		num_visible += visible[i];
+	}
+	return num_visible;
+}
+
+void RenderWorld::BoundsData::compute_depth(const Matrix4x4& view)
+{
+	const uint32_t num = array::size(x);
+
+	float min_depth = FLT_MAX;
+	float max_depth = -FLT_MAX;
+	for (uint32_t i = 0; i < num; i++)
+	{
+		if (!visible[i])
+			continue;
+
+		depth[i] = (view * Vector4(x[i], y[i], z[i], 1.0f)).z;
+		min_depth = math::min(min_depth, depth[i]);
+		max_depth = math::max(max_depth, depth[i]);
+	}
+
+	// Spread the visible range over the depth bits of the sort keys
+	const float range = max_depth - min_depth;
+	const float inv_range = range > 0.0f ? 1.0f / range : 0.0f;
+	for (uint32_t i = 0; i < num; i++)
+	{
+		depth[i] = visible[i] ? (depth[i] - min_depth) * inv_range : 0.0f;
+	}
+}
+
 RenderWorld::RenderWorld()
-	: m_mesh_pool(default_allocator(), MAX_MESHES, sizeof(Mesh), CE_ALIGNOF(Mesh))
-	, m_sprite_pool(default_allocator(), MAX_SPRITES, sizeof(Sprite), CE_ALIGNOF(Sprite))
-	, m_gui_pool(default_allocator(), MAX_GUIS, sizeof(Gui), CE_ALIGNOF(Gui))
+	: m_gui_pool(default_allocator(), MAX_GUIS, sizeof(Gui), CE_ALIGNOF(Gui))
+	, m_mesh(default_allocator())
+	, m_mesh_sparse(default_allocator())
+	, m_mesh_sparse_to_dense(default_allocator())
+	, m_mesh_dense_to_sparse(default_allocator())
+	, m_mesh_freelist(INVALID_ID)
+	, m_mesh_next_id(0)
+	, m_sprite_bounds(default_allocator())
+	, m_num_visible_sprites(0)
+	, m_sprite_batcher(default_allocator())
+	, m_mesh_bounds(default_allocator())
+	, m_num_visible_meshes(0)
+	, m_mesh_batcher(default_allocator())
+	, m_render_bucket(default_allocator())
 {
 }
 
 RenderWorld::~RenderWorld()
 {
+	for (uint32_t i = 0; i < array::size(m_mesh); i++)
+	{
+		CE_DELETE(default_allocator(), m_mesh[i]);
+	}
 }
 
 MeshId RenderWorld::create_mesh(MeshResource* mr, SceneGraph& sg, int32_t node)
 {
-	Mesh* mesh = CE_NEW(m_mesh_pool, Mesh)(sg, node, mr);
-	return id_array::create(m_mesh, mesh);
+	CE_ASSERT(array::size(m_mesh) + 1 < MAX_MESHES, "Max mesh number reached");
+
+	Mesh* mesh = CE_NEW(default_allocator(), Mesh)(sg, node, mr);
+
+	const MeshId id = allocate_mesh_id();
+	m_mesh_sparse_to_dense[id.index] = array::size(m_mesh);
+	array::push_back(m_mesh_dense_to_sparse, id.index);
+	array::push_back(m_mesh, mesh);
+
+	return id;
+}
+
+void RenderWorld::create_meshes(MeshResource* mr, uint32_t count, SceneGraph* const* graphs, int32_t node, MeshId* meshes)
+{
+	// Same limit as create_mesh(): indices must stay below INVALID_ID
+	CE_ASSERT(array::size(m_mesh) + count < MAX_MESHES, "Max mesh number reached");
+
+	reserve_meshes(count);
+
+	const uint32_t first = array::size(m_mesh);
+	array::resize(m_mesh, first + count);
+	array::resize(m_mesh_dense_to_sparse, first + count);
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		const MeshId id = allocate_mesh_id();
+		m_mesh_sparse_to_dense[id.index] = first + i;
+		m_mesh_dense_to_sparse[first + i] = id.index;
+		m_mesh[first + i] = CE_NEW(default_allocator(), Mesh)(*graphs[i], node, mr);
+		meshes[i] = id;
+	}
+}
+
+MeshId RenderWorld::allocate_mesh_id()
+{
+	MeshId id;
+	id.id = m_mesh_next_id++;
+	if (m_mesh_next_id == INVALID_ID)
+		m_mesh_next_id = 0;
+
+	// Recycle slot if there are any
+	if (m_mesh_freelist != INVALID_ID)
+	{
+		id.index = m_mesh_freelist;
+		m_mesh_freelist = m_mesh_sparse[m_mesh_freelist].index;
+	}
+	else
+	{
+		id.index = array::size(m_mesh_sparse);
+		array::push_back(m_mesh_sparse, id);
+		array::push_back(m_mesh_sparse_to_dense, uint16_t(0));
+	}
+
+	m_mesh_sparse[id.index] = id;
+	return id;
 }
 
 void RenderWorld::destroy_mesh(MeshId id)
 {
-	Mesh* mesh = id_array::get(m_mesh, id);
-	CE_DELETE(m_mesh_pool, mesh);
-	id_array::destroy(m_mesh, id);
+	CE_DELETE(default_allocator(), get_mesh(id));
+
+	const uint16_t dense = m_mesh_sparse_to_dense[id.index];
+	m_mesh_sparse[id.index].id = INVALID_ID;
+	m_mesh_sparse[id.index].index = m_mesh_freelist;
+	m_mesh_freelist = id.index;
+
+	// Swap with last element
+	const uint16_t last = array::size(m_mesh) - 1;
+	const uint16_t last_sparse = m_mesh_dense_to_sparse[last];
+	m_mesh[dense] = m_mesh[last];
+	m_mesh_dense_to_sparse[dense] = last_sparse;
+	m_mesh_sparse_to_dense[last_sparse] = dense;
+
+	array::pop_back(m_mesh);
+	array::pop_back(m_mesh_dense_to_sparse);
 }
 
 Mesh* RenderWorld::get_mesh(MeshId mesh)
 {
-	return id_array::get(m_mesh, mesh);
+	CE_ASSERT(mesh.index < array::size(m_mesh_sparse) && m_mesh_sparse[mesh.index].id == mesh.id, "Mesh does not exist");
+	return m_mesh[m_mesh_sparse_to_dense[mesh.index]];
+}
+
+void RenderWorld::reserve_meshes(uint32_t num)
+{
+	const uint32_t capacity = array::size(m_mesh) + num;
+	array::reserve(m_mesh, capacity);
+	array::reserve(m_mesh_dense_to_sparse, capacity);
+	array::reserve(m_mesh_sparse, capacity);
+	array::reserve(m_mesh_sparse_to_dense, capacity);
 }
 
 SpriteId RenderWorld::create_sprite(SpriteResource* sr, SceneGraph& sg, int32_t node)
 {
-	Sprite* sprite = CE_NEW(m_sprite_pool, Sprite)(*this, sg, node, sr);
+	Sprite* sprite = CE_NEW(default_allocator(), Sprite)(*this, sg, node, sr);
 	return id_array::create(m_sprite, sprite);
 }
 
 void RenderWorld::destroy_sprite(SpriteId id)
 {
-	CE_DELETE(m_sprite_pool, id_array::get(m_sprite, id));
+	CE_DELETE(default_allocator(), id_array::get(m_sprite, id));
 	id_array::destroy(m_sprite, id);
 }
 
@@ -89,8 +272,10 @@ Sprite*	RenderWorld::get_sprite(SpriteId id)
 
 GuiId RenderWorld::create_gui(uint16_t width, uint16_t height, const char* material)
 {
-	Gui* gui = CE_NEW(m_gui_pool, Gui)(width, height, material);
-	GuiId id = id_array::create(m_guis, gui);
+	// View 0 draws the world, each gui draws in the view after it
+	const GuiId id = id_array::reserve(m_guis);
+	Gui* gui = CE_NEW(m_gui_pool, Gui)(m_render_bucket, uint8_t(1 + id.index), width, height, material);
+	id_array::insert(m_guis, id, gui);
 	gui->set_id(id);
 	return id;
 }
@@ -133,15 +318,108 @@ void RenderWorld::update(const Matrix4x4& view, const Matrix4x4& projection, uin
 	bgfx::dbgTextClear();
 	bgfx::dbgTextPrintf(0, 2, 0x6f, "dt = %4.7f", dt);
 
-	// Draw all sprites
+	const Matrix4x4 view_proj = projection * view;
+
+	cull(view, view_proj);
+
+	// Draw visible meshes, instancing the ones sharing resource and material
+	m_mesh_batcher.begin();
+	for (uint32_t m = 0; m < array::size(m_mesh); m++)
+	{
+		if (m_mesh_bounds.visible[m])
+			m_mesh_batcher.add(*m_mesh[m], m_mesh_bounds.depth[m]);
+	}
+	m_mesh_batcher.submit(m_render_bucket, 0);
+
+	bgfx::dbgTextPrintf(0, 4, 0x6f, "meshes = %d/%d, draws = %d", m_num_visible_meshes, array::size(m_mesh), m_mesh_batcher.num_batches());
+
+	// Draw visible sprites, merging the ones that allow it
+	m_sprite_batcher.begin();
+	uint32_t num_draws = 0;
 	for (uint32_t s = 0; s < id_array::size(m_sprite); s++)
 	{
-		m_sprite[s]->render();
+		if (!m_sprite_bounds.visible[s])
+			continue;
+
+		if (m_sprite[s]->m_batched)
+		{
+			m_sprite_batcher.add(*m_sprite[s], m_sprite_bounds.depth[s]);
+		}
+		else
+		{
+			m_sprite[s]->render(m_render_bucket, 0, m_sprite_bounds.depth[s]);
+			num_draws++;
+		}
 	}
+	m_sprite_batcher.submit(m_render_bucket, 0);
+	num_draws += m_sprite_batcher.num_batches();
+
+	record_texture_usage(view_proj, projection.y.y * height * 0.5f);
+
+	bgfx::dbgTextPrintf(0, 3, 0x6f, "sprites = %d/%d, draws = %d", m_num_visible_sprites, id_array::size(m_sprite), num_draws);
+
+	for (uint32_t g = 0; g < id_array::size(m_guis); g++)
+	{
+		m_guis[g]->flush();
+	}
+
+	// Submit everything recorded since the last frame, gui included,
+	// sorted by view, layer and state
+	m_render_bucket.submit();
 
 	// Advance to next frame. Rendering thread will be kicked to 
 	// process submitted rendering primitives.
 	bgfx::frame();
 }
 
+void RenderWorld::record_texture_usage(const Matrix4x4& view_proj, float scale)
+{
+	TextureStreamer& ts = *device()->resource_manager()->texture_streamer();
+	MaterialManager& mm = *material_manager::get();
+
+	for (uint32_t i = 0; i < array::size(m_mesh); i++)
+	{
+		const MaterialId mat = m_mesh[i]->m_material;
+		if (!m_mesh_bounds.visible[i] || mat.id == INVALID_ID)
+			continue;
+
+		mm.lookup_material(mat)->record_texture_usage(ts, m_mesh_bounds.screen_size(i, view_proj, scale));
+	}
+
+	for (uint32_t i = 0; i < id_array::size(m_sprite); i++)
+	{
+		const MaterialId mat = m_sprite[i]->m_material;
+		if (!m_sprite_bounds.visible[i] || mat.id == INVALID_ID)
+			continue;
+
+		mm.lookup_material(mat)->record_texture_usage(ts, m_sprite_bounds.screen_size(i, view_proj, scale));
+	}
+}
+
+void RenderWorld::cull(const Matrix4x4& view, const Matrix4x4& view_proj)
+{
+	// Bring local bounds to world space
+	const uint32_t num_meshes = array::size(m_mesh);
+	m_mesh_bounds.resize(num_meshes);
+	for (uint32_t i = 0; i < num_meshes; i++)
+	{
+		m_mesh_bounds.set(i, m_mesh[i]->m_resource->aabb(), m_mesh[i]->world_pose());
+	}
+
+	const uint32_t num_sprites = id_array::size(m_sprite);
+	m_sprite_bounds.resize(num_sprites);
+	for (uint32_t i = 0; i < num_sprites; i++)
+	{
+		m_sprite_bounds.set(i, m_sprite[i]->m_resource->aabb, m_sprite[i]->world_pose());
+	}
+
+	Frustum f;
+	frustum::from_matrix(f, view_proj);
+	m_num_visible_meshes = m_mesh_bounds.cull(f);
+	m_num_visible_sprites = m_sprite_bounds.cull(f);
+
+	m_mesh_bounds.compute_depth(view);
+	m_sprite_bounds.compute_depth(view);
+}
+
 } // namespace crown
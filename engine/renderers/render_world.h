@@ -33,9 +33,13 @@ OTHER DEALINGS IN THE SOFTWARE.
 #include "matrix4x4.h"
 #include "render_world_types.h"
 #include "material_manager.h"
+#include "sprite_batcher.h"
+#include "mesh_batcher.h"
+#include "render_bucket.h"
 
-#define MAX_MESHES 100
-#define MAX_SPRITES 512
+// Mesh ids are 16 bit and the last one is reserved
+#define MAX_MESHES 65535
+#define MAX_SPRITES 8192
 #define MAX_GUIS 8
 
 namespace crown
@@ -52,6 +56,8 @@ struct Gui;
 struct Vector2;
 struct Vector3;
 struct GuiResource;
+struct AABB;
+struct Frustum;
 
 /// @defgroup Graphics Graphics
 
@@ -67,12 +73,19 @@ public:
 
 	MeshId create_mesh(MeshResource* mr, SceneGraph& sg, int32_t node);
 
+	/// Creates @a count meshes of @a mr, the i-th at the @a node of @a graphs[i],
+	/// and writes their ids to @a meshes. The dense store grows once for all of them.
+	void create_meshes(MeshResource* mr, uint32_t count, SceneGraph* const* graphs, int32_t node, MeshId* meshes);
+
 	/// Destroys the mesh @a id.
 	void destroy_mesh(MeshId id);
 
 	/// Returns the mesh @a id.
 	Mesh* get_mesh(MeshId mesh);
 
+	/// Makes room for @a num more meshes.
+	void reserve_meshes(uint32_t num);
+
 	SpriteId create_sprite(SpriteResource* sr, SceneGraph& sg, int32_t node);
 
 	/// Destroys the sprite @a id.
@@ -89,13 +102,72 @@ public:
 
 private:
 
-	PoolAllocator m_mesh_pool;
-	PoolAllocator m_sprite_pool;
+	/// Returns a new mesh id, recycling a free sparse slot if there are any.
+	MeshId allocate_mesh_id();
+
+	/// Updates the world bounds of all the meshes and sprites, tests
+	/// them against the frustum extracted from @a view_proj and computes
+	/// the depth of the visible ones in the space of @a view.
+	void cull(const Matrix4x4& view, const Matrix4x4& view_proj);
+
+	/// Records to the texture streamer the screen-space size of the visible
+	/// meshes and sprites. @a scale converts a size in clip space to pixels.
+	void record_texture_usage(const Matrix4x4& view_proj, float scale);
+
+private:
+
+	/// World bounding spheres of meshes or sprites, stored as
+	/// structure of arrays in the same order as the objects.
+	struct BoundsData
+	{
+		BoundsData(Allocator& a);
+
+		/// Resizes the arrays to hold @a num spheres.
+		void resize(uint32_t num);
+
+		/// Sets the sphere @a i to the local bounds @a aabb transformed by @a pose.
+		void set(uint32_t i, const AABB& aabb, const Matrix4x4& pose);
+
+		/// Returns the diameter in pixels of the sphere @a i, @a scale converts a size in clip space to pixels.
+		float screen_size(uint32_t i, const Matrix4x4& view_proj, float scale) const;
+
+		/// Tests the spheres against the frustum @a f and returns the number of visible ones.
+		uint32_t cull(const Frustum& f);
+
+		/// Sets the depth of the visible spheres to the view-space distance
+		/// of their centers, remapped to [0, 1] over the visible ones.
+		void compute_depth(const Matrix4x4& view);
+
+		Array<float> x;
+		Array<float> y;
+		Array<float> z;
+		Array<float> radius;
+		Array<float> depth;
+		Array<uint8_t> visible;
+	};
+
 	PoolAllocator m_gui_pool;
 
-	IdArray<MAX_MESHES, Mesh*> m_mesh;
+	// Meshes are stored densely in m_mesh and grow on demand. Ids refer
+	// to slots in m_mesh_sparse which map to the dense index.
+	Array<Mesh*> m_mesh;
+	Array<Id> m_mesh_sparse;
+	Array<uint16_t> m_mesh_sparse_to_dense;
+	Array<uint16_t> m_mesh_dense_to_sparse;
+	uint16_t m_mesh_freelist;
+	uint16_t m_mesh_next_id;
 	IdArray<MAX_SPRITES, Sprite*> m_sprite;
 	IdArray<MAX_GUIS, Gui*> m_guis;
+
+	BoundsData m_sprite_bounds;
+	uint32_t m_num_visible_sprites;
+	SpriteBatcher m_sprite_batcher;
+
+	BoundsData m_mesh_bounds;
+	uint32_t m_num_visible_meshes;
+	MeshBatcher m_mesh_batcher;
+
+	RenderBucket m_render_bucket;
 };
 
 } // namespace crown
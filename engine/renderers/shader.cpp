@@ -30,6 +30,11 @@ OTHER DEALINGS IN THE SOFTWARE.
 #include "os.h"
 #include "reader_writer.h"
 #include "config.h"
+#include "path.h"
+#include "string_utils.h"
+#include "parallel_for.h"
+#include "error.h"
+#include <inttypes.h>
 
 namespace crown
 {
@@ -42,73 +47,383 @@ namespace shader_resource
 		"android"
 	};
 
-	void compile(const char* path, CompileOptions& opts)
+	static const uint32_t MAX_INCLUDE_DEPTH = 16;
+
+	/// Finds the file #included as @a name in the same directories as shaderc:
+	/// @a dir, the one of the including file, for quoted includes only, then
+	/// @a code_dir, the one of the shader being compiled, and CE_SHADER_INCLUDE_DIR.
+	/// Returns false if no such file exists.
+	static bool find_include(CompileOptions& opts, const char* name, bool quoted, const char* dir, const char* code_dir, char* path, uint32_t len)
 	{
-		Buffer buf = opts.read(path);
-		JSONParser json(array::begin(buf));
-		JSONElement root = json.root();
+		const char* dirs[] = { quoted ? dir : NULL, code_dir, CE_SHADER_INCLUDE_DIR[0] != '\0' ? CE_SHADER_INCLUDE_DIR : NULL };
+
+		for (uint32_t i = 0; i < CE_COUNTOF(dirs); i++)
+		{
+			if (dirs[i] == NULL)
+				continue;
+
+			if (dirs[i][0] != '\0')
+				snprintf(path, len, "%s/%s", dirs[i], name);
+			else
+				snprintf(path, len, "%s", name);
+
+			if (opts._fs.exists(path))
+				return true;
+		}
+
+		return false;
+	}
+
+	/// Hashes the file at @a path and, recursively, the files it #includes
+	/// so that the result changes whenever the preprocessed source does.
+	/// @a code_dir is the directory of the shader being compiled.
+	/// Includes not found in the source directory are hashed by name only.
+	static uint64_t hash_source(CompileOptions& opts, const char* path, const char* code_dir, uint64_t seed, uint32_t depth = 0)
+	{
+		CE_ASSERT(depth < MAX_INCLUDE_DEPTH, "Too many nested includes: '%s'", path);
+
+		if (!opts._fs.exists(path))
+			return string::murmur2_64(path, string::strlen(path), seed);
+
+		Buffer src = opts.read(path);
+		uint64_t hash = string::murmur2_64(array::begin(src), array::size(src), seed);
+
+		char dir[512];
+		path::pathname(path, dir, sizeof(dir));
+
+		const char* cur = array::begin(src);
+		const char* end = array::end(src);
+
+		while (cur != end)
+		{
+			const char* eol = cur;
+			while (eol != end && *eol != '\n')
+				eol++;
+
+			const char* ch = cur;
+			while (ch != eol && (*ch == ' ' || *ch == '\t'))
+				ch++;
+
+			if (eol - ch > 8 && string::strncmp(ch, "#include", 8) == 0)
+			{
+				const char* name_begin = ch + 8;
+				while (name_begin != eol && *name_begin != '"' && *name_begin != '<')
+					name_begin++;
+
+				const bool quoted = name_begin != eol && *name_begin == '"';
+				const char close = quoted ? '"' : '>';
+
+				const char* name_end = name_begin == eol ? eol : name_begin + 1;
+				while (name_end != eol && *name_end != close)
+					name_end++;
+
+				if (name_end != eol)
+				{
+					char name[512];
+					string::substring(name_begin + 1, name_end, name, sizeof(name));
+
+					char include_path[512];
+					if (find_include(opts, name, quoted, dir, code_dir, include_path, sizeof(include_path)))
+						hash = hash_source(opts, include_path, code_dir, hash, depth + 1);
+					else
+						hash = string::murmur2_64(name, string::strlen(name), hash);
+				}
+			}
+
+			cur = eol == end ? end : eol + 1;
+		}
+
+		return hash;
+	}
 
+	/// Hashes the shader at @a path with the files it #includes.
+	static uint64_t hash_code(CompileOptions& opts, const char* path, uint64_t seed)
+	{
+		char code_dir[512];
+		path::pathname(path, code_dir, sizeof(code_dir));
+		return hash_source(opts, path, code_dir, seed);
+	}
+
+	/// Returns a value that changes whenever the shaderc binary does.
+	static uint64_t shaderc_version()
+	{
+		return os::exists("shaderc") ? os::mtime("shaderc") : 0;
+	}
+
+	/// Bumped whenever the layout of the cache entries changes.
+	static const uint32_t CACHE_VERSION = 2;
+
+	/// The sources of a .shader resource and the cache entry they compile to.
+	struct ShaderSource
+	{
 		DynamicString vs_code;
 		DynamicString fs_code;
 		DynamicString varying_def;
+		DynamicString defines;
+		DynamicString instanced_vs_code;
+		uint64_t key;
+		char cache_path[512];
+	};
+
+	static void read_source(CompileOptions& opts, const char* path, ShaderSource& ss)
+	{
+		Buffer buf = opts.read(path);
+		JSONParser json(array::begin(buf));
+		JSONElement root = json.root();
 
-		root.key("vs_code").to_string(vs_code);
-		root.key("fs_code").to_string(fs_code);
-		root.key("varying_def").to_string(varying_def);
+		root.key("vs_code").to_string(ss.vs_code);
+		root.key("fs_code").to_string(ss.fs_code);
+		root.key("varying_def").to_string(ss.varying_def);
+		root.key_or_nil("defines").to_string(ss.defines);
+		root.key_or_nil("instanced_vs_code").to_string(ss.instanced_vs_code);
 
-		DynamicString vs_code_path;
-		DynamicString fs_code_path;
+		const char* platform = s_scplatform[opts.platform()];
+		const uint64_t version = shaderc_version();
+
+		uint64_t key = 0;
+		key = string::murmur2_64(&CACHE_VERSION, sizeof(CACHE_VERSION), key);
+		key = hash_code(opts, ss.vs_code.c_str(), key);
+		key = hash_code(opts, ss.fs_code.c_str(), key);
+		key = hash_code(opts, ss.varying_def.c_str(), key);
+		if (ss.instanced_vs_code.length() > 0)
+			key = hash_code(opts, ss.instanced_vs_code.c_str(), key);
+		key = string::murmur2_64(ss.defines.c_str(), ss.defines.length(), key);
+		key = string::murmur2_64(platform, string::strlen(platform), key);
+		key = string::murmur2_64(&version, sizeof(version), key);
+
+		ss.key = key;
+		snprintf(ss.cache_path, sizeof(ss.cache_path), CE_SHADER_CACHE_DIR "/%.16" PRIx64, key);
+	}
+
+	/// Vertex, fragment and instanced vertex shader of a ShadercJob.
+	static const uint32_t NUM_STAGES = 3;
+
+	/// The shaderc processes which compile a ShaderSource missing from the cache.
+	struct ShadercJob
+	{
+		ShadercJob(const ShaderSource& ss) : source(ss), num_stages(0) {}
+
+		const ShaderSource& source;
+		const char* code[NUM_STAGES];
+		char tmp[NUM_STAGES][512];
+		char tmpcache[512];
+		DynamicString code_path[NUM_STAGES];
+		DynamicString tmp_path[NUM_STAGES];
 		DynamicString varying_def_path;
-		DynamicString tmpvs_path;
-		DynamicString tmpfs_path;
+		DynamicString include_path;
+		const char* args[NUM_STAGES][16];
+		int32_t exit_code[NUM_STAGES];
+		uint32_t num_stages;
+	};
 
-		opts.get_absolute_path(vs_code.c_str(), vs_code_path);
-		opts.get_absolute_path(fs_code.c_str(), fs_code_path);
-		opts.get_absolute_path(varying_def.c_str(), varying_def_path);
-		opts.get_absolute_path("tmpvs", tmpvs_path);
-		opts.get_absolute_path("tmpfs", tmpfs_path);
+	/// Runs the stages [begin, end) of an Array<ShadercJob*>, NUM_STAGES per job.
+	static void run_shaderc(uint32_t begin, uint32_t end, void* data)
+	{
+		Array<ShadercJob*>& jobs = *(Array<ShadercJob*>*) data;
 
-		const char* compile_vs[] =
+		for (uint32_t i = begin; i < end; i++)
 		{
-			"shaderc",
-			"-f", vs_code_path.c_str(),
-			"-o", tmpvs_path.c_str(),
-			"--varyingdef", varying_def_path.c_str(),
-			"--type", "vertex",
-			"--platform", s_scplatform[opts.platform()],
+			ShadercJob& job = *jobs[i / NUM_STAGES];
+			const uint32_t stage = i % NUM_STAGES;
+
+			if (stage < job.num_stages)
+				job.exit_code[stage] = os::execute_process(job.args[stage]);
+		}
+	}
+
+	/// Aborts the compilation, in release builds too, if shaderc failed to
+	/// write @a out_path from @a src_path, so that no cache entry is created.
+	static void check_shaderc(CompileOptions& opts, int32_t exit_code, const char* out_path, const char* src_path)
+	{
+		if (exit_code == 0 && opts._fs.exists(out_path))
+			return;
+
+		error::abort(__FILE__, __LINE__, "Failed to compile shader: '%s' (shaderc exit code %d)\n", src_path, exit_code);
+	}
+
+	/// Deletes @a path if an interrupted compilation left it behind.
+	static void delete_stale(CompileOptions& opts, const char* path)
+	{
+		if (opts._fs.exists(path))
+			opts.delete_file(path);
+	}
+
+	/// Fills @a args with the shaderc command line to compile @a code_path.
+	/// @a include_dir is NULL if there is no CE_SHADER_INCLUDE_DIR.
+	static void shaderc_args(const char* code_path, const char* out_path, const char* varying_def_path, const char* include_dir,
+		const char* type, const char* profile, const char* defines, Platform::Enum platform, const char** args)
+	{
+		uint32_t num = 0;
+		args[num++] = "shaderc";
+		args[num++] = "-f";
+		args[num++] = code_path;
+		args[num++] = "-o";
+		args[num++] = out_path;
+		args[num++] = "--varyingdef";
+		args[num++] = varying_def_path;
+		args[num++] = "--type";
+		args[num++] = type;
+		args[num++] = "--platform";
+		args[num++] = s_scplatform[platform];
 #if CROWN_PLATFORM_WINDOWS
-			"--profile", "vs_3_0",
+		args[num++] = "--profile";
+		args[num++] = profile;
+#else
+		CE_UNUSED(profile);
 #endif
-			NULL
-		};
-		os::execute_process(compile_vs);
+		if (include_dir != NULL)
+		{
+			args[num++] = "-i";
+			args[num++] = include_dir;
+		}
+		if (defines[0] != '\0')
+		{
+			args[num++] = "--define";
+			args[num++] = defines;
+		}
+		args[num++] = NULL;
+	}
+
+	/// Fills the command lines of @a job and removes what an interrupted
+	/// compilation of the same entry left behind.
+	static void prepare_job(CompileOptions& opts, ShadercJob& job)
+	{
+		const ShaderSource& ss = job.source;
+		static const char* s_type[NUM_STAGES] = { "vertex", "fragment", "vertex" };
+		static const char* s_profile[NUM_STAGES] = { "vs_3_0", "ps_3_0", "vs_3_0" };
+		static const char* s_suffix[NUM_STAGES] = { "vs", "fs", "ivs" };
+
+		job.code[0] = ss.vs_code.c_str();
+		job.code[1] = ss.fs_code.c_str();
+		job.code[2] = ss.instanced_vs_code.c_str();
+		job.num_stages = ss.instanced_vs_code.length() > 0 ? 3 : 2;
+
+		snprintf(job.tmpcache, sizeof(job.tmpcache), "%s.tmp", ss.cache_path);
+		delete_stale(opts, job.tmpcache);
+
+		opts.get_absolute_path(ss.varying_def.c_str(), job.varying_def_path);
 
-		const char* compile_fs[] =
+		const bool has_include_dir = CE_SHADER_INCLUDE_DIR[0] != '\0';
+		if (has_include_dir)
+			opts.get_absolute_path(CE_SHADER_INCLUDE_DIR, job.include_path);
+
+		for (uint32_t i = 0; i < job.num_stages; i++)
 		{
-			"shaderc",
-			"-f", fs_code_path.c_str(),
-			"-o", tmpfs_path.c_str(),
-			"--varyingdef", varying_def_path.c_str(),
-			"--type", "fragment",
-			"--platform", s_scplatform[opts.platform()],
-#if CROWN_PLATFORM_WINDOWS
-			"--profile", "ps_3_0",
-#endif
-			NULL
-		};
-		os::execute_process(compile_fs);
+			snprintf(job.tmp[i], sizeof(job.tmp[i]), "%s.%s.tmp", ss.cache_path, s_suffix[i]);
+			delete_stale(opts, job.tmp[i]);
+
+			opts.get_absolute_path(job.code[i], job.code_path[i]);
+			opts.get_absolute_path(job.tmp[i], job.tmp_path[i]);
+			shaderc_args(job.code_path[i].c_str(), job.tmp_path[i].c_str(), job.varying_def_path.c_str(),
+				has_include_dir ? job.include_path.c_str() : NULL, s_type[i], s_profile[i], ss.defines.c_str(), opts.platform(), job.args[i]);
+			job.exit_code[i] = 0;
+		}
+	}
+
+	/// Writes the cache entry of @a job from the output of shaderc.
+	static void write_entry(CompileOptions& opts, ShadercJob& job)
+	{
+		for (uint32_t i = 0; i < job.num_stages; i++)
+			check_shaderc(opts, job.exit_code[i], job.tmp[i], job.code[i]);
 
-		Buffer tmpvs = opts.read(tmpvs_path.c_str());
-		Buffer tmpfs = opts.read(tmpfs_path.c_str());
+		Buffer vs = opts.read(job.tmp[0]);
+		Buffer fs = opts.read(job.tmp[1]);
+		Buffer ivs(default_allocator());
+		if (job.num_stages > 2)
+			ivs = opts.read(job.tmp[2]);
 
-		opts.write(uint32_t(1)); // version
-		opts.write(uint32_t(array::size(tmpvs)));
-		opts.write(array::begin(tmpvs), array::size(tmpvs));
-		opts.write(uint32_t(array::size(tmpfs)));
-		opts.write(array::begin(tmpfs), array::size(tmpfs));
+		// Write the entry aside and move it in place once complete, so that
+		// an interrupted compilation never leaves a truncated entry behind
+		File* cache = opts._fs.open(job.tmpcache, FOM_WRITE);
+		BinaryWriter bw(*cache);
+		bw.write(uint32_t(array::size(vs)));
+		bw.write(array::begin(vs), array::size(vs));
+		bw.write(uint32_t(array::size(fs)));
+		bw.write(array::begin(fs), array::size(fs));
+		bw.write(uint32_t(array::size(ivs)));
+		bw.write(array::begin(ivs), array::size(ivs));
+		bw.flush();
+		opts._fs.close(cache);
 
-		opts.delete_file(tmpvs_path.c_str());
-		opts.delete_file(tmpfs_path.c_str());
+		DynamicString tmpcache_path;
+		DynamicString cache_abs_path;
+		opts.get_absolute_path(job.tmpcache, tmpcache_path);
+		opts.get_absolute_path(job.source.cache_path, cache_abs_path);
+		os::rename_file(tmpcache_path.c_str(), cache_abs_path.c_str());
+
+		for (uint32_t i = 0; i < job.num_stages; i++)
+			opts.delete_file(job.tmp[i]);
+	}
+
+	/// Compiles the @a num @a sources missing from the cache, running
+	/// the shaderc processes of all of them concurrently.
+	static void fill_cache(CompileOptions& opts, ShaderSource* const* sources, uint32_t num)
+	{
+		Array<ShadercJob*> jobs(default_allocator());
+
+		for (uint32_t i = 0; i < num; i++)
+		{
+			const ShaderSource& ss = *sources[i];
+			if (opts._fs.exists(ss.cache_path))
+				continue;
+
+			// Identical shaders share the entry, compile it once
+			bool duplicate = false;
+			for (uint32_t j = 0; j < array::size(jobs) && !duplicate; j++)
+				duplicate = jobs[j]->source.key == ss.key;
+
+			if (duplicate)
+				continue;
+
+			if (!opts._fs.exists(CE_SHADER_CACHE_DIR))
+				opts._fs.create_directory(CE_SHADER_CACHE_DIR);
+
+			ShadercJob* job = CE_NEW(default_allocator(), ShadercJob)(ss);
+			prepare_job(opts, *job);
+			array::push_back(jobs, job);
+		}
+
+		if (array::size(jobs) == 0)
+			return;
+
+		parallel_for(array::size(jobs) * NUM_STAGES, run_shaderc, &jobs);
+
+		for (uint32_t i = 0; i < array::size(jobs); i++)
+		{
+			write_entry(opts, *jobs[i]);
+			CE_DELETE(default_allocator(), jobs[i]);
+		}
+	}
+
+	void precompile(const char* const* paths, uint32_t num, CompileOptions& opts)
+	{
+		Array<ShaderSource*> sources(default_allocator());
+
+		for (uint32_t i = 0; i < num; i++)
+		{
+			ShaderSource* ss = CE_NEW(default_allocator(), ShaderSource)();
+			read_source(opts, paths[i], *ss);
+			array::push_back(sources, ss);
+		}
+
+		fill_cache(opts, array::begin(sources), num);
+
+		for (uint32_t i = 0; i < num; i++)
+			CE_DELETE(default_allocator(), sources[i]);
+	}
+
+	void compile(const char* path, CompileOptions& opts)
+	{
+		ShaderSource ss;
+		read_source(opts, path, ss);
+
+		ShaderSource* sources = &ss;
+		fill_cache(opts, &sources, 1);
+
+		Buffer shader = opts.read(ss.cache_path);
+
+		opts.write(uint32_t(2)); // version
+		opts.write(shader);
 	}
 
 	void* load(File& file, Allocator& a)
@@ -127,10 +442,21 @@ namespace shader_resource
 		const bgfx::Memory* fsmem = bgfx::alloc(fs_code_size);
 		br.read(fsmem->data, fs_code_size);
 
+		uint32_t ivs_code_size;
+		br.read(ivs_code_size);
+		const bgfx::Memory* ivsmem = NULL;
+		if (ivs_code_size > 0)
+		{
+			ivsmem = bgfx::alloc(ivs_code_size);
+			br.read(ivsmem->data, ivs_code_size);
+		}
+
 		Shader* shader = (Shader*) a.allocate(sizeof(Shader));
 		shader->vs = vsmem;
 		shader->fs = fsmem;
+		shader->instanced_vs = ivsmem;
 		shader->program.idx = bgfx::invalidHandle;
+		shader->instanced_program.idx = bgfx::invalidHandle;
 
 		return shader;
 	}
@@ -140,13 +466,27 @@ namespace shader_resource
 		Shader* shader = (Shader*) rm.get(SHADER_TYPE, id);
 		bgfx::ShaderHandle vs = bgfx::createShader(shader->vs);
 		bgfx::ShaderHandle fs = bgfx::createShader(shader->fs);
-		shader->program = bgfx::createProgram(vs, fs, true);
+		shader->program = bgfx::createProgram(vs, fs);
+
+		// The instanced variant shares the fragment shader
+		if (shader->instanced_vs != NULL)
+		{
+			bgfx::ShaderHandle ivs = bgfx::createShader(shader->instanced_vs);
+			shader->instanced_program = bgfx::createProgram(ivs, fs);
+			bgfx::destroyShader(ivs);
+		}
+
+		bgfx::destroyShader(vs);
+		bgfx::destroyShader(fs);
 	}
 
 	void offline(StringId64 id, ResourceManager& rm)
 	{
 		Shader* shader = (Shader*) rm.get(SHADER_TYPE, id);
 		bgfx::destroyProgram(shader->program);
+
+		if (shader->instanced_program.idx != bgfx::invalidHandle)
+			bgfx::destroyProgram(shader->instanced_program);
 	}
 
 	void unload(Allocator& a, void* res)
@@ -41,11 +41,16 @@ struct Shader
 {
 	const bgfx::Memory* vs;
 	const bgfx::Memory* fs;
+	const bgfx::Memory* instanced_vs; // NULL if the shader has no instanced variant
 	bgfx::ProgramHandle program;
+	bgfx::ProgramHandle instanced_program; // Reads the model matrix from i_data0..3
 };
 
 namespace shader_resource
 {
+	/// Compiles the @a num shaders at @a paths which are missing from the shader
+	/// cache, running shaderc for all of them at once, so that compile() hits the cache.
+	void precompile(const char* const* paths, uint32_t num, CompileOptions& opts);
 	void compile(const char* path, CompileOptions& opts);
 	void* load(File& file, Allocator& a);
 	void online(StringId64 id, ResourceManager& rm);
@@ -35,6 +35,7 @@ OTHER DEALINGS IN THE SOFTWARE.
 #include "render_world.h"
 #include "device.h"
 #include "material_manager.h"
+#include "render_bucket.h"
 
 namespace crown
 {
@@ -45,6 +46,7 @@ Sprite::Sprite(RenderWorld& render_world, SceneGraph& sg, int32_t node, const Sp
 	, m_node(node)
 	, m_resource(sr)
 	, m_frame(0)
+	, m_batched(true)
 {
 }
 
@@ -103,22 +105,21 @@ void Sprite::set_frame(uint32_t i)
 	m_frame = i;
 }
 
-void Sprite::render()
+void Sprite::set_batched(bool batched)
 {
-	if (m_material.id != INVALID_ID)
-		material_manager::get()->lookup_material(m_material)->bind();
-
-	bgfx::setState(BGFX_STATE_RGB_WRITE
-		| BGFX_STATE_ALPHA_WRITE
-		| BGFX_STATE_DEPTH_TEST_LEQUAL
-		| BGFX_STATE_DEPTH_WRITE
-		| BGFX_STATE_CULL_CW
-		| BGFX_STATE_MSAA
-		| BGFX_STATE_BLEND_ALPHA);
-	bgfx::setVertexBuffer(m_resource->vb);
-	bgfx::setIndexBuffer(m_resource->ib, m_frame * 6, 6);
-	bgfx::setTransform(matrix4x4::to_float_ptr(world_pose()));
-	bgfx::submit(0);
+	m_batched = batched;
+}
+
+void Sprite::render(RenderBucket& bucket, uint8_t view, float depth)
+{
+	RenderCommand cmd;
+	cmd.material = m_material.id != INVALID_ID ? material_manager::get()->lookup_material(m_material) : NULL;
+	cmd.state = SPRITE_RENDER_STATE;
+	cmd.set_buffers(m_resource->vb, m_resource->ib, m_frame * 6, 6);
+
+	const Matrix4x4 pose = world_pose();
+	const uint64_t key = render_key::translucent(view, 0, depth, render_key::material_bits(cmd.material), render_key::mesh_bits(m_resource));
+	bucket.add(key, cmd, &pose);
 }
 
 } // namespace crown
@@ -39,10 +39,20 @@ namespace crown
 
 class Renderer;
 class RenderWorld;
+class RenderBucket;
 struct SceneGraph;
 struct Unit;
 typedef Id MaterialId;
 
+/// Render state used to draw sprites.
+const uint64_t SPRITE_RENDER_STATE = BGFX_STATE_RGB_WRITE
+	| BGFX_STATE_ALPHA_WRITE
+	| BGFX_STATE_DEPTH_TEST_LEQUAL
+	| BGFX_STATE_DEPTH_WRITE
+	| BGFX_STATE_CULL_CW
+	| BGFX_STATE_MSAA
+	| BGFX_STATE_BLEND_ALPHA;
+
 struct Sprite
 {
 	Sprite(RenderWorld& render_world, SceneGraph& sg, int32_t node, const SpriteResource* sr);
@@ -78,7 +88,13 @@ struct Sprite
 
 	void set_frame(uint32_t i);
 
-	void render();
+	/// Sets whether the sprite can be merged with others sharing the same material.
+	/// Sprites that opt out are drawn by render() with their own transform.
+	void set_batched(bool batched);
+
+	/// Records a draw of the sprite into @a bucket for @a view.
+	/// @a depth is the view depth of the sprite in [0, 1] and orders the draws back to front.
+	void render(RenderBucket& bucket, uint8_t view, float depth);
 
 public:
 
@@ -88,6 +104,7 @@ public:
 	const SpriteResource* m_resource;
 	MaterialId m_material;
 	uint32_t m_frame;
+	bool m_batched;
 };
 
 } // namespace crown
@@ -0,0 +1,199 @@
+/*
+Copyright (c) 2013 Daniele Bartolini, Michele Rossi
+Copyright (c) 2012 Daniele Bartolini, Simone Boscaratto
+
+Permission is hereby granted, free of charge, to any person
+obtaining a copy of this software and associated documentation
+files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use,
+copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following
+conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "sprite_batcher.h"
+#include "sprite.h"
+#include "sprite_resource.h"
+#include "material.h"
+#include "material_manager.h"
+#include "matrix4x4.h"
+#include "vector3.h"
+#include "array.h"
+#include "render_bucket.h"
+#include <algorithm>
+
+namespace crown
+{
+
+namespace sprite_batcher_internal
+{
+	// Sprites using material instances with the same resource and the
+	// same parameters end up next to each other once sorted
+	static uint64_t sort_key(const Material* m)
+	{
+		return m != NULL ? m->sort_key() : 0;
+	}
+
+	static bool same_material(const Material* a, const Material* b)
+	{
+		if (a == NULL || b == NULL)
+			return a == b;
+
+		return a->equals(*b);
+	}
+
+	static const Material* material(const Sprite& s)
+	{
+		return s.m_material.id != INVALID_ID ? material_manager::get()->lookup_material(s.m_material) : NULL;
+	}
+} // namespace sprite_batcher_internal
+
+// Indices are 16 bit
+static const uint32_t MAX_QUADS_PER_BATCH = 65536 / 4;
+
+SpriteBatcher::SpriteBatcher(Allocator& a)
+	: m_items(a)
+	, m_num_batches(0)
+{
+	m_decl
+		.begin()
+		.add(bgfx::Attrib::Position, 3, bgfx::AttribType::Float)
+		.add(bgfx::Attrib::TexCoord0, 2, bgfx::AttribType::Float, false)
+		.end();
+}
+
+void SpriteBatcher::begin()
+{
+	array::clear(m_items);
+}
+
+void SpriteBatcher::add(const Sprite& s, float depth)
+{
+	Item item;
+	item.key = sprite_batcher_internal::sort_key(sprite_batcher_internal::material(s));
+	item.depth = depth;
+	item.sprite = &s;
+	array::push_back(m_items, item);
+}
+
+void SpriteBatcher::submit(RenderBucket& bucket, uint8_t view)
+{
+	using namespace sprite_batcher_internal;
+
+	m_num_batches = 0;
+
+	const uint32_t num = array::size(m_items);
+	if (num == 0)
+		return;
+
+	std::sort(array::begin(m_items), array::end(m_items));
+
+	uint32_t first = 0;
+	const Material* first_mat = material(*m_items[0].sprite);
+
+	for (uint32_t i = 1; i <= num; i++)
+	{
+		const Material* mat = i < num ? material(*m_items[i].sprite) : NULL;
+
+		const bool flush = i == num
+			|| m_items[i].key != m_items[first].key
+			|| !same_material(mat, first_mat)
+			|| i - first == MAX_QUADS_PER_BATCH;
+
+		if (flush)
+		{
+			submit_batch(bucket, view, first, i);
+			first = i;
+			first_mat = mat;
+		}
+	}
+}
+
+uint32_t SpriteBatcher::num_batches() const
+{
+	return m_num_batches;
+}
+
+void SpriteBatcher::submit_batch(RenderBucket& bucket, uint8_t view, uint32_t begin, uint32_t end)
+{
+	const uint32_t num_quads = end - begin;
+
+	if (!bgfx::checkAvailTransientVertexBuffer(num_quads * 4, m_decl)
+		|| !bgfx::checkAvailTransientIndexBuffer(num_quads * 6))
+	{
+		// Out of transient memory, fall back to one draw per sprite
+		for (uint32_t i = begin; i < end; i++)
+		{
+			const_cast<Sprite*>(m_items[i].sprite)->render(bucket, view, m_items[i].depth);
+		}
+		m_num_batches += num_quads;
+		return;
+	}
+
+	bgfx::TransientVertexBuffer tvb;
+	bgfx::TransientIndexBuffer tib;
+	bgfx::allocTransientVertexBuffer(&tvb, num_quads * 4, m_decl);
+	bgfx::allocTransientIndexBuffer(&tib, num_quads * 6);
+
+	float* verts = (float*) tvb.data;
+	uint16_t* inds = (uint16_t*) tib.data;
+
+	for (uint32_t i = 0; i < num_quads; i++)
+	{
+		const Sprite& s = *m_items[begin + i].sprite;
+		CE_ASSERT(s.m_frame * 4 < s.m_resource->num_verts, "Frame out of bounds");
+
+		const float* src = s.m_resource->verts + s.m_frame * 16;
+
+		Vector3 pos[4];
+		for (uint32_t v = 0; v < 4; v++)
+		{
+			pos[v] = Vector3(src[v * 4 + 0], src[v * 4 + 1], 0.0f);
+		}
+
+		matrix4x4::transform_points(s.world_pose(), pos, pos, 4);
+
+		for (uint32_t v = 0; v < 4; v++)
+		{
+			*verts++ = pos[v].x;
+			*verts++ = pos[v].y;
+			*verts++ = pos[v].z;
+			*verts++ = src[v * 4 + 2];
+			*verts++ = src[v * 4 + 3];
+		}
+
+		const uint16_t base = uint16_t(i * 4);
+		*inds++ = base;
+		*inds++ = base + 1;
+		*inds++ = base + 2;
+		*inds++ = base;
+		*inds++ = base + 2;
+		*inds++ = base + 3;
+	}
+
+	RenderCommand cmd;
+	cmd.material = sprite_batcher_internal::material(*m_items[begin].sprite);
+	cmd.state = SPRITE_RENDER_STATE;
+	cmd.set_buffers(tvb, tib);
+
+	// Quads are written back to front and the batch is sorted by the farthest of them
+	bucket.add(render_key::translucent(view, 0, m_items[begin].depth, render_key::material_bits(cmd.material), 0), cmd);
+
+	m_num_batches++;
+}
+
+} // namespace crown
@@ -0,0 +1,89 @@
+/*
+Copyright (c) 2013 Daniele Bartolini, Michele Rossi
+Copyright (c) 2012 Daniele Bartolini, Simone Boscaratto
+
+Permission is hereby granted, free of charge, to any person
+obtaining a copy of this software and associated documentation
+files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use,
+copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following
+conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#pragma once
+
+#include "types.h"
+#include "container_types.h"
+#include "memory_types.h"
+#include <bgfx.h>
+
+namespace crown
+{
+
+class RenderBucket;
+struct Sprite;
+
+/// Merges sprites sharing the same material into as few draw calls as possible.
+/// Quads are transformed to world space on the CPU and streamed through
+/// transient vertex and index buffers.
+///
+/// @ingroup Graphics
+class SpriteBatcher
+{
+public:
+
+	SpriteBatcher(Allocator& a);
+
+	/// Starts collecting sprites for a new frame.
+	void begin();
+
+	/// Adds the sprite @a s with the view @a depth in [0, 1] to the current batch list.
+	void add(const Sprite& s, float depth);
+
+	/// Sorts the collected sprites by material and records them into @a bucket for @a view.
+	void submit(RenderBucket& bucket, uint8_t view);
+
+	/// Returns the number of draw calls recorded by the last submit().
+	uint32_t num_batches() const;
+
+private:
+
+	/// Records the sprites in [begin, end) of m_items as a single draw call.
+	void submit_batch(RenderBucket& bucket, uint8_t view, uint32_t begin, uint32_t end);
+
+private:
+
+	struct Item
+	{
+		uint64_t key;
+		float depth;
+		const Sprite* sprite;
+
+		// Back to front within the same material
+		bool operator<(const Item& other) const
+		{
+			return key != other.key ? key < other.key : depth > other.depth;
+		}
+	};
+
+	Array<Item> m_items;
+	bgfx::VertexDecl m_decl;
+	uint32_t m_num_batches;
+};
+
+} // namespace crown
@@ -0,0 +1,408 @@
+/*
+Copyright (c) 2013 Daniele Bartolini, Michele Rossi
+Copyright (c) 2012 Daniele Bartolini, Simone Boscaratto
+
+Permission is hereby granted, free of charge, to any person
+obtaining a copy of this software and associated documentation
+files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use,
+copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following
+conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "animation_resource.h"
+#include "json_parser.h"
+#include "array.h"
+#include "memory.h"
+#include "math_utils.h"
+#include "quaternion.h"
+#include "vector3.h"
+#include "compile_options.h"
+
+namespace crown
+{
+namespace animation_resource
+{
+	// Range of the three smallest components of a unit quaternion
+	static const float SMALLEST_THREE_RANGE = 0.70710678f;
+
+	struct Tolerance
+	{
+		float rotation;		// Radians
+		float translation;	// Units
+		float scale;
+	};
+
+	static Quaternion normalize(const Quaternion& q)
+	{
+		const float len = quaternion::length(q);
+		return len > 0.0f ? q * (1.0f / len) : quaternion::IDENTITY;
+	}
+
+	static Quaternion nlerp(const Quaternion& a, const Quaternion& b, float t)
+	{
+		const float s = quaternion::dot(a, b) < 0.0f ? -1.0f : 1.0f;
+		return normalize(Quaternion(a.x + (b.x * s - a.x) * t,
+			a.y + (b.y * s - a.y) * t,
+			a.z + (b.z * s - a.z) * t,
+			a.w + (b.w * s - a.w) * t));
+	}
+
+	static float rotation_error(const Quaternion& a, const Quaternion& b)
+	{
+		return 2.0f * math::acos(math::min(1.0f, math::abs(quaternion::dot(a, b))));
+	}
+
+	static float vector3_error(const Vector3& a, const Vector3& b)
+	{
+		return vector3::length(a - b);
+	}
+
+	/// Removes the keys which can be rebuilt by interpolating their neighbours
+	/// within @a tol and returns the frames of the keys left.
+	template <typename T, typename Lerp, typename Error>
+	static void reduce_keys(const Array<T>& frames, float tol, Lerp lerp, Error error, Array<uint16_t>& keys)
+	{
+		const uint32_t num = array::size(frames);
+
+		// Constant channels need a single key
+		bool constant = true;
+		for (uint32_t i = 1; i < num && constant; i++)
+			constant = error(frames[0], frames[i]) <= tol;
+
+		array::push_back(keys, uint16_t(0));
+		if (constant)
+			return;
+
+		uint32_t last = 0;
+		for (uint32_t i = 1; i < num - 1; i++)
+		{
+			const uint32_t next = i + 1;
+			const float span = float(next - last);
+
+			bool skip = true;
+			for (uint32_t j = last + 1; j <= i && skip; j++)
+				skip = error(lerp(frames[last], frames[next], float(j - last) / span), frames[j]) <= tol;
+
+			if (!skip)
+			{
+				array::push_back(keys, uint16_t(i));
+				last = i;
+			}
+		}
+
+		array::push_back(keys, uint16_t(num - 1));
+	}
+
+	void encode_rotation(const Quaternion& q, uint16_t* v)
+	{
+		uint32_t largest = 0;
+		for (uint32_t i = 1; i < 4; i++)
+		{
+			if (math::abs(q[i]) > math::abs(q[largest]))
+				largest = i;
+		}
+
+		// The largest component is rebuilt as positive, q and -q being the same rotation
+		const float sign = q[largest] < 0.0f ? -1.0f : 1.0f;
+
+		uint64_t bits = uint64_t(largest) << 45;
+		for (uint32_t i = 0, j = 0; i < 4; i++)
+		{
+			if (i == largest)
+				continue;
+
+			const float n = math::clamp(0.0f, 1.0f, (q[i] * sign / SMALLEST_THREE_RANGE) * 0.5f + 0.5f);
+			bits |= uint64_t(n * 32767.0f + 0.5f) << (15 * j);
+			j++;
+		}
+
+		v[0] = uint16_t(bits);
+		v[1] = uint16_t(bits >> 16);
+		v[2] = uint16_t(bits >> 32);
+	}
+
+	static void encode_vector3(const AnimationChannel& ch, const Vector3& a, uint16_t* v)
+	{
+		for (uint32_t i = 0; i < 3; i++)
+		{
+			const float n = ch.extent[i] > 0.0f ? (a[i] - ch.min[i]) / ch.extent[i] : 0.0f;
+			v[i] = uint16_t(math::clamp(0.0f, 1.0f, n) * 65535.0f + 0.5f);
+		}
+	}
+
+	static Quaternion lerp_rotation(const Quaternion& a, const Quaternion& b, float t) { return nlerp(a, b, t); }
+	static Vector3 lerp_vector3(const Vector3& a, const Vector3& b, float t) { return a + (b - a) * t; }
+
+	static void parse_rotations(JSONElement e, Array<Quaternion>& frames)
+	{
+		if (e.is_nil())
+			return;
+
+		for (uint32_t i = 0; i < e.size(); i++)
+		{
+			Quaternion q = normalize(e[i].to_quaternion());
+
+			// Keep consecutive frames in the same hemisphere
+			if (i > 0 && quaternion::dot(q, frames[i - 1]) < 0.0f)
+				q = -q;
+
+			array::push_back(frames, q);
+		}
+	}
+
+	static void parse_vector3s(JSONElement e, Array<Vector3>& frames)
+	{
+		if (e.is_nil())
+			return;
+
+		for (uint32_t i = 0; i < e.size(); i++)
+			array::push_back(frames, e[i].to_vector3());
+	}
+
+	static void compile_rotation(const Array<Quaternion>& frames, float tol, uint32_t base, AnimationChannel& ch, Array<uint16_t>& data)
+	{
+		ch.num_keys = 0;
+		ch.times_offset = 0;
+		ch.values_offset = 0;
+		for (uint32_t i = 0; i < 3; i++)
+		{
+			ch.min[i] = 0.0f;
+			ch.extent[i] = 0.0f;
+		}
+
+		if (array::size(frames) == 0)
+			return;
+
+		Array<uint16_t> keys(default_allocator());
+		reduce_keys(frames, tol, lerp_rotation, rotation_error, keys);
+
+		ch.num_keys = array::size(keys);
+		ch.times_offset = base + sizeof(uint16_t) * array::size(data);
+		for (uint32_t i = 0; i < array::size(keys); i++)
+			array::push_back(data, keys[i]);
+
+		ch.values_offset = base + sizeof(uint16_t) * array::size(data);
+		for (uint32_t i = 0; i < array::size(keys); i++)
+		{
+			uint16_t v[3];
+			encode_rotation(frames[keys[i]], v);
+			array::push(data, v, 3);
+		}
+	}
+
+	static void compile_vector3(const Array<Vector3>& frames, float tol, uint32_t base, AnimationChannel& ch, Array<uint16_t>& data)
+	{
+		ch.num_keys = 0;
+		ch.times_offset = 0;
+		ch.values_offset = 0;
+		for (uint32_t i = 0; i < 3; i++)
+		{
+			ch.min[i] = 0.0f;
+			ch.extent[i] = 0.0f;
+		}
+
+		if (array::size(frames) == 0)
+			return;
+
+		Array<uint16_t> keys(default_allocator());
+		reduce_keys(frames, tol, lerp_vector3, vector3_error, keys);
+
+		// Quantize in the range of the keys left
+		Vector3 min = frames[keys[0]];
+		Vector3 max = frames[keys[0]];
+		for (uint32_t i = 1; i < array::size(keys); i++)
+		{
+			const Vector3& a = frames[keys[i]];
+			for (uint32_t c = 0; c < 3; c++)
+			{
+				min[c] = math::min(min[c], a[c]);
+				max[c] = math::max(max[c], a[c]);
+			}
+		}
+
+		for (uint32_t i = 0; i < 3; i++)
+		{
+			ch.min[i] = min[i];
+			ch.extent[i] = max[i] - min[i];
+		}
+
+		ch.num_keys = array::size(keys);
+		ch.times_offset = base + sizeof(uint16_t) * array::size(data);
+		for (uint32_t i = 0; i < array::size(keys); i++)
+			array::push_back(data, keys[i]);
+
+		ch.values_offset = base + sizeof(uint16_t) * array::size(data);
+		for (uint32_t i = 0; i < array::size(keys); i++)
+		{
+			uint16_t v[3];
+			encode_vector3(ch, frames[keys[i]], v);
+			array::push(data, v, 3);
+		}
+	}
+
+	void compile(const char* path, CompileOptions& opts)
+	{
+		static const uint32_t VERSION = 1;
+
+		Buffer buf = opts.read(path);
+		JSONParser json(array::begin(buf));
+		JSONElement root = json.root();
+
+		JSONElement jtol = root.key_or_nil("tolerance");
+		Tolerance tol;
+		tol.rotation = jtol.key_or_nil("rotation").to_float(0.001f);
+		tol.translation = jtol.key_or_nil("translation").to_float(0.001f);
+		tol.scale = jtol.key_or_nil("scale").to_float(0.001f);
+
+		JSONElement jtracks = root.key("tracks");
+		const uint32_t num_tracks = jtracks.size();
+
+		// All the animated channels must have the same number of frames
+		uint32_t num_frames = 1;
+		for (uint32_t i = 0; i < num_tracks; i++)
+		{
+			const char* channels[] = { "rotations", "positions", "scales" };
+			for (uint32_t c = 0; c < 3; c++)
+			{
+				JSONElement jc = jtracks[i].key_or_nil(channels[c]);
+				const uint32_t n = jc.is_nil() ? 0 : jc.size();
+				CE_ASSERT(n <= 1 || num_frames == 1 || n == num_frames, "Channel '%s' has %d frames, %d expected", channels[c], n, num_frames);
+				num_frames = math::max(num_frames, n);
+			}
+		}
+		CE_ASSERT(num_frames <= 0xFFFF, "Too many frames");
+
+		AnimationResource ar;
+		ar.version = VERSION;
+		ar.num_tracks = num_tracks;
+		ar.num_frames = num_frames;
+		ar.sample_rate = root.key_or_nil("sample_rate").to_float(30.0f);
+		ar.duration = float(num_frames - 1) / ar.sample_rate;
+		ar.tracks_offset = sizeof(AnimationResource);
+
+		const uint32_t base = ar.tracks_offset + sizeof(AnimationTrack) * num_tracks;
+		Array<AnimationTrack> tracks(default_allocator());
+		Array<uint16_t> data(default_allocator());
+
+		for (uint32_t i = 0; i < num_tracks; i++)
+		{
+			JSONElement jt = jtracks[i];
+
+			Array<Quaternion> rotations(default_allocator());
+			Array<Vector3> positions(default_allocator());
+			Array<Vector3> scales(default_allocator());
+			parse_rotations(jt.key_or_nil("rotations"), rotations);
+			parse_vector3s(jt.key_or_nil("positions"), positions);
+			parse_vector3s(jt.key_or_nil("scales"), scales);
+
+			AnimationTrack at;
+			at.bone = jt.key("bone").to_string_id();
+			compile_rotation(rotations, tol.rotation, base, at.rotation, data);
+			compile_vector3(positions, tol.translation, base, at.translation, data);
+			compile_vector3(scales, tol.scale, base, at.scale, data);
+			array::push_back(tracks, at);
+		}
+
+		opts.write(ar.version);
+		opts.write(ar.num_tracks);
+		opts.write(ar.num_frames);
+		opts.write(ar.sample_rate);
+		opts.write(ar.duration);
+		opts.write(ar.tracks_offset);
+		opts.write(tracks);
+		opts.write(data);
+	}
+
+	void* load(File& file, Allocator& a)
+	{
+		const size_t file_size = file.size();
+		void* res = a.allocate(file_size);
+		file.read(res, file_size);
+		return res;
+	}
+
+	void online(StringId64 /*id*/, ResourceManager& /*rm*/)
+	{
+	}
+
+	void offline(StringId64 /*id*/, ResourceManager& /*rm*/)
+	{
+	}
+
+	void unload(Allocator& allocator, void* resource)
+	{
+		allocator.deallocate(resource);
+	}
+
+	float duration(const AnimationResource* ar)
+	{
+		return ar->duration;
+	}
+
+	uint32_t num_tracks(const AnimationResource* ar)
+	{
+		return ar->num_tracks;
+	}
+
+	const AnimationTrack* track(const AnimationResource* ar, uint32_t i)
+	{
+		CE_ASSERT(i < num_tracks(ar), "Index out of bounds");
+		const AnimationTrack* begin = (AnimationTrack*) ((char*)ar + ar->tracks_offset);
+		return &begin[i];
+	}
+
+	const uint16_t* key_times(const AnimationResource* ar, const AnimationChannel& ch)
+	{
+		return (uint16_t*) ((char*)ar + ch.times_offset);
+	}
+
+	const uint16_t* key_values(const AnimationResource* ar, const AnimationChannel& ch)
+	{
+		return (uint16_t*) ((char*)ar + ch.values_offset);
+	}
+
+	Quaternion decode_rotation(const uint16_t* v)
+	{
+		const uint64_t bits = uint64_t(v[0]) | (uint64_t(v[1]) << 16) | (uint64_t(v[2]) << 32);
+		const uint32_t largest = uint32_t(bits >> 45) & 3;
+
+		Quaternion q;
+		float sum = 0.0f;
+		for (uint32_t i = 0, j = 0; i < 4; i++)
+		{
+			if (i == largest)
+				continue;
+
+			const float n = float((bits >> (15 * j)) & 0x7FFF) / 32767.0f;
+			q[i] = (n * 2.0f - 1.0f) * SMALLEST_THREE_RANGE;
+			sum += q[i] * q[i];
+			j++;
+		}
+
+		q[largest] = math::sqrt(math::max(0.0f, 1.0f - sum));
+		return q;
+	}
+
+	Vector3 decode_vector3(const AnimationChannel& ch, const uint16_t* v)
+	{
+		return Vector3(ch.min[0] + ch.extent[0] * (v[0] / 65535.0f),
+			ch.min[1] + ch.extent[1] * (v[1] / 65535.0f),
+			ch.min[2] + ch.extent[2] * (v[2] / 65535.0f));
+	}
+} // namespace animation_resource
+} // namespace crown
@@ -0,0 +1,105 @@
+/*
+Copyright (c) 2013 Daniele Bartolini, Michele Rossi
+Copyright (c) 2012 Daniele Bartolini, Simone Boscaratto
+
+Permission is hereby granted, free of charge, to any person
+obtaining a copy of this software and associated documentation
+files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use,
+copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following
+conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+
+#include "types.h"
+#include "resource.h"
+#include "allocator.h"
+#include "file.h"
+#include "math_types.h"
+
+namespace crown
+{
+
+// All offsets are absolute
+struct AnimationResource
+{
+	uint32_t version;
+	uint32_t num_tracks;
+	uint32_t num_frames;
+	float sample_rate;
+	float duration;
+	uint32_t tracks_offset;	// AnimationTrack[num_tracks]
+};
+
+/// Keys of a rotation, translation or scale channel.
+///
+/// Keys are the source frames left after key reduction: @a times_offset points
+/// to the uint16_t frame of each key, @a values_offset to three uint16_t per key.
+/// Rotations are quantized with the smallest three method, translations and
+/// scales to 16 bits per component in the range [min, min + extent].
+/// A channel with no keys is not animated and keeps the bind pose.
+struct AnimationChannel
+{
+	uint32_t num_keys;
+	uint32_t times_offset;
+	uint32_t values_offset;
+	float min[3];
+	float extent[3];
+};
+
+struct AnimationTrack
+{
+	StringId32 bone;
+	AnimationChannel rotation;
+	AnimationChannel translation;
+	AnimationChannel scale;
+};
+
+namespace animation_resource
+{
+	void compile(const char* path, CompileOptions& opts);
+	void* load(File& file, Allocator& a);
+	void online(StringId64 /*id*/, ResourceManager& /*rm*/);
+	void offline(StringId64 /*id*/, ResourceManager& /*rm*/);
+	void unload(Allocator& allocator, void* resource);
+
+	/// Returns the duration of the clip in seconds.
+	float duration(const AnimationResource* ar);
+
+	/// Returns the number of tracks in the clip, one per animated bone.
+	uint32_t num_tracks(const AnimationResource* ar);
+
+	/// Returns the track @a i.
+	const AnimationTrack* track(const AnimationResource* ar, uint32_t i);
+
+	/// Returns the frames of the keys of @a ch.
+	const uint16_t* key_times(const AnimationResource* ar, const AnimationChannel& ch);
+
+	/// Returns the quantized values of the keys of @a ch.
+	const uint16_t* key_values(const AnimationResource* ar, const AnimationChannel& ch);
+
+	/// Encodes the unit quaternion @a q in the three values at @a v.
+	void encode_rotation(const Quaternion& q, uint16_t* v);
+
+	/// Returns the rotation encoded in @a v.
+	Quaternion decode_rotation(const uint16_t* v);
+
+	/// Returns the translation or scale encoded in @a v.
+	Vector3 decode_vector3(const AnimationChannel& ch, const uint16_t* v);
+} // namespace animation_resource
+} // namespace crown
@@ -0,0 +1,355 @@
+/*
+Copyright (c) 2013 Daniele Bartolini, Michele Rossi
+Copyright (c) 2012 Daniele Bartolini, Simone Boscaratto
+
+Permission is hereby granted, free of charge, to any person
+obtaining a copy of this software and associated documentation
+files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use,
+copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following
+conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "dxt.h"
+#include "math_utils.h"
+#include "simd.h"
+#include "parallel_for.h"
+#include <string.h>
+
+namespace crown
+{
+namespace dxt
+{
+	// Colors are compared in RGB only
+	struct Color
+	{
+		int32_t r;
+		int32_t g;
+		int32_t b;
+	};
+
+	static uint16_t to_565(const uint8_t* c)
+	{
+		return uint16_t(((c[0] >> 3) << 11) | ((c[1] >> 2) << 5) | (c[2] >> 3));
+	}
+
+	static Color from_565(uint16_t c)
+	{
+		const int32_t r = (c >> 11) & 0x1f;
+		const int32_t g = (c >> 5) & 0x3f;
+		const int32_t b = c & 0x1f;
+
+		Color col;
+		col.r = (r << 3) | (r >> 2);
+		col.g = (g << 2) | (g >> 4);
+		col.b = (b << 3) | (b >> 2);
+		return col;
+	}
+
+	// Copies the 4x4 block at (bx, by) to @a block, clamping at the image borders
+	static void extract_block(const uint8_t* src, uint32_t width, uint32_t height, uint32_t bx, uint32_t by, uint8_t* block)
+	{
+		for (uint32_t y = 0; y < 4; y++)
+		{
+			const uint32_t sy = math::min(by * 4 + y, height - 1);
+			for (uint32_t x = 0; x < 4; x++)
+			{
+				const uint32_t sx = math::min(bx * 4 + x, width - 1);
+				memcpy(block + (y * 4 + x) * 4, src + (sy * width + sx) * 4, 4);
+			}
+		}
+	}
+
+	// Returns the per-channel minimum and maximum of the 16 pixels in @a block
+	static void bounding_box(const uint8_t* block, uint8_t* min, uint8_t* max)
+	{
+#if CROWN_SIMD_SSE
+		__m128i mn = _mm_loadu_si128((const __m128i*) block);
+		__m128i mx = mn;
+		for (uint32_t i = 1; i < 4; i++)
+		{
+			const __m128i row = _mm_loadu_si128((const __m128i*) (block + i * 16));
+			mn = _mm_min_epu8(mn, row);
+			mx = _mm_max_epu8(mx, row);
+		}
+
+		// Reduce the 4 pixels of each register to 1
+		mn = _mm_min_epu8(mn, _mm_srli_si128(mn, 8));
+		mn = _mm_min_epu8(mn, _mm_srli_si128(mn, 4));
+		mx = _mm_max_epu8(mx, _mm_srli_si128(mx, 8));
+		mx = _mm_max_epu8(mx, _mm_srli_si128(mx, 4));
+
+		const uint32_t mn32 = (uint32_t) _mm_cvtsi128_si32(mn);
+		const uint32_t mx32 = (uint32_t) _mm_cvtsi128_si32(mx);
+		memcpy(min, &mn32, 4);
+		memcpy(max, &mx32, 4);
+#else
+		memcpy(min, block, 4);
+		memcpy(max, block, 4);
+		for (uint32_t i = 1; i < 16; i++)
+		{
+			for (uint32_t c = 0; c < 4; c++)
+			{
+				min[c] = math::min(min[c], block[i * 4 + c]);
+				max[c] = math::max(max[c], block[i * 4 + c]);
+			}
+		}
+#endif // CROWN_SIMD_SSE
+	}
+
+	// Writes in @a indices the index of the palette entry nearest to each pixel
+	static void color_indices(const uint8_t* block, const Color* palette, uint8_t* indices)
+	{
+#if CROWN_SIMD_SSE
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i rgb_mask = _mm_set1_epi32(0x00ffffff);
+
+		__m128i pal[4];
+		for (uint32_t j = 0; j < 4; j++)
+			pal[j] = _mm_set_epi16(0, palette[j].b, palette[j].g, palette[j].r, 0, palette[j].b, palette[j].g, palette[j].r);
+
+		for (uint32_t row = 0; row < 4; row++)
+		{
+			const __m128i px = _mm_and_si128(_mm_loadu_si128((const __m128i*) (block + row * 16)), rgb_mask);
+			const __m128i lo = _mm_unpacklo_epi8(px, zero);
+			const __m128i hi = _mm_unpackhi_epi8(px, zero);
+
+			__m128i best = _mm_set1_epi32(0x7fffffff);
+			__m128i best_idx = zero;
+
+			for (uint32_t j = 0; j < 4; j++)
+			{
+				const __m128i dlo = _mm_sub_epi16(lo, pal[j]);
+				const __m128i dhi = _mm_sub_epi16(hi, pal[j]);
+
+				// (r^2 + g^2, b^2) for each pixel, then summed
+				__m128i slo = _mm_madd_epi16(dlo, dlo);
+				__m128i shi = _mm_madd_epi16(dhi, dhi);
+				slo = _mm_add_epi32(slo, _mm_shuffle_epi32(slo, _MM_SHUFFLE(2, 3, 0, 1)));
+				shi = _mm_add_epi32(shi, _mm_shuffle_epi32(shi, _MM_SHUFFLE(2, 3, 0, 1)));
+				slo = _mm_shuffle_epi32(slo, _MM_SHUFFLE(3, 1, 2, 0));
+				shi = _mm_shuffle_epi32(shi, _MM_SHUFFLE(3, 1, 2, 0));
+				const __m128i dist = _mm_unpacklo_epi64(slo, shi);
+
+				const __m128i closer = _mm_cmplt_epi32(dist, best);
+				best = _mm_or_si128(_mm_and_si128(closer, dist), _mm_andnot_si128(closer, best));
+				best_idx = _mm_or_si128(_mm_and_si128(closer, _mm_set1_epi32(j)), _mm_andnot_si128(closer, best_idx));
+			}
+
+			int32_t idx[4];
+			_mm_storeu_si128((__m128i*) idx, best_idx);
+			for (uint32_t i = 0; i < 4; i++)
+				indices[row * 4 + i] = (uint8_t) idx[i];
+		}
+#else
+		for (uint32_t i = 0; i < 16; i++)
+		{
+			const uint8_t* p = block + i * 4;
+			int32_t best = 0x7fffffff;
+
+			for (uint32_t j = 0; j < 4; j++)
+			{
+				const int32_t dr = p[0] - palette[j].r;
+				const int32_t dg = p[1] - palette[j].g;
+				const int32_t db = p[2] - palette[j].b;
+				const int32_t dist = dr * dr + dg * dg + db * db;
+
+				if (dist < best)
+				{
+					best = dist;
+					indices[i] = (uint8_t) j;
+				}
+			}
+		}
+#endif // CROWN_SIMD_SSE
+	}
+
+	// Compresses the colors of @a block to 8 bytes in 4 colors mode
+	static void compress_color_block(const uint8_t* block, bool dxt1, uint8_t* dst)
+	{
+		uint8_t min[4];
+		uint8_t max[4];
+		bounding_box(block, min, max);
+
+		// Inset the bounding box to reduce the error at the extremes
+		uint8_t c0[3];
+		uint8_t c1[3];
+		for (uint32_t c = 0; c < 3; c++)
+		{
+			const uint8_t inset = (max[c] - min[c]) >> 4;
+			c0[c] = max[c] - inset;
+			c1[c] = min[c] + inset;
+		}
+
+		uint16_t e0 = to_565(c0);
+		uint16_t e1 = to_565(c1);
+
+		uint32_t bits = 0;
+
+		if (e0 != e1)
+		{
+			// DXT1 selects the 4 colors mode when e0 > e1
+			if (dxt1 && e0 < e1)
+			{
+				const uint16_t tmp = e0;
+				e0 = e1;
+				e1 = tmp;
+			}
+
+			Color palette[4];
+			palette[0] = from_565(e0);
+			palette[1] = from_565(e1);
+			palette[2].r = (2 * palette[0].r + palette[1].r) / 3;
+			palette[2].g = (2 * palette[0].g + palette[1].g) / 3;
+			palette[2].b = (2 * palette[0].b + palette[1].b) / 3;
+			palette[3].r = (palette[0].r + 2 * palette[1].r) / 3;
+			palette[3].g = (palette[0].g + 2 * palette[1].g) / 3;
+			palette[3].b = (palette[0].b + 2 * palette[1].b) / 3;
+
+			uint8_t indices[16];
+			color_indices(block, palette, indices);
+
+			for (uint32_t i = 0; i < 16; i++)
+				bits |= uint32_t(indices[i]) << (i * 2);
+		}
+
+		dst[0] = uint8_t(e0);
+		dst[1] = uint8_t(e0 >> 8);
+		dst[2] = uint8_t(e1);
+		dst[3] = uint8_t(e1 >> 8);
+		memcpy(dst + 4, &bits, 4);
+	}
+
+	// Compresses the alpha of @a block to 8 bytes in 8 alphas mode
+	static void compress_alpha_block(const uint8_t* block, uint8_t* dst)
+	{
+		uint8_t a0 = 0;
+		uint8_t a1 = 255;
+		for (uint32_t i = 0; i < 16; i++)
+		{
+			a0 = math::max(a0, block[i * 4 + 3]);
+			a1 = math::min(a1, block[i * 4 + 3]);
+		}
+
+		dst[0] = a0;
+		dst[1] = a1;
+
+		uint64_t bits = 0;
+
+		if (a0 != a1)
+		{
+			int32_t palette[8];
+			palette[0] = a0;
+			palette[1] = a1;
+			for (uint32_t j = 1; j < 7; j++)
+				palette[j + 1] = ((7 - j) * a0 + j * a1) / 7;
+
+			for (uint32_t i = 0; i < 16; i++)
+			{
+				const int32_t a = block[i * 4 + 3];
+				uint32_t best_idx = 0;
+				int32_t best = 256;
+
+				for (uint32_t j = 0; j < 8; j++)
+				{
+					const int32_t d = a - palette[j];
+					const int32_t dist = d < 0 ? -d : d;
+					if (dist < best)
+					{
+						best = dist;
+						best_idx = j;
+					}
+				}
+
+				bits |= uint64_t(best_idx) << (i * 3);
+			}
+		}
+
+		for (uint32_t i = 0; i < 6; i++)
+			dst[2 + i] = uint8_t(bits >> (i * 8));
+	}
+
+	struct CompressJob
+	{
+		const uint8_t* src;
+		uint32_t width;
+		uint32_t height;
+		bool alpha;
+		uint8_t* dst;
+	};
+
+	// Compresses the rows of blocks [begin, end)
+	static void compress_rows(uint32_t begin, uint32_t end, void* data)
+	{
+		const CompressJob& job = *(CompressJob*) data;
+		const uint32_t blocks_x = (job.width + 3) / 4;
+		const uint32_t block_size = job.alpha ? 16 : 8;
+
+		uint8_t block[64];
+
+		for (uint32_t by = begin; by < end; by++)
+		{
+			uint8_t* dst = job.dst + by * blocks_x * block_size;
+
+			for (uint32_t bx = 0; bx < blocks_x; bx++)
+			{
+				extract_block(job.src, job.width, job.height, bx, by, block);
+
+				if (job.alpha)
+				{
+					compress_alpha_block(block, dst);
+					compress_color_block(block, false, dst + 8);
+				}
+				else
+				{
+					compress_color_block(block, true, dst);
+				}
+
+				dst += block_size;
+			}
+		}
+	}
+
+	static void compress(const uint8_t* src, uint32_t width, uint32_t height, bool alpha, uint8_t* dst)
+	{
+		CompressJob job;
+		job.src = src;
+		job.width = width;
+		job.height = height;
+		job.alpha = alpha;
+		job.dst = dst;
+
+		parallel_for((height + 3) / 4, compress_rows, &job);
+	}
+
+	uint32_t size(uint32_t width, uint32_t height, bool alpha)
+	{
+		return ((width + 3) / 4) * ((height + 3) / 4) * (alpha ? 16 : 8);
+	}
+
+	void compress_dxt1(const uint8_t* src, uint32_t width, uint32_t height, uint8_t* dst)
+	{
+		compress(src, width, height, false, dst);
+	}
+
+	void compress_dxt5(const uint8_t* src, uint32_t width, uint32_t height, uint8_t* dst)
+	{
+		compress(src, width, height, true, dst);
+	}
+} // namespace dxt
+} // namespace crown
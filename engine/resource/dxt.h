@@ -0,0 +1,51 @@
+/*
+Copyright (c) 2013 Daniele Bartolini, Michele Rossi
+Copyright (c) 2012 Daniele Bartolini, Simone Boscaratto
+
+Permission is hereby granted, free of charge, to any person
+obtaining a copy of this software and associated documentation
+files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use,
+copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following
+conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#pragma once
+
+#include "types.h"
+
+namespace crown
+{
+
+/// Functions to compress RGBA8 images to the DXT1 and DXT5 block formats.
+///
+/// @ingroup Resource
+namespace dxt
+{
+	/// Returns the size in bytes of a @a width x @a height image compressed
+	/// with DXT5 if @a alpha is true or DXT1 otherwise.
+	uint32_t size(uint32_t width, uint32_t height, bool alpha);
+
+	/// Compresses the RGBA8 image @a src of size @a width x @a height to DXT1 into @a dst.
+	/// Alpha is ignored.
+	void compress_dxt1(const uint8_t* src, uint32_t width, uint32_t height, uint8_t* dst);
+
+	/// Compresses the RGBA8 image @a src of size @a width x @a height to DXT5 into @a dst.
+	void compress_dxt5(const uint8_t* src, uint32_t width, uint32_t height, uint8_t* dst);
+} // namespace dxt
+} // namespace crown
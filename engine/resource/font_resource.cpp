@@ -26,32 +26,40 @@ OTHER DEALINGS IN THE SOFTWARE.
 
 #include "font_resource.h"
 #include "json_parser.h"
+#include "json_schema.h"
 #include "allocator.h"
 #include "filesystem.h"
 #include "string_utils.h"
 #include "bundle.h"
 #include "types.h"
-
+#include <algorithm>
 
 namespace crown
 {
 namespace font_resource
 {
-	void parse_glyph(JSONElement e, FontGlyphData& glyph)
+	static const JSONField FONT_GLYPH_FIELDS[] =
+	{
+		CE_JSON_FIELD(FontGlyphData, id, UINT32, "id"),
+		CE_JSON_FIELD(FontGlyphData, x, UINT32, "x"),
+		CE_JSON_FIELD(FontGlyphData, y, UINT32, "y"),
+		CE_JSON_FIELD(FontGlyphData, width, UINT32, "width"),
+		CE_JSON_FIELD(FontGlyphData, height, UINT32, "height"),
+		CE_JSON_FIELD(FontGlyphData, x_offset, FLOAT, "x_offset"),
+		CE_JSON_FIELD(FontGlyphData, y_offset, FLOAT, "y_offset"),
+		CE_JSON_FIELD(FontGlyphData, x_advance, FLOAT, "x_advance")
+	};
+
+	static const JSONSchema FONT_GLYPH_SCHEMA = CE_JSON_SCHEMA(FontGlyphData, FONT_GLYPH_FIELDS);
+
+	static bool glyph_less(const FontGlyphData& a, const FontGlyphData& b)
 	{
-		glyph.id =        e.key("id").to_int();
-		glyph.x =         e.key("x").to_int();
-		glyph.y =         e.key("y").to_int();
-		glyph.width =     e.key("width").to_int();
-		glyph.height =    e.key("height").to_int();
-		glyph.x_offset =  e.key("x_offset").to_float();
-		glyph.y_offset =  e.key("y_offset").to_float();
-		glyph.x_advance = e.key("x_advance").to_float();
+		return a.id < b.id;
 	}
 
 	void compile(const char* path, CompileOptions& opts)
 	{
-		static const uint32_t VERSION = 1;
+		static const uint32_t VERSION = 2;
 
 		Buffer buf = opts.read(path);
 		JSONParser json(array::begin(buf));
@@ -63,14 +71,15 @@ namespace font_resource
 		JSONElement font_size = root.key("font_size");
 		JSONElement glyphs = root.key("glyphs");
 
-		uint32_t num_glyphs = count.to_int();
+		json_schema::validate(FONT_GLYPH_SCHEMA);
+		json_schema::read_array(FONT_GLYPH_SCHEMA, glyphs, m_glyphs);
 
-		for (uint32_t i = 0; i < num_glyphs; i++)
-		{
-			FontGlyphData data;
-			parse_glyph(glyphs[i], data);
-			array::push_back(m_glyphs, data);
-		}
+		const uint32_t num_glyphs = count.to_int();
+		CE_ASSERT(num_glyphs <= array::size(m_glyphs), "Not enough glyphs");
+		array::resize(m_glyphs, num_glyphs);
+
+		// Glyphs are looked up by binary search
+		std::sort(array::begin(m_glyphs), array::end(m_glyphs), glyph_less);
 
 		FontResource fr;
 		fr.version = VERSION;
@@ -83,17 +92,7 @@ namespace font_resource
 		opts.write(fr.texture_size);
 		opts.write(fr.font_size);
 
-		for (uint32_t i = 0; i < array::size(m_glyphs); i++)
-		{
-			opts.write(m_glyphs[i].id);
-			opts.write(m_glyphs[i].x);
-			opts.write(m_glyphs[i].y);
-			opts.write(m_glyphs[i].width);
-			opts.write(m_glyphs[i].height);
-			opts.write(m_glyphs[i].x_offset);
-			opts.write(m_glyphs[i].y_offset);
-			opts.write(m_glyphs[i].x_advance);
-		}
+		opts.write(m_glyphs);
 	}
 
 	void* load(File& file, Allocator& a)
@@ -132,20 +131,22 @@ namespace font_resource
 		return fr->font_size;
 	}
 
-	const FontGlyphData* get_glyph(const FontResource* fr, uint32_t i)
+	const FontGlyphData* get_glyph(const FontResource* fr, uint32_t code_point)
 	{
-		CE_ASSERT(i < num_glyphs(fr), "Index out of bounds");
-
-		FontGlyphData* begin = (FontGlyphData*)((char*)fr + sizeof(FontResource));
+		const FontGlyphData* begin = (const FontGlyphData*)((const char*)fr + sizeof(FontResource));
 
-		for (uint32_t i = 0; i < num_glyphs(fr); i++)
+		uint32_t lo = 0;
+		uint32_t hi = num_glyphs(fr);
+		while (lo < hi)
 		{
-			if (begin[i].id == i)
-				return &begin[i];
+			const uint32_t mid = lo + (hi - lo) / 2;
+			if (begin[mid].id < code_point)
+				lo = mid + 1;
+			else
+				hi = mid;
 		}
 
-		CE_FATAL("Glyph not found");
-		return NULL;
+		return (lo < num_glyphs(fr) && begin[lo].id == code_point) ? &begin[lo] : NULL;
 	}
 } // namespace font_resource
 } // namespace crown
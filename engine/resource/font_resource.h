@@ -68,6 +68,8 @@ namespace font_resource
 	uint32_t num_glyphs(const FontResource* fr);
 	uint32_t texture_size(const FontResource* fr);
 	uint32_t font_size(const FontResource* fr);
-	const FontGlyphData* get_glyph(const FontResource* fr, uint32_t i);
+
+	/// Returns the glyph of @a code_point or NULL if the font does not have it.
+	const FontGlyphData* get_glyph(const FontResource* fr, uint32_t code_point);
 } // namespace font_resource
 } // namespace crown
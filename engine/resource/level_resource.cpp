@@ -28,219 +28,147 @@ OTHER DEALINGS IN THE SOFTWARE.
 #include "array.h"
 #include "memory.h"
 #include "json_parser.h"
+#include "json_schema.h"
 #include "filesystem.h"
+#include "math_utils.h"
+#include <algorithm>
 
 namespace crown
 {
 
-template <typename STREAM, typename T> inline STREAM& operator&(STREAM& stream, T& t)
+static const JSONField LEVEL_UNIT_FIELDS[] =
 {
-	return t.serialize(stream);
-}
+	CE_JSON_RESOURCE(LevelUnit, name, "name", "unit"),
+	CE_JSON_FIELD(LevelUnit, position, VECTOR3, "position"),
+	CE_JSON_FIELD(LevelUnit, rotation, QUATERNION, "rotation"),
+	CE_JSON_PADDING(LevelUnit, _pad)
+};
 
-template <> inline BinaryWriter& operator&(BinaryWriter& bw, bool& v)
+static const JSONField LEVEL_SOUND_FIELDS[] =
 {
-	bw.write(v);
-	return bw;
-}
+	CE_JSON_RESOURCE(LevelSound, name, "name", "sound"),
+	CE_JSON_FIELD(LevelSound, position, VECTOR3, "position"),
+	CE_JSON_FIELD(LevelSound, volume, FLOAT, "volume"),
+	CE_JSON_FIELD(LevelSound, range, FLOAT, "range"),
+	CE_JSON_FIELD(LevelSound, loop, BOOL, "loop"),
+	CE_JSON_PADDING(LevelSound, _pad)
+};
 
-template <> inline BinaryReader& operator&(BinaryReader& br, bool& v)
-{
-	br.read(v);
-	return br;
-}
-
-template <> inline BinaryWriter& operator&(BinaryWriter& bw, float& v)
-{
-	bw.write(v);
-	return bw;
-}
-
-template <> inline BinaryReader& operator&(BinaryReader& br, float& v)
-{
-	br.read(v);
-	return br;
-}
-
-template <> inline BinaryWriter& operator&(BinaryWriter& bw, char& v)
-{
-	bw.write(v);
-	return bw;
-}
-
-template <> inline BinaryReader& operator&(BinaryReader& br, char& v)
-{
-	br.read(v);
-	return br;
-}
-
-template <> inline BinaryWriter& operator&(BinaryWriter& bw, int8_t& v)
-{
-	bw.write(v);
-	return bw;
-}
-
-template <> inline BinaryReader& operator&(BinaryReader& br, int8_t& v)
-{
-	br.read(v);
-	return br;
-}
-
-template <> inline BinaryWriter& operator&(BinaryWriter& bw, uint8_t& v)
-{
-	bw.write(v);
-	return bw;
-}
+static const JSONSchema LEVEL_UNIT_SCHEMA = CE_JSON_SCHEMA(LevelUnit, LEVEL_UNIT_FIELDS);
+static const JSONSchema LEVEL_SOUND_SCHEMA = CE_JSON_SCHEMA(LevelSound, LEVEL_SOUND_FIELDS);
 
-template <> inline BinaryReader& operator&(BinaryReader& br, uint8_t& v)
-{
-	br.read(v);
-	return br;
-}
-
-template <> inline BinaryWriter& operator&(BinaryWriter& bw, uint32_t& v)
-{
-	bw.write(v);
-	return bw;
-}
-
-template <> inline BinaryReader& operator&(BinaryReader& br, uint32_t& v)
-{
-	br.read(v);
-	return br;
-}
-
-template <> inline BinaryWriter& operator&(BinaryWriter& br, uint64_t& v)
-{
-	br.write(v);
-	return br;
-}
-
-template <> inline BinaryReader& operator&(BinaryReader& br, uint64_t& v)
-{
-	br.read(v);
-	return br;
-}
-
-template <> inline BinaryReader& operator&(BinaryReader& br, ResourceId& id)
-{
-	return br & id.type & id.name;
-}
-
-template <> inline BinaryWriter& operator&(BinaryWriter& bw, Vector3& v)
-{
-	return bw & v.x & v.y & v.z;
-}
-
-template <> inline BinaryReader& operator&(BinaryReader& br, Vector3& v)
+namespace level_resource
 {
-	return br & v.x & v.y & v.z;
-}
+	/// Position of a unit in the grid of cells, used to sort the units by cell.
+	struct CellKey
+	{
+		StringId64 package;
+		int32_t x;
+		int32_t y;
+		int32_t z;
+		uint32_t unit;
 
-template <> inline BinaryWriter& operator&(BinaryWriter& bw, Quaternion& q)
-{
-	return bw & q.x & q.y & q.z & q.w;
-}
+		bool operator<(const CellKey& b) const
+		{
+			if (package != b.package) return package < b.package;
+			if (x != b.x) return x < b.x;
+			if (y != b.y) return y < b.y;
+			if (z != b.z) return z < b.z;
+			return unit < b.unit;
+		}
 
-template <> inline BinaryReader& operator&(BinaryReader& br, Quaternion& q)
-{
-	return br & q.x & q.y & q.z & q.w;
-}
+		bool same_cell(const CellKey& b) const
+		{
+			return package == b.package && x == b.x && y == b.y && z == b.z;
+		}
+	};
 
-template <> inline BinaryWriter& operator&(BinaryWriter& bw, LevelResource& data)
-{
-	return bw
-		& data.version
-		& data.num_units
-		& data.units_offset
-		& data.num_sounds
-		& data.sounds_offset;
-}
-
-template <> inline BinaryWriter& operator&(BinaryWriter& bw, LevelUnit& data)
-{
-	return bw
-		& data.name
-		& data.position
-		& data.rotation
-		& data._pad;
-}
-
-template <> inline BinaryWriter& operator&(BinaryWriter& bw, LevelSound& data)
-{
-	return bw
-		& data.name
-		& data.position
-		& data.volume
-		& data.range
-		& data.loop
-		& data._pad[0]
-		& data._pad[1]
-		& data._pad[2];
-}
-
-template <typename T> inline BinaryWriter& operator&(BinaryWriter& bw, Array<T> arr)
-{
-	for (uint32_t i = 0; i < array::size(arr); i++)
-		bw & arr[i];
-	return bw;
-}
+	static int32_t cell_coord(float value, float cell_size)
+	{
+		return cell_size > 0.0f ? int32_t(math::floor(value / cell_size)) : 0;
+	}
 
-namespace level_resource
-{
 	void compile(const char* path, CompileOptions& opts)
 	{
-		static const uint32_t VERSION = 1;
+		static const uint32_t VERSION = 2;
 
 		Buffer buf = opts.read(path);
 		JSONParser json(array::begin(buf));
 		JSONElement root = json.root();
 
+		json_schema::validate(LEVEL_UNIT_SCHEMA);
+		json_schema::validate(LEVEL_SOUND_SCHEMA);
+
 		Array<LevelUnit> units(default_allocator());
 		Array<LevelSound> sounds(default_allocator());
 
+		json_schema::read_array(LEVEL_SOUND_SCHEMA, root.key("sounds"), sounds);
+		json_schema::read_array(LEVEL_UNIT_SCHEMA, root.key("units"), units);
+
+		// Group the units in cells by package and position
+		JSONElement cell_size_key = root.key_or_nil("cell_size");
+		const float cell_size = cell_size_key.is_nil() ? 0.0f : cell_size_key.to_float();
+
+		JSONElement junits = root.key("units");
+		Array<CellKey> keys(default_allocator());
+		array::resize(keys, array::size(units));
+		for (uint32_t i = 0; i < array::size(units); i++)
 		{
-			JSONElement sounds_arr = root.key("sounds");
-			const uint32_t size = sounds_arr.size();
-			for (uint32_t i = 0; i < size; i++)
-			{
-				JSONElement e = sounds_arr[i];
-				LevelSound ls;
-				ls.name = e.key("name").to_resource_id("sound").name;
-				ls.position = e.key("position").to_vector3();
-				ls.volume = e.key("volume").to_float();
-				ls.range = e.key("range").to_float();
-				ls.loop = e.key("loop").to_bool();
-				array::push_back(sounds, ls);
-			}
+			JSONElement package = junits[i].key_or_nil("package");
+
+			CellKey& k = keys[i];
+			k.package = package.is_nil() ? 0 : package.to_resource_id("package").name;
+			k.x = cell_coord(units[i].position.x, cell_size);
+			k.y = cell_coord(units[i].position.y, cell_size);
+			k.z = cell_coord(units[i].position.z, cell_size);
+			k.unit = i;
 		}
+		std::sort(array::begin(keys), array::end(keys));
 
+		Array<LevelUnit> sorted_units(default_allocator());
+		Array<LevelCell> cells(default_allocator());
+		for (uint32_t i = 0; i < array::size(keys); i++)
 		{
-			JSONElement units_arr = root.key("units");
-			const uint32_t size = units_arr.size();
-			for (uint32_t i = 0; i < size; i++)
+			const LevelUnit& lu = units[keys[i].unit];
+
+			if (i == 0 || !keys[i].same_cell(keys[i - 1]))
 			{
-				JSONElement e = units_arr[i];
-				LevelUnit lu;
-				lu.name = e.key("name").to_resource_id("unit").name;
-				lu.position = e.key("position").to_vector3();
-				lu.rotation = e.key("rotation").to_quaternion();
-				array::push_back(units, lu);
+				LevelCell cell;
+				cell.min = lu.position;
+				cell.max = lu.position;
+				cell.first_unit = i;
+				cell.num_units = 0;
+				cell.package = keys[i].package;
+				array::push_back(cells, cell);
 			}
+
+			LevelCell& cell = array::back(cells);
+			cell.min.x = math::min(cell.min.x, lu.position.x);
+			cell.min.y = math::min(cell.min.y, lu.position.y);
+			cell.min.z = math::min(cell.min.z, lu.position.z);
+			cell.max.x = math::max(cell.max.x, lu.position.x);
+			cell.max.y = math::max(cell.max.y, lu.position.y);
+			cell.max.z = math::max(cell.max.z, lu.position.z);
+			cell.num_units++;
+			array::push_back(sorted_units, lu);
 		}
 
 		LevelResource lr;
 		lr.version = VERSION;
-		lr.num_units = array::size(units);
+		lr.num_units = array::size(sorted_units);
 		lr.num_sounds = array::size(sounds);
+		lr.cell_size = cell_size;
+		lr.num_cells = array::size(cells);
 
 		uint32_t offt = sizeof(LevelResource);
 		lr.units_offset = offt; offt += sizeof(LevelUnit) * lr.num_units;
-		lr.sounds_offset = offt;
+		lr.sounds_offset = offt; offt += sizeof(LevelSound) * lr.num_sounds;
+		lr.cells_offset = offt;
 
-		opts._bw & lr
-			& units
-			& sounds;
+		opts.write(lr);
+		opts.write(sorted_units);
+		opts.write(sounds);
+		opts.write(cells);
 	}
 
 	void* load(File& file, Allocator& a)
@@ -287,5 +215,22 @@ namespace level_resource
 		const LevelSound* begin = (LevelSound*)((char*)lr + lr->sounds_offset);
 		return &begin[i];
 	}
+
+	float cell_size(const LevelResource* lr)
+	{
+		return lr->cell_size;
+	}
+
+	uint32_t num_cells(const LevelResource* lr)
+	{
+		return lr->num_cells;
+	}
+
+	const LevelCell* get_cell(const LevelResource* lr, uint32_t i)
+	{
+		CE_ASSERT(i < num_cells(lr), "Index out of bounds");
+		const LevelCell* begin = (LevelCell*)((char*)lr + lr->cells_offset);
+		return &begin[i];
+	}
 } // namespace level_resource
 } // namespace crown
@@ -45,6 +45,9 @@ struct LevelResource
 	uint32_t units_offset;
 	uint32_t num_sounds;
 	uint32_t sounds_offset;
+	float cell_size;
+	uint32_t num_cells;
+	uint32_t cells_offset;
 };
 
 struct LevelUnit
@@ -65,6 +68,17 @@ struct LevelSound
 	char _pad[3];
 };
 
+/// A group of units of a level which are streamed in and out together.
+/// Units of a cell are contiguous and are all in the same package.
+struct LevelCell
+{
+	Vector3 min; // Bounds of the positions of the units
+	Vector3 max;
+	uint32_t first_unit;
+	uint32_t num_units;
+	StringId64 package; // 0 if the units need no package
+};
+
 namespace level_resource
 {
 	void compile(const char* path, CompileOptions& opts);
@@ -77,5 +91,10 @@ namespace level_resource
 	const LevelUnit* get_unit(const LevelResource* lr, uint32_t i);
 	uint32_t num_sounds(const LevelResource* lr);
 	const LevelSound* get_sound(const LevelResource* lr, uint32_t i);
+
+	/// Returns the size of the cells the units are grouped into, 0 if not grouped by position.
+	float cell_size(const LevelResource* lr);
+	uint32_t num_cells(const LevelResource* lr);
+	const LevelCell* get_cell(const LevelResource* lr, uint32_t i);
 } // namespace level_resource
 } // namespace crown
@@ -30,7 +30,13 @@ OTHER DEALINGS IN THE SOFTWARE.
 #include "log.h"
 #include "mesh_resource.h"
 #include "temp_allocator.h"
+#include "vector2.h"
 #include "vector3.h"
+#include "aabb.h"
+#include "array.h"
+#include "hash.h"
+#include "resource_manager.h"
+#include "compile_options.h"
 
 namespace crown
 {
@@ -41,158 +47,90 @@ namespace mesh_resource
 		Vector3 position;
 		Vector3 normal;
 		Vector2 texcoord;
-
-		bool operator==(const MeshVertex& other)
-		{
-			return position == other.position &&
-					normal == other.normal &&
-					texcoord == other.texcoord;
-		}
 	};
 
-	MeshHeader			m_mesh_header;
-	bool				m_has_normal;
-	bool				m_has_texcoord;
-
-	Array<MeshVertex>	m_vertices(default_allocator());
-	Array<uint16_t>		m_indices(default_allocator());
-
 	void compile(const char* path, CompileOptions& opts)
 	{
-		// File* file = fs.open(resource_path, FOM_READ);
-		// JSONParser json(*file);
-		// fs.close(file);
-
-		// JSONElement root = json.root();
-
-		// // Read data arrays
-		// JSONElement position = root.key_or_nil("position");
-		// JSONElement normal = root.key_or_nil("normal");
-		// JSONElement texcoord = root.key_or_nil("texcoord");
-
-		// m_has_normal = false;
-		// m_has_texcoord = false;
-
-		// if (position.is_nil())
-		// {
-		// 	CE_LOGE("Bad mesh: array 'position' not found.");
-		// 	return;
-		// }
-		// Array<float> position_array(default_allocator());
-		// position.to_array(position_array);
-
-
-		// Array<float> normal_array(default_allocator());
-		// if (!normal.is_nil())
-		// {
-		// 	m_has_normal = true;
-		// 	normal.to_array(normal_array);
-		// }
-
-		// Array<float> texcoord_array(default_allocator());
-		// if (!texcoord.is_nil())
-		// {
-		// 	m_has_texcoord = true;
-		// 	texcoord.to_array(texcoord_array);
-		// }
-
-		// // Read index arrays
-		// JSONElement index = root.key_or_nil("index");
-		// if (index.is_nil())
-		// {
-		// 	CE_LOGE("Bad mesh: array 'index' not found.");
-		// 	return;
-		// }
-
-		// Array<uint16_t> position_index(default_allocator());
-		// Array<uint16_t> normal_index(default_allocator());
-		// Array<uint16_t> texcoord_index(default_allocator());
-
-		// index[0].to_array(position_index);
-
-		// if (m_has_normal)
-		// {
-		// 	index[1].to_array(normal_index);
-		// }
-
-		// if (m_has_texcoord)
-		// {
-		// 	index[2].to_array(texcoord_index);
-		// }
-
-		// // Generate vb/ib
-		// uint32_t idx = 0;
-		// for (uint32_t i = 0; i < array::size(position_index); i++)
-		// {
-		// 	MeshVertex v;
-
-		// 	uint16_t p_idx = position_index[i] * 3;
-		// 	v.position = Vector3(position_array[p_idx], position_array[p_idx + 1], position_array[p_idx + 2]);
-
-		// 	if (m_has_normal)
-		// 	{
-		// 		uint16_t n_idx = normal_index[i] * 3;
-		// 		v.normal = Vector3(normal_array[n_idx], normal_array[n_idx + 1], normal_array[n_idx + 2]);
-		// 	}
-
-		// 	if (m_has_texcoord)
-		// 	{
-		// 		uint16_t t_idx = texcoord_index[i] * 2;
-		// 		v.texcoord = Vector2(texcoord_array[t_idx], texcoord_array[t_idx + 1]);
-		// 	}
-
-
-		// 	uint32_t f_idx = 0;
-		// 	bool found = false;
-		// 	for (; f_idx < array::size(m_vertices); f_idx++)
-		// 	{
-		// 		if (m_vertices[f_idx] == v)
-		// 		{
-		// 			found = true;
-		// 			break;
-		// 		}
-		// 	}
-
-		// 	if (found)
-		// 	{
-		// 		array::push_back(m_indices, (uint16_t) f_idx);
-		// 	}
-		// 	else
-		// 	{
-		// 		array::push_back(m_vertices, v);
-		// 		array::push_back(m_indices, (uint16_t) idx);
-		// 		idx++;
-		// 	}
-		// }
-
-		// m_mesh_header.version = MESH_VERSION;
-		// m_mesh_header.num_meshes = 1;
-		// m_mesh_header.num_joints = 0;
-		// //m_mesh_header.padding[0] = 0xCECECECE;
-
-		// MeshData data;
-		// data.vertices.num_vertices = array::size(m_vertices);
-		// // data.vertices.format = VertexFormat::P3_N3_T2;
-		// data.vertices.offset = sizeof(MeshHeader) + sizeof(MeshData);
-
-		// data.indices.num_indices = array::size(m_indices);
-		// data.indices.offset = sizeof(MeshHeader) + sizeof(MeshData) + array::size(m_vertices) * sizeof(MeshVertex);
-
-		// // Write header
-		// out_file->write((char*)&m_mesh_header, sizeof(MeshHeader));
-
-		// // Write mesh metadata
-		// out_file->write((char*)&data, sizeof(MeshData));
-
-		// // Write vertices
-		// out_file->write((char*) array::begin(m_vertices), array::size(m_vertices) * sizeof(MeshVertex));
-
-		// // Write indices
-		// out_file->write((char*) array::begin(m_indices), array::size(m_indices) * sizeof(uint16_t));
-
-		// // Cleanup
-		// array::clear(m_vertices);
-		// array::clear(m_indices);
+		Buffer buf = opts.read(path);
+		JSONParser json(array::begin(buf));
+		JSONElement root = json.root();
+
+		// Read data arrays
+		JSONElement position = root.key("position");
+		JSONElement normal = root.key_or_nil("normal");
+		JSONElement texcoord = root.key_or_nil("texcoord");
+		JSONElement index = root.key("index");
+
+		const bool has_normal = !normal.is_nil();
+		const bool has_texcoord = !texcoord.is_nil();
+
+		Array<float> position_array(default_allocator());
+		Array<float> normal_array(default_allocator());
+		Array<float> texcoord_array(default_allocator());
+		position.to_array(position_array);
+		if (has_normal) normal.to_array(normal_array);
+		if (has_texcoord) texcoord.to_array(texcoord_array);
+
+		// Read index arrays
+		Array<uint16_t> position_index(default_allocator());
+		Array<uint16_t> normal_index(default_allocator());
+		Array<uint16_t> texcoord_index(default_allocator());
+		index[0].to_array(position_index);
+		if (has_normal) index[1].to_array(normal_index);
+		if (has_texcoord) index[2].to_array(texcoord_index);
+
+		// Generate vb/ib, merging identical (position, normal, texcoord) triplets
+		Array<MeshVertex> vertices(default_allocator());
+		Array<uint16_t> indices(default_allocator());
+		Hash<uint16_t> unique(default_allocator());
+
+		AABB aabb;
+		aabb::reset(aabb);
+
+		for (uint32_t i = 0; i < array::size(position_index); i++)
+		{
+			const uint16_t p_idx = position_index[i];
+			const uint16_t n_idx = has_normal ? normal_index[i] : 0;
+			const uint16_t t_idx = has_texcoord ? texcoord_index[i] : 0;
+			const uint64_t key = uint64_t(p_idx) | (uint64_t(n_idx) << 16) | (uint64_t(t_idx) << 32);
+
+			if (hash::has(unique, key))
+			{
+				array::push_back(indices, hash::get(unique, key, uint16_t(0)));
+				continue;
+			}
+
+			CE_ASSERT(array::size(vertices) < 65536, "Too many vertices");
+
+			MeshVertex v;
+			v.position = Vector3(position_array[p_idx * 3], position_array[p_idx * 3 + 1], position_array[p_idx * 3 + 2]);
+			v.normal = has_normal ? Vector3(normal_array[n_idx * 3], normal_array[n_idx * 3 + 1], normal_array[n_idx * 3 + 2]) : Vector3(0, 0, 0);
+			v.texcoord = has_texcoord ? Vector2(texcoord_array[t_idx * 2], texcoord_array[t_idx * 2 + 1]) : Vector2(0, 0);
+
+			const uint16_t new_idx = (uint16_t) array::size(vertices);
+			hash::set(unique, key, new_idx);
+			array::push_back(vertices, v);
+			array::push_back(indices, new_idx);
+			aabb::add_points(aabb, 1, &v.position);
+		}
+
+		MeshHeader header;
+		memset(&header, 0, sizeof(header));
+		header.version = MESH_VERSION;
+		header.num_meshes = 1;
+		header.num_joints = 0;
+		header.aabb = aabb;
+
+		MeshData data;
+		data.vertices.num_vertices = array::size(vertices);
+		data.vertices.offset = sizeof(MeshHeader) + sizeof(MeshData);
+		data.indices.num_indices = array::size(indices);
+		data.indices.offset = data.vertices.offset + array::size(vertices) * sizeof(MeshVertex);
+
+		opts.write(header);
+		opts.write(data);
+		opts.write(vertices);
+		opts.write(indices);
 	}
 
 	void* load(File& file, Allocator& a)
@@ -203,12 +141,30 @@ namespace mesh_resource
 		return res;
 	}
 
-	void online(StringId64 /*id*/, ResourceManager& /*rm*/)
+	void online(StringId64 id, ResourceManager& rm)
 	{
+		MeshResource* mr = (MeshResource*) rm.get(MESH_TYPE, id);
+		MeshHeader* h = (MeshHeader*) mr;
+
+		bgfx::VertexDecl decl;
+		decl.begin()
+			.add(bgfx::Attrib::Position, 3, bgfx::AttribType::Float)
+			.add(bgfx::Attrib::Normal, 3, bgfx::AttribType::Float)
+			.add(bgfx::Attrib::TexCoord0, 2, bgfx::AttribType::Float)
+			.end();
+
+		const bgfx::Memory* vbmem = bgfx::copy(mr->vertices(), mr->num_vertices() * sizeof(MeshVertex));
+		const bgfx::Memory* ibmem = bgfx::copy(mr->indices(), mr->num_indices() * sizeof(uint16_t));
+		h->vbuffer = bgfx::createVertexBuffer(vbmem, decl).idx;
+		h->ibuffer = bgfx::createIndexBuffer(ibmem).idx;
 	}
 
-	void offline(StringId64 /*id*/, ResourceManager& /*rm*/)
+	void offline(StringId64 id, ResourceManager& rm)
 	{
+		MeshResource* mr = (MeshResource*) rm.get(MESH_TYPE, id);
+
+		bgfx::destroyVertexBuffer(mr->vertex_buffer());
+		bgfx::destroyIndexBuffer(mr->index_buffer());
 	}
 
 	void unload(Allocator& a, void* res)
@@ -31,21 +31,24 @@ OTHER DEALINGS IN THE SOFTWARE.
 #include "allocator.h"
 #include "bundle.h"
 #include "file.h"
+#include "math_types.h"
+#include <bgfx.h>
 
 namespace crown
 {
 
 // Bump the version whenever a change in the format is made.
-const uint32_t MESH_VERSION = 1;
+const uint32_t MESH_VERSION = 2;
 
 struct MeshHeader
 {
-	uint32_t			vbuffer;
-	uint32_t			ibuffer;
+	uint32_t			vbuffer; // Runtime only
+	uint32_t			ibuffer; // Runtime only
 	uint32_t			version;
 	uint32_t			num_meshes;
 	uint32_t			num_joints;
-	uint32_t			padding[16];
+	AABB				aabb;
+	uint32_t			padding[10];
 };
 
 struct VertexData
@@ -67,30 +70,57 @@ struct MeshData
 	IndexData			indices;
 };
 
+/// Vertices are stored as position (3 floats), normal (3 floats) and texcoord (2 floats).
 struct MeshResource
 {
+	const MeshHeader* header() const
+	{
+		return (const MeshHeader*) this;
+	}
+
+	const MeshData* data() const
+	{
+		return (const MeshData*) (((const char*) this) + sizeof(MeshHeader));
+	}
+
 	uint32_t num_vertices() const
 	{
-		MeshData* data = (MeshData*) ((char*) this) + sizeof(MeshHeader);
-		return data->vertices.num_vertices;
+		return data()->vertices.num_vertices;
 	}
 
 	float* vertices() const
 	{
-		MeshData* data = (MeshData*) ((char*) this) + sizeof(MeshHeader);
-		return (float*) (((char*)this) + data->vertices.offset);
+		return (float*) (((char*) this) + data()->vertices.offset);
 	}
 
 	uint32_t num_indices() const
 	{
-		MeshData* data = (MeshData*) ((char*) this) + sizeof(MeshHeader);
-		return data->indices.num_indices;
+		return data()->indices.num_indices;
 	}
 
 	uint16_t* indices() const
 	{
-		MeshData* data = (MeshData*) ((char*) this) + sizeof(MeshHeader);
-		return (uint16_t*) (((char*)this) + data->indices.offset);
+		return (uint16_t*) (((char*) this) + data()->indices.offset);
+	}
+
+	/// Returns the local bounds of the mesh.
+	const AABB& aabb() const
+	{
+		return header()->aabb;
+	}
+
+	bgfx::VertexBufferHandle vertex_buffer() const
+	{
+		bgfx::VertexBufferHandle vb;
+		vb.idx = (uint16_t) header()->vbuffer;
+		return vb;
+	}
+
+	bgfx::IndexBufferHandle index_buffer() const
+	{
+		bgfx::IndexBufferHandle ib;
+		ib.idx = (uint16_t) header()->ibuffer;
+		return ib;
 	}
 
 private:
@@ -103,8 +133,8 @@ namespace mesh_resource
 {
 	void compile(const char* path, CompileOptions& opts);
 	void* load(File& file, Allocator& a);
-	void online(StringId64 /*id*/, ResourceManager& /*rm*/);
-	void offline(StringId64 /*id*/, ResourceManager& /*rm*/);
+	void online(StringId64 id, ResourceManager& rm);
+	void offline(StringId64 id, ResourceManager& rm);
 	void unload(Allocator& a, void* res);
 }
 } // namespace crown
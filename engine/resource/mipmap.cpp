@@ -0,0 +1,256 @@
+/*
+Copyright (c) 2013 Daniele Bartolini, Michele Rossi
+Copyright (c) 2012 Daniele Bartolini, Simone Boscaratto
+
+Permission is hereby granted, free of charge, to any person
+obtaining a copy of this software and associated documentation
+files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use,
+copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following
+conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "mipmap.h"
+#include "math_utils.h"
+#include "memory.h"
+#include "parallel_for.h"
+#include <math.h>
+
+namespace crown
+{
+namespace mipmap
+{
+	static const uint32_t MAX_TAPS = 8;
+
+	/// Weights of the source pixels which contribute to a destination pixel.
+	/// Destination pixel i reads source pixels [2 * i + first, 2 * i + first + num).
+	struct Kernel
+	{
+		int32_t first;
+		uint32_t num;
+		float weights[MAX_TAPS];
+	};
+
+	static float s_to_linear[256];
+	static bool s_tables_ready = false;
+
+	static void init_tables()
+	{
+		if (s_tables_ready)
+			return;
+
+		for (uint32_t i = 0; i < 256; i++)
+		{
+			const float c = i / 255.0f;
+			s_to_linear[i] = c <= 0.04045f ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+		}
+
+		s_tables_ready = true;
+	}
+
+	static uint8_t to_uint8(float c)
+	{
+		return (uint8_t) math::clamp(0.0f, 255.0f, c * 255.0f + 0.5f);
+	}
+
+	static float to_srgb(float c)
+	{
+		c = math::clamp(0.0f, 1.0f, c);
+		return c <= 0.0031308f ? c * 12.92f : 1.055f * powf(c, 1.0f / 2.4f) - 0.055f;
+	}
+
+	// Zeroth order modified Bessel function of the first kind
+	static float bessel_i0(float x)
+	{
+		float sum = 1.0f;
+		float term = 1.0f;
+		for (uint32_t k = 1; k < 16; k++)
+		{
+			term *= (x / (2.0f * k)) * (x / (2.0f * k));
+			sum += term;
+		}
+		return sum;
+	}
+
+	static float sinc(float x)
+	{
+		if (math::abs(x) < 0.0001f)
+			return 1.0f;
+		return math::sin(math::PI * x) / (math::PI * x);
+	}
+
+	static void make_kernel(Filter::Enum filter, uint32_t src_size, Kernel& k)
+	{
+		// A single row or column is copied as is
+		if (src_size == 1)
+		{
+			k.first = 0;
+			k.num = 1;
+			k.weights[0] = 1.0f;
+			return;
+		}
+
+		if (filter == Filter::BOX)
+		{
+			k.first = 0;
+			k.num = 2;
+			k.weights[0] = 0.5f;
+			k.weights[1] = 0.5f;
+			return;
+		}
+
+		// Kaiser-windowed sinc, 2 destination pixels wide on each side
+		const float alpha = 4.0f;
+		const float width = 2.0f;
+
+		k.first = -3;
+		k.num = MAX_TAPS;
+
+		float total = 0.0f;
+		for (uint32_t i = 0; i < k.num; i++)
+		{
+			// Distance between the source pixel center and the destination
+			// pixel center, in destination pixels
+			const float t = (k.first + int32_t(i) - 0.5f) * 0.5f;
+			const float r = t / width;
+			const float window = math::abs(r) < 1.0f ? bessel_i0(alpha * math::sqrt(1.0f - r * r)) / bessel_i0(alpha) : 0.0f;
+			k.weights[i] = sinc(t) * window;
+			total += k.weights[i];
+		}
+
+		for (uint32_t i = 0; i < k.num; i++)
+		{
+			k.weights[i] /= total;
+		}
+	}
+
+	struct DownsampleJob
+	{
+		const uint8_t* src;
+		uint32_t src_width;
+		uint32_t src_height;
+		uint32_t dst_width;
+		uint32_t dst_height;
+		bool srgb;
+		Kernel kx;
+		Kernel ky;
+		float* tmp; // dst_width x src_height, linear RGBA
+		uint8_t* dst;
+	};
+
+	static int32_t clamp_index(int32_t i, uint32_t size)
+	{
+		return math::clamp(int32_t(0), int32_t(size) - 1, i);
+	}
+
+	// Filters the source rows [begin, end) horizontally into tmp
+	static void filter_rows(uint32_t begin, uint32_t end, void* data)
+	{
+		const DownsampleJob& job = *(DownsampleJob*) data;
+
+		for (uint32_t y = begin; y < end; y++)
+		{
+			const uint8_t* src_row = job.src + y * job.src_width * 4;
+			float* tmp_row = job.tmp + y * job.dst_width * 4;
+
+			for (uint32_t x = 0; x < job.dst_width; x++)
+			{
+				float acc[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+
+				for (uint32_t i = 0; i < job.kx.num; i++)
+				{
+					const int32_t sx = clamp_index(int32_t(x * 2) + job.kx.first + int32_t(i), job.src_width);
+					const uint8_t* p = src_row + sx * 4;
+					const float w = job.kx.weights[i];
+
+					for (uint32_t c = 0; c < 3; c++)
+						acc[c] += w * (job.srgb ? s_to_linear[p[c]] : p[c] / 255.0f);
+					acc[3] += w * (p[3] / 255.0f);
+				}
+
+				for (uint32_t c = 0; c < 4; c++)
+					tmp_row[x * 4 + c] = acc[c];
+			}
+		}
+	}
+
+	// Filters tmp vertically into the destination rows [begin, end)
+	static void filter_columns(uint32_t begin, uint32_t end, void* data)
+	{
+		const DownsampleJob& job = *(DownsampleJob*) data;
+
+		for (uint32_t y = begin; y < end; y++)
+		{
+			uint8_t* dst_row = job.dst + y * job.dst_width * 4;
+
+			for (uint32_t x = 0; x < job.dst_width; x++)
+			{
+				float acc[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+
+				for (uint32_t i = 0; i < job.ky.num; i++)
+				{
+					const int32_t sy = clamp_index(int32_t(y * 2) + job.ky.first + int32_t(i), job.src_height);
+					const float* p = job.tmp + (sy * job.dst_width + x) * 4;
+					const float w = job.ky.weights[i];
+
+					for (uint32_t c = 0; c < 4; c++)
+						acc[c] += w * p[c];
+				}
+
+				for (uint32_t c = 0; c < 3; c++)
+					dst_row[x * 4 + c] = to_uint8(job.srgb ? to_srgb(acc[c]) : acc[c]);
+				dst_row[x * 4 + 3] = to_uint8(acc[3]);
+			}
+		}
+	}
+
+	uint32_t num_levels(uint32_t width, uint32_t height)
+	{
+		uint32_t levels = 1;
+		while (width > 1 || height > 1)
+		{
+			width = math::max(1u, width >> 1);
+			height = math::max(1u, height >> 1);
+			levels++;
+		}
+		return levels;
+	}
+
+	void downsample(const uint8_t* src, uint32_t width, uint32_t height, Filter::Enum filter, bool srgb, uint8_t* dst)
+	{
+		init_tables();
+
+		DownsampleJob job;
+		job.src = src;
+		job.src_width = width;
+		job.src_height = height;
+		job.dst_width = math::max(1u, width >> 1);
+		job.dst_height = math::max(1u, height >> 1);
+		job.srgb = srgb;
+		make_kernel(filter, width, job.kx);
+		make_kernel(filter, height, job.ky);
+		job.tmp = (float*) default_allocator().allocate(job.dst_width * height * 4 * sizeof(float));
+		job.dst = dst;
+
+		parallel_for(height, filter_rows, &job);
+		parallel_for(job.dst_height, filter_columns, &job);
+
+		default_allocator().deallocate(job.tmp);
+	}
+} // namespace mipmap
+} // namespace crown
@@ -24,63 +24,35 @@ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
 OTHER DEALINGS IN THE SOFTWARE.
 */
 
-#include "sprite_animation.h"
-#include "log.h"
 
-namespace crown
-{
-
-SpriteAnimation::SpriteAnimation(const SpriteAnimationResource* sar)
-	: m_resource(sar)
-	, m_animation(NULL)
-	, m_frames(sprite_animation_resource::get_animation_frames(sar))
-	, m_cur_time(0)
-	, m_cur_frame(0)
-	, m_loop(false)
-{
-}
-
-void SpriteAnimation::play(StringId32 name, bool loop)
-{
-	if (m_animation)
-		return;
+#pragma once
 
-	m_animation = sprite_animation_resource::get_animation(m_resource, name);
-	m_cur_time = 0;
-	m_cur_frame = 0;
-	m_loop = loop;
-}
+#include "types.h"
 
-void SpriteAnimation::stop()
+namespace crown
 {
-	m_animation = NULL;
-	m_cur_time = 0;
-	m_cur_frame = 0;
-}
 
-void SpriteAnimation::update(float dt)
+/// Functions to generate mip chains of RGBA8 images.
+///
+/// @ingroup Resource
+namespace mipmap
 {
-	if (!m_animation)
-		return;
-
-	const uint32_t frame = m_animation->first_frame + uint32_t(m_animation->num_frames * (m_cur_time / m_animation->time));
-
-	m_cur_frame = m_frames[frame];
-	m_cur_time += dt;
-
-	if (m_cur_time >= m_animation->time)
+	struct Filter
 	{
-		if (m_loop)
-		{
-			m_cur_time = 0;
-			return;
-		}
-		else
+		enum Enum
 		{
-			stop();
-			return;
-		}
-	}
-}
-
+			BOX,
+			KAISER,
+			COUNT
+		};
+	};
+
+	/// Returns the number of levels of the full mip chain of a @a width x @a height image.
+	uint32_t num_levels(uint32_t width, uint32_t height);
+
+	/// Downsamples the RGBA8 image @a src of size @a width x @a height into @a dst,
+	/// which must hold max(1, width / 2) x max(1, height / 2) pixels.
+	/// If @a srgb is true the color channels are filtered in linear space.
+	void downsample(const uint8_t* src, uint32_t width, uint32_t height, Filter::Enum filter, bool srgb, uint8_t* dst);
+} // namespace mipmap
 } // namespace crown
@@ -37,7 +37,7 @@ namespace package_resource
 {
 	void compile(const char* path, CompileOptions& opts)
 	{
-		static const uint32_t VERSION = 1;
+		static const uint32_t VERSION = 2;
 
 		Buffer buf = opts.read(path);
 		JSONParser json(array::begin(buf));
@@ -56,6 +56,8 @@ namespace package_resource
 		JSONElement phyconf  = root.key_or_nil("physics_config");
 		JSONElement shader   = root.key_or_nil("shader");
 		JSONElement sprite_animation = root.key_or_nil("sprite_animation");
+		JSONElement skeleton = root.key_or_nil("skeleton");
+		JSONElement animation = root.key_or_nil("animation");
 
 		const uint32_t num_textures  = texture.is_nil() ? 0 : texture.size();
 		const uint32_t num_scripts   = script.is_nil() ? 0 : script.size();
@@ -70,6 +72,8 @@ namespace package_resource
 		const uint32_t num_phyconfs  = phyconf.is_nil() ? 0 : phyconf.size();
 		const uint32_t num_shaders   = shader.is_nil() ? 0 : shader.size();
 		const uint32_t num_sprite_animations = sprite_animation.is_nil() ? 0 : sprite_animation.size();
+		const uint32_t num_skeletons = skeleton.is_nil() ? 0 : skeleton.size();
+		const uint32_t num_animations = animation.is_nil() ? 0 : animation.size();
 
 		// Write header
 		opts.write(VERSION);
@@ -125,6 +129,14 @@ namespace package_resource
 		offt += sizeof(StringId64) * num_shaders;
 		opts.write(offt);
 
+		opts.write(num_skeletons);
+		offt += sizeof(StringId64) * num_sprite_animations;
+		opts.write(offt);
+
+		opts.write(num_animations);
+		offt += sizeof(StringId64) * num_skeletons;
+		opts.write(offt);
+
 		// Write resource ids
 		for (uint32_t i = 0; i < num_textures; i++)
 			opts.write(texture[i].to_resource_id("texture").name);
@@ -164,6 +176,12 @@ namespace package_resource
 
 		for (uint32_t i = 0; i < num_sprite_animations; i++)
 			opts.write(sprite_animation[i].to_resource_id("sprite_animation").name);
+
+		for (uint32_t i = 0; i < num_skeletons; i++)
+			opts.write(skeleton[i].to_resource_id("skeleton").name);
+
+		for (uint32_t i = 0; i < num_animations; i++)
+			opts.write(animation[i].to_resource_id("animation").name);
 	}
 
 	void* load(File& file, Allocator& a)
@@ -252,6 +270,16 @@ namespace package_resource
 		return pr->num_sprite_animations;
 	}
 
+	uint32_t num_skeletons(const PackageResource* pr)
+	{
+		return pr->num_skeletons;
+	}
+
+	uint32_t num_animations(const PackageResource* pr)
+	{
+		return pr->num_animations;
+	}
+
 	StringId64 get_texture_id(const PackageResource* pr, uint32_t i)
 	{
 		CE_ASSERT(i < num_textures(pr), "Index out of bounds");
@@ -342,5 +370,19 @@ namespace package_resource
 		StringId64* begin = (StringId64*) ((char*)pr + pr->sprite_animations_offset);
 		return begin[i];
 	}
+
+	StringId64 get_skeleton_id(const PackageResource* pr, uint32_t i)
+	{
+		CE_ASSERT(i < num_skeletons(pr), "Index out of bounds");
+		StringId64* begin = (StringId64*) ((char*)pr + pr->skeletons_offset);
+		return begin[i];
+	}
+
+	StringId64 get_animation_id(const PackageResource* pr, uint32_t i)
+	{
+		CE_ASSERT(i < num_animations(pr), "Index out of bounds");
+		StringId64* begin = (StringId64*) ((char*)pr + pr->animations_offset);
+		return begin[i];
+	}
 } // namespace package_resource
 } // namespace crown
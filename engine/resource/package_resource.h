@@ -64,6 +64,10 @@ struct PackageResource
 	uint32_t shaders_offset;
 	uint32_t num_sprite_animations;
 	uint32_t sprite_animations_offset;
+	uint32_t num_skeletons;
+	uint32_t skeletons_offset;
+	uint32_t num_animations;
+	uint32_t animations_offset;
 };
 
 namespace package_resource
@@ -87,6 +91,8 @@ namespace package_resource
 	uint32_t num_physics_configs(const PackageResource* pr);
 	uint32_t num_shaders(const PackageResource* pr);
 	uint32_t num_sprite_animations(const PackageResource* pr);
+	uint32_t num_skeletons(const PackageResource* pr);
+	uint32_t num_animations(const PackageResource* pr);
 	StringId64 get_texture_id(const PackageResource* pr, uint32_t i);
 	StringId64 get_script_id(const PackageResource* pr, uint32_t i);
 	StringId64 get_sound_id(const PackageResource* pr, uint32_t i);
@@ -100,5 +106,7 @@ namespace package_resource
 	StringId64 get_physics_config_id(const PackageResource* pr, uint32_t i);
 	StringId64 get_shader_id(const PackageResource* pr, uint32_t i);
 	StringId64 get_sprite_animation_id(const PackageResource* pr, uint32_t i);
+	StringId64 get_skeleton_id(const PackageResource* pr, uint32_t i);
+	StringId64 get_animation_id(const PackageResource* pr, uint32_t i);
 } // namespace package_resource
 } // namespace crown
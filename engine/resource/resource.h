@@ -35,6 +35,7 @@ namespace crown
 {
 
 /// Hashed values for supported resource types
+#define ANIMATION_EXTENSION			"animation"
 #define CONFIG_EXTENSION			"config"
 #define FONT_EXTENSION				"font"
 #define LEVEL_EXTENSION				"level"
@@ -45,12 +46,14 @@ namespace crown
 #define PHYSICS_CONFIG_EXTENSION	"physics_config"
 #define PHYSICS_EXTENSION			"physics"
 #define SHADER_EXTENSION			"shader"
+#define SKELETON_EXTENSION			"skeleton"
 #define SOUND_EXTENSION				"sound"
 #define SPRITE_ANIMATION_EXTENSION	"sprite_animation"
 #define SPRITE_EXTENSION			"sprite"
 #define TEXTURE_EXTENSION			"texture"
 #define UNIT_EXTENSION				"unit"
 
+#define ANIMATION_TYPE				uint64_t(0x931e336d7646cc26)
 #define CONFIG_TYPE					uint64_t(0x82645835e6b73232)
 #define FONT_TYPE					uint64_t(0x9efe0a916aae7880)
 #define LEVEL_TYPE					uint64_t(0x2a690fd348fe9ac5)
@@ -61,6 +64,7 @@ namespace crown
 #define PHYSICS_CONFIG_TYPE			uint64_t(0x72e3cc03787a11a1)
 #define PHYSICS_TYPE				uint64_t(0x5f7203c8f280dab8)
 #define SHADER_TYPE					uint64_t(0xcce8d5b5f5ae333f)
+#define SKELETON_TYPE				uint64_t(0x975cebbda510e575)
 #define SOUND_TYPE					uint64_t(0x90641b51c98b7aac)
 #define SPRITE_ANIMATION_TYPE		uint64_t(0x487e78e3f87f238d)
 #define SPRITE_TYPE					uint64_t(0x8d5871f9ebdb651c)
@@ -30,14 +30,16 @@ OTHER DEALINGS IN THE SOFTWARE.
 #include "log.h"
 #include "queue.h"
 #include "bundle.h"
+#include "texture_streamer.h"
 
 namespace crown
 {
 
-ResourceLoader::ResourceLoader(Bundle& bundle, Allocator& resource_heap)
+ResourceLoader::ResourceLoader(Bundle& bundle, Allocator& resource_heap, TextureStreamer& streamer)
 	: m_thread()
 	, m_bundle(bundle)
 	, m_resource_heap(resource_heap)
+	, m_texture_streamer(streamer)
 	, m_requests(default_allocator())
 	, m_loaded(default_allocator())
 	, m_exit(false)
@@ -97,6 +99,7 @@ int32_t ResourceLoader::run()
 		if (queue::empty(m_requests))
 		{
 			m_mutex.unlock();
+			m_texture_streamer.process();
 			continue;
 		}
 		ResourceId id = queue::front(m_requests);
@@ -37,6 +37,7 @@ namespace crown
 
 class Bundle;
 class Allocator;
+class TextureStreamer;
 
 struct ResourceData
 {
@@ -53,7 +54,8 @@ public:
 
 	/// Reads the resources data from the given @a bundle using
 	/// @a resource_heap to allocate memory for them.
-	ResourceLoader(Bundle& bundle, Allocator& resource_heap);
+	/// The mips requested by @a streamer are read when no resource is waiting to be loaded.
+	ResourceLoader(Bundle& bundle, Allocator& resource_heap, TextureStreamer& streamer);
 	~ResourceLoader();
 
 	/// Loads the @a resource in a background thread.
@@ -84,6 +86,7 @@ private:
 	Thread m_thread;
 	Bundle& m_bundle;
 	Allocator& m_resource_heap;
+	TextureStreamer& m_texture_streamer;
 
 	Queue<ResourceId> m_requests;
 	Queue<ResourceData> m_loaded;
@@ -28,6 +28,7 @@ OTHER DEALINGS IN THE SOFTWARE.
 #include <inttypes.h>
 #include "types.h"
 #include "resource_manager.h"
+#include "config.h"
 #include "resource_registry.h"
 #include "string_utils.h"
 #include "string_utils.h"
@@ -43,11 +44,21 @@ ResourceId::ResourceId(const char* type, const char* name)
 	: type(string::murmur2_64(type, string::strlen(type), 0))
 	, name(string::murmur2_64(name, string::strlen(name), 0))
 {
+	string_id_table::add(StringId64(this->type), type);
+	string_id_table::add(StringId64(this->name), name);
+}
+
+/// Returns the name of the string id @a id if known, "?" otherwise.
+static const char* id_name(StringId64 id)
+{
+	const char* s = string_id_table::lookup(id);
+	return s != NULL ? s : "?";
 }
 
 ResourceManager::ResourceManager(Bundle& bundle)
 	: m_resource_heap("resource", default_allocator())
-	, m_loader(bundle, m_resource_heap)
+	, m_texture_streamer(bundle, m_texture_backend, CE_TEXTURE_MEMORY_BUDGET)
+	, m_loader(bundle, m_resource_heap, m_texture_streamer)
 	, m_resources(default_allocator())
 {
 }
@@ -94,10 +105,16 @@ void ResourceManager::unload(StringId64 type, StringId64 name)
 
 void ResourceManager::unload(ResourceId id)
 {
-	CE_ASSERT(find(id) != NULL, "Resource not loaded: ""%.16"PRIx64"-%.16"PRIx64, id.type, id.name);
-
-	flush();
 	ResourceEntry* entry = find(id);
+
+	// Only wait for the loader if the resource is still being loaded
+	if (entry == NULL)
+	{
+		flush();
+		entry = find(id);
+	}
+
+	CE_ASSERT(entry != NULL, "Resource not loaded: ""%.16"PRIx64"-%.16"PRIx64" (%s.%s)", id.type, id.name, id_name(id.name), id_name(id.type));
 	entry->references--;
 
 	if (entry->references == 0)
@@ -139,13 +156,13 @@ const void* ResourceManager::get(StringId64 type, StringId64 name)
 
 const void* ResourceManager::get(ResourceId id) const
 {
-	CE_ASSERT(find(id) != NULL, "Resource not loaded: ""%.16"PRIx64"-%.16"PRIx64, id.type, id.name);
+	CE_ASSERT(find(id) != NULL, "Resource not loaded: ""%.16"PRIx64"-%.16"PRIx64" (%s.%s)", id.type, id.name, id_name(id.name), id_name(id.type));
 	return find(id)->resource;
 }
 
 uint32_t ResourceManager::references(ResourceId id) const
 {
-	CE_ASSERT(find(id) != NULL, "Resource not loaded: ""%.16"PRIx64"-%.16"PRIx64, id.type, id.name);
+	CE_ASSERT(find(id) != NULL, "Resource not loaded: ""%.16"PRIx64"-%.16"PRIx64" (%s.%s)", id.type, id.name, id_name(id.name), id_name(id.type));
 	return find(id)->references;
 }
 
@@ -155,6 +172,11 @@ void ResourceManager::flush()
 	complete_requests();
 }
 
+TextureStreamer* ResourceManager::texture_streamer()
+{
+	return &m_texture_streamer;
+}
+
 ResourceEntry* ResourceManager::find(ResourceId id) const
 {
 	const ResourceEntry* entry = std::find(array::begin(m_resources), array::end(m_resources), id);
@@ -31,6 +31,7 @@ OTHER DEALINGS IN THE SOFTWARE.
 #include "resource.h"
 #include "proxy_allocator.h"
 #include "resource_loader.h"
+#include "texture_streamer.h"
 
 namespace crown
 {
@@ -64,6 +65,7 @@ public:
 	void load(StringId64 type, StringId64 name);
 
 	/// Unloads the resource @a type @a name.
+	/// If the resource is still being loaded, waits for it first.
 	void unload(StringId64 type, StringId64 name);
 
 	/// Returns whether the manager has the given resource. 
@@ -87,6 +89,9 @@ public:
 	/// Completes all load() requests which have been loaded by ResourceLoader.
 	void complete_requests();
 
+	/// Returns the texture streamer.
+	TextureStreamer* texture_streamer();
+
 private:
 
 	void load(ResourceId id);
@@ -100,6 +105,8 @@ private:
 private:
 
 	ProxyAllocator m_resource_heap;
+	BgfxTextureStreamerBackend m_texture_backend;
+	TextureStreamer m_texture_streamer;
 	ResourceLoader m_loader;
 	Array<ResourceEntry> m_resources;
 };
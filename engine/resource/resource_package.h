@@ -42,11 +42,12 @@ struct ResourcePackage
 		: _resman(&resman)
 		, _id(id)
 		, _package(NULL)
+		, _num_loaded(0)
+		, _loading(false)
 		, _has_loaded(false)
 	{
+		// The list of resources is loaded asynchronously like any other resource
 		resman.load(PACKAGE_TYPE, _id);
-		resman.flush();
-		_package = (const PackageResource*) resman.get(PACKAGE_TYPE, _id);
 	}
 
 	~ResourcePackage()
@@ -59,9 +60,116 @@ struct ResourcePackage
 	/// The resources are not immediately available after the call is made,
 	/// instead, you have to poll for completion with has_loaded()
 	void load()
+	{
+		_loading = true;
+
+		if (_package == NULL && _resman->can_get(PACKAGE_TYPE, _id))
+			load_resources();
+	}
+
+	/// Unloads all the resources in the package.
+	void unload()
+	{
+		// Nothing to unload if the resources have not been requested yet
+		if (_package != NULL)
+			unload_resources();
+
+		_package = NULL;
+		_num_loaded = 0;
+		_loading = false;
+		_has_loaded = false;
+	}
+
+	/// Waits until the package has been loaded.
+	void flush()
+	{
+		_resman->flush();
+
+		if (_loading && _package == NULL)
+		{
+			load_resources();
+			_resman->flush();
+		}
+
+		_has_loaded = true;
+	}
+
+	/// Returns whether the package has been loaded.
+	/// Polling it starts loading the resources of the package as soon as its
+	/// list of resources is available.
+	/// @note
+	/// Only the resources of the package are waited for, requests of
+	/// other packages still loading do not delay it.
+	bool has_loaded()
+	{
+		if (_has_loaded)
+			return true;
+
+		if (!_loading)
+			return false;
+
+		if (_package == NULL)
+		{
+			if (!_resman->can_get(PACKAGE_TYPE, _id))
+				return false;
+
+			load_resources();
+		}
+
+		_has_loaded = resources_loaded();
+		return _has_loaded;
+	}
+
+private:
+
+	typedef StringId64 (*GetResourceId)(const PackageResource* pr, uint32_t i);
+
+	/// Returns whether all the resources of the package can be got.
+	/// The resources are checked in the order they are requested, resuming
+	/// from the first one which could not be got the last time.
+	bool resources_loaded()
+	{
+		using namespace package_resource;
+
+		uint32_t base = 0;
+		return resources_loaded(TEXTURE_TYPE, num_textures(_package), get_texture_id, base)
+			&& resources_loaded(LUA_TYPE, num_scripts(_package), get_script_id, base)
+			&& resources_loaded(SOUND_TYPE, num_sounds(_package), get_sound_id, base)
+			&& resources_loaded(MESH_TYPE, num_meshes(_package), get_mesh_id, base)
+			&& resources_loaded(UNIT_TYPE, num_units(_package), get_unit_id, base)
+			&& resources_loaded(SPRITE_TYPE, num_sprites(_package), get_sprite_id, base)
+			&& resources_loaded(PHYSICS_TYPE, num_physics(_package), get_physics_id, base)
+			&& resources_loaded(MATERIAL_TYPE, num_materials(_package), get_material_id, base)
+			&& resources_loaded(FONT_TYPE, num_fonts(_package), get_font_id, base)
+			&& resources_loaded(LEVEL_TYPE, num_levels(_package), get_level_id, base)
+			&& resources_loaded(PHYSICS_CONFIG_TYPE, num_physics_configs(_package), get_physics_config_id, base)
+			&& resources_loaded(SHADER_TYPE, num_shaders(_package), get_shader_id, base)
+			&& resources_loaded(SPRITE_ANIMATION_TYPE, num_sprite_animations(_package), get_sprite_animation_id, base)
+			&& resources_loaded(SKELETON_TYPE, num_skeletons(_package), get_skeleton_id, base)
+			&& resources_loaded(ANIMATION_TYPE, num_animations(_package), get_animation_id, base);
+	}
+
+	/// Checks the @a num resources of @a type, which come after the @a base
+	/// resources of the other types, and advances @a base past them.
+	bool resources_loaded(StringId64 type, uint32_t num, GetResourceId get_id, uint32_t& base)
+	{
+		for (; _num_loaded < base + num; _num_loaded++)
+		{
+			if (!_resman->can_get(type, get_id(_package, _num_loaded - base)))
+				return false;
+		}
+
+		base += num;
+		return true;
+	}
+
+	/// Requests all the resources listed by the package resource.
+	void load_resources()
 	{
 		using namespace package_resource;
 
+		_package = (const PackageResource*) _resman->get(PACKAGE_TYPE, _id);
+
 		for (uint32_t i = 0; i < num_textures(_package); i++)
 		{
 			_resman->load(TEXTURE_TYPE, get_texture_id(_package, i));
@@ -126,13 +234,32 @@ struct ResourcePackage
 		{
 			_resman->load(SPRITE_ANIMATION_TYPE, get_sprite_animation_id(_package, i));
 		}
+
+		for (uint32_t i = 0; i < num_skeletons(_package); i++)
+		{
+			_resman->load(SKELETON_TYPE, get_skeleton_id(_package, i));
+		}
+
+		for (uint32_t i = 0; i < num_animations(_package); i++)
+		{
+			_resman->load(ANIMATION_TYPE, get_animation_id(_package, i));
+		}
 	}
 
-	/// Unloads all the resources in the package.
-	void unload()
+	void unload_resources()
 	{
 		using namespace package_resource;
-		
+
+		for (uint32_t i = 0; i < num_animations(_package); i++)
+		{
+			_resman->unload(ANIMATION_TYPE, get_animation_id(_package, i));
+		}
+
+		for (uint32_t i = 0; i < num_skeletons(_package); i++)
+		{
+			_resman->unload(SKELETON_TYPE, get_skeleton_id(_package, i));
+		}
+
 		for (uint32_t i = 0; i < num_sprite_animations(_package); i++)
 		{
 			_resman->unload(SPRITE_ANIMATION_TYPE, get_sprite_animation_id(_package, i));
@@ -199,24 +326,13 @@ struct ResourcePackage
 		}
 	}
 
-	/// Waits until the package has been loaded.
-	void flush()
-	{
-		_resman->flush();
-		_has_loaded = true;
-	}
-
-	/// Returns whether the package has been loaded.
-	bool has_loaded() const
-	{
-		return _has_loaded;
-	}
-
 private:
 
 	ResourceManager* _resman;
 	StringId64 _id;
 	const PackageResource* _package;
+	uint32_t _num_loaded;	// Resources of the package known to be loaded
+	bool _loading;
 	bool _has_loaded;
 };
 
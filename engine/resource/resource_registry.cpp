@@ -37,6 +37,8 @@ OTHER DEALINGS IN THE SOFTWARE.
 #include "font_resource.h"
 #include "level_resource.h"
 #include "shader.h"
+#include "skeleton_resource.h"
+#include "animation_resource.h"
 
 namespace crown
 {
@@ -55,6 +57,8 @@ namespace lvr = level_resource;
 namespace spr = sprite_resource;
 namespace shr = shader_resource;
 namespace sar = sprite_animation_resource;
+namespace skr = skeleton_resource;
+namespace anr = animation_resource;
 
 typedef void  (*ResourceCompileCallback)(const char* path, CompileOptions& opts);
 typedef void* (*ResourceLoadCallback)(File& file, Allocator& a);
@@ -88,6 +92,8 @@ static const ResourceCallback RESOURCE_CALLBACK_REGISTRY[] =
 	{ LEVEL_TYPE,            lvr::compile, lvr::load, lvr::unload, lvr::online, lvr::offline },
 	{ SHADER_TYPE,           shr::compile, shr::load, shr::unload, shr::online, shr::offline },
 	{ SPRITE_ANIMATION_TYPE, sar::compile, sar::load, sar::unload, sar::online, sar::offline },
+	{ SKELETON_TYPE,         skr::compile, skr::load, skr::unload, skr::online, skr::offline },
+	{ ANIMATION_TYPE,        anr::compile, anr::load, anr::unload, anr::online, anr::offline },
 	{ 0,                     NULL,         NULL,      NULL,        NULL,        NULL         }
 };
 
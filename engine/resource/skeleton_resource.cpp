@@ -0,0 +1,224 @@
+/*
+Copyright (c) 2013 Daniele Bartolini, Michele Rossi
+Copyright (c) 2012 Daniele Bartolini, Simone Boscaratto
+
+Permission is hereby granted, free of charge, to any person
+obtaining a copy of this software and associated documentation
+files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use,
+copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following
+conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "skeleton_resource.h"
+#include "json_parser.h"
+#include "array.h"
+#include "memory.h"
+#include "matrix4x4.h"
+#include "quaternion.h"
+#include "vector3.h"
+#include "compile_options.h"
+
+namespace crown
+{
+namespace skeleton_resource
+{
+	struct Bone
+	{
+		StringId32 name;
+		StringId32 parent_name;
+		int32_t parent;
+		BoneTransform pose;
+	};
+
+	static int32_t find_bone(const Array<Bone>& bones, StringId32 name)
+	{
+		for (uint32_t i = 0; i < array::size(bones); i++)
+		{
+			if (bones[i].name == name)
+				return i;
+		}
+
+		return -1;
+	}
+
+	void compile(const char* path, CompileOptions& opts)
+	{
+		static const uint32_t VERSION = 1;
+
+		Buffer buf = opts.read(path);
+		JSONParser json(array::begin(buf));
+		JSONElement root = json.root();
+
+		JSONElement jbones = root.key("bones");
+		const uint32_t num = jbones.size();
+
+		Array<Bone> src(default_allocator());
+		for (uint32_t i = 0; i < num; i++)
+		{
+			JSONElement jb = jbones[i];
+
+			Bone b;
+			b.name = jb.key("name").to_string_id();
+			b.parent_name = jb.key_or_nil("parent").to_string_id();
+			b.parent = -1;
+			b.pose.position = jb.key_or_nil("position").to_vector3();
+			b.pose.rotation = jb.key_or_nil("rotation").to_quaternion();
+			b.pose.scale = jb.key_or_nil("scale").to_vector3(Vector3(1, 1, 1));
+			array::push_back(src, b);
+		}
+
+		// Sort the bones so that parents come before their children
+		Array<Bone> bones(default_allocator());
+		Array<bool> emitted(default_allocator());
+		array::resize(emitted, num);
+		for (uint32_t i = 0; i < num; i++)
+			emitted[i] = false;
+
+		while (array::size(bones) < num)
+		{
+			const uint32_t prev_size = array::size(bones);
+
+			for (uint32_t i = 0; i < num; i++)
+			{
+				if (emitted[i])
+					continue;
+
+				Bone b = src[i];
+				if (b.parent_name != 0)
+				{
+					b.parent = find_bone(bones, b.parent_name);
+					if (b.parent == -1)
+						continue;
+				}
+
+				array::push_back(bones, b);
+				emitted[i] = true;
+			}
+
+			CE_ASSERT(array::size(bones) != prev_size, "Skeleton has bones with missing parents or cycles");
+		}
+
+		// Compute the inverse bind pose
+		Array<Matrix4x4> model(default_allocator());
+		array::resize(model, num);
+		for (uint32_t i = 0; i < num; i++)
+		{
+			const BoneTransform& bt = bones[i].pose;
+			Matrix4x4 local(bt.rotation, bt.position);
+			local.x *= bt.scale.x;
+			local.y *= bt.scale.y;
+			local.z *= bt.scale.z;
+
+			model[i] = bones[i].parent == -1 ? local : model[bones[i].parent] * local;
+		}
+
+		SkeletonResource sr;
+		sr.version = VERSION;
+		sr.num_bones = num;
+		uint32_t offt = sizeof(SkeletonResource);
+		sr.names_offset = offt;     offt += sizeof(StringId32) * num;
+		sr.parents_offset = offt;   offt += sizeof(int32_t) * num;
+		sr.bind_pose_offset = offt; offt += sizeof(BoneTransform) * num;
+		sr.inv_bind_offset = offt;
+
+		opts.write(sr.version);
+		opts.write(sr.num_bones);
+		opts.write(sr.names_offset);
+		opts.write(sr.parents_offset);
+		opts.write(sr.bind_pose_offset);
+		opts.write(sr.inv_bind_offset);
+
+		for (uint32_t i = 0; i < num; i++)
+			opts.write(bones[i].name);
+
+		for (uint32_t i = 0; i < num; i++)
+			opts.write(bones[i].parent);
+
+		for (uint32_t i = 0; i < num; i++)
+		{
+			opts.write(bones[i].pose.position);
+			opts.write(bones[i].pose.rotation);
+			opts.write(bones[i].pose.scale);
+		}
+
+		for (uint32_t i = 0; i < num; i++)
+			opts.write(matrix4x4::get_inverted(model[i]));
+	}
+
+	void* load(File& file, Allocator& a)
+	{
+		const size_t file_size = file.size();
+		void* res = a.allocate(file_size);
+		file.read(res, file_size);
+		return res;
+	}
+
+	void online(StringId64 /*id*/, ResourceManager& /*rm*/)
+	{
+	}
+
+	void offline(StringId64 /*id*/, ResourceManager& /*rm*/)
+	{
+	}
+
+	void unload(Allocator& allocator, void* resource)
+	{
+		allocator.deallocate(resource);
+	}
+
+	uint32_t num_bones(const SkeletonResource* sr)
+	{
+		return sr->num_bones;
+	}
+
+	StringId32 bone_name(const SkeletonResource* sr, uint32_t i)
+	{
+		CE_ASSERT(i < num_bones(sr), "Index out of bounds");
+		const StringId32* begin = (StringId32*) ((char*)sr + sr->names_offset);
+		return begin[i];
+	}
+
+	int32_t bone_index(const SkeletonResource* sr, StringId32 name)
+	{
+		const StringId32* begin = (StringId32*) ((char*)sr + sr->names_offset);
+
+		for (uint32_t i = 0; i < num_bones(sr); i++)
+		{
+			if (begin[i] == name)
+				return i;
+		}
+
+		return -1;
+	}
+
+	const int32_t* parents(const SkeletonResource* sr)
+	{
+		return (int32_t*) ((char*)sr + sr->parents_offset);
+	}
+
+	const BoneTransform* bind_pose(const SkeletonResource* sr)
+	{
+		return (BoneTransform*) ((char*)sr + sr->bind_pose_offset);
+	}
+
+	const Matrix4x4* inverse_bind_pose(const SkeletonResource* sr)
+	{
+		return (Matrix4x4*) ((char*)sr + sr->inv_bind_offset);
+	}
+} // namespace skeleton_resource
+} // namespace crown
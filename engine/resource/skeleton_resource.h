@@ -0,0 +1,84 @@
+/*
+Copyright (c) 2013 Daniele Bartolini, Michele Rossi
+Copyright (c) 2012 Daniele Bartolini, Simone Boscaratto
+
+Permission is hereby granted, free of charge, to any person
+obtaining a copy of this software and associated documentation
+files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use,
+copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following
+conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+
+#include "types.h"
+#include "resource.h"
+#include "allocator.h"
+#include "file.h"
+#include "math_types.h"
+
+namespace crown
+{
+
+// All offsets are absolute
+struct SkeletonResource
+{
+	uint32_t version;
+	uint32_t num_bones;
+	uint32_t names_offset;		// StringId32[num_bones]
+	uint32_t parents_offset;	// int32_t[num_bones]
+	uint32_t bind_pose_offset;	// BoneTransform[num_bones]
+	uint32_t inv_bind_offset;	// Matrix4x4[num_bones]
+};
+
+/// Local transform of a bone.
+struct BoneTransform
+{
+	Vector3 position;
+	Quaternion rotation;
+	Vector3 scale;
+};
+
+namespace skeleton_resource
+{
+	void compile(const char* path, CompileOptions& opts);
+	void* load(File& file, Allocator& a);
+	void online(StringId64 /*id*/, ResourceManager& /*rm*/);
+	void offline(StringId64 /*id*/, ResourceManager& /*rm*/);
+	void unload(Allocator& allocator, void* resource);
+
+	/// Returns the number of bones in the skeleton.
+	/// Bones are sorted so that parents always come before their children.
+	uint32_t num_bones(const SkeletonResource* sr);
+
+	/// Returns the name of the bone @a i.
+	StringId32 bone_name(const SkeletonResource* sr, uint32_t i);
+
+	/// Returns the index of the bone @a name or -1 if the skeleton has no such bone.
+	int32_t bone_index(const SkeletonResource* sr, StringId32 name);
+
+	/// Returns the parent of the bones, -1 meaning no parent.
+	const int32_t* parents(const SkeletonResource* sr);
+
+	/// Returns the local transforms of the bones in bind pose.
+	const BoneTransform* bind_pose(const SkeletonResource* sr);
+
+	/// Returns the inverse of the model-space transforms of the bones in bind pose.
+	const Matrix4x4* inverse_bind_pose(const SkeletonResource* sr);
+} // namespace skeleton_resource
+} // namespace crown
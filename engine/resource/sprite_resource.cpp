@@ -28,13 +28,16 @@ OTHER DEALINGS IN THE SOFTWARE.
 #include "filesystem.h"
 #include "string_utils.h"
 #include "json_parser.h"
+#include "json_schema.h"
 #include "sprite_resource.h"
 #include "string_utils.h"
 #include "array.h"
 #include "config.h"
 #include "reader_writer.h"
 #include "vector2.h"
+#include "vector3.h"
 #include "vector4.h"
+#include "aabb.h"
 #include <cfloat>
 #include <cstring>
 #include <inttypes.h>
@@ -52,13 +55,15 @@ namespace sprite_resource
 		Vector2 offset;		// [Ox, Oy]
 	};
 
-	void parse_frame(JSONElement e, SpriteFrame& frame)
+	static const JSONField SPRITE_FRAME_FIELDS[] =
 	{
-		frame.name   = e.key("name"  ).to_string_id();
-		frame.region = e.key("region").to_vector4();
-		frame.offset = e.key("offset").to_vector2();
-		frame.scale  = e.key("scale" ).to_vector2();
-	}
+		CE_JSON_FIELD(SpriteFrame, name, STRING_ID32, "name"),
+		CE_JSON_FIELD(SpriteFrame, region, VECTOR4, "region"),
+		CE_JSON_FIELD(SpriteFrame, scale, VECTOR2, "scale"),
+		CE_JSON_FIELD(SpriteFrame, offset, VECTOR2, "offset")
+	};
+
+	static const JSONSchema SPRITE_FRAME_SCHEMA = CE_JSON_SCHEMA(SpriteFrame, SPRITE_FRAME_FIELDS);
 
 	void compile(const char* path, CompileOptions& opts)
 	{
@@ -71,19 +76,21 @@ namespace sprite_resource
 		// Read width/height
 		const float width  = root.key("width" ).to_float();
 		const float height = root.key("height").to_float();
-		const uint32_t num_frames = root.key("frames").size();
+
+		json_schema::validate(SPRITE_FRAME_SCHEMA);
+
+		Array<SpriteFrame> frames(default_allocator());
+		json_schema::read_array(SPRITE_FRAME_SCHEMA, root.key("frames"), frames);
+		const uint32_t num_frames = array::size(frames);
 
 		Array<float> vertices(default_allocator());
 		Array<uint16_t> indices(default_allocator());
+		array::reserve(vertices, num_frames * 16);
+		array::reserve(indices, num_frames * 6);
 		uint32_t num_idx = 0;
 		for (uint32_t i = 0; i < num_frames; i++)
 		{
-			JSONElement e(root.key("frames")[i]);
-
-			SpriteFrame frame;
-			parse_frame(e, frame);
-
-			const SpriteFrame& fd = frame;
+			const SpriteFrame& fd = frames[i];
 
 			// Compute uv coords
 			const float u0 = fd.region.x / width;
@@ -124,16 +131,10 @@ namespace sprite_resource
 		opts.write(VERSION);
 
 		opts.write(num_vertices);
-		for (uint32_t i = 0; i < array::size(vertices); i++)
-		{
-			opts.write(vertices[i]);
-		}
+		opts.write(vertices);
 
 		opts.write(num_indices);
-		for (uint32_t i = 0; i < array::size(indices); i++)
-		{
-			opts.write(indices[i]);
-		}
+		opts.write(indices);
 	}
 
 	void* load(File& file, Allocator& a)
@@ -153,9 +154,22 @@ namespace sprite_resource
 		const bgfx::Memory* ibmem = bgfx::alloc(num_inds * sizeof(uint16_t));
 		br.read(ibmem->data, num_inds * sizeof(uint16_t));
 
-		SpriteResource* so = (SpriteResource*) a.allocate(sizeof(SpriteResource));
+		// Vertices are kept on the CPU too for batching
+		const uint32_t verts_size = num_verts * sizeof(float) * 4;
+		SpriteResource* so = (SpriteResource*) a.allocate(sizeof(SpriteResource) + verts_size);
 		so->vbmem = vbmem;
 		so->ibmem = ibmem;
+		so->num_verts = num_verts;
+		so->verts = (const float*) memcpy(so + 1, vbmem->data, verts_size);
+
+		// Compute bounds from vertex positions
+		const float* verts = so->verts;
+		aabb::reset(so->aabb);
+		for (uint32_t i = 0; i < num_verts; i++)
+		{
+			const Vector3 pos(verts[i * 4 + 0], verts[i * 4 + 1], 0.0f);
+			aabb::add_points(so->aabb, 1, &pos);
+		}
 
 		return so;
 	}
@@ -254,10 +268,7 @@ namespace sprite_animation_resource
 			opts.write(anim_data[i].time);
 		}
 
-		for (uint32_t i = 0; i < array::size(anim_frames); i++)
-		{
-			opts.write(anim_frames[i]);
-		}
+		opts.write(anim_frames);
 	}
 
 	void* load(File& file, Allocator& a)
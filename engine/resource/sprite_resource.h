@@ -36,6 +36,7 @@ OTHER DEALINGS IN THE SOFTWARE.
 #include "resource_manager.h"
 #include "string_utils.h"
 #include "types.h"
+#include "math_types.h"
 #include <cstring>
 #include <inttypes.h>
 #include <bgfx.h>
@@ -56,6 +57,9 @@ struct SpriteResource
 	const bgfx::Memory* ibmem;
 	bgfx::VertexBufferHandle vb;
 	bgfx::IndexBufferHandle ib;
+	AABB aabb; // Local bounds enclosing all the frames
+	uint32_t num_verts;
+	const float* verts; // CPU copy of the vertices, 4 per frame (x, y, u, v)
 };
 
 namespace sprite_resource
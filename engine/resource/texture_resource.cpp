@@ -31,6 +31,11 @@ OTHER DEALINGS IN THE SOFTWARE.
 #include "json_parser.h"
 #include "math_utils.h"
 #include "log.h"
+#include "mipmap.h"
+#include "dxt.h"
+#include "config.h"
+#include "error.h"
+#include <string.h>
 
 namespace crown
 {
@@ -90,6 +95,16 @@ namespace crown
 #define DDPF_FOURCC_DXT5			FOURCC('D', 'X', 'T', '5')
 #define DDPF_FOURCC_DX10			FOURCC('D', 'X', '1', '0')
 
+#define DXGI_FORMAT_BC1_UNORM		uint32_t(71)
+#define DXGI_FORMAT_BC1_UNORM_SRGB	uint32_t(72)
+#define DXGI_FORMAT_BC2_UNORM		uint32_t(74)
+#define DXGI_FORMAT_BC2_UNORM_SRGB	uint32_t(75)
+#define DXGI_FORMAT_BC3_UNORM		uint32_t(77)
+#define DXGI_FORMAT_BC3_UNORM_SRGB	uint32_t(78)
+#define DXGI_FORMAT_B8G8R8A8_UNORM	uint32_t(87)
+#define DXGI_FORMAT_B8G8R8A8_UNORM_SRGB	uint32_t(91)
+#define D3D10_RESOURCE_DIMENSION_TEXTURE2D	uint32_t(3)
+
 #define DDS_HEADER_OFFSET			uint32_t(sizeof(TextureHeader))
 #define DDS_DATA_OFFSET				uint32_t(DDS_HEADER_OFFSET + DDSD_HEADERSIZE)
 
@@ -202,6 +217,21 @@ namespace texture_resource
 		char* data;
 	};
 
+	struct TextureSettings
+	{
+		bool mips;
+		bool srgb;
+		mipmap::Filter::Enum filter;
+		PixelFormat::Enum format;
+	};
+
+	uint32_t mip_size(PixelFormat::Enum format, uint32_t width, uint32_t height)
+	{
+		return pixel_format::is_compressed(format)
+			? ((width + 3) / 4) * ((height + 3) / 4) * pixel_format::size(format)
+			: width * height * pixel_format::size(format);
+	}
+
 	void read_mip_image(const ImageData& image, uint8_t mip, MipData& data)
 	{
 		uint32_t width = image.width;
@@ -212,7 +242,7 @@ namespace texture_resource
 
 		while (1)
 		{
-			const uint32_t size = width * height * pixel_format::size(image.format);
+			const uint32_t size = mip_size(image.format, width, height);
 
 			if (cur_mip == mip)
 			{
@@ -499,7 +529,46 @@ namespace texture_resource
 		image.num_mips = (flags & DDSD_MIPMAPCOUNT) ? num_mips : 1;
 		image.data = (char*) (uintptr_t) DDS_DATA_OFFSET;
 
-		const uint32_t raw_fmt = (pf_flags & DDPF_FOURCC) ? pf_fourcc : pf_flags;
+		uint32_t raw_fmt = (pf_flags & DDPF_FOURCC) ? pf_fourcc : pf_flags;
+
+		// The pixel format of DX10 files is in the DDS_HEADER_DXT10 which
+		// follows the header, map the DXGI formats to their legacy equivalents
+		if (raw_fmt == DDPF_FOURCC_DX10)
+		{
+			uint32_t dxgi_format;
+			br.read(dxgi_format);
+
+			uint32_t dimension;
+			br.read(dimension);
+
+			uint32_t misc_flags;
+			br.read(misc_flags);
+
+			uint32_t array_size;
+			br.read(array_size);
+
+			uint32_t misc_flags2;
+			br.read(misc_flags2);
+
+			if (dimension != D3D10_RESOURCE_DIMENSION_TEXTURE2D || array_size != 1)
+			{
+				error::abort(__FILE__, __LINE__, "DDS: only single 2D textures are supported (dimension %u, array size %u)\n", dimension, array_size);
+			}
+
+			switch (dxgi_format)
+			{
+				case DXGI_FORMAT_BC1_UNORM:
+				case DXGI_FORMAT_BC1_UNORM_SRGB: raw_fmt = DDPF_FOURCC_DXT1; break;
+				case DXGI_FORMAT_BC2_UNORM:
+				case DXGI_FORMAT_BC2_UNORM_SRGB: raw_fmt = DDPF_FOURCC_DXT3; break;
+				case DXGI_FORMAT_BC3_UNORM:
+				case DXGI_FORMAT_BC3_UNORM_SRGB: raw_fmt = DDPF_FOURCC_DXT5; break;
+				case DXGI_FORMAT_B8G8R8A8_UNORM:
+				case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB: raw_fmt = DDS_RGBA; break;
+				default: error::abort(__FILE__, __LINE__, "DDS: DXGI format %u not supported\n", dxgi_format); break;
+			}
+		}
+
 		switch (raw_fmt)
 		{
 			case DDPF_FOURCC_DXT1: image.format = PixelFormat::DXT1; break;
@@ -507,40 +576,31 @@ namespace texture_resource
 			case DDPF_FOURCC_DXT5: image.format = PixelFormat::DXT5; break;
 			case DDS_RGB: image.format = PixelFormat::R8G8B8; break;
 			case DDS_RGBA: image.format = PixelFormat::R8G8B8A8; break;
-			default: image.format = PixelFormat::COUNT; break;
+			default: error::abort(__FILE__, __LINE__, "DDS: pixel format %.8x not supported\n", raw_fmt); break;
 		}
 
-		CE_ASSERT(image.format != PixelFormat::COUNT, "DDS pixel format not supported");
 		CE_LOGD("PixelFormat = %u", image.format);
 	}
 
-	void write_dds(BinaryWriter& bw, const ImageData& image)
+	void fill_dds_header(uint32_t width, uint32_t height, PixelFormat::Enum format, uint32_t num_mips, DdsHeader& h)
 	{
-		bw.write(DDSD_MAGIC);
-
-		// Header
-		bw.write(DDSD_HEADERSIZE); // dwSize
-		bw.write(DDS_HEADER_FLAGS_TEXTURE
-			| DDSD_MIPMAPCOUNT
-			| (pixel_format::is_compressed(image.format) ? DDSD_LINEARSIZE : DDSD_PITCH)
-			| (image.num_mips ? DDSD_MIPMAPCOUNT : 0)); // dwFlags
-		bw.write(image.height); // dwHeight
-		bw.write(image.width); // dwWidth
-
-		const uint32_t pitch = pixel_format::is_compressed(image.format) ? 0 // fixme
-								: (image.width * pixel_format::size(image.format) * 8 + 7) / 8;
-
-		bw.write(pitch); // dwPitchOrLinearSize
-		bw.write(DDSD_UNUSED); // dwDepth
-		bw.write(image.num_mips); // dwMipMapCount;
-
-		for (uint32_t i = 0; i < 11; i++)
-			bw.write(DDSD_UNUSED); // dwReserved1[11];
+		memset(&h, 0, sizeof(h));
+
+		h.magic = DDSD_MAGIC;
+		h.size = DDSD_HEADERSIZE;
+		h.flags = DDS_HEADER_FLAGS_TEXTURE
+			| (pixel_format::is_compressed(format) ? DDSD_LINEARSIZE : DDSD_PITCH)
+			| (num_mips > 1 ? DDSD_MIPMAPCOUNT : 0);
+		h.height = height;
+		h.width = width;
+		h.pitch_or_linear_size = pixel_format::is_compressed(format) ? mip_size(format, width, height)
+								: (width * pixel_format::size(format) * 8 + 7) / 8;
+		h.depth = DDSD_UNUSED;
+		h.num_mips = num_mips;
 
 		// Pixel format
-		bw.write(DDPF_HEADERSIZE); // dwSize;
 		uint32_t pf = 0;
-		switch (image.format)
+		switch (format)
 		{
 			case PixelFormat::DXT1:     pf = DDPF_FOURCC_DXT1; break;
 			case PixelFormat::DXT3:     pf = DDPF_FOURCC_DXT3; break;
@@ -549,21 +609,25 @@ namespace texture_resource
 			case PixelFormat::R8G8B8A8: pf = DDS_RGBA; break;
 			default: CE_FATAL("Pixel format unknown"); break;
 		}
-		bw.write(pixel_format::is_compressed(image.format) ? DDPF_FOURCC : pf); // dwFlags;
-		bw.write(pixel_format::is_compressed(image.format) ? pf : DDSD_UNUSED); // dwFourCC;
-		bw.write(uint32_t(pixel_format::size(image.format) * 8)); // dwRGBBitCount;
-		bw.write(uint32_t(0x00FF0000)); // dwRBitMask;
-		bw.write(uint32_t(0x0000FF00)); // dwGBitMask;
-		bw.write(uint32_t(0x000000FF)); // dwBBitMask;
-		bw.write(uint32_t(0xFF000000)); // dwABitMask;
-
-		bw.write(DDSCAPS_TEXTURE
-			| (image.num_mips > 1 ? DDSCAPS_COMPLEX : DDSD_UNUSED) // also for cubemap, depth mipmap
-			| (image.num_mips > 1 ? DDSCAPS_MIPMAP : DDSD_UNUSED)); // dwCaps;
-		bw.write(DDSD_UNUSED); // dwCaps2;
-		bw.write(DDSD_UNUSED); // dwCaps3;
-		bw.write(DDSD_UNUSED); // dwCaps4;
-		bw.write(DDSD_UNUSED); // dwReserved2;
+		h.ddspf.size = DDPF_HEADERSIZE;
+		h.ddspf.flags = pixel_format::is_compressed(format) ? DDPF_FOURCC : pf;
+		h.ddspf.fourcc = pixel_format::is_compressed(format) ? pf : DDSD_UNUSED;
+		h.ddspf.bitcount = pixel_format::size(format) * 8;
+		h.ddspf.rmask = 0x00FF0000;
+		h.ddspf.gmask = 0x0000FF00;
+		h.ddspf.bmask = 0x000000FF;
+		h.ddspf.amask = 0xFF000000;
+
+		h.caps = DDSCAPS_TEXTURE
+			| (num_mips > 1 ? DDSCAPS_COMPLEX : DDSD_UNUSED) // also for cubemap, depth mipmap
+			| (num_mips > 1 ? DDSCAPS_MIPMAP : DDSD_UNUSED);
+	}
+
+	void write_dds(BinaryWriter& bw, const ImageData& image)
+	{
+		DdsHeader h;
+		fill_dds_header(image.width, image.height, image.format, image.num_mips, h);
+		bw.write(h);
 
 		// Image data
 		for (uint32_t i = 0; i < image.num_mips; i++)
@@ -576,9 +640,122 @@ namespace texture_resource
 		}
 	}
 
+	/// Returns a copy of the R8G8B8 or R8G8B8A8 @a image converted to R8G8B8A8.
+	uint8_t* to_rgba8(const ImageData& image)
+	{
+		const uint32_t num_pixels = image.width * image.height;
+		const uint32_t channels = pixel_format::size(image.format);
+		const uint8_t* src = (const uint8_t*) image.data;
+		uint8_t* rgba = (uint8_t*) default_allocator().allocate(num_pixels * 4);
+
+		for (uint32_t i = 0; i < num_pixels; i++)
+		{
+			rgba[i * 4 + 0] = src[i * channels + 0];
+			rgba[i * 4 + 1] = src[i * channels + 1];
+			rgba[i * 4 + 2] = src[i * channels + 2];
+			rgba[i * 4 + 3] = channels == 4 ? src[i * channels + 3] : 255;
+		}
+
+		return rgba;
+	}
+
+	bool has_alpha(const uint8_t* rgba, uint32_t num_pixels)
+	{
+		for (uint32_t i = 0; i < num_pixels; i++)
+		{
+			if (rgba[i * 4 + 3] != 255)
+				return true;
+		}
+
+		return false;
+	}
+
+	void parse_settings(JSONElement root, bool alpha, TextureSettings& ts)
+	{
+		DynamicString filter;
+		root.key_or_nil("filter").to_string(filter, "box");
+		DynamicString format;
+		root.key_or_nil("format").to_string(format, alpha ? "dxt5" : "dxt1");
+
+		ts.mips = root.key_or_nil("mips").to_bool(true);
+		ts.srgb = root.key_or_nil("srgb").to_bool(false);
+
+		if (filter == "box") ts.filter = mipmap::Filter::BOX;
+		else if (filter == "kaiser") ts.filter = mipmap::Filter::KAISER;
+		else CE_FATAL("Unknown mip filter");
+
+		if (format == "dxt1") ts.format = PixelFormat::DXT1;
+		else if (format == "dxt5") ts.format = PixelFormat::DXT5;
+		else if (format == "rgba") ts.format = PixelFormat::R8G8B8A8;
+		else CE_FATAL("Unknown texture format");
+	}
+
+	/// Generates the mip chain of the R8G8B8A8 image @a rgba and stores it
+	/// in @a image encoded as specified by @a ts.
+	void encode_image(const uint8_t* rgba, uint32_t width, uint32_t height, const TextureSettings& ts, ImageData& image)
+	{
+		image.width = width;
+		image.height = height;
+		image.pitch = 0;
+		image.format = ts.format;
+		image.num_mips = ts.mips ? mipmap::num_levels(width, height) : 1;
+
+		uint32_t total_size = 0;
+		for (uint32_t i = 0, w = width, h = height; i < image.num_mips; i++)
+		{
+			total_size += mip_size(image.format, w, h);
+			w = math::max(1u, w >> 1);
+			h = math::max(1u, h >> 1);
+		}
+
+		image.data = (char*) default_allocator().allocate(total_size);
+
+		// Levels are downsampled alternately into two scratch buffers
+		const uint32_t scratch_size = math::max(1u, width >> 1) * math::max(1u, height >> 1) * 4;
+		uint8_t* scratch[2] = { NULL, NULL };
+		if (image.num_mips > 1)
+		{
+			scratch[0] = (uint8_t*) default_allocator().allocate(scratch_size);
+			scratch[1] = (uint8_t*) default_allocator().allocate(scratch_size);
+		}
+
+		const uint8_t* level = rgba;
+		char* dst = image.data;
+
+		for (uint32_t i = 0, w = width, h = height; i < image.num_mips; i++)
+		{
+			switch (image.format)
+			{
+				case PixelFormat::DXT1: dxt::compress_dxt1(level, w, h, (uint8_t*) dst); break;
+				case PixelFormat::DXT5: dxt::compress_dxt5(level, w, h, (uint8_t*) dst); break;
+				case PixelFormat::R8G8B8A8:
+				{
+					// DDS stores uncompressed pixels as BGRA
+					memcpy(dst, level, w * h * 4);
+					swap_red_blue(w, h, 4, dst);
+					break;
+				}
+				default: CE_FATAL("Pixel format not supported"); break;
+			}
+
+			dst += mip_size(image.format, w, h);
+
+			if (i + 1 < image.num_mips)
+			{
+				mipmap::downsample(level, w, h, ts.filter, ts.srgb, scratch[i % 2]);
+				level = scratch[i % 2];
+				w = math::max(1u, w >> 1);
+				h = math::max(1u, h >> 1);
+			}
+		}
+
+		default_allocator().deallocate(scratch[0]);
+		default_allocator().deallocate(scratch[1]);
+	}
+
 	void compile(const char* path, CompileOptions& opts)
 	{
-		static const uint32_t VERSION = 1;
+		static const uint32_t VERSION = 2;
 
 		Buffer buf = opts.read(path);
 		JSONParser json(array::begin(buf));
@@ -593,19 +770,24 @@ namespace texture_resource
 
 		if (name.ends_with(".tga"))
 		{
-			parse_tga(br, image);
+			ImageData tga;
+			parse_tga(br, tga);
+			uint8_t* rgba = to_rgba8(tga);
+			default_allocator().deallocate(tga.data);
+
+			TextureSettings ts;
+			parse_settings(root, has_alpha(rgba, tga.width * tga.height), ts);
+			encode_image(rgba, tga.width, tga.height, ts, image);
+			default_allocator().deallocate(rgba);
 		}
 		else if (name.ends_with(".dds"))
 		{
-			// parse_dds(br, image);
-			// size_t size = source->size();
-			// image.data = (char*) default_allocator().allocate(size);
-			// source->seek(0);
-			// source->read(image.data, size);
-			// image.data += DDS_DATA_OFFSET;
-
-			// BinaryWriter bw(*out_file);
-			// write_dds(bw, image);
+			// Pre-compressed data is copied as is, including its mips.
+			// The data starts after the header, and the DX10 header if any
+			parse_dds(br, image);
+			const uint32_t size = source->size() - source->position();
+			image.data = (char*) default_allocator().allocate(size);
+			br.read(image.data, size);
 		}
 		else
 		{
@@ -622,16 +804,68 @@ namespace texture_resource
 		default_allocator().deallocate(image.data);
 	}
 
+	uint32_t mips_size(const TextureResource& tr, uint32_t first)
+	{
+		uint32_t size = 0;
+		for (uint32_t i = first; i < tr.num_mips; i++)
+			size += mip_size((PixelFormat::Enum) tr.format, math::max(1u, tr.width >> i), math::max(1u, tr.height >> i));
+
+		return size;
+	}
+
+	void write_dds_header(const TextureResource& tr, uint32_t first, char* dds)
+	{
+		DdsHeader h;
+		fill_dds_header(math::max(1u, tr.width >> first)
+			, math::max(1u, tr.height >> first)
+			, (PixelFormat::Enum) tr.format
+			, tr.num_mips - first
+			, h);
+		memcpy(dds, &h, sizeof(h));
+	}
+
 	void* load(File& file, Allocator& a)
 	{
-		const size_t file_size = file.size();
-		file.skip(sizeof(TextureHeader));
-		const bgfx::Memory* mem = bgfx::alloc(file_size);
-		file.read(mem->data, file_size - sizeof(TextureHeader));
+		BinaryReader br(file);
+		TextureHeader header;
+		br.read(header);
+		DdsHeader dds;
+		br.read(dds);
 
 		TextureResource* teximg = (TextureResource*) a.allocate(sizeof(TextureResource));
-		teximg->mem = mem;
 		teximg->handle.idx = bgfx::invalidHandle;
+		teximg->width = dds.width;
+		teximg->height = dds.height;
+		teximg->num_mips = (dds.flags & DDSD_MIPMAPCOUNT) ? dds.num_mips : 1;
+
+		const uint32_t raw_fmt = (dds.ddspf.flags & DDPF_FOURCC) ? dds.ddspf.fourcc : dds.ddspf.flags;
+		switch (raw_fmt)
+		{
+			case DDPF_FOURCC_DXT1: teximg->format = PixelFormat::DXT1; break;
+			case DDPF_FOURCC_DXT3: teximg->format = PixelFormat::DXT3; break;
+			case DDPF_FOURCC_DXT5: teximg->format = PixelFormat::DXT5; break;
+			case DDS_RGB: teximg->format = PixelFormat::R8G8B8; break;
+			case DDS_RGBA: teximg->format = PixelFormat::R8G8B8A8; break;
+			default: CE_FATAL("DDS pixel format not supported"); break;
+		}
+
+		// Only the mips up to CE_TEXTURE_STREAMING_MIN_SIZE are loaded,
+		// TextureStreamer brings in the others when needed
+		uint32_t first = 0;
+		while (first + 1 < teximg->num_mips
+			&& math::max(teximg->width >> first, teximg->height >> first) > CE_TEXTURE_STREAMING_MIN_SIZE)
+		{
+			first++;
+		}
+		teximg->first_mip = first;
+
+		const uint32_t size = mips_size(*teximg, first);
+		file.skip(mips_size(*teximg, 0) - size);
+
+		const bgfx::Memory* mem = bgfx::alloc(DDS_HEADER_SIZE + size);
+		write_dds_header(*teximg, first, (char*) mem->data);
+		file.read(mem->data + DDS_HEADER_SIZE, size);
+		teximg->mem = mem;
 
 		return teximg;
 	}
@@ -640,18 +874,32 @@ namespace texture_resource
 	{
 		TextureResource* teximg = (TextureResource*) rm.get(TEXTURE_TYPE, id);
 		teximg->handle = bgfx::createTexture(teximg->mem);
+		rm.texture_streamer()->add(id, teximg);
 	}
 
 	void offline(StringId64 id, ResourceManager& rm)
 	{
 		TextureResource* teximg = (TextureResource*) rm.get(TEXTURE_TYPE, id);
+		rm.texture_streamer()->remove(teximg);
 		bgfx::destroyTexture(teximg->handle);
 	}
-	
+
 	void unload(Allocator& a, void* resource)
 	{
 		a.deallocate(resource);
 	}
 
 } // namespace texture_resource
+
+uint16_t BgfxTextureStreamerBackend::create_texture(const char* dds, uint32_t size)
+{
+	return bgfx::createTexture(bgfx::copy(dds, size)).idx;
+}
+
+void BgfxTextureStreamerBackend::destroy_texture(uint16_t handle)
+{
+	bgfx::TextureHandle th;
+	th.idx = handle;
+	bgfx::destroyTexture(th);
+}
 } // namespace crown
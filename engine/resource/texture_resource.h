@@ -33,6 +33,7 @@ OTHER DEALINGS IN THE SOFTWARE.
 #include "file.h"
 #include "resource_manager.h"
 #include "memory.h"
+#include "texture_streamer.h"
 #include <bgfx.h>
 
 namespace crown
@@ -46,16 +47,37 @@ struct TextureHeader
 
 struct TextureResource
 {
-	const bgfx::Memory* mem; // BGFX will take care of deallocation
+	const bgfx::Memory* mem; // Resident mips as a DDS image. BGFX will take care of deallocation
 	bgfx::TextureHandle handle;
+
+	uint32_t width;
+	uint32_t height;
+	uint32_t format;
+	uint32_t num_mips;
+
+	/// First mip in mem, the mips before it are streamed in by TextureStreamer.
+	uint32_t first_mip;
 };
 
 namespace texture_resource
 {
+	/// Size of the DDS header, magic number included.
+	const uint32_t DDS_HEADER_SIZE = 128;
+
+	/// Offset of the first mip from the start of the resource file.
+	const uint32_t DATA_OFFSET = sizeof(TextureHeader) + DDS_HEADER_SIZE;
+
 	void compile(const char* path, CompileOptions& opts);
 	void* load(File& file, Allocator& a);
 	void offline(StringId64 id, ResourceManager& rm);
 	void online(StringId64 id, ResourceManager& rm);
 	void unload(Allocator& a, void* resource);
+
+	/// Returns the size in bytes of the mips [@a first, num_mips) of @a tr.
+	uint32_t mips_size(const TextureResource& tr, uint32_t first);
+
+	/// Writes to @a dds the DDS header of the image made by the mips [@a first, num_mips) of @a tr.
+	/// @a dds must be DDS_HEADER_SIZE bytes long.
+	void write_dds_header(const TextureResource& tr, uint32_t first, char* dds);
 } // namespace texture_resource
 } // namespace crown
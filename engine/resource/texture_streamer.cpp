@@ -0,0 +1,353 @@
+/*
+Copyright (c) 2013 Daniele Bartolini, Michele Rossi
+Copyright (c) 2012 Daniele Bartolini, Simone Boscaratto
+
+Permission is hereby granted, free of charge, to any person
+obtaining a copy of this software and associated documentation
+files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use,
+copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following
+conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "texture_streamer.h"
+#include "texture_resource.h"
+#include "bundle.h"
+#include "file.h"
+#include "array.h"
+#include "memory.h"
+#include "temp_allocator.h"
+#include "math_utils.h"
+#include "config.h"
+#include <algorithm>
+#include <math.h>
+
+namespace crown
+{
+
+// Per frame decay of the usage of a texture, so that textures briefly
+// out of sight keep their mips
+static const float USAGE_DECAY = 0.95f;
+
+namespace texture_streamer_internal
+{
+	struct UsageLess
+	{
+		UsageLess(const float* usage) : usage(usage) {}
+
+		bool operator()(uint32_t a, uint32_t b) const
+		{
+			return usage[a] < usage[b];
+		}
+
+		const float* usage;
+	};
+} // namespace texture_streamer_internal
+
+TextureStreamer::TextureStreamer(Bundle& bundle, TextureStreamerBackend& backend, uint32_t budget)
+	: m_bundle(bundle)
+	, m_backend(backend)
+	, m_budget(budget)
+	, m_next_serial(0)
+	, m_usage_changed(false)
+	, m_entries(default_allocator())
+	, m_handle_to_entry(default_allocator())
+	, m_uploads(default_allocator())
+{
+}
+
+TextureStreamer::~TextureStreamer()
+{
+	for (uint32_t i = 0; i < array::size(m_uploads); i++)
+		default_allocator().deallocate(m_uploads[i].dds);
+}
+
+void TextureStreamer::add(StringId64 name, TextureResource* tr)
+{
+	if (tr->first_mip == 0)
+		return;
+
+	ScopedMutex sm(m_mutex);
+
+	Entry e;
+	e.serial = m_next_serial++;
+	e.name = name;
+	e.texture = tr;
+	e.min_mip = tr->first_mip;
+	e.resident = tr->first_mip;
+	e.pending = NONE;
+	e.frame_usage = 0.0f;
+	e.usage = 0.0f;
+
+	const uint16_t handle = tr->handle.idx;
+	if (handle >= array::size(m_handle_to_entry))
+	{
+		const uint32_t old_size = array::size(m_handle_to_entry);
+		array::resize(m_handle_to_entry, handle + 1);
+		for (uint32_t i = old_size; i < array::size(m_handle_to_entry); i++)
+			m_handle_to_entry[i] = NONE;
+	}
+
+	m_handle_to_entry[handle] = array::size(m_entries);
+	array::push_back(m_entries, e);
+}
+
+void TextureStreamer::remove(TextureResource* tr)
+{
+	ScopedMutex sm(m_mutex);
+
+	uint32_t i = 0;
+	while (i < array::size(m_entries) && m_entries[i].texture != tr)
+		i++;
+
+	if (i == array::size(m_entries))
+		return;
+
+	// Reads still in flight for the entry are dropped by update()
+	const uint32_t last = array::size(m_entries) - 1;
+	m_handle_to_entry[tr->handle.idx] = NONE;
+	m_entries[i] = m_entries[last];
+	array::pop_back(m_entries);
+
+	if (i != last)
+		m_handle_to_entry[m_entries[i].texture->handle.idx] = i;
+}
+
+void TextureStreamer::record_usage(uint16_t handle, float size)
+{
+	// Only touches main thread data, no need to lock
+	if (handle >= array::size(m_handle_to_entry) || m_handle_to_entry[handle] == NONE)
+		return;
+
+	Entry& e = m_entries[m_handle_to_entry[handle]];
+	e.frame_usage = math::max(e.frame_usage, size);
+}
+
+bool TextureStreamer::update()
+{
+	ScopedMutex sm(m_mutex);
+
+	for (uint32_t i = 0; i < array::size(m_entries); i++)
+	{
+		Entry& e = m_entries[i];
+		e.usage = math::max(e.frame_usage, e.usage * USAGE_DECAY);
+		e.frame_usage = 0.0f;
+	}
+	m_usage_changed = true;
+
+	bool changed = false;
+
+	for (uint32_t i = 0; i < array::size(m_uploads); i++)
+	{
+		const Upload& up = m_uploads[i];
+		const uint32_t ei = find(up.serial);
+
+		if (ei != NONE)
+		{
+			Entry& e = m_entries[ei];
+			TextureResource* tr = e.texture;
+
+			const uint16_t old_handle = tr->handle.idx;
+			const uint16_t new_handle = m_backend.create_texture(up.dds, up.size);
+			m_backend.destroy_texture(old_handle);
+
+			m_handle_to_entry[old_handle] = NONE;
+			if (new_handle >= array::size(m_handle_to_entry))
+			{
+				const uint32_t old_size = array::size(m_handle_to_entry);
+				array::resize(m_handle_to_entry, new_handle + 1);
+				for (uint32_t j = old_size; j < array::size(m_handle_to_entry); j++)
+					m_handle_to_entry[j] = NONE;
+			}
+			m_handle_to_entry[new_handle] = ei;
+
+			tr->handle.idx = new_handle;
+			e.resident = up.first_mip;
+			e.pending = NONE;
+			changed = true;
+		}
+
+		default_allocator().deallocate(up.dds);
+	}
+
+	array::clear(m_uploads);
+	return changed;
+}
+
+void TextureStreamer::process()
+{
+	using namespace texture_streamer_internal;
+
+	m_mutex.lock();
+
+	if (!m_usage_changed)
+	{
+		m_mutex.unlock();
+		return;
+	}
+
+	const uint32_t num = array::size(m_entries);
+
+	TempAllocator4096 ta;
+	Array<uint32_t> target(ta);
+	Array<uint32_t> order(ta);
+	Array<float> usage(ta);
+	array::resize(target, num);
+	array::resize(order, num);
+	array::resize(usage, num);
+
+	uint32_t total = 0;
+	for (uint32_t i = 0; i < num; i++)
+	{
+		const Entry& e = m_entries[i];
+		target[i] = e.pending != NONE ? e.pending : wanted_mip(e);
+		order[i] = i;
+		usage[i] = e.usage;
+		total += texture_resource::mips_size(*e.texture, target[i]);
+	}
+
+	// Drop the high resolution mips of the least used textures until the budget is met
+	std::sort(array::begin(order), array::end(order), UsageLess(array::begin(usage)));
+
+	for (uint32_t o = 0; o < num && total > m_budget; o++)
+	{
+		const uint32_t i = order[o];
+		const Entry& e = m_entries[i];
+
+		if (e.pending != NONE)
+			continue;
+
+		while (target[i] < e.min_mip && total > m_budget)
+		{
+			total -= texture_resource::mips_size(*e.texture, target[i]) - texture_resource::mips_size(*e.texture, target[i] + 1);
+			target[i]++;
+		}
+	}
+
+	// Free memory first, then load the mips of the most used texture
+	uint32_t chosen = NONE;
+	for (uint32_t o = 0; o < num && chosen == NONE; o++)
+	{
+		const Entry& e = m_entries[order[o]];
+		if (e.pending == NONE && target[order[o]] > e.resident)
+			chosen = order[o];
+	}
+
+	for (uint32_t o = num; o > 0 && chosen == NONE; o--)
+	{
+		const Entry& e = m_entries[order[o - 1]];
+		if (e.pending == NONE && target[order[o - 1]] < e.resident)
+			chosen = order[o - 1];
+	}
+
+	if (chosen == NONE)
+	{
+		m_usage_changed = false;
+		m_mutex.unlock();
+		return;
+	}
+
+	Entry& e = m_entries[chosen];
+	e.pending = target[chosen];
+
+	const uint32_t serial = e.serial;
+	const uint32_t first = e.pending;
+	ResourceId id;
+	id.type = TEXTURE_TYPE;
+	id.name = e.name;
+
+	// The texture may be unloaded while its mips are read
+	const TextureResource tr = *e.texture;
+
+	m_mutex.unlock();
+
+	// Read the mips [first, num_mips) and make a DDS image of them
+	const uint32_t data_size = texture_resource::mips_size(tr, first);
+	const uint32_t size = texture_resource::DDS_HEADER_SIZE + data_size;
+	char* dds = (char*) default_allocator().allocate(size);
+	texture_resource::write_dds_header(tr, first, dds);
+
+	File* file = m_bundle.open(id);
+	file->skip(texture_resource::DATA_OFFSET + texture_resource::mips_size(tr, 0) - data_size);
+	file->read(dds + texture_resource::DDS_HEADER_SIZE, data_size);
+	m_bundle.close(file);
+
+	Upload up;
+	up.serial = serial;
+	up.first_mip = first;
+	up.dds = dds;
+	up.size = size;
+
+	ScopedMutex sm(m_mutex);
+	array::push_back(m_uploads, up);
+}
+
+void TextureStreamer::set_budget(uint32_t budget)
+{
+	ScopedMutex sm(m_mutex);
+	m_budget = budget;
+	m_usage_changed = true;
+}
+
+uint32_t TextureStreamer::memory_used()
+{
+	ScopedMutex sm(m_mutex);
+
+	uint32_t used = 0;
+	for (uint32_t i = 0; i < array::size(m_entries); i++)
+		used += texture_resource::mips_size(*m_entries[i].texture, m_entries[i].resident);
+
+	return used;
+}
+
+uint32_t TextureStreamer::resident_mip(const TextureResource* tr)
+{
+	ScopedMutex sm(m_mutex);
+
+	for (uint32_t i = 0; i < array::size(m_entries); i++)
+	{
+		if (m_entries[i].texture == tr)
+			return m_entries[i].resident;
+	}
+
+	return tr->first_mip;
+}
+
+uint32_t TextureStreamer::find(uint32_t serial) const
+{
+	for (uint32_t i = 0; i < array::size(m_entries); i++)
+	{
+		if (m_entries[i].serial == serial)
+			return i;
+	}
+
+	return NONE;
+}
+
+uint32_t TextureStreamer::wanted_mip(const Entry& e) const
+{
+	if (e.usage <= 0.0f)
+		return e.min_mip;
+
+	// Pick the mip with about one texel per pixel
+	const float size = (float) math::max(e.texture->width, e.texture->height);
+	const float mip = floorf(logf(size / e.usage) / logf(2.0f));
+	return (uint32_t) math::clamp(0.0f, (float) e.min_mip, mip);
+}
+
+} // namespace crown
@@ -0,0 +1,184 @@
+/*
+Copyright (c) 2013 Daniele Bartolini, Michele Rossi
+Copyright (c) 2012 Daniele Bartolini, Simone Boscaratto
+
+Permission is hereby granted, free of charge, to any person
+obtaining a copy of this software and associated documentation
+files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use,
+copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following
+conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#pragma once
+
+#include "types.h"
+#include "container_types.h"
+#include "mutex.h"
+
+namespace crown
+{
+
+class Bundle;
+struct TextureResource;
+
+/// Interface to the renderer used by TextureStreamer to create the textures.
+/// Keeps the streaming logic independent of the renderer, so that it can
+/// run headless with NullTextureStreamerBackend.
+///
+/// @ingroup Resource
+class TextureStreamerBackend
+{
+public:
+
+	virtual ~TextureStreamerBackend() {}
+
+	/// Creates a texture from the DDS image @a dds of @a size bytes and returns its handle.
+	virtual uint16_t create_texture(const char* dds, uint32_t size) = 0;
+
+	/// Destroys the texture @a handle.
+	virtual void destroy_texture(uint16_t handle) = 0;
+};
+
+/// Backend which creates no textures, for running without a renderer.
+///
+/// @ingroup Resource
+class NullTextureStreamerBackend : public TextureStreamerBackend
+{
+public:
+
+	NullTextureStreamerBackend() : m_next_handle(0), m_num_textures(0) {}
+
+	uint16_t create_texture(const char* /*dds*/, uint32_t /*size*/) { m_num_textures++; return m_next_handle++; }
+	void destroy_texture(uint16_t /*handle*/) { m_num_textures--; }
+
+	/// Returns the number of textures alive.
+	uint32_t num_textures() const { return m_num_textures; }
+
+private:
+
+	uint16_t m_next_handle;
+	uint32_t m_num_textures;
+};
+
+/// Creates the textures uploaded by TextureStreamer with bgfx.
+/// Implemented in texture_resource.cpp.
+///
+/// @ingroup Resource
+class BgfxTextureStreamerBackend : public TextureStreamerBackend
+{
+public:
+
+	uint16_t create_texture(const char* dds, uint32_t size);
+	void destroy_texture(uint16_t handle);
+};
+
+/// Streams the high resolution mips of the textures in and out.
+///
+/// The mips not larger than CE_TEXTURE_STREAMING_MIN_SIZE are always resident,
+/// the others are loaded on demand based on the screen-space size of the
+/// textures recorded during rendering, as long as the textures fit in the
+/// memory budget. Residency decisions and mip reads run on the loader thread
+/// in process(), the textures are created on the main thread in update().
+///
+/// @ingroup Resource
+class TextureStreamer
+{
+public:
+
+	/// Reads the mips from @a bundle and creates the textures with @a backend.
+	/// Resident mips never exceed @a budget bytes, unless the mips which are
+	/// always resident do.
+	TextureStreamer(Bundle& bundle, TextureStreamerBackend& backend, uint32_t budget);
+	~TextureStreamer();
+
+	/// Starts streaming the texture @a tr, whose name is @a name.
+	/// Textures without mips to stream are ignored.
+	void add(StringId64 name, TextureResource* tr);
+
+	/// Stops streaming the texture @a tr.
+	void remove(TextureResource* tr);
+
+	/// Records that the texture @a handle has been drawn @a size pixels wide.
+	void record_usage(uint16_t handle, float size);
+
+	/// Publishes the usage recorded since the last call to the loader thread and
+	/// creates the textures whose mips have been read in the meantime.
+	/// Returns whether any TextureResource::handle has changed.
+	/// Must be called once per frame from the main thread.
+	bool update();
+
+	/// Decides which mips must be resident and reads the mips of a texture
+	/// whose residency changed. Called from the loader thread.
+	void process();
+
+	/// Sets the memory budget to @a budget bytes.
+	void set_budget(uint32_t budget);
+
+	/// Returns the memory used by the resident mips in bytes.
+	uint32_t memory_used();
+
+	/// Returns the first mip of the texture @a tr in use.
+	uint32_t resident_mip(const TextureResource* tr);
+
+private:
+
+	enum { NONE = 0xFFFFFFFFu };
+
+	struct Entry
+	{
+		uint32_t serial;
+		StringId64 name;
+		TextureResource* texture;
+
+		uint32_t min_mip;	// Mips from min_mip on are always resident
+		uint32_t resident;	// First mip of the texture in use
+		uint32_t pending;	// First mip being read, NONE if none
+
+		float frame_usage;	// Largest size drawn in the current frame
+		float usage;		// Decayed maximum of frame_usage
+	};
+
+	struct Upload
+	{
+		uint32_t serial;
+		uint32_t first_mip;
+		char* dds;
+		uint32_t size;
+	};
+
+	uint32_t find(uint32_t serial) const;
+	uint32_t wanted_mip(const Entry& e) const;
+
+private:
+
+	Bundle& m_bundle;
+	TextureStreamerBackend& m_backend;
+
+	// Protects all the members below
+	Mutex m_mutex;
+
+	uint32_t m_budget;
+	uint32_t m_next_serial;
+	bool m_usage_changed;
+	Array<Entry> m_entries;
+	Array<uint32_t> m_handle_to_entry;
+	Array<Upload> m_uploads;
+};
+
+} // namespace crown
@@ -207,6 +207,19 @@ namespace unit_resource
 		}
 	}
 
+	void parse_actor_nodes(JSONElement e, Array<int32_t>& actor_nodes, const Array<GraphNodeDepth>& node_depths)
+	{
+		// Actors are visited in the same order the physics compiler writes them
+		Vector<DynamicString> keys(default_allocator());
+		e.to_keys(keys);
+
+		for (uint32_t k = 0; k < vector::size(keys); k++)
+		{
+			const StringId32 node = e.key(keys[k].c_str()).key("node").to_string_id();
+			array::push_back(actor_nodes, (int32_t) find_node_index(node, node_depths));
+		}
+	}
+
 	void parse_renderables(JSONElement e, Array<UnitRenderable>& renderables, const Array<GraphNodeDepth>& node_depths)
 	{
 		Vector<DynamicString> keys(default_allocator());
@@ -322,7 +335,7 @@ namespace unit_resource
 
 	void compile(const char* path, CompileOptions& opts)
 	{
-		static const uint32_t VERSION = 1;
+		static const uint32_t VERSION = 3;
 
 		Buffer buf = opts.read(path);
 		JSONParser json(array::begin(buf));
@@ -336,6 +349,7 @@ namespace unit_resource
 		Array<Key>				m_keys(default_allocator());
 		Array<char>				m_values(default_allocator());
 		Array<UnitMaterial>		m_materials(default_allocator());
+		Array<int32_t>			m_actor_nodes(default_allocator());
 
 		// Check for nodes
 		if (root.has_key("nodes")) parse_nodes(root.key("nodes"), m_nodes, m_node_depths);
@@ -360,6 +374,11 @@ namespace unit_resource
 		if (opts._fs.exists(physics_name.c_str()))
 		{
 			m_physics_resource = ResourceId("physics", unit_name.c_str());
+
+			Buffer physics_buf = opts.read(physics_name.c_str());
+			JSONParser physics_json(array::begin(physics_buf));
+			JSONElement physics_root = physics_json.root();
+			if (physics_root.has_key("actors")) parse_actor_nodes(physics_root.key("actors"), m_actor_nodes, m_node_depths);
 		}
 		else
 		{
@@ -372,14 +391,20 @@ namespace unit_resource
 		if (root.has_key("sprite_animation"))
 			sprite_anim = root.key("sprite_animation").to_resource_id("sprite_animation");
 
+		ResourceId skeleton_id;
+		if (root.has_key("skeleton"))
+			skeleton_id = root.key("skeleton").to_resource_id("skeleton");
+
 		UnitResource ur;
 		ur.version = VERSION;
 		ur.physics_resource = m_physics_resource.name;
 		ur.sprite_animation = sprite_anim.name;
+		ur.skeleton = skeleton_id.name;
 		ur.num_renderables = array::size(m_renderables);
 		ur.num_materials = array::size(m_materials);
 		ur.num_cameras = array::size(m_cameras);
 		ur.num_scene_graph_nodes = array::size(m_nodes);
+		ur.num_actor_nodes = array::size(m_actor_nodes);
 		ur.num_keys = array::size(m_keys);
 		ur.values_size = array::size(m_values);
 
@@ -388,6 +413,7 @@ namespace unit_resource
 		ur.materials_offset           = offt; offt += sizeof(UnitMaterial) * ur.num_materials;
 		ur.cameras_offset             = offt; offt += sizeof(UnitCamera) * ur.num_cameras;
 		ur.scene_graph_nodes_offset   = offt; offt += sizeof(UnitNode) * ur.num_scene_graph_nodes;
+		ur.actor_nodes_offset         = offt; offt += sizeof(int32_t) * ur.num_actor_nodes;
 		ur.keys_offset                = offt; offt += sizeof(Key) * ur.num_keys;
 		ur.values_offset              = offt;
 
@@ -395,6 +421,7 @@ namespace unit_resource
 		opts.write(ur._pad);
 		opts.write(ur.physics_resource);
 		opts.write(ur.sprite_animation);
+		opts.write(ur.skeleton);
 		opts.write(ur.num_renderables);
 		opts.write(ur.renderables_offset);
 		opts.write(ur.num_materials);
@@ -403,6 +430,8 @@ namespace unit_resource
 		opts.write(ur.cameras_offset);
 		opts.write(ur.num_scene_graph_nodes);
 		opts.write(ur.scene_graph_nodes_offset);
+		opts.write(ur.num_actor_nodes);
+		opts.write(ur.actor_nodes_offset);
 		opts.write(ur.num_keys);
 		opts.write(ur.keys_offset);
 		opts.write(ur.values_size);
@@ -458,6 +487,12 @@ namespace unit_resource
 			opts.write(un.parent);
 		}
 
+		// Actor nodes
+		for (uint32_t i = 0; i < array::size(m_actor_nodes); i++)
+		{
+			opts.write(m_actor_nodes[i]);
+		}
+
 		// Key/values
 		for (uint32_t i = 0; i < array::size(m_keys); i++)
 		{
@@ -498,6 +533,11 @@ namespace unit_resource
 		return ur->sprite_animation;
 	}
 
+	StringId64 skeleton(const UnitResource* ur)
+	{
+		return ur->skeleton;
+	}
+
 	StringId64 physics_resource(const UnitResource* ur)
 	{
 		return ur->physics_resource;
@@ -552,6 +592,16 @@ namespace unit_resource
 		return (UnitNode*) ((char*)ur + ur->scene_graph_nodes_offset);
 	}
 
+	uint32_t num_actor_nodes(const UnitResource* ur)
+	{
+		return ur->num_actor_nodes;
+	}
+
+	const int32_t* actor_nodes(const UnitResource* ur)
+	{
+		return (int32_t*) ((char*)ur + ur->actor_nodes_offset);
+	}
+
 	uint32_t num_keys(const UnitResource* ur)
 	{
 		return ur->num_keys;
@@ -45,6 +45,7 @@ struct UnitResource
 	uint32_t _pad;
 	StringId64 physics_resource;
 	StringId64 sprite_animation;
+	StringId64 skeleton;
 	uint32_t num_renderables;
 	uint32_t renderables_offset;
 	uint32_t num_materials;
@@ -53,6 +54,8 @@ struct UnitResource
 	uint32_t cameras_offset;
 	uint32_t num_scene_graph_nodes;
 	uint32_t scene_graph_nodes_offset;
+	uint32_t num_actor_nodes;
+	uint32_t actor_nodes_offset;
 	uint32_t num_keys;
 	uint32_t keys_offset;
 	uint32_t values_size;
@@ -121,6 +124,7 @@ namespace unit_resource
 	void unload(Allocator& allocator, void* resource);
 
 	StringId64 sprite_animation(const UnitResource* ur);
+	StringId64 skeleton(const UnitResource* ur);
 	StringId64 physics_resource(const UnitResource* ur);
 	uint32_t num_renderables(const UnitResource* ur);
 	const UnitRenderable* get_renderable(const UnitResource* ur, uint32_t i);
@@ -130,6 +134,13 @@ namespace unit_resource
 	const UnitCamera* get_camera(const UnitResource* ur, uint32_t i);
 	uint32_t num_scene_graph_nodes(const UnitResource* ur);
 	const UnitNode* scene_graph_nodes(const UnitResource* ur);
+
+	/// Returns the number of entries returned by actor_nodes().
+	uint32_t num_actor_nodes(const UnitResource* ur);
+
+	/// Returns the index of the scene graph node of each actor in the
+	/// physics resource of the unit, resolved when the unit is compiled.
+	const int32_t* actor_nodes(const UnitResource* ur);
 	uint32_t num_keys(const UnitResource* ur);
 	bool has_key(const UnitResource* ur, const char* k);
 	bool get_key(const UnitResource* ur, const char* k, Key& out_k);
@@ -0,0 +1,432 @@
+/*
+Copyright (c) 2013 Daniele Bartolini, Michele Rossi
+Copyright (c) 2012 Daniele Bartolini, Simone Boscaratto
+
+Permission is hereby granted, free of charge, to any person
+obtaining a copy of this software and associated documentation
+files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use,
+copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following
+conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "animation.h"
+#include "scene_graph.h"
+#include "array.h"
+#include "math_utils.h"
+#include "matrix4x4.h"
+#include "quaternion.h"
+#include "vector3.h"
+#include "simd.h"
+
+namespace crown
+{
+
+SkeletonPose::SkeletonPose(Allocator& a)
+	: num_bones(0)
+	, tx(a), ty(a), tz(a)
+	, rx(a), ry(a), rz(a), rw(a)
+	, sx(a), sy(a), sz(a)
+{
+}
+
+PoseSampler::PoseSampler(Allocator& a)
+	: next(a)
+	, rotation_alpha(a)
+	, translation_alpha(a)
+	, scale_alpha(a)
+{
+}
+
+namespace animation
+{
+	static uint32_t padded(uint32_t num_bones)
+	{
+		return (num_bones + 3) & ~3u;
+	}
+
+	static void set(SkeletonPose& pose, uint32_t i, const Vector3& t, const Quaternion& r, const Vector3& s)
+	{
+		pose.tx[i] = t.x; pose.ty[i] = t.y; pose.tz[i] = t.z;
+		pose.rx[i] = r.x; pose.ry[i] = r.y; pose.rz[i] = r.z; pose.rw[i] = r.w;
+		pose.sx[i] = s.x; pose.sy[i] = s.y; pose.sz[i] = s.z;
+	}
+
+	static void resize(SkeletonPose& pose, uint32_t num_bones)
+	{
+		const uint32_t num = padded(num_bones);
+		pose.num_bones = num_bones;
+		array::resize(pose.tx, num); array::resize(pose.ty, num); array::resize(pose.tz, num);
+		array::resize(pose.rx, num); array::resize(pose.ry, num); array::resize(pose.rz, num); array::resize(pose.rw, num);
+		array::resize(pose.sx, num); array::resize(pose.sy, num); array::resize(pose.sz, num);
+
+		// Padding bones are kept at identity
+		for (uint32_t i = num_bones; i < num; i++)
+			set(pose, i, Vector3(0, 0, 0), quaternion::IDENTITY, Vector3(1, 1, 1));
+	}
+
+	/// out = a + (b - a) * t, where t is either one value per item
+	/// or a single value if @a t_stride is 0.
+	static void lerp(const float* a, const float* b, const float* t, uint32_t t_stride, uint32_t num, float* out)
+	{
+#if CROWN_SIMD_SSE
+		for (uint32_t i = 0; i < num; i += 4)
+		{
+			const __m128 va = _mm_loadu_ps(a + i);
+			const __m128 vb = _mm_loadu_ps(b + i);
+			const __m128 vt = t_stride ? _mm_loadu_ps(t + i) : _mm_set1_ps(t[0]);
+			_mm_storeu_ps(out + i, _mm_add_ps(va, _mm_mul_ps(_mm_sub_ps(vb, va), vt)));
+		}
+#else
+		for (uint32_t i = 0; i < num; i++)
+			out[i] = a[i] + (b[i] - a[i]) * t[i * t_stride];
+#endif // CROWN_SIMD_SSE
+	}
+
+	/// Normalized linear interpolation along the shortest path of the rotations
+	/// of @a a and @a b, with t as in lerp().
+	static void nlerp(const SkeletonPose& a, const SkeletonPose& b, const float* t, uint32_t t_stride, SkeletonPose& out)
+	{
+		const uint32_t num = array::size(a.rx);
+		const float* ax = array::begin(a.rx); const float* ay = array::begin(a.ry);
+		const float* az = array::begin(a.rz); const float* aw = array::begin(a.rw);
+		const float* bx = array::begin(b.rx); const float* by = array::begin(b.ry);
+		const float* bz = array::begin(b.rz); const float* bw = array::begin(b.rw);
+		float* ox = array::begin(out.rx); float* oy = array::begin(out.ry);
+		float* oz = array::begin(out.rz); float* ow = array::begin(out.rw);
+
+#if CROWN_SIMD_SSE
+		const __m128 sign_mask = _mm_set1_ps(-0.0f);
+		const __m128 one = _mm_set1_ps(1.0f);
+
+		for (uint32_t i = 0; i < num; i += 4)
+		{
+			const __m128 vax = _mm_loadu_ps(ax + i);
+			const __m128 vay = _mm_loadu_ps(ay + i);
+			const __m128 vaz = _mm_loadu_ps(az + i);
+			const __m128 vaw = _mm_loadu_ps(aw + i);
+			__m128 vbx = _mm_loadu_ps(bx + i);
+			__m128 vby = _mm_loadu_ps(by + i);
+			__m128 vbz = _mm_loadu_ps(bz + i);
+			__m128 vbw = _mm_loadu_ps(bw + i);
+			const __m128 vt = t_stride ? _mm_loadu_ps(t + i) : _mm_set1_ps(t[0]);
+
+			// Flip b when the dot product is negative
+			__m128 dot = _mm_mul_ps(vax, vbx);
+			dot = _mm_add_ps(dot, _mm_mul_ps(vay, vby));
+			dot = _mm_add_ps(dot, _mm_mul_ps(vaz, vbz));
+			dot = _mm_add_ps(dot, _mm_mul_ps(vaw, vbw));
+			const __m128 sign = _mm_and_ps(dot, sign_mask);
+			vbx = _mm_xor_ps(vbx, sign);
+			vby = _mm_xor_ps(vby, sign);
+			vbz = _mm_xor_ps(vbz, sign);
+			vbw = _mm_xor_ps(vbw, sign);
+
+			const __m128 rx = _mm_add_ps(vax, _mm_mul_ps(_mm_sub_ps(vbx, vax), vt));
+			const __m128 ry = _mm_add_ps(vay, _mm_mul_ps(_mm_sub_ps(vby, vay), vt));
+			const __m128 rz = _mm_add_ps(vaz, _mm_mul_ps(_mm_sub_ps(vbz, vaz), vt));
+			const __m128 rw = _mm_add_ps(vaw, _mm_mul_ps(_mm_sub_ps(vbw, vaw), vt));
+
+			__m128 len = _mm_mul_ps(rx, rx);
+			len = _mm_add_ps(len, _mm_mul_ps(ry, ry));
+			len = _mm_add_ps(len, _mm_mul_ps(rz, rz));
+			len = _mm_add_ps(len, _mm_mul_ps(rw, rw));
+			const __m128 inv_len = _mm_div_ps(one, _mm_sqrt_ps(len));
+
+			_mm_storeu_ps(ox + i, _mm_mul_ps(rx, inv_len));
+			_mm_storeu_ps(oy + i, _mm_mul_ps(ry, inv_len));
+			_mm_storeu_ps(oz + i, _mm_mul_ps(rz, inv_len));
+			_mm_storeu_ps(ow + i, _mm_mul_ps(rw, inv_len));
+		}
+#else
+		for (uint32_t i = 0; i < num; i++)
+		{
+			const float tt = t[i * t_stride];
+			const float s = ax[i] * bx[i] + ay[i] * by[i] + az[i] * bz[i] + aw[i] * bw[i] < 0.0f ? -1.0f : 1.0f;
+
+			const float rx = ax[i] + (bx[i] * s - ax[i]) * tt;
+			const float ry = ay[i] + (by[i] * s - ay[i]) * tt;
+			const float rz = az[i] + (bz[i] * s - az[i]) * tt;
+			const float rw = aw[i] + (bw[i] * s - aw[i]) * tt;
+			const float inv_len = 1.0f / math::sqrt(rx * rx + ry * ry + rz * rz + rw * rw);
+
+			ox[i] = rx * inv_len;
+			oy[i] = ry * inv_len;
+			oz[i] = rz * inv_len;
+			ow[i] = rw * inv_len;
+		}
+#endif // CROWN_SIMD_SSE
+	}
+
+	static void interpolate(const SkeletonPose& a, const SkeletonPose& b, const float* rt, const float* tt, const float* st, uint32_t t_stride, SkeletonPose& out)
+	{
+		const uint32_t num = array::size(a.tx);
+
+		lerp(array::begin(a.tx), array::begin(b.tx), tt, t_stride, num, array::begin(out.tx));
+		lerp(array::begin(a.ty), array::begin(b.ty), tt, t_stride, num, array::begin(out.ty));
+		lerp(array::begin(a.tz), array::begin(b.tz), tt, t_stride, num, array::begin(out.tz));
+		nlerp(a, b, rt, t_stride, out);
+		lerp(array::begin(a.sx), array::begin(b.sx), st, t_stride, num, array::begin(out.sx));
+		lerp(array::begin(a.sy), array::begin(b.sy), st, t_stride, num, array::begin(out.sy));
+		lerp(array::begin(a.sz), array::begin(b.sz), st, t_stride, num, array::begin(out.sz));
+	}
+
+	/// Finds the keys of @a ch around @a frame.
+	static void find_keys(const AnimationResource* ar, const AnimationChannel& ch, float frame, uint32_t& k0, uint32_t& k1, float& alpha)
+	{
+		const uint16_t* times = animation_resource::key_times(ar, ch);
+
+		uint32_t lo = 0;
+		uint32_t hi = ch.num_keys - 1;
+		while (hi - lo > 1)
+		{
+			const uint32_t mid = (lo + hi) / 2;
+			if (times[mid] <= frame)
+				lo = mid;
+			else
+				hi = mid;
+		}
+
+		k0 = lo;
+		k1 = hi;
+		alpha = times[hi] > times[lo] ? math::clamp(0.0f, 1.0f, (frame - times[lo]) / float(times[hi] - times[lo])) : 0.0f;
+	}
+
+	void init(SkeletonPose& pose, const SkeletonResource* sr)
+	{
+		const uint32_t num = skeleton_resource::num_bones(sr);
+		const BoneTransform* bind = skeleton_resource::bind_pose(sr);
+
+		resize(pose, num);
+		for (uint32_t i = 0; i < num; i++)
+			set(pose, i, bind[i].position, bind[i].rotation, bind[i].scale);
+	}
+
+	void bind_tracks(const SkeletonResource* sr, const AnimationResource* ar, Array<int32_t>& tracks)
+	{
+		const uint32_t num = skeleton_resource::num_bones(sr);
+
+		array::resize(tracks, num);
+		for (uint32_t i = 0; i < num; i++)
+			tracks[i] = -1;
+
+		for (uint32_t i = 0; i < animation_resource::num_tracks(ar); i++)
+		{
+			const int32_t bone = skeleton_resource::bone_index(sr, animation_resource::track(ar, i)->bone);
+			if (bone != -1)
+				tracks[bone] = i;
+		}
+	}
+
+	void sample(const SkeletonResource* sr, const AnimationResource* ar, const int32_t* tracks, float time, PoseSampler& sampler, SkeletonPose& pose)
+	{
+		using namespace animation_resource;
+
+		const uint32_t num = pose.num_bones;
+		const BoneTransform* bind = skeleton_resource::bind_pose(sr);
+		SkeletonPose& next = sampler.next;
+
+		if (next.num_bones != num || array::size(next.tx) != padded(num))
+		{
+			resize(next, num);
+			array::resize(sampler.rotation_alpha, padded(num));
+			array::resize(sampler.translation_alpha, padded(num));
+			array::resize(sampler.scale_alpha, padded(num));
+			for (uint32_t i = 0; i < padded(num); i++)
+			{
+				sampler.rotation_alpha[i] = 0.0f;
+				sampler.translation_alpha[i] = 0.0f;
+				sampler.scale_alpha[i] = 0.0f;
+			}
+		}
+
+		const float frame = math::clamp(0.0f, float(ar->num_frames - 1), time * ar->sample_rate);
+
+		// Decode the keys around the frame of each channel into pose and next
+		for (uint32_t i = 0; i < num; i++)
+		{
+			const AnimationTrack* at = tracks[i] == -1 ? NULL : track(ar, tracks[i]);
+			uint32_t k0, k1;
+			float alpha;
+
+			Quaternion r0 = bind[i].rotation;
+			Quaternion r1 = bind[i].rotation;
+			sampler.rotation_alpha[i] = 0.0f;
+			if (at && at->rotation.num_keys)
+			{
+				find_keys(ar, at->rotation, frame, k0, k1, alpha);
+				const uint16_t* v = key_values(ar, at->rotation);
+				r0 = decode_rotation(v + k0 * 3);
+				r1 = decode_rotation(v + k1 * 3);
+				sampler.rotation_alpha[i] = alpha;
+			}
+
+			Vector3 t0 = bind[i].position;
+			Vector3 t1 = bind[i].position;
+			sampler.translation_alpha[i] = 0.0f;
+			if (at && at->translation.num_keys)
+			{
+				find_keys(ar, at->translation, frame, k0, k1, alpha);
+				const uint16_t* v = key_values(ar, at->translation);
+				t0 = decode_vector3(at->translation, v + k0 * 3);
+				t1 = decode_vector3(at->translation, v + k1 * 3);
+				sampler.translation_alpha[i] = alpha;
+			}
+
+			Vector3 s0 = bind[i].scale;
+			Vector3 s1 = bind[i].scale;
+			sampler.scale_alpha[i] = 0.0f;
+			if (at && at->scale.num_keys)
+			{
+				find_keys(ar, at->scale, frame, k0, k1, alpha);
+				const uint16_t* v = key_values(ar, at->scale);
+				s0 = decode_vector3(at->scale, v + k0 * 3);
+				s1 = decode_vector3(at->scale, v + k1 * 3);
+				sampler.scale_alpha[i] = alpha;
+			}
+
+			set(pose, i, t0, r0, s0);
+			set(next, i, t1, r1, s1);
+		}
+
+		interpolate(pose, next, array::begin(sampler.rotation_alpha), array::begin(sampler.translation_alpha),
+			array::begin(sampler.scale_alpha), 1, pose);
+	}
+
+	void blend(const SkeletonPose& a, const SkeletonPose& b, float weight, SkeletonPose& out)
+	{
+		CE_ASSERT(a.num_bones == b.num_bones, "Poses have different skeletons");
+
+		if (out.num_bones != a.num_bones)
+			resize(out, a.num_bones);
+
+		interpolate(a, b, &weight, &weight, &weight, 0, out);
+	}
+
+	void to_model(const SkeletonResource* sr, const SkeletonPose& pose, Matrix4x4* model)
+	{
+		const uint32_t num = pose.num_bones;
+		const int32_t* parents = skeleton_resource::parents(sr);
+
+		// Local matrices, four bones at a time
+		for (uint32_t i = 0; i < num; i += 4)
+		{
+			float m[12][4];
+
+#if CROWN_SIMD_SSE
+			const __m128 x = _mm_loadu_ps(&pose.rx[i]);
+			const __m128 y = _mm_loadu_ps(&pose.ry[i]);
+			const __m128 z = _mm_loadu_ps(&pose.rz[i]);
+			const __m128 w = _mm_loadu_ps(&pose.rw[i]);
+			const __m128 sx = _mm_loadu_ps(&pose.sx[i]);
+			const __m128 sy = _mm_loadu_ps(&pose.sy[i]);
+			const __m128 sz = _mm_loadu_ps(&pose.sz[i]);
+			const __m128 one = _mm_set1_ps(1.0f);
+			const __m128 two = _mm_set1_ps(2.0f);
+
+			const __m128 x2 = _mm_mul_ps(x, two);
+			const __m128 y2 = _mm_mul_ps(y, two);
+			const __m128 z2 = _mm_mul_ps(z, two);
+			const __m128 xx = _mm_mul_ps(x, x2);
+			const __m128 yy = _mm_mul_ps(y, y2);
+			const __m128 zz = _mm_mul_ps(z, z2);
+			const __m128 xy = _mm_mul_ps(x, y2);
+			const __m128 xz = _mm_mul_ps(x, z2);
+			const __m128 yz = _mm_mul_ps(y, z2);
+			const __m128 wx = _mm_mul_ps(w, x2);
+			const __m128 wy = _mm_mul_ps(w, y2);
+			const __m128 wz = _mm_mul_ps(w, z2);
+
+			_mm_storeu_ps(m[0], _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(yy, zz)), sx));
+			_mm_storeu_ps(m[1], _mm_mul_ps(_mm_add_ps(xy, wz), sx));
+			_mm_storeu_ps(m[2], _mm_mul_ps(_mm_sub_ps(xz, wy), sx));
+			_mm_storeu_ps(m[3], _mm_mul_ps(_mm_sub_ps(xy, wz), sy));
+			_mm_storeu_ps(m[4], _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(xx, zz)), sy));
+			_mm_storeu_ps(m[5], _mm_mul_ps(_mm_add_ps(yz, wx), sy));
+			_mm_storeu_ps(m[6], _mm_mul_ps(_mm_add_ps(xz, wy), sz));
+			_mm_storeu_ps(m[7], _mm_mul_ps(_mm_sub_ps(yz, wx), sz));
+			_mm_storeu_ps(m[8], _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(xx, yy)), sz));
+			_mm_storeu_ps(m[9], _mm_loadu_ps(&pose.tx[i]));
+			_mm_storeu_ps(m[10], _mm_loadu_ps(&pose.ty[i]));
+			_mm_storeu_ps(m[11], _mm_loadu_ps(&pose.tz[i]));
+#else
+			for (uint32_t j = 0; j < 4; j++)
+			{
+				const float x = pose.rx[i + j];
+				const float y = pose.ry[i + j];
+				const float z = pose.rz[i + j];
+				const float w = pose.rw[i + j];
+				const float sx = pose.sx[i + j];
+				const float sy = pose.sy[i + j];
+				const float sz = pose.sz[i + j];
+
+				m[0][j] = (1.0f - 2.0f * (y * y + z * z)) * sx;
+				m[1][j] = 2.0f * (x * y + w * z) * sx;
+				m[2][j] = 2.0f * (x * z - w * y) * sx;
+				m[3][j] = 2.0f * (x * y - w * z) * sy;
+				m[4][j] = (1.0f - 2.0f * (x * x + z * z)) * sy;
+				m[5][j] = 2.0f * (y * z + w * x) * sy;
+				m[6][j] = 2.0f * (x * z + w * y) * sz;
+				m[7][j] = 2.0f * (y * z - w * x) * sz;
+				m[8][j] = (1.0f - 2.0f * (x * x + y * y)) * sz;
+				m[9][j] = pose.tx[i + j];
+				m[10][j] = pose.ty[i + j];
+				m[11][j] = pose.tz[i + j];
+			}
+#endif // CROWN_SIMD_SSE
+
+			for (uint32_t j = 0; j < 4 && i + j < num; j++)
+			{
+				model[i + j] = Matrix4x4(m[0][j], m[1][j], m[2][j], 0.0f,
+					m[3][j], m[4][j], m[5][j], 0.0f,
+					m[6][j], m[7][j], m[8][j], 0.0f,
+					m[9][j], m[10][j], m[11][j], 1.0f);
+			}
+		}
+
+		// Parents always come before their children
+		for (uint32_t i = 0; i < num; i++)
+		{
+			if (parents[i] != -1)
+				model[i] = model[parents[i]] * model[i];
+		}
+	}
+
+	void to_skinning_palette(const SkeletonResource* sr, const Matrix4x4* model, Matrix4x4* palette)
+	{
+		const uint32_t num = skeleton_resource::num_bones(sr);
+		const Matrix4x4* inv_bind = skeleton_resource::inverse_bind_pose(sr);
+
+		for (uint32_t i = 0; i < num; i++)
+			palette[i] = model[i] * inv_bind[i];
+	}
+
+	void to_scene_graph(const SkeletonPose& pose, const int32_t* nodes, SceneGraph& sg)
+	{
+		for (uint32_t i = 0; i < pose.num_bones; i++)
+		{
+			const int32_t n = nodes[i];
+			if (n == -1)
+				continue;
+
+			sg.set_local_position(n, Vector3(pose.tx[i], pose.ty[i], pose.tz[i]));
+			sg.set_local_rotation(n, Quaternion(pose.rx[i], pose.ry[i], pose.rz[i], pose.rw[i]));
+			sg.set_local_scale(n, Vector3(pose.sx[i], pose.sy[i], pose.sz[i]));
+		}
+	}
+} // namespace animation
+} // namespace crown
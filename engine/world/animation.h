@@ -0,0 +1,100 @@
+/*
+Copyright (c) 2013 Daniele Bartolini, Michele Rossi
+Copyright (c) 2012 Daniele Bartolini, Simone Boscaratto
+
+Permission is hereby granted, free of charge, to any person
+obtaining a copy of this software and associated documentation
+files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use,
+copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following
+conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+
+#include "types.h"
+#include "math_types.h"
+#include "container_types.h"
+#include "skeleton_resource.h"
+#include "animation_resource.h"
+
+namespace crown
+{
+
+struct SceneGraph;
+
+/// Local transforms of the bones of a skeleton, stored as structure of arrays.
+/// The arrays are padded to a multiple of four bones so that poses can be
+/// sampled and blended four bones at a time.
+///
+/// @ingroup World
+struct SkeletonPose
+{
+	SkeletonPose(Allocator& a);
+
+	uint32_t num_bones;
+	Array<float> tx, ty, tz;
+	Array<float> rx, ry, rz, rw;
+	Array<float> sx, sy, sz;
+};
+
+/// Scratch memory used by animation::sample().
+///
+/// @ingroup World
+struct PoseSampler
+{
+	PoseSampler(Allocator& a);
+
+	SkeletonPose next;
+	Array<float> rotation_alpha;
+	Array<float> translation_alpha;
+	Array<float> scale_alpha;
+};
+
+/// Functions to sample, blend and convert skeleton poses.
+/// They only touch CPU memory, so poses can be checked against reference data
+/// without a renderer.
+///
+/// @ingroup World
+namespace animation
+{
+	/// Sizes @a pose for the bones of @a sr and sets it to the bind pose.
+	void init(SkeletonPose& pose, const SkeletonResource* sr);
+
+	/// Fills @a tracks with the index of the track of @a ar which animates
+	/// each bone of @a sr, or -1 if the bone is not animated.
+	void bind_tracks(const SkeletonResource* sr, const AnimationResource* ar, Array<int32_t>& tracks);
+
+	/// Samples @a ar at @a time into @a pose.
+	/// Bones and channels not animated by @a ar are set to the bind pose.
+	void sample(const SkeletonResource* sr, const AnimationResource* ar, const int32_t* tracks, float time, PoseSampler& sampler, SkeletonPose& pose);
+
+	/// Blends @a a and @a b into @a out, with @a weight in [0, 1] being
+	/// the weight of @a b. @a out can alias @a a or @a b.
+	void blend(const SkeletonPose& a, const SkeletonPose& b, float weight, SkeletonPose& out);
+
+	/// Computes the model-space transforms of the bones in @a pose.
+	void to_model(const SkeletonResource* sr, const SkeletonPose& pose, Matrix4x4* model);
+
+	/// Computes the skinning matrices of the bones from their model-space transforms.
+	void to_skinning_palette(const SkeletonResource* sr, const Matrix4x4* model, Matrix4x4* palette);
+
+	/// Writes the local transforms in @a pose to the nodes of @a sg.
+	/// @a nodes is the node of each bone, -1 meaning the bone has no node.
+	void to_scene_graph(const SkeletonPose& pose, const int32_t* nodes, SceneGraph& sg);
+} // namespace animation
+} // namespace crown
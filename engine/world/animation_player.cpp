@@ -0,0 +1,190 @@
+/*
+Copyright (c) 2013 Daniele Bartolini, Michele Rossi
+Copyright (c) 2012 Daniele Bartolini, Simone Boscaratto
+
+Permission is hereby granted, free of charge, to any person
+obtaining a copy of this software and associated documentation
+files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use,
+copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following
+conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "animation_player.h"
+#include "scene_graph.h"
+#include "array.h"
+#include "memory.h"
+#include "math_utils.h"
+
+namespace crown
+{
+
+/// Advances the @a time by @a dt, wrapping or clamping it to the clip duration.
+static void advance(float& time, float duration, bool loop, float dt)
+{
+	time += dt;
+
+	if (time > duration)
+		time = loop && duration > 0.0f ? math::fmod(time, duration) : duration;
+}
+
+AnimationPlayer::Clip::Clip(Allocator& a)
+	: resource(NULL)
+	, tracks(a)
+	, time(0.0f)
+	, loop(false)
+{
+}
+
+AnimationPlayer::Animation::Animation(Allocator& a, const SkeletonResource* sr, SceneGraph& sg)
+	: skeleton(sr)
+	, scene_graph(sg)
+	, nodes(a)
+	, current(a)
+	, previous(a)
+	, speed(1.0f)
+	, blend_time(0.0f)
+	, blend_elapsed(0.0f)
+	, pose(a)
+	, blend_pose(a)
+	, model(a)
+	, palette(a)
+{
+	const uint32_t num = skeleton_resource::num_bones(sr);
+
+	array::resize(nodes, num);
+	for (uint32_t i = 0; i < num; i++)
+	{
+		const StringId32 name = skeleton_resource::bone_name(sr, i);
+		nodes[i] = sg.has_node(name) ? sg.node(name) : -1;
+	}
+
+	animation::init(pose, sr);
+	animation::init(blend_pose, sr);
+
+	array::resize(model, num);
+	array::resize(palette, num);
+	animation::to_model(sr, pose, array::begin(model));
+	animation::to_skinning_palette(sr, array::begin(model), array::begin(palette));
+}
+
+AnimationPlayer::AnimationPlayer()
+	: m_sampler(default_allocator())
+{
+}
+
+AnimationPlayer::~AnimationPlayer()
+{
+	for (uint32_t i = 0; i < id_array::size(m_animations); i++)
+	{
+		CE_DELETE(default_allocator(), m_animations[i]);
+	}
+}
+
+AnimationId AnimationPlayer::create_animation(const SkeletonResource* sr, SceneGraph& sg)
+{
+	Animation* a = CE_NEW(default_allocator(), Animation)(default_allocator(), sr, sg);
+	return id_array::create(m_animations, a);
+}
+
+void AnimationPlayer::destroy_animation(AnimationId id)
+{
+	CE_DELETE(default_allocator(), id_array::get(m_animations, id));
+	id_array::destroy(m_animations, id);
+}
+
+void AnimationPlayer::play(AnimationId id, const AnimationResource* ar, bool loop, float blend_time)
+{
+	Animation& a = *id_array::get(m_animations, id);
+
+	// Keep the clip being played to fade out from it
+	a.previous.resource = NULL;
+	if (a.current.resource != NULL && blend_time > 0.0f)
+	{
+		a.previous.resource = a.current.resource;
+		a.previous.tracks = a.current.tracks;
+		a.previous.time = a.current.time;
+		a.previous.loop = a.current.loop;
+	}
+
+	a.current.resource = ar;
+	a.current.time = 0.0f;
+	a.current.loop = loop;
+	animation::bind_tracks(a.skeleton, ar, a.current.tracks);
+
+	a.blend_time = blend_time;
+	a.blend_elapsed = 0.0f;
+}
+
+void AnimationPlayer::stop(AnimationId id)
+{
+	Animation& a = *id_array::get(m_animations, id);
+	a.current.resource = NULL;
+	a.previous.resource = NULL;
+}
+
+void AnimationPlayer::set_speed(AnimationId id, float speed)
+{
+	id_array::get(m_animations, id)->speed = speed;
+}
+
+const Matrix4x4* AnimationPlayer::skinning_palette(AnimationId id)
+{
+	return array::begin(id_array::get(m_animations, id)->palette);
+}
+
+void AnimationPlayer::update(float dt)
+{
+	for (uint32_t i = 0; i < id_array::size(m_animations); i++)
+	{
+		update_animation(*m_animations[i], dt);
+	}
+}
+
+void AnimationPlayer::update_animation(Animation& a, float dt)
+{
+	if (a.current.resource == NULL)
+		return;
+
+	const float clip_dt = dt * a.speed;
+	const SkeletonResource* sr = a.skeleton;
+
+	advance(a.current.time, animation_resource::duration(a.current.resource), a.current.loop, clip_dt);
+	animation::sample(sr, a.current.resource, array::begin(a.current.tracks), a.current.time, m_sampler, a.pose);
+
+	if (a.previous.resource != NULL)
+	{
+		a.blend_elapsed += dt;
+
+		if (a.blend_elapsed < a.blend_time)
+		{
+			advance(a.previous.time, animation_resource::duration(a.previous.resource), a.previous.loop, clip_dt);
+			animation::sample(sr, a.previous.resource, array::begin(a.previous.tracks), a.previous.time, m_sampler, a.blend_pose);
+			animation::blend(a.blend_pose, a.pose, a.blend_elapsed / a.blend_time, a.pose);
+		}
+		else
+		{
+			a.previous.resource = NULL;
+		}
+	}
+
+	animation::to_scene_graph(a.pose, array::begin(a.nodes), a.scene_graph);
+	animation::to_model(sr, a.pose, array::begin(a.model));
+	animation::to_skinning_palette(sr, array::begin(a.model), array::begin(a.palette));
+}
+
+} // namespace crown
@@ -0,0 +1,112 @@
+/*
+Copyright (c) 2013 Daniele Bartolini, Michele Rossi
+Copyright (c) 2012 Daniele Bartolini, Simone Boscaratto
+
+Permission is hereby granted, free of charge, to any person
+obtaining a copy of this software and associated documentation
+files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use,
+copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following
+conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+
+#include "types.h"
+#include "id_array.h"
+#include "config.h"
+#include "animation.h"
+
+namespace crown
+{
+
+struct SceneGraph;
+typedef Id AnimationId;
+
+/// Plays skeletal animations.
+///
+/// Each animation samples its current clip, cross-fades from the previous
+/// one if any, and writes the resulting pose to the nodes of a scene graph
+/// named after the bones and to a skinning matrix palette.
+///
+/// @ingroup World
+struct AnimationPlayer
+{
+	AnimationPlayer();
+	~AnimationPlayer();
+
+	/// Creates a new animation of the skeleton @a sr which drives the nodes
+	/// of @a sg with the same name as the bones.
+	AnimationId create_animation(const SkeletonResource* sr, SceneGraph& sg);
+
+	/// Destroys the animation @a id.
+	void destroy_animation(AnimationId id);
+
+	/// Plays the clip @a ar on @a id, cross-fading from the current clip in @a blend_time seconds.
+	void play(AnimationId id, const AnimationResource* ar, bool loop, float blend_time);
+
+	/// Stops @a id, leaving the skeleton in its current pose.
+	void stop(AnimationId id);
+
+	/// Sets the playback speed of @a id, 1.0 being the speed of the clip.
+	void set_speed(AnimationId id, float speed);
+
+	/// Returns the skinning matrices of the bones of @a id.
+	const Matrix4x4* skinning_palette(AnimationId id);
+
+	/// Advances all the animations by @a dt.
+	void update(float dt);
+
+private:
+
+	struct Clip
+	{
+		Clip(Allocator& a);
+
+		const AnimationResource* resource;
+		Array<int32_t> tracks;
+		float time;
+		bool loop;
+	};
+
+	struct Animation
+	{
+		Animation(Allocator& a, const SkeletonResource* sr, SceneGraph& sg);
+
+		const SkeletonResource* skeleton;
+		SceneGraph& scene_graph;
+		Array<int32_t> nodes;
+		Clip current;
+		Clip previous;
+		float speed;
+		float blend_time;
+		float blend_elapsed;
+		SkeletonPose pose;
+		SkeletonPose blend_pose;
+		Array<Matrix4x4> model;
+		Array<Matrix4x4> palette;
+	};
+
+	void update_animation(Animation& a, float dt);
+
+private:
+
+	PoseSampler m_sampler;
+	IdArray<CE_MAX_ANIMATIONS, Animation*> m_animations;
+};
+
+} // namespace crown
@@ -0,0 +1,222 @@
+/*
+Copyright (c) 2013 Daniele Bartolini, Michele Rossi
+Copyright (c) 2012 Daniele Bartolini, Simone Boscaratto
+
+Permission is hereby granted, free of charge, to any person
+obtaining a copy of this software and associated documentation
+files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use,
+copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following
+conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "command_buffer.h"
+#include "world.h"
+#include "unit_template.h"
+#include "device.h"
+#include "resource_manager.h"
+
+namespace crown
+{
+
+CommandBuffer::CommandBuffer(World& world)
+	: m_world(world)
+	, m_commands(default_allocator())
+	, m_playback(default_allocator())
+{
+}
+
+UnitId CommandBuffer::spawn_unit(const char* name, const Matrix4x4& pose)
+{
+	const ResourceId id(UNIT_EXTENSION, name);
+	return spawn_unit(id.name, pose);
+}
+
+UnitId CommandBuffer::spawn_unit(StringId64 name, const Matrix4x4& pose)
+{
+	UnitTemplateId no_template;
+	no_template.id = INVALID_ID;
+	return spawn_unit(no_template, name, pose);
+}
+
+UnitId CommandBuffer::spawn_unit(UnitTemplateId id, const Matrix4x4& pose)
+{
+	return spawn_unit(id, 0, pose);
+}
+
+UnitId CommandBuffer::spawn_unit(UnitTemplateId id, StringId64 name, const Matrix4x4& pose)
+{
+	SpawnUnitCommand c;
+	c.id = m_world.reserve_unit_id();
+	c.unit_template = id;
+	c.name = name;
+	c.pose = pose;
+
+	ScopedMutex sm(m_mutex);
+	event_stream::write(m_commands, CommandType::SPAWN_UNIT, c);
+	return c.id;
+}
+
+void CommandBuffer::destroy_unit(UnitId id)
+{
+	DestroyUnitCommand c;
+	c.id = id;
+	c._pad = 0;
+
+	ScopedMutex sm(m_mutex);
+	event_stream::write(m_commands, CommandType::DESTROY_UNIT, c);
+}
+
+void CommandBuffer::link_unit(UnitId child, UnitId parent, int32_t node)
+{
+	LinkUnitCommand c;
+	c.child = child;
+	c.parent = parent;
+	c.node = node;
+	c._pad = 0;
+
+	ScopedMutex sm(m_mutex);
+	event_stream::write(m_commands, CommandType::LINK_UNIT, c);
+}
+
+void CommandBuffer::unlink_unit(UnitId id)
+{
+	UnlinkUnitCommand c;
+	c.id = id;
+	c._pad = 0;
+
+	ScopedMutex sm(m_mutex);
+	event_stream::write(m_commands, CommandType::UNLINK_UNIT, c);
+}
+
+void CommandBuffer::set_local_pose(UnitId id, int32_t node, const Matrix4x4& pose)
+{
+	SetLocalPoseCommand c;
+	c.id = id;
+	c.node = node;
+	c.pose = pose;
+
+	ScopedMutex sm(m_mutex);
+	event_stream::write(m_commands, CommandType::SET_LOCAL_POSE, c);
+}
+
+void CommandBuffer::flush()
+{
+	// Take the commands so that other threads can keep recording during playback
+	{
+		ScopedMutex sm(m_mutex);
+		if (array::size(m_commands) == 0)
+			return;
+
+		array::swap(m_playback, m_commands);
+	}
+
+	const char* cur = array::begin(m_playback);
+	const char* end = array::end(m_playback);
+
+	while (cur != end)
+	{
+		const event_stream::Header& h = *(event_stream::Header*) cur;
+		const char* command = cur + sizeof(event_stream::Header);
+
+		switch (h.type)
+		{
+			case CommandType::SPAWN_UNIT:
+			{
+				const SpawnUnitCommand& c = *(SpawnUnitCommand*) command;
+
+				if (c.unit_template.id != INVALID_ID)
+				{
+					cur = spawn_units(*id_array::get(m_world.m_unit_templates, c.unit_template), cur, end);
+				}
+				else
+				{
+					const UnitTemplate ut(c.name, (UnitResource*) device()->resource_manager()->get(UNIT_TYPE, c.name));
+					cur = spawn_units(ut, cur, end);
+				}
+				continue;
+			}
+			case CommandType::DESTROY_UNIT:
+			{
+				const DestroyUnitCommand& c = *(DestroyUnitCommand*) command;
+
+				// The unit may have been destroyed already
+				if (id_array::has(m_world.m_units, c.id))
+					m_world.destroy_unit(c.id);
+				break;
+			}
+			case CommandType::LINK_UNIT:
+			{
+				const LinkUnitCommand& c = *(LinkUnitCommand*) command;
+
+				if (id_array::has(m_world.m_units, c.child) && id_array::has(m_world.m_units, c.parent))
+					m_world.link_unit(c.child, c.parent, c.node);
+				break;
+			}
+			case CommandType::UNLINK_UNIT:
+			{
+				const UnlinkUnitCommand& c = *(UnlinkUnitCommand*) command;
+
+				if (id_array::has(m_world.m_units, c.id))
+					m_world.unlink_unit(c.id);
+				break;
+			}
+			case CommandType::SET_LOCAL_POSE:
+			{
+				const SetLocalPoseCommand& c = *(SetLocalPoseCommand*) command;
+
+				if (id_array::has(m_world.m_units, c.id))
+					m_world.get_unit(c.id)->set_local_pose(c.node, c.pose);
+				break;
+			}
+			default:
+			{
+				CE_FATAL("Unknown command type");
+				break;
+			}
+		}
+
+		cur = command + h.size;
+	}
+
+	array::clear(m_playback);
+}
+
+const char* CommandBuffer::spawn_units(const UnitTemplate& ut, const char* cur, const char* end)
+{
+	const SpawnUnitCommand& first = *(SpawnUnitCommand*) (cur + sizeof(event_stream::Header));
+
+	while (cur != end)
+	{
+		const event_stream::Header& h = *(event_stream::Header*) cur;
+		const SpawnUnitCommand& c = *(SpawnUnitCommand*) (cur + sizeof(event_stream::Header));
+
+		if (h.type != CommandType::SPAWN_UNIT
+			|| c.unit_template.id != first.unit_template.id
+			|| c.name != first.name)
+		{
+			break;
+		}
+
+		m_world.create_unit(c.id, ut, c.pose);
+		cur += sizeof(event_stream::Header) + h.size;
+	}
+
+	return cur;
+}
+
+} // namespace crown
@@ -0,0 +1,148 @@
+/*
+Copyright (c) 2013 Daniele Bartolini, Michele Rossi
+Copyright (c) 2012 Daniele Bartolini, Simone Boscaratto
+
+Permission is hereby granted, free of charge, to any person
+obtaining a copy of this software and associated documentation
+files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use,
+copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following
+conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+
+#include "types.h"
+#include "math_types.h"
+#include "world_types.h"
+#include "event_stream.h"
+#include "mutex.h"
+
+namespace crown
+{
+
+class World;
+struct UnitTemplate;
+
+/// Records changes to a World to be applied later, at the end of
+/// World::update_scene().
+///
+/// Commands can be recorded from any thread, and from physics callbacks
+/// or scripts while the world is iterating its units. Spawn commands
+/// return the id the unit will have once it is created, so that later
+/// commands in the same buffer can refer to it.
+///
+/// @ingroup World
+class CommandBuffer
+{
+public:
+
+	CommandBuffer(World& world);
+
+	/// Spawns the unit @a name at the given @a pose.
+	UnitId spawn_unit(const char* name, const Matrix4x4& pose);
+	UnitId spawn_unit(StringId64 name, const Matrix4x4& pose);
+
+	/// Spawns an instance of the unit template @a id at the given @a pose.
+	/// @note The template must not be destroyed before the command is applied.
+	UnitId spawn_unit(UnitTemplateId id, const Matrix4x4& pose);
+
+	/// Destroys the unit @a id.
+	void destroy_unit(UnitId id);
+
+	/// Links the unit @a child to the @a node of the unit @a parent.
+	void link_unit(UnitId child, UnitId parent, int32_t node);
+
+	/// Unlinks the unit @a id from its parent.
+	void unlink_unit(UnitId id);
+
+	/// Sets the local @a pose of the @a node of the unit @a id.
+	void set_local_pose(UnitId id, int32_t node, const Matrix4x4& pose);
+
+	/// Applies all the commands recorded so far, in order.
+	/// Consecutive spawns of the same unit share the same resolved UnitTemplate.
+	/// @note Must be called from the thread that updates the world.
+	void flush();
+
+private:
+
+	struct CommandType
+	{
+		enum Enum
+		{
+			SPAWN_UNIT,
+			DESTROY_UNIT,
+			LINK_UNIT,
+			UNLINK_UNIT,
+			SET_LOCAL_POSE
+		};
+	};
+
+	// Commands are padded to multiples of 8 bytes to keep
+	// the ones that follow them aligned in the stream.
+	struct SpawnUnitCommand
+	{
+		UnitId id;
+		UnitTemplateId unit_template; // INVALID_ID to spawn by name
+		StringId64 name;
+		Matrix4x4 pose;
+	};
+
+	struct DestroyUnitCommand
+	{
+		UnitId id;
+		uint32_t _pad;
+	};
+
+	struct LinkUnitCommand
+	{
+		UnitId child;
+		UnitId parent;
+		int32_t node;
+		uint32_t _pad;
+	};
+
+	struct UnlinkUnitCommand
+	{
+		UnitId id;
+		uint32_t _pad;
+	};
+
+	struct SetLocalPoseCommand
+	{
+		UnitId id;
+		int32_t node;
+		Matrix4x4 pose;
+	};
+
+	UnitId spawn_unit(UnitTemplateId id, StringId64 name, const Matrix4x4& pose);
+
+	/// Spawns the unit of the command at @a cur and of all the spawn
+	/// commands of the same unit following it using the template @a ut.
+	/// Returns the first command after them.
+	const char* spawn_units(const UnitTemplate& ut, const char* cur, const char* end);
+
+private:
+
+	World& m_world;
+
+	Mutex m_mutex;
+	EventStream m_commands;
+	EventStream m_playback;
+};
+
+} // namespace crown
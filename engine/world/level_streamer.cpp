@@ -0,0 +1,355 @@
+/*
+Copyright (c) 2013 Daniele Bartolini, Michele Rossi
+Copyright (c) 2012 Daniele Bartolini, Simone Boscaratto
+
+Permission is hereby granted, free of charge, to any person
+obtaining a copy of this software and associated documentation
+files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use,
+copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following
+conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "level_streamer.h"
+#include "world.h"
+#include "device.h"
+#include "resource_package.h"
+#include "level_resource.h"
+#include "array.h"
+#include "hash.h"
+#include "vector3.h"
+#include "math_utils.h"
+#include "os.h"
+#include "config.h"
+
+namespace crown
+{
+
+LevelStreamer::LevelStreamer(World& world)
+	: m_world(world)
+	, m_level(NULL)
+	, m_cells(default_allocator())
+	, m_units(default_allocator())
+	, m_packages(default_allocator())
+	, m_focus(vector3::ZERO)
+	, m_load_radius(100.0f)
+	, m_unload_radius(120.0f)
+	, m_budget(CE_LEVEL_STREAMING_BUDGET)
+	, m_last_update_time(0.0f)
+	, m_loaded_event_posted(false)
+{
+}
+
+LevelStreamer::~LevelStreamer()
+{
+	// The units are destroyed by the world
+	const Hash<Package>::Entry* begin = hash::begin(m_packages);
+	const Hash<Package>::Entry* end = hash::end(m_packages);
+	for (; begin != end; ++begin)
+	{
+		begin->value.package->unload();
+		device()->destroy_resource_package(begin->value.package);
+	}
+}
+
+void LevelStreamer::load(const LevelResource* lr)
+{
+	unload();
+
+	m_level = lr;
+	m_loaded_event_posted = false;
+
+	const uint32_t num_cells = level_resource::num_cells(lr);
+	array::resize(m_cells, num_cells);
+	for (uint32_t i = 0; i < num_cells; i++)
+	{
+		m_cells[i].state = CellState::UNLOADED;
+		m_cells[i].num_spawned = 0;
+	}
+
+	array::resize(m_units, level_resource::num_units(lr));
+
+	for (uint32_t i = 0; i < level_resource::num_sounds(lr); i++)
+	{
+		const LevelSound* ls = level_resource::get_sound(lr, i);
+		m_world.play_sound(ls->name, ls->loop, ls->volume, ls->position, ls->range);
+	}
+}
+
+void LevelStreamer::unload()
+{
+	if (m_level == NULL)
+		return;
+
+	for (uint32_t i = 0; i < array::size(m_cells); i++)
+	{
+		if (m_cells[i].state == CellState::UNLOADED)
+			continue;
+
+		while (!destroy_next(i))
+			;
+
+		const LevelCell* cell = level_resource::get_cell(m_level, i);
+		unload_package(cell->package);
+		m_cells[i].state = CellState::UNLOADED;
+	}
+
+	array::clear(m_cells);
+	array::clear(m_units);
+	m_level = NULL;
+}
+
+void LevelStreamer::set_focus(const Vector3& pos)
+{
+	m_focus = pos;
+}
+
+void LevelStreamer::set_radius(float load, float unload)
+{
+	CE_ASSERT(unload >= load, "Unload radius must not be smaller than load radius");
+	m_load_radius = load;
+	m_unload_radius = unload;
+}
+
+void LevelStreamer::set_budget(float seconds)
+{
+	m_budget = seconds;
+}
+
+void LevelStreamer::update()
+{
+	if (m_level == NULL)
+		return;
+
+	// Start loading the cells which came into range and unloading the ones which went out of it
+	for (uint32_t i = 0; i < array::size(m_cells); i++)
+	{
+		Cell& c = m_cells[i];
+		const LevelCell* cell = level_resource::get_cell(m_level, i);
+		const float dist = distance(i);
+
+		if (dist <= m_load_radius)
+		{
+			if (c.state == CellState::UNLOADED)
+			{
+				load_package(cell->package);
+				c.state = CellState::LOADING;
+			}
+			else if (c.state == CellState::DESPAWNING)
+			{
+				c.state = CellState::SPAWNING;
+			}
+		}
+		else if (dist > m_unload_radius)
+		{
+			if (c.state == CellState::SPAWNING || c.state == CellState::LOADED)
+			{
+				c.state = CellState::DESPAWNING;
+			}
+		}
+
+		// Cells which went out of range while loading keep their package until it
+		// has loaded, since unloading a package still being loaded would wait for it
+		if (c.state == CellState::LOADING && has_loaded_package(cell->package))
+		{
+			if (dist > m_unload_radius)
+			{
+				unload_package(cell->package);
+				c.state = CellState::UNLOADED;
+			}
+			else
+			{
+				c.state = CellState::SPAWNING;
+			}
+		}
+	}
+
+	// Spawn and destroy units until the budget runs out.
+	// Destroying comes first to release memory before it is needed again.
+	const int64_t start = os::clocktime();
+	const int64_t budget = int64_t(m_budget * os::clockfrequency());
+	bool has_time = true;
+
+	for (uint32_t i = 0; has_time && i < array::size(m_cells); i++)
+	{
+		Cell& c = m_cells[i];
+		if (c.state != CellState::DESPAWNING)
+			continue;
+
+		bool done = false;
+		while (!done && has_time)
+		{
+			done = destroy_next(i);
+			has_time = os::clocktime() - start < budget;
+		}
+
+		if (done)
+		{
+			unload_package(level_resource::get_cell(m_level, i)->package);
+			c.state = CellState::UNLOADED;
+		}
+	}
+
+	for (uint32_t i = 0; has_time && i < array::size(m_cells); i++)
+	{
+		Cell& c = m_cells[i];
+		if (c.state != CellState::SPAWNING)
+			continue;
+
+		bool done = false;
+		while (!done && has_time)
+		{
+			done = spawn_next(i);
+			has_time = os::clocktime() - start < budget;
+		}
+
+		if (done)
+			c.state = CellState::LOADED;
+	}
+
+	m_last_update_time = float(os::clocktime() - start) / float(os::clockfrequency());
+
+	if (!m_loaded_event_posted && progress() == 1.0f)
+	{
+		m_world.post_level_loaded_event();
+		m_loaded_event_posted = true;
+	}
+}
+
+float LevelStreamer::progress() const
+{
+	if (m_level == NULL)
+		return 1.0f;
+
+	uint32_t num_units = 0;
+	uint32_t num_spawned = 0;
+	for (uint32_t i = 0; i < array::size(m_cells); i++)
+	{
+		if (distance(i) > m_load_radius)
+			continue;
+
+		num_units += level_resource::get_cell(m_level, i)->num_units;
+		num_spawned += m_cells[i].num_spawned;
+	}
+
+	return num_units == 0 ? 1.0f : float(num_spawned) / float(num_units);
+}
+
+float LevelStreamer::last_update_time() const
+{
+	return m_last_update_time;
+}
+
+float LevelStreamer::distance(uint32_t i) const
+{
+	const LevelCell* cell = level_resource::get_cell(m_level, i);
+	const Vector3 closest(math::clamp(cell->min.x, cell->max.x, m_focus.x)
+		, math::clamp(cell->min.y, cell->max.y, m_focus.y)
+		, math::clamp(cell->min.z, cell->max.z, m_focus.z));
+	return vector3::length(m_focus - closest);
+}
+
+void LevelStreamer::load_package(StringId64 id)
+{
+	if (id == 0)
+		return;
+
+	Package deffault;
+	deffault.package = NULL;
+	deffault.references = 0;
+	Package p = hash::get(m_packages, id, deffault);
+
+	if (p.package == NULL)
+	{
+		p.package = device()->create_resource_package(id);
+		p.package->load();
+	}
+
+	p.references++;
+	hash::set(m_packages, id, p);
+}
+
+void LevelStreamer::unload_package(StringId64 id)
+{
+	if (id == 0)
+		return;
+
+	CE_ASSERT(hash::has(m_packages, id), "Package not loaded");
+	Package deffault;
+	deffault.package = NULL;
+	deffault.references = 0;
+	Package p = hash::get(m_packages, id, deffault);
+
+	if (--p.references == 0)
+	{
+		p.package->unload();
+		device()->destroy_resource_package(p.package);
+		hash::remove(m_packages, id);
+		return;
+	}
+
+	hash::set(m_packages, id, p);
+}
+
+bool LevelStreamer::has_loaded_package(StringId64 id) const
+{
+	if (id == 0)
+		return true;
+
+	Package deffault;
+	deffault.package = NULL;
+	deffault.references = 0;
+	const Package& p = hash::get(m_packages, id, deffault);
+	return p.package != NULL && p.package->has_loaded();
+}
+
+bool LevelStreamer::spawn_next(uint32_t i)
+{
+	const LevelCell* cell = level_resource::get_cell(m_level, i);
+	Cell& c = m_cells[i];
+
+	if (c.num_spawned < cell->num_units)
+	{
+		const uint32_t unit = cell->first_unit + c.num_spawned;
+		const LevelUnit* lu = level_resource::get_unit(m_level, unit);
+		m_units[unit] = m_world.spawn_unit(lu->name, lu->position, lu->rotation);
+		c.num_spawned++;
+	}
+
+	return c.num_spawned == cell->num_units;
+}
+
+bool LevelStreamer::destroy_next(uint32_t i)
+{
+	const LevelCell* cell = level_resource::get_cell(m_level, i);
+	Cell& c = m_cells[i];
+
+	if (c.num_spawned > 0)
+	{
+		c.num_spawned--;
+
+		// The unit might have been destroyed by the game already
+		const UnitId id = m_units[cell->first_unit + c.num_spawned];
+		if (m_world.has_unit(id))
+			m_world.destroy_unit(id);
+	}
+
+	return c.num_spawned == 0;
+}
+
+} // namespace crown
@@ -0,0 +1,142 @@
+/*
+Copyright (c) 2013 Daniele Bartolini, Michele Rossi
+Copyright (c) 2012 Daniele Bartolini, Simone Boscaratto
+
+Permission is hereby granted, free of charge, to any person
+obtaining a copy of this software and associated documentation
+files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use,
+copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following
+conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#pragma once
+
+#include "types.h"
+#include "math_types.h"
+#include "world_types.h"
+#include "resource_types.h"
+#include "container_types.h"
+
+namespace crown
+{
+
+class World;
+struct ResourcePackage;
+
+/// Loads the units of a level incrementally, as they come into range of a focus point.
+///
+/// The level is split into the cells written by the level compiler. When a cell
+/// gets within the load radius of the focus, its package is loaded in the
+/// background; once the package is ready its units are spawned, a few per
+/// update(), so that no more than the time budget is spent each frame.
+/// Cells beyond the unload radius are destroyed the same way and their
+/// packages unloaded.
+///
+/// @ingroup World
+class LevelStreamer
+{
+public:
+
+	LevelStreamer(World& world);
+	~LevelStreamer();
+
+	/// Starts streaming the level @a lr. The sounds of the level are played immediately.
+	/// Any level previously streamed is unloaded.
+	void load(const LevelResource* lr);
+
+	/// Destroys all the units spawned from the current level and unloads its packages.
+	void unload();
+
+	/// Sets the point around which the cells are loaded.
+	void set_focus(const Vector3& pos);
+
+	/// Sets the distance from the focus within which the cells are loaded
+	/// and the one beyond which they are unloaded.
+	/// @a unload must be greater than or equal to @a load.
+	void set_radius(float load, float unload);
+
+	/// Sets the @a seconds to spend spawning and destroying units each update.
+	/// At least one unit is spawned or destroyed per update regardless of the budget.
+	void set_budget(float seconds);
+
+	/// Loads and unloads cells around the focus within the time budget.
+	void update();
+
+	/// Returns the fraction of the units in the cells within
+	/// the load radius which have been spawned, from 0 to 1.
+	float progress() const;
+
+	/// Returns the seconds spent spawning and destroying units in the last update().
+	float last_update_time() const;
+
+private:
+
+	struct CellState
+	{
+		enum Enum
+		{
+			UNLOADED,
+			LOADING,
+			SPAWNING,
+			LOADED,
+			DESPAWNING
+		};
+	};
+
+	struct Cell
+	{
+		CellState::Enum state;
+		uint32_t num_spawned; // Units of the cell spawned so far, in order
+	};
+
+	struct Package
+	{
+		ResourcePackage* package;
+		uint32_t references;
+	};
+
+	/// Returns the distance of the focus from the bounds of the cell @a i.
+	float distance(uint32_t i) const;
+
+	void load_package(StringId64 id);
+	void unload_package(StringId64 id);
+	bool has_loaded_package(StringId64 id) const;
+
+	/// Spawns or destroys a unit of the cell @a i. Returns true if the cell is done.
+	bool spawn_next(uint32_t i);
+	bool destroy_next(uint32_t i);
+
+private:
+
+	World& m_world;
+	const LevelResource* m_level;
+
+	Array<Cell> m_cells;
+	Array<UnitId> m_units; // Indexed as the units of the level
+	Hash<Package> m_packages;
+
+	Vector3 m_focus;
+	float m_load_radius;
+	float m_unload_radius;
+	float m_budget;
+	float m_last_update_time;
+	bool m_loaded_event_posted;
+};
+
+} // namespace crown
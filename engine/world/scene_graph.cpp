@@ -25,72 +25,58 @@ OTHER DEALINGS IN THE SOFTWARE.
 */
 
 #include "scene_graph.h"
+#include "scene_graph_manager.h"
 #include "quaternion.h"
 #include "vector3.h"
 #include "matrix4x4.h"
-#include "allocator.h"
 #include "string_utils.h"
 
-#include <string.h>
-
-#define CLEAN		0
-#define LOCAL_DIRTY	1
-#define WORLD_DIRTY	1 << 2
-
 namespace crown
 {
 
 using namespace matrix4x4;
 
-SceneGraph::SceneGraph(Allocator& a, uint32_t index)
-	: m_allocator(&a)
-	, m_index(index)
+#define CE_SG_DATA (m_manager->m_data)
+#define CE_SG_NODE(node) (m_first + (node))
+
+SceneGraph::SceneGraph(SceneGraphManager& sgm)
+	: m_manager(&sgm)
+	, m_range(SceneGraphManager::NO_RANGE)
+	, m_first(0)
 	, m_num_nodes(0)
-	, m_flags(NULL)
-	, m_world_poses(NULL)
-	, m_local_poses(NULL)
-	, m_parents(NULL)
-	, m_names(NULL)
 {
 }
 
 void SceneGraph::create(const Matrix4x4& root, uint32_t count, const UnitNode* nodes)
 {
-	m_num_nodes = count;
+	m_manager->allocate_nodes(*this, count);
 
-	m_flags = (uint8_t*) m_allocator->allocate(sizeof(uint8_t) * count);
-	m_world_poses = (Matrix4x4*) m_allocator->allocate(sizeof(Matrix4x4) * count);
-	m_local_poses = (Matrix4x4*) m_allocator->allocate(sizeof(Matrix4x4) * count);
-	m_parents = (int32_t*) m_allocator->allocate(sizeof(int32_t) * count);
-	m_names = (StringId32*) m_allocator->allocate(sizeof(StringId32) * count);
+	SceneGraphManager::InstanceData& data = CE_SG_DATA;
 
 	for (uint32_t i = 0; i < count; i++)
 	{
-		m_flags[i] = (int) CLEAN;
-		m_local_poses[i] = nodes[i].pose;
-		m_parents[i] = -1;
-		m_names[i] = nodes[i].name;
+		const uint32_t n = CE_SG_NODE(i);
+		data.flags[n] = SceneGraphManager::CLEAN;
+		data.parent[n] = -1;
+		data.first_child[n] = -1;
+		data.next_sibling[n] = -1;
+		data.name[n] = nodes[i].name;
 	}
 
-	// Compute initial world poses
-	for (uint32_t i = 1; i < m_num_nodes; i++)
+	// Nodes without a parent have their local pose expressed in world space
+	data.local[CE_SG_NODE(0)] = SceneGraphManager::to_pose(root);
+	data.world[CE_SG_NODE(0)] = root;
+
+	for (uint32_t i = 1; i < count; i++)
 	{
-		m_world_poses[i] = root * m_local_poses[i];
+		data.world[CE_SG_NODE(i)] = root * nodes[i].pose;
+		data.local[CE_SG_NODE(i)] = SceneGraphManager::to_pose(data.world[CE_SG_NODE(i)]);
 	}
-
-	m_world_poses[0] = root;
-	m_flags[0] = WORLD_DIRTY;
-
-	update();
 }
 
 void SceneGraph::destroy()
 {
-	m_allocator->deallocate(m_flags);
-	m_allocator->deallocate(m_world_poses);
-	m_allocator->deallocate(m_local_poses);
-	m_allocator->deallocate(m_parents);
-	m_allocator->deallocate(m_names);
+	m_manager->release_nodes(*this);
 }
 
 int32_t SceneGraph::node(const char* name) const
@@ -100,9 +86,11 @@ int32_t SceneGraph::node(const char* name) const
 
 int32_t SceneGraph::node(StringId32 name) const
 {
+	const StringId32* names = CE_SG_DATA.name + m_first;
+
 	for (uint32_t i = 0; i < m_num_nodes; i++)
 	{
-		if (m_names[i] == name)
+		if (names[i] == name)
 		{
 			return i;
 		}
@@ -114,11 +102,16 @@ int32_t SceneGraph::node(StringId32 name) const
 
 bool SceneGraph::has_node(const char* name) const
 {
-	StringId32 name_hash = string::murmur2_32(name, string::strlen(name), 0);
+	return has_node(string::murmur2_32(name, string::strlen(name), 0));
+}
+
+bool SceneGraph::has_node(StringId32 name) const
+{
+	const StringId32* names = CE_SG_DATA.name + m_first;
 
 	for (uint32_t i = 0; i < m_num_nodes; i++)
 	{
-		if (m_names[i] == name_hash)
+		if (names[i] == name)
 		{
 			return true;
 		}
@@ -132,6 +125,14 @@ uint32_t SceneGraph::num_nodes() const
 	return m_num_nodes;
 }
 
+int32_t SceneGraph::parent(int32_t node) const
+{
+	CE_ASSERT(node < (int32_t) m_num_nodes, "Node does not exist");
+
+	const int32_t p = CE_SG_DATA.parent[CE_SG_NODE(node)];
+	return p == -1 ? -1 : p - (int32_t) m_first;
+}
+
 bool SceneGraph::can_link(int32_t child, int32_t parent) const
 {
 	return parent < child;
@@ -143,20 +144,24 @@ void SceneGraph::link(int32_t child, int32_t parent)
 	CE_ASSERT(parent < (int32_t) m_num_nodes, "Parent node does not exist");
 	CE_ASSERT(can_link(child, parent), "Parent must be < child");
 
-	m_world_poses[child] = matrix4x4::IDENTITY;
-	m_local_poses[child] = matrix4x4::IDENTITY;
-	m_parents[child] = parent;
+	SceneGraphManager::InstanceData& data = CE_SG_DATA;
+	data.world[CE_SG_NODE(child)] = matrix4x4::IDENTITY;
+	data.local[CE_SG_NODE(child)].position = Vector3(0, 0, 0);
+	data.local[CE_SG_NODE(child)].rotation = quaternion::IDENTITY;
+	data.local[CE_SG_NODE(child)].scale = Vector3(1, 1, 1);
+	m_manager->set_parent(CE_SG_NODE(child), parent == -1 ? -1 : (int32_t) CE_SG_NODE(parent));
 }
 
 void SceneGraph::unlink(int32_t child)
 {
 	CE_ASSERT(child < (int32_t) m_num_nodes, "Child node does not exist");
 
-	if (m_parents[child] != -1)
+	SceneGraphManager::InstanceData& data = CE_SG_DATA;
+	if (data.parent[CE_SG_NODE(child)] != -1)
 	{
 		// Copy world pose before unlinking from parent
-		m_local_poses[child] = m_world_poses[child];
-		m_parents[child] = -1;
+		data.local[CE_SG_NODE(child)] = SceneGraphManager::to_pose(data.world[CE_SG_NODE(child)]);
+		m_manager->set_parent(CE_SG_NODE(child), -1);
 	}
 }
 
@@ -164,113 +169,112 @@ void SceneGraph::set_local_position(int32_t node, const Vector3& pos)
 {
 	CE_ASSERT(node < (int32_t) m_num_nodes, "Node does not exist");
 
-	m_flags[node] |= LOCAL_DIRTY;
-	set_translation(m_local_poses[node], pos);
+	CE_SG_DATA.local[CE_SG_NODE(node)].position = pos;
+	m_manager->set_dirty(CE_SG_NODE(node));
 }
 
 void SceneGraph::set_local_rotation(int32_t node, const Quaternion& rot)
 {
 	CE_ASSERT(node < (int32_t) m_num_nodes, "Node does not exist");
 
-	m_flags[node] |= LOCAL_DIRTY;
-	set_rotation(m_local_poses[node], rot);
+	CE_SG_DATA.local[CE_SG_NODE(node)].rotation = rot;
+	m_manager->set_dirty(CE_SG_NODE(node));
+}
+
+void SceneGraph::set_local_scale(int32_t node, const Vector3& scale)
+{
+	CE_ASSERT(node < (int32_t) m_num_nodes, "Node does not exist");
+
+	CE_SG_DATA.local[CE_SG_NODE(node)].scale = scale;
+	m_manager->set_dirty(CE_SG_NODE(node));
 }
 
 void SceneGraph::set_local_pose(int32_t node, const Matrix4x4& pose)
 {
 	CE_ASSERT(node < (int32_t) m_num_nodes, "Node does not exist");
 
-	m_flags[node] |= LOCAL_DIRTY;
-	m_local_poses[node] = pose;
+	m_manager->set_local_pose(CE_SG_NODE(node), pose);
 }
 
 Vector3 SceneGraph::local_position(int32_t node) const
 {
 	CE_ASSERT(node < (int32_t) m_num_nodes, "Node does not exist");
 
-	return translation(m_local_poses[node]);
+	return CE_SG_DATA.local[CE_SG_NODE(node)].position;
 }
 
 Quaternion SceneGraph::local_rotation(int32_t node) const
 {
 	CE_ASSERT(node < (int32_t) m_num_nodes, "Node does not exist");
 
-	return to_quaternion(m_local_poses[node]);
+	return CE_SG_DATA.local[CE_SG_NODE(node)].rotation;
+}
+
+Vector3 SceneGraph::local_scale(int32_t node) const
+{
+	CE_ASSERT(node < (int32_t) m_num_nodes, "Node does not exist");
+
+	return CE_SG_DATA.local[CE_SG_NODE(node)].scale;
 }
 
 Matrix4x4 SceneGraph::local_pose(int32_t node) const
 {
 	CE_ASSERT(node < (int32_t) m_num_nodes, "Node does not exist");
 
-	return m_local_poses[node];
+	return SceneGraphManager::to_matrix4x4(CE_SG_DATA.local[CE_SG_NODE(node)]);
 }
 
 void SceneGraph::set_world_position(int32_t node, const Vector3& pos)
 {
 	CE_ASSERT(node < (int32_t) m_num_nodes, "Node does not exist");
 
-	m_flags[node] |= WORLD_DIRTY;
-	set_translation(m_world_poses[node], pos);
+	Matrix4x4 pose = CE_SG_DATA.world[CE_SG_NODE(node)];
+	set_translation(pose, pos);
+	m_manager->set_world_pose(CE_SG_NODE(node), pose);
 }
 
 void SceneGraph::set_world_rotation(int32_t node, const Quaternion& rot)
 {
 	CE_ASSERT(node < (int32_t) m_num_nodes, "Node does not exist");
 
-	m_flags[node] |= WORLD_DIRTY;
-	set_rotation(m_world_poses[node], rot);
+	Matrix4x4 pose = CE_SG_DATA.world[CE_SG_NODE(node)];
+	set_rotation(pose, rot);
+	m_manager->set_world_pose(CE_SG_NODE(node), pose);
 }
 
 void SceneGraph::set_world_pose(int32_t node, const Matrix4x4& pose)
 {
 	CE_ASSERT(node < (int32_t) m_num_nodes, "Node does not exist");
 
-	m_flags[node] |= WORLD_DIRTY;
-	m_world_poses[node] = pose;
+	m_manager->set_world_pose(CE_SG_NODE(node), pose);
 }
 
 Vector3 SceneGraph::world_position(int32_t node) const
 {
 	CE_ASSERT(node < (int32_t) m_num_nodes, "Node does not exist");
 
-	return translation(m_world_poses[node]);
+	return translation(CE_SG_DATA.world[CE_SG_NODE(node)]);
 }
 
 Quaternion SceneGraph::world_rotation(int32_t node) const
 {
 	CE_ASSERT(node < (int32_t) m_num_nodes, "Node does not exist");
 
-	return to_quaternion(m_world_poses[node]);
+	return to_quaternion(CE_SG_DATA.world[CE_SG_NODE(node)]);
 }
 
 Matrix4x4 SceneGraph::world_pose(int32_t node) const
 {
 	CE_ASSERT(node < (int32_t) m_num_nodes, "Node does not exist");
 
-	return m_world_poses[node];
+	return CE_SG_DATA.world[CE_SG_NODE(node)];
 }
 
-void SceneGraph::update()
+bool SceneGraph::has_changed(int32_t node) const
 {
-	for (uint32_t i = 0; i < m_num_nodes; i++)
-	{
-		const uint8_t my_flags = m_flags[i];
-		const uint8_t parent_flags = m_flags[m_parents[i]];
+	CE_ASSERT(node < (int32_t) m_num_nodes, "Node does not exist");
 
-		if (my_flags & LOCAL_DIRTY || parent_flags & WORLD_DIRTY)
-		{
-			if (m_parents[i] == -1)
-			{
-				m_world_poses[i] = m_local_poses[i];
-			}
-			else
-			{
-				m_world_poses[i] = m_world_poses[m_parents[i]] * m_local_poses[i];
-			}
-
-			m_flags[i] = CLEAN;
-		}
-	}
+	return (CE_SG_DATA.flags[CE_SG_NODE(node)] & SceneGraphManager::CHANGED) != 0;
 }
 
 } // namespace crown
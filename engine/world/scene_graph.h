@@ -34,12 +34,16 @@ OTHER DEALINGS IN THE SOFTWARE.
 namespace crown
 {
 
+class SceneGraphManager;
+
 /// Represents a collection of nodes, possibly linked together to form a tree.
+/// The nodes themselves live in the instance store of the owning SceneGraphManager,
+/// the graph only owns the range [m_first, m_first + m_num_nodes) of it.
 ///
 /// @ingroup World
 struct SceneGraph
 {
-	SceneGraph(Allocator& a, uint32_t index);
+	SceneGraph(SceneGraphManager& sgm);
 
 	/// Creates the graph with @a count items.
 	/// @a name, @a local and @parent are the array containing the name of the nodes,
@@ -47,7 +51,7 @@ struct SceneGraph
 	/// A parent of -1 means "no parent".
 	void create(const Matrix4x4& root, uint32_t count, const UnitNode* nodes);
 
-	/// Destroys the graph deallocating memory if necessary.
+	/// Destroys the graph releasing its nodes to the manager.
 	void destroy();
 
 	/// Returns the index of the node with the given @a name
@@ -59,9 +63,15 @@ struct SceneGraph
 	/// Returns whether the graph has the node with the given @a name.
 	bool has_node(const char* name) const;
 
+	/// @copydoc SceneGraph::has_node()
+	bool has_node(StringId32 name) const;
+
 	/// Returns the number of nodes in the graph.
 	uint32_t num_nodes() const;
 
+	/// Returns the parent of the given @a node, or -1 if it has no parent.
+	int32_t parent(int32_t node) const;
+
 	/// Returns whether the node @a child can be linked to @a parent.
 	bool can_link(int32_t child, int32_t parent) const;
 
@@ -74,25 +84,33 @@ struct SceneGraph
 	/// After unlinking, the @child local pose is set to its previous world pose.
 	void unlink(int32_t child);
 
-	/// Sets the local position, rotation or pose of the given @a node.
+	/// Sets the local position, rotation, scale or pose of the given @a node.
 	void set_local_position(int32_t node, const Vector3& pos);
 
 	/// @copydoc SceneGraph::set_local_position()
 	void set_local_rotation(int32_t node, const Quaternion& rot);
 
+	/// @copydoc SceneGraph::set_local_position()
+	void set_local_scale(int32_t node, const Vector3& scale);
+
 	/// @copydoc SceneGraph::set_local_position()
 	void set_local_pose(int32_t node, const Matrix4x4& pose);
 
-	/// Returns the local position, rotation or pose of the given @a node.
+	/// Returns the local position, rotation, scale or pose of the given @a node.
+	/// Local transforms are stored decomposed, so only local_pose() has to compose a matrix.
 	Vector3 local_position(int32_t node) const;
 
 	/// @copydoc SceneGraph::local_position()
 	Quaternion local_rotation(int32_t node) const;
 
+	/// @copydoc SceneGraph::local_position()
+	Vector3 local_scale(int32_t node) const;
+
 	/// @copydoc SceneGraph::local_position()
 	Matrix4x4 local_pose(int32_t node) const;
 
 	/// Sets the world position, rotation or pose of the given @a node.
+	/// The local pose is updated accordingly.
 	/// @note This should never be called by user code.
 	void set_world_position(int32_t node, const Vector3& pos);
 
@@ -111,21 +129,20 @@ struct SceneGraph
 	/// @copydoc SceneGraph::world_position()
 	Matrix4x4 world_pose(int32_t node) const;
 
-	/// Transforms local poses to world poses.
-	void update();
+	/// Returns whether the world pose of the given @a node changed during the last
+	/// SceneGraphManager::update().
+	bool has_changed(int32_t node) const;
 
 public:
 
-	/// Index into SceneGraphManager
-	Allocator* m_allocator;
-	uint32_t m_index;
+	SceneGraphManager* m_manager;
+
+	/// Index into SceneGraphManager's list of node ranges
+	uint32_t m_range;
 
+	/// First node in SceneGraphManager's instance store
+	uint32_t m_first;
 	uint32_t m_num_nodes;
-	uint8_t* m_flags;
-	Matrix4x4* m_world_poses;
-	Matrix4x4* m_local_poses;
-	int32_t* m_parents;
-	StringId32* m_names;
 };
 
 } // namespace crown
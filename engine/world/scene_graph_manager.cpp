@@ -28,44 +28,367 @@ OTHER DEALINGS IN THE SOFTWARE.
 #include "scene_graph.h"
 #include "array.h"
 #include "memory.h"
+#include "matrix4x4.h"
+#include "quaternion.h"
+#include "vector3.h"
+#include <string.h>
+#include <algorithm>
 
 namespace crown
 {
 
 SceneGraphManager::SceneGraphManager()
-	: m_graphs(default_allocator())
+	: m_ranges(default_allocator())
+	, m_num_released(0)
+	, m_dirty(default_allocator())
+	, m_stack(default_allocator())
+	, m_changed(default_allocator())
 {
+	memset(&m_data, 0, sizeof(m_data));
 }
 
 SceneGraphManager::~SceneGraphManager()
 {
+	default_allocator().deallocate(m_data.buffer);
 }
 
 SceneGraph* SceneGraphManager::create_scene_graph()
 {
-	uint32_t index = array::size(m_graphs);
-	SceneGraph* sg = CE_NEW(default_allocator(), SceneGraph)(default_allocator(), index);
-	array::push_back(m_graphs, sg);
-	return sg;
+	return CE_NEW(default_allocator(), SceneGraph)(*this);
 }
 
 void SceneGraphManager::destroy_scene_graph(SceneGraph* sg)
 {
 	CE_ASSERT_NOT_NULL(sg);
 
-	m_graphs[sg->m_index] = m_graphs[array::size(m_graphs) - 1];
-	m_graphs[sg->m_index]->m_index = sg->m_index;
-	array::pop_back(m_graphs);
-
+	release_nodes(*sg);
 	CE_DELETE(default_allocator(), sg);
 }
 
+void SceneGraphManager::reserve(uint32_t num_graphs, uint32_t num_nodes)
+{
+	array::reserve(m_ranges, array::size(m_ranges) + num_graphs);
+
+	if (m_data.size + num_nodes > m_data.capacity)
+	{
+		compact();
+
+		if (m_data.size + num_nodes > m_data.capacity)
+			grow(m_data.size + num_nodes);
+	}
+}
+
+void SceneGraphManager::create_scene_graphs(uint32_t count, const Matrix4x4* roots, uint32_t num_nodes, const UnitNode* nodes, SceneGraph** graphs)
+{
+	reserve(count, count * num_nodes);
+
+	const uint32_t first = m_data.size;
+	const uint32_t total = count * num_nodes;
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		graphs[i] = create_scene_graph();
+		allocate_nodes(*graphs[i], num_nodes);
+	}
+
+	memset(m_data.flags + first, CLEAN, total * sizeof(uint8_t));
+	std::fill(m_data.parent + first, m_data.parent + first + total, -1);
+	std::fill(m_data.first_child + first, m_data.first_child + first + total, -1);
+	std::fill(m_data.next_sibling + first, m_data.next_sibling + first + total, -1);
+
+	for (uint32_t n = first; n < first + total; n += num_nodes)
+	{
+		for (uint32_t i = 0; i < num_nodes; i++)
+			m_data.name[n + i] = nodes[i].name;
+	}
+
+	// Nodes without a parent have their local pose expressed in world space
+	for (uint32_t g = 0; g < count; g++)
+	{
+		const uint32_t n = first + g * num_nodes;
+		m_data.world[n] = roots[g];
+
+		for (uint32_t i = 1; i < num_nodes; i++)
+			m_data.world[n + i] = roots[g] * nodes[i].pose;
+	}
+
+	for (uint32_t n = first; n < first + total; n++)
+		m_data.local[n] = to_pose(m_data.world[n]);
+}
+
+const Array<ChangedNode>& SceneGraphManager::changed_nodes() const
+{
+	return m_changed;
+}
+
+void SceneGraphManager::allocate_nodes(SceneGraph& sg, uint32_t count)
+{
+	CE_ASSERT(sg.m_range == NO_RANGE, "Scene graph already created");
+
+	if (m_data.size + count > m_data.capacity)
+	{
+		// Reclaim released ranges before growing
+		compact();
+
+		if (m_data.size + count > m_data.capacity)
+			grow(m_data.capacity * 2 + count);
+	}
+
+	Range r;
+	r.graph = &sg;
+	r.first = m_data.size;
+	r.count = count;
+
+	sg.m_range = array::push_back(m_ranges, r);
+	sg.m_first = r.first;
+	sg.m_num_nodes = count;
+
+	m_data.size += count;
+}
+
+void SceneGraphManager::release_nodes(SceneGraph& sg)
+{
+	if (sg.m_range == NO_RANGE)
+		return;
+
+	m_ranges[sg.m_range].graph = NULL;
+	m_num_released++;
+
+	// Drop the changes reported for the graph
+	uint32_t num_changed = 0;
+	for (uint32_t i = 0; i < array::size(m_changed); i++)
+	{
+		if (m_changed[i].graph != &sg)
+			m_changed[num_changed++] = m_changed[i];
+	}
+	array::resize(m_changed, num_changed);
+
+	sg.m_range = NO_RANGE;
+	sg.m_first = 0;
+	sg.m_num_nodes = 0;
+}
+
+void SceneGraphManager::grow(uint32_t capacity)
+{
+	const uint32_t bytes = capacity * (sizeof(Matrix4x4) + sizeof(Pose) + sizeof(int32_t) * 3 + sizeof(StringId32) + sizeof(uint8_t));
+
+	InstanceData data;
+	data.size = m_data.size;
+	data.capacity = capacity;
+	data.buffer = default_allocator().allocate(bytes);
+
+	data.world = (Matrix4x4*) data.buffer;
+	data.local = (Pose*) (data.world + capacity);
+	data.parent = (int32_t*) (data.local + capacity);
+	data.first_child = (int32_t*) (data.parent + capacity);
+	data.next_sibling = (int32_t*) (data.first_child + capacity);
+	data.name = (StringId32*) (data.next_sibling + capacity);
+	data.flags = (uint8_t*) (data.name + capacity);
+
+	if (m_data.buffer != NULL)
+	{
+		memcpy(data.world, m_data.world, m_data.size * sizeof(Matrix4x4));
+		memcpy(data.local, m_data.local, m_data.size * sizeof(Pose));
+		memcpy(data.parent, m_data.parent, m_data.size * sizeof(int32_t));
+		memcpy(data.first_child, m_data.first_child, m_data.size * sizeof(int32_t));
+		memcpy(data.next_sibling, m_data.next_sibling, m_data.size * sizeof(int32_t));
+		memcpy(data.name, m_data.name, m_data.size * sizeof(StringId32));
+		memcpy(data.flags, m_data.flags, m_data.size * sizeof(uint8_t));
+
+		default_allocator().deallocate(m_data.buffer);
+	}
+
+	m_data = data;
+}
+
+void SceneGraphManager::compact()
+{
+	if (m_num_released == 0)
+		return;
+
+	// Dirty nodes are remapped while walking the ranges
+	std::sort(array::begin(m_dirty), array::end(m_dirty));
+
+	uint32_t num_ranges = 0;
+	uint32_t num_dirty = 0;
+	uint32_t cur_dirty = 0;
+	uint32_t dst = 0;
+
+	for (uint32_t i = 0; i < array::size(m_ranges); i++)
+	{
+		const Range r = m_ranges[i];
+		const int32_t shift = r.first - dst;
+
+		for (; cur_dirty < array::size(m_dirty) && m_dirty[cur_dirty] < r.first + r.count; cur_dirty++)
+		{
+			if (r.graph != NULL)
+				m_dirty[num_dirty++] = m_dirty[cur_dirty] - shift;
+		}
+
+		if (r.graph == NULL)
+			continue;
+
+		if (shift != 0)
+		{
+			memmove(m_data.world + dst, m_data.world + r.first, r.count * sizeof(Matrix4x4));
+			memmove(m_data.local + dst, m_data.local + r.first, r.count * sizeof(Pose));
+			memmove(m_data.parent + dst, m_data.parent + r.first, r.count * sizeof(int32_t));
+			memmove(m_data.first_child + dst, m_data.first_child + r.first, r.count * sizeof(int32_t));
+			memmove(m_data.next_sibling + dst, m_data.next_sibling + r.first, r.count * sizeof(int32_t));
+			memmove(m_data.name + dst, m_data.name + r.first, r.count * sizeof(StringId32));
+			memmove(m_data.flags + dst, m_data.flags + r.first, r.count * sizeof(uint8_t));
+
+			// Links never cross ranges so they all move by the same amount
+			for (uint32_t n = dst; n < dst + r.count; n++)
+			{
+				if (m_data.parent[n] != -1) m_data.parent[n] -= shift;
+				if (m_data.first_child[n] != -1) m_data.first_child[n] -= shift;
+				if (m_data.next_sibling[n] != -1) m_data.next_sibling[n] -= shift;
+			}
+		}
+
+		r.graph->m_first = dst;
+		r.graph->m_range = num_ranges;
+
+		Range nr = r;
+		nr.first = dst;
+		m_ranges[num_ranges++] = nr;
+		dst += r.count;
+	}
+
+	array::resize(m_ranges, num_ranges);
+	array::resize(m_dirty, num_dirty);
+	m_data.size = dst;
+	m_num_released = 0;
+}
+
+void SceneGraphManager::set_dirty(uint32_t i)
+{
+	if (m_data.flags[i] & DIRTY)
+		return;
+
+	m_data.flags[i] |= DIRTY;
+	array::push_back(m_dirty, i);
+}
+
+Matrix4x4 SceneGraphManager::to_matrix4x4(const Pose& p)
+{
+	Matrix4x4 m(p.rotation, p.position);
+	m.x *= p.scale.x;
+	m.y *= p.scale.y;
+	m.z *= p.scale.z;
+	return m;
+}
+
+SceneGraphManager::Pose SceneGraphManager::to_pose(const Matrix4x4& m)
+{
+	Vector3 x = matrix4x4::x(m);
+	Vector3 y = matrix4x4::y(m);
+	Vector3 z = matrix4x4::z(m);
+
+	Pose p;
+	p.position = matrix4x4::translation(m);
+	p.scale = Vector3(vector3::length(x), vector3::length(y), vector3::length(z));
+	p.rotation = matrix3x3::to_quaternion(Matrix3x3(x / p.scale.x, y / p.scale.y, z / p.scale.z));
+	return p;
+}
+
+void SceneGraphManager::set_world_pose(uint32_t i, const Matrix4x4& pose)
+{
+	const int32_t p = m_data.parent[i];
+	m_data.local[i] = to_pose(p == -1 ? pose : matrix4x4::get_inverted(m_data.world[p]) * pose);
+	m_data.world[i] = pose;
+	set_dirty(i);
+}
+
+void SceneGraphManager::set_local_pose(uint32_t i, const Matrix4x4& pose)
+{
+	m_data.local[i] = to_pose(pose);
+	set_dirty(i);
+}
+
+void SceneGraphManager::set_parent(uint32_t i, int32_t parent)
+{
+	const int32_t old_parent = m_data.parent[i];
+
+	// Remove from the children of the old parent
+	if (old_parent != -1)
+	{
+		int32_t* cur = &m_data.first_child[old_parent];
+		while (*cur != (int32_t) i)
+			cur = &m_data.next_sibling[*cur];
+		*cur = m_data.next_sibling[i];
+	}
+
+	m_data.parent[i] = parent;
+	m_data.next_sibling[i] = -1;
+
+	if (parent != -1)
+	{
+		m_data.next_sibling[i] = m_data.first_child[parent];
+		m_data.first_child[parent] = i;
+	}
+
+	set_dirty(i);
+}
+
+void SceneGraphManager::transform(const SceneGraph& sg, uint32_t i)
+{
+	array::clear(m_stack);
+	array::push_back(m_stack, i);
+
+	while (!array::empty(m_stack))
+	{
+		const uint32_t n = array::back(m_stack);
+		array::pop_back(m_stack);
+
+		const int32_t p = m_data.parent[n];
+		const Matrix4x4 local = to_matrix4x4(m_data.local[n]);
+		m_data.world[n] = p == -1 ? local : m_data.world[p] * local;
+		m_data.flags[n] = CHANGED;
+
+		ChangedNode cn;
+		cn.graph = const_cast<SceneGraph*>(&sg);
+		cn.node = n - sg.m_first;
+		array::push_back(m_changed, cn);
+
+		for (int32_t c = m_data.first_child[n]; c != -1; c = m_data.next_sibling[c])
+			array::push_back(m_stack, (uint32_t) c);
+	}
+}
+
 void SceneGraphManager::update()
 {
-	for (uint32_t i = 0; i < array::size(m_graphs); i++)
+	// Forget about the changes of the previous frame
+	for (uint32_t i = 0; i < array::size(m_changed); i++)
+	{
+		const ChangedNode& cn = m_changed[i];
+		m_data.flags[cn.graph->m_first + cn.node] &= ~CHANGED;
+	}
+	array::clear(m_changed);
+
+	compact();
+
+	// Parents precede their children in the store, so visiting the dirty
+	// nodes in order guarantees that a dirty node nested inside a dirty
+	// subtree has already been recomputed when it is reached
+	std::sort(array::begin(m_dirty), array::end(m_dirty));
+
+	uint32_t cur_range = 0;
+	for (uint32_t i = 0; i < array::size(m_dirty); i++)
 	{
-		m_graphs[i]->update();
+		const uint32_t n = m_dirty[i];
+
+		if (m_data.flags[n] & CHANGED)
+			continue;
+
+		while (m_ranges[cur_range].first + m_ranges[cur_range].count <= n)
+			cur_range++;
+
+		transform(*m_ranges[cur_range].graph, n);
 	}
+
+	array::clear(m_dirty);
 }
 
 } // namespace crown
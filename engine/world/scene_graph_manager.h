@@ -27,14 +27,33 @@ OTHER DEALINGS IN THE SOFTWARE.
 #pragma once
 
 #include "container_types.h"
+#include "math_types.h"
 
 namespace crown
 {
 
 struct SceneGraph;
+struct UnitNode;
+
+/// A node whose world pose has been recomputed by SceneGraphManager::update().
+///
+/// @ingroup World
+struct ChangedNode
+{
+	SceneGraph* graph;
+	int32_t node;
+};
 
 /// Manages a collection of scene graphs.
 ///
+/// The nodes of all the graphs in a world are stored in a single
+/// structure-of-arrays instance store. Each graph owns a contiguous
+/// range of it and nodes within a range are ordered by hierarchy depth,
+/// so that every parent precedes its children.
+///
+/// Modified nodes are put in a dirty list and update() only recomputes
+/// the subtrees rooted at them, so static nodes cost nothing.
+///
 /// @ingroup World
 class SceneGraphManager
 {
@@ -49,12 +68,113 @@ public:
 	/// Destroys the @a sg scene graph
 	void destroy_scene_graph(SceneGraph* sg);
 
-	/// Updates all the scene graphs
+	/// Makes room for @a num_graphs more graphs totalling @a num_nodes nodes,
+	/// so that creating them does not grow the store again.
+	void reserve(uint32_t num_graphs, uint32_t num_nodes);
+
+	/// Creates @a count scene graphs sharing the same @a num_nodes @a nodes,
+	/// the i-th rooted at @a roots[i], and writes them to @a graphs.
+	/// The graphs get adjacent ranges of the store, which is filled one
+	/// column at a time.
+	void create_scene_graphs(uint32_t count, const Matrix4x4* roots, uint32_t num_nodes, const UnitNode* nodes, SceneGraph** graphs);
+
+	/// Recomputes the world poses of all the dirty nodes and their descendants.
 	void update();
 
+	/// Returns the nodes whose world pose changed during the last update().
+	/// Render, audio and physics can use it to only sync what actually moved.
+	/// @note The list is valid until the next call to update().
+	const Array<ChangedNode>& changed_nodes() const;
+
+private:
+
+	/// Allocates @a count contiguous nodes at the end of the store and assigns them to @a sg.
+	void allocate_nodes(SceneGraph& sg, uint32_t count);
+
+	/// Releases the nodes owned by @a sg.
+	/// The store is compacted at the beginning of the next update().
+	void release_nodes(SceneGraph& sg);
+
+	/// Grows the store to hold at least @a capacity nodes.
+	void grow(uint32_t capacity);
+
+	/// Removes the holes left by released ranges.
+	void compact();
+
+	/// Puts the node @a i in the dirty list.
+	void set_dirty(uint32_t i);
+
+	/// Sets the world pose of node @a i and updates its local pose to match.
+	void set_world_pose(uint32_t i, const Matrix4x4& pose);
+
+	/// Sets the local pose of node @a i from the matrix @a pose.
+	void set_local_pose(uint32_t i, const Matrix4x4& pose);
+
+	/// Sets the parent of node @a i to @a parent, -1 means "no parent".
+	void set_parent(uint32_t i, int32_t parent);
+
+	/// Recomputes the world poses of the subtree rooted at node @a i.
+	void transform(const SceneGraph& sg, uint32_t i);
+
 private:
 
-	Array<SceneGraph*> m_graphs;
+	enum { NO_RANGE = 0xFFFFFFFFu };
+
+	enum
+	{
+		CLEAN = 0,
+		DIRTY = 1,
+		CHANGED = 1 << 1
+	};
+
+	/// Local transform decomposed in translation, rotation and scale.
+	struct Pose
+	{
+		Vector3 position;
+		Quaternion rotation;
+		Vector3 scale;
+	};
+
+	/// Returns the matrix composed from @a p.
+	static Matrix4x4 to_matrix4x4(const Pose& p);
+
+	/// Returns @a m decomposed in translation, rotation and scale.
+	static Pose to_pose(const Matrix4x4& m);
+
+	struct InstanceData
+	{
+		uint32_t size;
+		uint32_t capacity;
+		void* buffer;
+
+		Matrix4x4* world;
+		Pose* local;
+		int32_t* parent; // Index into the store, -1 means "no parent"
+		int32_t* first_child;
+		int32_t* next_sibling;
+		StringId32* name;
+		uint8_t* flags;
+	};
+
+	struct Range
+	{
+		SceneGraph* graph; // NULL if released
+		uint32_t first;
+		uint32_t count;
+	};
+
+	InstanceData m_data;
+
+	// Ranges of the store, ordered by first node.
+	// Released ranges are kept until the next compaction.
+	Array<Range> m_ranges;
+	uint32_t m_num_released;
+
+	Array<uint32_t> m_dirty;
+	Array<uint32_t> m_stack;
+	Array<ChangedNode> m_changed;
+
+	friend struct SceneGraph;
 };
 
 } // namespace crown
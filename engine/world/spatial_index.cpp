@@ -0,0 +1,634 @@
+/*
+Copyright (c) 2013 Daniele Bartolini, Michele Rossi
+Copyright (c) 2012 Daniele Bartolini, Simone Boscaratto
+
+Permission is hereby granted, free of charge, to any person
+obtaining a copy of this software and associated documentation
+files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use,
+copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following
+conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "spatial_index.h"
+#include "array.h"
+#include "hash.h"
+#include "vector3.h"
+#include "aabb.h"
+#include "math_utils.h"
+#include "string_utils.h"
+#include "memory.h"
+#include <algorithm>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+
+namespace crown
+{
+
+static const float GRID_CELL_SIZE = 8.0f;
+static const float OCTREE_MIN_CELL_SIZE = 8.0f;
+static const int32_t CELL_COORD_BIAS = 1 << 18;
+
+// Probing a cell hashes its key and looks it up, which costs about as
+// much as testing this many objects in a linear scan
+static const float CELL_PROBE_COST = 32.0f;
+
+namespace spatial_index_internal
+{
+	inline float distance_squared(const Vector3& p, const AABB& b)
+	{
+		const float dx = math::max(0.0f, math::max(b.min.x - p.x, p.x - b.max.x));
+		const float dy = math::max(0.0f, math::max(b.min.y - p.y, p.y - b.max.y));
+		const float dz = math::max(0.0f, math::max(b.min.z - p.z, p.z - b.max.z));
+		return dx*dx + dy*dy + dz*dz;
+	}
+
+	/// Returns the distance along an axis from the coordinate @a p, in the cell
+	/// @a c of size @a size, to the cell @a offset cells away.
+	inline float cell_gap(int32_t c, int32_t offset, float size, float p)
+	{
+		if (offset > 0)
+			return float(c + offset) * size - p;
+		if (offset < 0)
+			return p - float(c + offset + 1) * size;
+		return 0.0f;
+	}
+
+	struct SphereFilter
+	{
+		Vector3 center;
+		float radius;
+
+		bool operator()(const Vector3& c, float r) const
+		{
+			const float d = radius + r;
+			return vector3::squared_length(c - center) <= d*d;
+		}
+	};
+
+	struct BoxFilter
+	{
+		AABB box;
+
+		bool operator()(const Vector3& c, float r) const
+		{
+			return distance_squared(c, box) <= r*r;
+		}
+	};
+} // namespace spatial_index_internal
+
+SpatialIndex::SpatialIndex(Allocator& a)
+	: m_type(SpatialIndexType::OCTREE)
+	, m_objects(a)
+	, m_lookup(a)
+	, m_cells(a)
+{
+	memset(m_level_size, 0, sizeof(m_level_size));
+	clear_bounds();
+}
+
+void SpatialIndex::set_type(SpatialIndexType::Enum type)
+{
+	if (type == m_type)
+		return;
+
+	m_type = type;
+
+	hash::clear(m_cells);
+	memset(m_level_size, 0, sizeof(m_level_size));
+	clear_bounds();
+
+	for (uint32_t i = 0; i < array::size(m_objects); i++)
+		link(i);
+}
+
+SpatialIndexType::Enum SpatialIndex::type() const
+{
+	return m_type;
+}
+
+void SpatialIndex::insert(UnitId id, const Vector3& center, float radius)
+{
+	CE_ASSERT(!has(id), "Unit already in index");
+
+	if (id.index >= array::size(m_lookup))
+	{
+		const uint32_t old_size = array::size(m_lookup);
+		array::resize(m_lookup, id.index + 1);
+		for (uint32_t i = old_size; i < array::size(m_lookup); i++)
+			m_lookup[i] = NONE;
+	}
+
+	Object obj;
+	obj.unit = id;
+	obj.center = center;
+	obj.radius = radius;
+
+	const uint32_t i = array::size(m_objects);
+	array::push_back(m_objects, obj);
+	m_lookup[id.index] = i;
+	link(i);
+}
+
+void SpatialIndex::update(UnitId id, const Vector3& center, float radius)
+{
+	CE_ASSERT(has(id), "Unit not in index");
+
+	const uint32_t i = m_lookup[id.index];
+	Object& obj = m_objects[i];
+	obj.center = center;
+	obj.radius = radius;
+
+	const uint32_t level = level_for(radius);
+	const float size = cell_size(level);
+	const uint64_t cell = level == MAX_LEVELS ? cell_key(level, 0, 0, 0)
+		: cell_key(level, cell_coord(center.x, size), cell_coord(center.y, size), m_type == SpatialIndexType::GRID ? 0 : cell_coord(center.z, size));
+
+	// Most moves stay in the same cell
+	if (cell != obj.cell)
+	{
+		unlink(i);
+		link(i);
+	}
+}
+
+void SpatialIndex::update(UnitId id, const Vector3& center)
+{
+	CE_ASSERT(has(id), "Unit not in index");
+	update(id, center, m_objects[m_lookup[id.index]].radius);
+}
+
+void SpatialIndex::remove(UnitId id)
+{
+	CE_ASSERT(has(id), "Unit not in index");
+
+	const uint32_t i = m_lookup[id.index];
+	const uint32_t last = array::size(m_objects) - 1;
+
+	unlink(i);
+	m_lookup[id.index] = NONE;
+
+	if (i != last)
+	{
+		// Move the last object in the hole and fix up its links
+		Object& obj = m_objects[i];
+		obj = m_objects[last];
+		m_lookup[obj.unit.index] = i;
+
+		if (obj.prev != NONE)
+			m_objects[obj.prev].next = i;
+		else
+			hash::set(m_cells, obj.cell, i);
+
+		if (obj.next != NONE)
+			m_objects[obj.next].prev = i;
+	}
+
+	array::pop_back(m_objects);
+
+	if (array::size(m_objects) == 0)
+		clear_bounds();
+}
+
+bool SpatialIndex::has(UnitId id) const
+{
+	return id.index < array::size(m_lookup)
+		&& m_lookup[id.index] != NONE
+		&& m_objects[m_lookup[id.index]].unit.id == id.id;
+}
+
+uint32_t SpatialIndex::size() const
+{
+	return array::size(m_objects);
+}
+
+void SpatialIndex::query_sphere(const Vector3& center, float radius, Array<UnitId>& units) const
+{
+	using namespace spatial_index_internal;
+
+	const Vector3 extent(radius, radius, radius);
+	SphereFilter filter;
+	filter.center = center;
+	filter.radius = radius;
+	gather(AABB(center - extent, center + extent), filter, units);
+}
+
+void SpatialIndex::query_box(const AABB& box, Array<UnitId>& units) const
+{
+	using namespace spatial_index_internal;
+
+	BoxFilter filter;
+	filter.box = box;
+	gather(box, filter, units);
+}
+
+inline void SpatialIndex::push_nearest(UnitId unit, float distance, uint32_t k, Array<Neighbour>& nearest)
+{
+	if (array::size(nearest) < k)
+	{
+		Neighbour n;
+		n.distance = distance;
+		n.unit = unit;
+		array::push_back(nearest, n);
+		std::push_heap(array::begin(nearest), array::end(nearest));
+	}
+	else if (distance < nearest[0].distance)
+	{
+		std::pop_heap(array::begin(nearest), array::end(nearest));
+		array::back(nearest).distance = distance;
+		array::back(nearest).unit = unit;
+		std::push_heap(array::begin(nearest), array::end(nearest));
+	}
+}
+
+void SpatialIndex::query_nearest(const Vector3& point, uint32_t k, Array<UnitId>& units) const
+{
+	const uint32_t num = array::size(m_objects);
+	if (k == 0 || num == 0)
+		return;
+
+	Array<Neighbour> nearest(default_allocator());
+	array::reserve(nearest, math::min(k, num));
+
+	// Scan all the objects when the search would visit more cells than
+	// that would cost, keeping the k nearest of them in a max-heap
+	if (k >= num || !search_nearest(point, k, nearest))
+	{
+		array::clear(nearest);
+
+		float farthest = FLT_MAX;
+		for (uint32_t i = 0; i < num; i++)
+		{
+			const float dist = vector3::squared_length(m_objects[i].center - point);
+			if (dist < farthest)
+			{
+				push_nearest(m_objects[i].unit, dist, k, nearest);
+				farthest = array::size(nearest) < k ? FLT_MAX : nearest[0].distance;
+			}
+		}
+	}
+
+	std::sort_heap(array::begin(nearest), array::end(nearest));
+
+	for (uint32_t i = 0; i < array::size(nearest); i++)
+		array::push_back(units, nearest[i].unit);
+}
+
+bool SpatialIndex::search_nearest(const Vector3& point, uint32_t k, Array<Neighbour>& nearest) const
+{
+	const bool flat = m_type == SpatialIndexType::GRID;
+	const float dim = flat ? 2.0f : 3.0f;
+
+	// Visiting more cells than this costs more than scanning all the objects
+	const float budget = float(array::size(m_objects)) / CELL_PROBE_COST;
+	float visited = 0.0f;
+
+	// Volume of the unit ball and volume per center, as if the centers
+	// were spread evenly over their bounds
+	const float ball = flat ? math::PI : math::PI * 4.0f / 3.0f;
+	const Vector3 extent = m_bounds.max - m_bounds.min;
+	float volume_per_center = math::max(extent.x, cell_size(0)) * math::max(extent.y, cell_size(0));
+	if (!flat)
+		volume_per_center *= math::max(extent.z, cell_size(0));
+	volume_per_center /= float(array::size(m_objects));
+
+	// The cell of each level containing the point and the next ring of
+	// cells around it to visit
+	NearestSearch levels[MAX_LEVELS];
+	uint32_t active = 0;
+
+	for (uint32_t l = 0; l < num_levels(); l++)
+	{
+		if (m_level_size[l] == 0)
+			continue;
+
+		NearestSearch& ls = levels[l];
+		ls.size = cell_size(l);
+		ls.x = cell_coord(point.x, ls.size);
+		ls.y = cell_coord(point.y, ls.size);
+		ls.z = flat ? 0 : cell_coord(point.z, ls.size);
+		ls.ring = 0;
+		ls.visited = 0.0f;
+
+		// Distance of the point from the nearest face of its cell
+		ls.margin = math::min(point.x - float(ls.x) * ls.size, float(ls.x + 1) * ls.size - point.x);
+		ls.margin = math::min(ls.margin, math::min(point.y - float(ls.y) * ls.size, float(ls.y + 1) * ls.size - point.y));
+		if (!flat)
+			ls.margin = math::min(ls.margin, math::min(point.z - float(ls.z) * ls.size, float(ls.z + 1) * ls.size - point.z));
+		ls.margin = math::max(0.0f, ls.margin);
+
+		active |= 1u << l;
+	}
+
+	// Objects too big for any level share a single cell
+	uint32_t i = hash::get(m_cells, cell_key(MAX_LEVELS, 0, 0, 0), (uint32_t) NONE);
+	for (; i != NONE; i = m_objects[i].next)
+	{
+		if (m_objects[i].level == MAX_LEVELS)
+			push_nearest(m_objects[i].unit, vector3::squared_length(m_objects[i].center - point), k, nearest);
+	}
+
+	// Visit the rings of cells of all the levels in order of distance,
+	// until the next ring is farther than the k-th nearest center found
+	while (active != 0)
+	{
+		uint32_t next = 0;
+		float searched = FLT_MAX;
+		for (uint32_t l = 0; l < num_levels(); l++)
+		{
+			if ((active & (1u << l)) && levels[l].distance() < searched)
+			{
+				next = l;
+				searched = levels[next].distance();
+			}
+		}
+
+		const bool full = array::size(nearest) == k;
+		if (full && searched * searched > nearest[0].distance)
+			return true;
+
+		// All the centers closer than searched have been found. Guess how far
+		// the k-th nearest is from their density, or use it once found, and give
+		// up if the rings needed to get there cost more than a linear scan.
+		float reach = 0.0f;
+		if (full)
+		{
+			reach = sqrtf(nearest[0].distance);
+		}
+		else
+		{
+			uint32_t num_within = 0;
+			for (uint32_t j = 0; j < array::size(nearest); j++)
+				num_within += nearest[j].distance <= searched * searched;
+
+			// Blend in the density over the bounds as if it had been
+			// measured in the volume holding one center
+			const float searched_volume = ball * powf(searched, dim);
+			const float density = float(num_within + 1) / (searched_volume + volume_per_center);
+			reach = math::max(searched, powf(float(k) / (density * ball), 1.0f / dim));
+		}
+
+		float predicted = 0.0f;
+		for (uint32_t l = 0; l < num_levels(); l++)
+		{
+			if (active & (1u << l))
+				predicted += levels[l].cells_until(reach, flat);
+		}
+
+		if (visited + predicted > budget)
+			return false;
+
+		const float num = visit_ring(next, levels[next], point, k, nearest);
+		levels[next].visited += num;
+		levels[next].ring++;
+		visited += num;
+	}
+
+	return true;
+}
+
+float SpatialIndex::visit_ring(uint32_t level, const NearestSearch& ls, const Vector3& point, uint32_t k, Array<Neighbour>& nearest) const
+{
+	using namespace spatial_index_internal;
+
+	const int32_t r = ls.ring;
+	const int32_t rz = m_type == SpatialIndexType::GRID ? 0 : r;
+	float num = 0.0f;
+
+	for (int32_t z = -rz; z <= rz; z++)
+	{
+		const float gz = cell_gap(ls.z, z, ls.size, point.z);
+
+		for (int32_t y = -r; y <= r; y++)
+		{
+			const float gy = cell_gap(ls.y, y, ls.size, point.y);
+
+			// Rows inside the ring only have a cell at each end
+			const bool inside = (z != -r && z != r) && (y != -r && y != r);
+			const int32_t step = inside ? 2 * r : 1;
+
+			for (int32_t x = -r; x <= r; x += step)
+			{
+				// Skip the cells farther than the k-th nearest center found
+				const float gx = cell_gap(ls.x, x, ls.size, point.x);
+				if (array::size(nearest) == k && gx*gx + gy*gy + gz*gz > nearest[0].distance)
+					continue;
+
+				uint32_t i = hash::get(m_cells, cell_key(level, ls.x + x, ls.y + y, ls.z + z), (uint32_t) NONE);
+				for (; i != NONE; i = m_objects[i].next)
+				{
+					if (m_objects[i].level == level)
+						push_nearest(m_objects[i].unit, vector3::squared_length(m_objects[i].center - point), k, nearest);
+				}
+
+				num += 1.0f;
+			}
+		}
+	}
+
+	return num;
+}
+
+float SpatialIndex::NearestSearch::distance() const
+{
+	return ring == 0 ? 0.0f : float(ring - 1) * size + margin;
+}
+
+float SpatialIndex::NearestSearch::cells_until(float reach, bool flat) const
+{
+	// Cells overlapping a ball of radius reach, which is about the volume
+	// of the ball grown by a cell
+	const float r = reach / size;
+	const float cells = flat
+		? 1.0f + 4.0f * r + math::PI * r*r
+		: 1.0f + 6.0f * r + 3.0f * math::PI * r*r + math::PI * 4.0f / 3.0f * r*r*r;
+
+	return math::max(0.0f, cells - visited);
+}
+
+float SpatialIndex::num_cells(uint32_t level, const AABB& bounds) const
+{
+	const float size = cell_size(level);
+	const float loose = size * 0.5f;
+	const int32_t x0 = cell_coord(bounds.min.x - loose, size);
+	const int32_t x1 = cell_coord(bounds.max.x + loose, size);
+	const int32_t y0 = cell_coord(bounds.min.y - loose, size);
+	const int32_t y1 = cell_coord(bounds.max.y + loose, size);
+	const int32_t z0 = m_type == SpatialIndexType::GRID ? 0 : cell_coord(bounds.min.z - loose, size);
+	const int32_t z1 = m_type == SpatialIndexType::GRID ? 0 : cell_coord(bounds.max.z + loose, size);
+
+	return float(x1 - x0 + 1) * float(y1 - y0 + 1) * float(z1 - z0 + 1);
+}
+
+bool SpatialIndex::scans_level(uint32_t level, const AABB& bounds) const
+{
+	return num_cells(level, bounds) * CELL_PROBE_COST > float(m_level_size[level]);
+}
+
+uint32_t SpatialIndex::num_levels() const
+{
+	return m_type == SpatialIndexType::GRID ? 1 : MAX_LEVELS;
+}
+
+float SpatialIndex::cell_size(uint32_t level) const
+{
+	return m_type == SpatialIndexType::GRID ? GRID_CELL_SIZE : OCTREE_MIN_CELL_SIZE * float(1u << level);
+}
+
+uint32_t SpatialIndex::level_for(float radius) const
+{
+	// Cells are loose by half their size on each side
+	uint32_t level = 0;
+	while (level < num_levels() && radius > cell_size(level) * 0.5f)
+		level++;
+
+	return level == num_levels() ? MAX_LEVELS : level;
+}
+
+int32_t SpatialIndex::cell_coord(float v, float size) const
+{
+	const float c = floorf(v / size);
+	return (int32_t) math::clamp(float(-CELL_COORD_BIAS), float(CELL_COORD_BIAS - 1), c);
+}
+
+uint64_t SpatialIndex::cell_key(uint32_t level, int32_t x, int32_t y, int32_t z) const
+{
+	const uint64_t key = (uint64_t(level) << 57)
+		| (uint64_t(x + CELL_COORD_BIAS) << 38)
+		| (uint64_t(y + CELL_COORD_BIAS) << 19)
+		| uint64_t(z + CELL_COORD_BIAS);
+
+	// Spread neighbouring cells across the hash buckets
+	return string::murmur2_64(&key, sizeof(key), 0);
+}
+
+void SpatialIndex::clear_bounds()
+{
+	m_bounds.min = Vector3(FLT_MAX, FLT_MAX, FLT_MAX);
+	m_bounds.max = Vector3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+}
+
+void SpatialIndex::link(uint32_t i)
+{
+	Object& obj = m_objects[i];
+	obj.level = level_for(obj.radius);
+
+	if (obj.level == MAX_LEVELS)
+	{
+		obj.cell = cell_key(MAX_LEVELS, 0, 0, 0);
+	}
+	else
+	{
+		const float size = cell_size(obj.level);
+		obj.cell = cell_key(obj.level
+			, cell_coord(obj.center.x, size)
+			, cell_coord(obj.center.y, size)
+			, m_type == SpatialIndexType::GRID ? 0 : cell_coord(obj.center.z, size));
+	}
+
+	const uint32_t first = hash::get(m_cells, obj.cell, (uint32_t) NONE);
+	obj.prev = NONE;
+	obj.next = first;
+
+	if (first != NONE)
+		m_objects[first].prev = i;
+
+	hash::set(m_cells, obj.cell, i);
+	m_level_size[obj.level]++;
+
+	aabb::add_points(m_bounds, 1, &obj.center);
+}
+
+void SpatialIndex::unlink(uint32_t i)
+{
+	Object& obj = m_objects[i];
+
+	if (obj.prev != NONE)
+		m_objects[obj.prev].next = obj.next;
+	else if (obj.next != NONE)
+		hash::set(m_cells, obj.cell, obj.next);
+	else
+		hash::remove(m_cells, obj.cell);
+
+	if (obj.next != NONE)
+		m_objects[obj.next].prev = obj.prev;
+
+	m_level_size[obj.level]--;
+}
+
+template <typename Filter>
+void SpatialIndex::gather(const AABB& bounds, const Filter& filter, Array<UnitId>& units) const
+{
+	// Levels where probing the cells would cost more than testing all
+	// their objects are scanned linearly instead
+	uint32_t scan_levels = 0;
+
+	for (uint32_t l = 0; l < num_levels(); l++)
+	{
+		if (m_level_size[l] == 0)
+			continue;
+
+		if (scans_level(l, bounds))
+		{
+			scan_levels |= 1u << l;
+			continue;
+		}
+
+		const float size = cell_size(l);
+		const float loose = size * 0.5f;
+		const int32_t x0 = cell_coord(bounds.min.x - loose, size);
+		const int32_t x1 = cell_coord(bounds.max.x + loose, size);
+		const int32_t y0 = cell_coord(bounds.min.y - loose, size);
+		const int32_t y1 = cell_coord(bounds.max.y + loose, size);
+		const int32_t z0 = m_type == SpatialIndexType::GRID ? 0 : cell_coord(bounds.min.z - loose, size);
+		const int32_t z1 = m_type == SpatialIndexType::GRID ? 0 : cell_coord(bounds.max.z + loose, size);
+
+		for (int32_t z = z0; z <= z1; z++)
+		{
+			for (int32_t y = y0; y <= y1; y++)
+			{
+				for (int32_t x = x0; x <= x1; x++)
+				{
+					uint32_t i = hash::get(m_cells, cell_key(l, x, y, z), (uint32_t) NONE);
+					for (; i != NONE; i = m_objects[i].next)
+					{
+						const Object& obj = m_objects[i];
+						if (obj.level == l && filter(obj.center, obj.radius))
+							array::push_back(units, obj.unit);
+					}
+				}
+			}
+		}
+	}
+
+	if (m_level_size[MAX_LEVELS] != 0)
+		scan_levels |= 1u << MAX_LEVELS;
+
+	if (scan_levels == 0)
+		return;
+
+	for (uint32_t i = 0; i < array::size(m_objects); i++)
+	{
+		const Object& obj = m_objects[i];
+		if ((scan_levels & (1u << obj.level)) && filter(obj.center, obj.radius))
+			array::push_back(units, obj.unit);
+	}
+}
+
+} // namespace crown
@@ -0,0 +1,199 @@
+/*
+Copyright (c) 2013 Daniele Bartolini, Michele Rossi
+Copyright (c) 2012 Daniele Bartolini, Simone Boscaratto
+
+Permission is hereby granted, free of charge, to any person
+obtaining a copy of this software and associated documentation
+files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use,
+copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following
+conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#pragma once
+
+#include "container_types.h"
+#include "math_types.h"
+#include "world_types.h"
+
+namespace crown
+{
+
+/// Enumerates the structures a SpatialIndex can use.
+///
+/// @ingroup World
+struct SpatialIndexType
+{
+	enum Enum
+	{
+		GRID,	// Loose grid on the XY plane, for 2D worlds
+		OCTREE,	// Loose octree, for 3D worlds
+		COUNT
+	};
+};
+
+/// Broad-phase index of the bounding spheres of the units in a World.
+///
+/// Cells are loose: an object is stored in the cell containing its center
+/// and may overhang it by half the cell size. The octree is stored as a
+/// hashed set of loose grids, one per depth, each twice as coarse as the
+/// previous, and every object is put at the finest depth whose cells can
+/// hold it. Neither structure needs the bounds of the world in advance.
+///
+/// @ingroup World
+class SpatialIndex
+{
+public:
+
+	SpatialIndex(Allocator& a);
+
+	/// Switches the index to the structure @a type, rebuilding it.
+	void set_type(SpatialIndexType::Enum type);
+
+	/// Returns the structure currently used by the index.
+	SpatialIndexType::Enum type() const;
+
+	/// Adds the unit @a id with the bounding sphere (@a center, @a radius).
+	void insert(UnitId id, const Vector3& center, float radius);
+
+	/// Moves the bounding sphere of the unit @a id to (@a center, @a radius).
+	void update(UnitId id, const Vector3& center, float radius);
+
+	/// @copydoc SpatialIndex::update()
+	/// The radius is left unchanged.
+	void update(UnitId id, const Vector3& center);
+
+	/// Removes the unit @a id.
+	void remove(UnitId id);
+
+	/// Returns whether the unit @a id is in the index.
+	bool has(UnitId id) const;
+
+	/// Returns the number of units in the index.
+	uint32_t size() const;
+
+	/// Appends to @a units the units whose bounding sphere overlaps the sphere (@a center, @a radius).
+	void query_sphere(const Vector3& center, float radius, Array<UnitId>& units) const;
+
+	/// Appends to @a units the units whose bounding sphere overlaps @a box.
+	void query_box(const AABB& box, Array<UnitId>& units) const;
+
+	/// Appends to @a units the (at most) @a k units whose center is nearest
+	/// to @a point, ordered by increasing distance.
+	void query_nearest(const Vector3& point, uint32_t k, Array<UnitId>& units) const;
+
+private:
+
+	enum { NONE = 0xFFFFFFFFu };
+	enum { MAX_LEVELS = 16 };
+
+	struct Object
+	{
+		UnitId unit;
+		Vector3 center;
+		float radius;
+		uint64_t cell;
+		uint32_t level;
+		uint32_t prev;
+		uint32_t next;
+	};
+
+	struct Neighbour
+	{
+		float distance; // Squared
+		UnitId unit;
+
+		bool operator<(const Neighbour& other) const
+		{
+			return distance < other.distance;
+		}
+	};
+
+	/// The cell of a level containing the point of a query_nearest()
+	/// and the next ring of cells around it to visit.
+	struct NearestSearch
+	{
+		int32_t x;
+		int32_t y;
+		int32_t z;
+		int32_t ring;
+		float size;
+		float margin; // Distance of the point from the nearest face of its cell
+		float visited; // Cells visited so far
+
+		/// Returns the distance from the point within which all the cells have been visited.
+		float distance() const;
+
+		/// Returns about how many cells are left to visit to find all
+		/// the centers within @a reach, in two dimensions if @a flat.
+		float cells_until(float reach, bool flat) const;
+	};
+
+	/// Returns the number of cells of @a level overlapped by @a bounds.
+	float num_cells(uint32_t level, const AABB& bounds) const;
+
+	/// Returns whether gather() scans @a level linearly rather than probing its cells.
+	bool scans_level(uint32_t level, const AABB& bounds) const;
+
+	uint32_t num_levels() const;
+	float cell_size(uint32_t level) const;
+	uint32_t level_for(float radius) const;
+	uint64_t cell_key(uint32_t level, int32_t x, int32_t y, int32_t z) const;
+	int32_t cell_coord(float v, float size) const;
+
+	/// Finds the @a k nearest centers to @a point visiting rings of cells of
+	/// growing distance. Returns false as soon as that would cost more than
+	/// scanning all the objects, leaving @a nearest incomplete.
+	bool search_nearest(const Vector3& point, uint32_t k, Array<Neighbour>& nearest) const;
+
+	/// Adds to @a nearest the objects in the cells of the ring @a ls.ring
+	/// of @a level. Returns the number of cells visited.
+	float visit_ring(uint32_t level, const NearestSearch& ls, const Vector3& point, uint32_t k, Array<Neighbour>& nearest) const;
+
+	/// Adds @a unit, whose center is at the squared @a distance, to the
+	/// max-heap of the @a k nearest units.
+	static void push_nearest(UnitId unit, float distance, uint32_t k, Array<Neighbour>& nearest);
+
+	void clear_bounds();
+	void link(uint32_t i);
+	void unlink(uint32_t i);
+
+	/// Calls @a filter on every object whose loose cell overlaps @a bounds.
+	template <typename Filter> void gather(const AABB& bounds, const Filter& filter, Array<UnitId>& units) const;
+
+private:
+
+	SpatialIndexType::Enum m_type;
+	Array<Object> m_objects;
+
+	// UnitId::index -> index into m_objects
+	Array<uint32_t> m_lookup;
+
+	// Cell key -> first object in the cell
+	Hash<uint32_t> m_cells;
+
+	// Number of objects at each level, the last one holds the
+	// objects too big for any level
+	uint32_t m_level_size[MAX_LEVELS + 1];
+
+	// Bounds of the centers linked since the index was last empty or
+	// rebuilt, they only grow
+	AABB m_bounds;
+};
+
+} // namespace crown
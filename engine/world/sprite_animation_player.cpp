@@ -25,48 +25,182 @@ OTHER DEALINGS IN THE SOFTWARE.
 */
 
 #include "sprite_animation_player.h"
+#include "sprite.h"
 #include "array.h"
 #include "memory.h"
+#include "assert.h"
+#include <math.h>
 
 namespace crown
 {
 
 SpriteAnimationPlayer::SpriteAnimationPlayer()
-	: m_animations(default_allocator())
+	: m_sparse(default_allocator())
+	, m_sparse_to_dense(default_allocator())
+	, m_dense_to_sparse(default_allocator())
+	, m_freelist(INVALID_ID)
+	, m_next_id(0)
+	, m_resource(default_allocator())
+	, m_animation(default_allocator())
+	, m_frames(default_allocator())
+	, m_time(default_allocator())
+	, m_frame(default_allocator())
+	, m_speed(default_allocator())
+	, m_loop(default_allocator())
+	, m_sprite(default_allocator())
 {
 }
 
-SpriteAnimation* SpriteAnimationPlayer::create_sprite_animation(const SpriteAnimationResource* sar)
+SpriteAnimationId SpriteAnimationPlayer::create_sprite_animation(const SpriteAnimationResource* sar, Sprite* sprite)
 {
-	SpriteAnimation* anim = CE_NEW(default_allocator(), SpriteAnimation)(sar);
-	array::push_back(m_animations, anim);
-	return anim;
+	CE_ASSERT(array::size(m_resource) < INVALID_ID - 1, "Max sprite animation number reached");
+
+	SpriteAnimationId id;
+	id.id = m_next_id++;
+	if (m_next_id == INVALID_ID)
+		m_next_id = 0;
+
+	// Recycle slot if there are any
+	if (m_freelist != INVALID_ID)
+	{
+		id.index = m_freelist;
+		m_freelist = m_sparse[m_freelist].index;
+	}
+	else
+	{
+		id.index = array::size(m_sparse);
+		array::push_back(m_sparse, id);
+		array::push_back(m_sparse_to_dense, uint16_t(0));
+	}
+
+	m_sparse[id.index] = id;
+	m_sparse_to_dense[id.index] = array::size(m_resource);
+	array::push_back(m_dense_to_sparse, id.index);
+
+	array::push_back(m_resource, sar);
+	array::push_back(m_animation, (const SpriteAnimationData*) NULL);
+	array::push_back(m_frames, sprite_animation_resource::get_animation_frames(sar));
+	array::push_back(m_time, 0.0f);
+	array::push_back(m_frame, uint32_t(0));
+	array::push_back(m_speed, 1.0f);
+	array::push_back(m_loop, uint8_t(0));
+	array::push_back(m_sprite, sprite);
+
+	return id;
 }
 
-void SpriteAnimationPlayer::destroy_sprite_animation(SpriteAnimation* anim)
+void SpriteAnimationPlayer::destroy_sprite_animation(SpriteAnimationId id)
 {
-	const uint32_t num = array::size(m_animations);
+	const uint16_t dense = index(id);
+	m_sparse[id.index].id = INVALID_ID;
+	m_sparse[id.index].index = m_freelist;
+	m_freelist = id.index;
+
+	// Swap with last element
+	const uint16_t last = array::size(m_resource) - 1;
+	const uint16_t last_sparse = m_dense_to_sparse[last];
+	m_dense_to_sparse[dense] = last_sparse;
+	m_sparse_to_dense[last_sparse] = dense;
+	array::pop_back(m_dense_to_sparse);
+
+	m_resource[dense] = m_resource[last];
+	m_animation[dense] = m_animation[last];
+	m_frames[dense] = m_frames[last];
+	m_time[dense] = m_time[last];
+	m_frame[dense] = m_frame[last];
+	m_speed[dense] = m_speed[last];
+	m_loop[dense] = m_loop[last];
+	m_sprite[dense] = m_sprite[last];
+
+	array::pop_back(m_resource);
+	array::pop_back(m_animation);
+	array::pop_back(m_frames);
+	array::pop_back(m_time);
+	array::pop_back(m_frame);
+	array::pop_back(m_speed);
+	array::pop_back(m_loop);
+	array::pop_back(m_sprite);
+}
+
+void SpriteAnimationPlayer::play(SpriteAnimationId id, StringId32 name, bool loop)
+{
+	const uint16_t i = index(id);
+	if (m_animation[i])
+		return;
+
+	m_animation[i] = sprite_animation_resource::get_animation(m_resource[i], name);
+	m_time[i] = 0.0f;
+	m_loop[i] = loop;
+}
+
+void SpriteAnimationPlayer::stop(SpriteAnimationId id)
+{
+	stop_index(index(id));
+}
+
+void SpriteAnimationPlayer::set_speed(SpriteAnimationId id, float speed)
+{
+	m_speed[index(id)] = speed;
+}
+
+void SpriteAnimationPlayer::update(float dt)
+{
+	const uint32_t num = array::size(m_resource);
+
+	const SpriteAnimationData** animation = array::begin(m_animation);
+	const uint32_t* const* frames = array::begin(m_frames);
+	float* time = array::begin(m_time);
+	uint32_t* cur_frame = array::begin(m_frame);
+	const float* speed = array::begin(m_speed);
+	const uint8_t* loop = array::begin(m_loop);
+	Sprite** sprite = array::begin(m_sprite);
 
 	for (uint32_t i = 0; i < num; i++)
 	{
-		if (anim == m_animations[i])
+		const SpriteAnimationData* anim = animation[i];
+		if (!anim)
+			continue;
+
+		float t = time[i] + dt * speed[i];
+
+		if (t >= anim->time)
+		{
+			if (!loop[i])
+			{
+				stop_index(i);
+				continue;
+			}
+
+			t = anim->time > 0.0f ? fmodf(t, anim->time) : 0.0f;
+		}
+
+		time[i] = t;
+
+		uint32_t local = uint32_t(anim->num_frames * (t / anim->time));
+		local = local < anim->num_frames ? local : anim->num_frames - 1;
+		const uint32_t frame = frames[i][anim->first_frame + local];
+
+		// Only touch the sprite when the frame actually changes
+		if (frame != cur_frame[i])
 		{
-			CE_DELETE(default_allocator(), anim);
-			m_animations[i] = m_animations[num - 1];
-			array::pop_back(m_animations);
-			return;
+			cur_frame[i] = frame;
+			sprite[i]->m_frame = frame;
 		}
 	}
 }
 
-void SpriteAnimationPlayer::update(float dt)
+uint16_t SpriteAnimationPlayer::index(SpriteAnimationId id) const
 {
-	const uint32_t num = array::size(m_animations);
+	CE_ASSERT(id.index < array::size(m_sparse) && m_sparse[id.index].id == id.id, "Sprite animation does not exist");
+	return m_sparse_to_dense[id.index];
+}
 
-	for (uint32_t i = 0; i < num; i++)
-	{
-		m_animations[i]->update(dt);
-	}
+void SpriteAnimationPlayer::stop_index(uint16_t i)
+{
+	m_animation[i] = NULL;
+	m_time[i] = 0.0f;
+	m_frame[i] = 0;
+	m_sprite[i]->m_frame = 0;
 }
 
 } // namespace crown
@@ -28,23 +28,66 @@ OTHER DEALINGS IN THE SOFTWARE.
 
 #include "sprite_resource.h"
 #include "container_types.h"
-#include "sprite_animation.h"
+#include "id_array.h"
 
 namespace crown
 {
 
+struct Sprite;
+typedef Id SpriteAnimationId;
+
+/// Plays the frame animations of sprites.
+///
+/// The state of the animations is kept in contiguous arrays and updated
+/// in a single pass which writes the current frame straight into the
+/// animated sprite.
+///
+/// @ingroup World
 struct SpriteAnimationPlayer
 {
 	SpriteAnimationPlayer();
 
-	SpriteAnimation* create_sprite_animation(const SpriteAnimationResource* sar);
-	void destroy_sprite_animation(SpriteAnimation* anim);
+	/// Creates a new animation from @a sar which drives the frame of @a sprite.
+	SpriteAnimationId create_sprite_animation(const SpriteAnimationResource* sar, Sprite* sprite);
+
+	/// Destroys the animation @a id.
+	void destroy_sprite_animation(SpriteAnimationId id);
+
+	/// Plays the animation @a name of @a id, if @a id is not playing already.
+	void play(SpriteAnimationId id, StringId32 name, bool loop);
+
+	/// Stops the animation @a id and resets its sprite to the first frame.
+	void stop(SpriteAnimationId id);
+
+	/// Sets the playback speed of @a id, 1.0 being the speed of the resource.
+	void set_speed(SpriteAnimationId id, float speed);
 
+	/// Advances all the animations by @a dt.
 	void update(float dt);
 
 private:
 
-	Array<SpriteAnimation*> m_animations;
+	uint16_t index(SpriteAnimationId id) const;
+	void stop_index(uint16_t i);
+
+private:
+
+	// Animations are stored densely and ids refer to slots in
+	// m_sparse which map to the dense index.
+	Array<Id> m_sparse;
+	Array<uint16_t> m_sparse_to_dense;
+	Array<uint16_t> m_dense_to_sparse;
+	uint16_t m_freelist;
+	uint16_t m_next_id;
+
+	Array<const SpriteAnimationResource*> m_resource;
+	Array<const SpriteAnimationData*> m_animation; // NULL if not playing
+	Array<const uint32_t*> m_frames;
+	Array<float> m_time;
+	Array<uint32_t> m_frame;
+	Array<float> m_speed;
+	Array<uint8_t> m_loop;
+	Array<Sprite*> m_sprite;
 };
 
 } // namespace crown
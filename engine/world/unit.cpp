@@ -36,19 +36,20 @@ OTHER DEALINGS IN THE SOFTWARE.
 #include "device.h"
 #include "resource_manager.h"
 #include "sprite.h"
+#include "mesh.h"
 #include "sprite_animation_player.h"
+#include "unit_template.h"
 
 namespace crown
 {
 
 using namespace unit_resource;
 
-Unit::Unit(World& w, UnitId unit_id, StringId64 resid, const UnitResource* ur, const Matrix4x4& pose)
+Unit::Unit(World& w, UnitId unit_id, const UnitTemplate& ut, const Matrix4x4& pose)
 	: m_world(w)
 	, m_scene_graph(*w.scene_graph_manager()->create_scene_graph())
-	, m_sprite_animation(NULL)
-	, m_resource_id(resid)
-	, m_resource(ur)
+	, m_resource_id(ut.name)
+	, m_resource(ut.resource)
 	, m_id(unit_id)
 	, m_num_cameras(0)
 	, m_num_meshes(0)
@@ -58,7 +59,29 @@ Unit::Unit(World& w, UnitId unit_id, StringId64 resid, const UnitResource* ur, c
 	, m_values(NULL)
 {
 	m_controller.component.id = INVALID_ID;
-	create_objects(pose);
+	m_sprite_animation.id = INVALID_ID;
+	m_animation.id = INVALID_ID;
+	m_scene_graph.create(pose, ut.num_nodes, ut.nodes);
+	create_objects(ut, NULL);
+}
+
+Unit::Unit(World& w, UnitId unit_id, const UnitTemplate& ut, SceneGraph& sg, const MeshId* meshes)
+	: m_world(w)
+	, m_scene_graph(sg)
+	, m_resource_id(ut.name)
+	, m_resource(ut.resource)
+	, m_id(unit_id)
+	, m_num_cameras(0)
+	, m_num_meshes(0)
+	, m_num_sprites(0)
+	, m_num_actors(0)
+	, m_num_materials(0)
+	, m_values(NULL)
+{
+	m_controller.component.id = INVALID_ID;
+	m_sprite_animation.id = INVALID_ID;
+	m_animation.id = INVALID_ID;
+	create_objects(ut, meshes);
 }
 
 Unit::~Unit()
@@ -82,32 +105,40 @@ const UnitResource*	Unit::resource() const
 	return m_resource;
 }
 
-void Unit::create_objects(const Matrix4x4& pose)
+void Unit::create_objects(const UnitTemplate& ut, const MeshId* meshes)
 {
-	using namespace unit_resource;
-	m_scene_graph.create(pose, num_scene_graph_nodes(m_resource), scene_graph_nodes(m_resource));
-
 	create_camera_objects();
-	create_renderable_objects();
-	create_physics_objects();
+	create_renderable_objects(ut, meshes);
+	create_physics_objects(ut);
 
 	set_default_material();
 
 	m_values = (char*) default_allocator().allocate(values_size(m_resource));
 	memcpy(m_values, values(m_resource), values_size(m_resource));
 
-	StringId64 anim_id = sprite_animation(m_resource);
-	if (anim_id != 0)
+	if (ut.sprite_animation != NULL)
 	{
-		m_sprite_animation = m_world.sprite_animation_player()->create_sprite_animation((SpriteAnimationResource*) device()->resource_manager()->get(SPRITE_ANIMATION_TYPE, anim_id));
+		m_sprite_animation = m_world.sprite_animation_player()->create_sprite_animation(ut.sprite_animation, sprite(0u));
+	}
+
+	if (ut.skeleton != NULL)
+	{
+		m_animation = m_world.animation_player()->create_animation(ut.skeleton, m_scene_graph);
 	}
 }
 
 void Unit::destroy_objects()
 {
-	if (m_sprite_animation)
+	if (m_sprite_animation.id != INVALID_ID)
 	{
 		m_world.sprite_animation_player()->destroy_sprite_animation(m_sprite_animation);
+		m_sprite_animation.id = INVALID_ID;
+	}
+
+	if (m_animation.id != INVALID_ID)
+	{
+		m_world.animation_player()->destroy_animation(m_animation);
+		m_animation.id = INVALID_ID;
 	}
 
 	default_allocator().deallocate(m_values);
@@ -168,46 +199,34 @@ void Unit::create_camera_objects()
 	}
 }
 
-void Unit::create_renderable_objects()
+void Unit::create_renderable_objects(const UnitTemplate& ut, const MeshId* meshes)
 {
-	// Create renderables
-	for (uint32_t i = 0; i < num_renderables(m_resource); i++)
+	RenderWorld* rw = m_world.render_world();
+
+	for (uint32_t i = 0; i < ut.num_meshes; i++)
 	{
-		const UnitRenderable* ur = get_renderable(m_resource, i);
+		const TemplateRenderable& tr = ut.meshes[i];
+		add_mesh(tr.name, meshes != NULL ? meshes[i] : rw->create_mesh((MeshResource*) tr.resource, m_scene_graph, tr.node));
+	}
 
-		if (ur->type == UnitRenderable::MESH)
-		{
-			MeshResource* mr = (MeshResource*) device()->resource_manager()->get(MESH_TYPE, ur->resource);
-			MeshId mesh = m_world.render_world()->create_mesh(mr, m_scene_graph, ur->node);
-			add_mesh(ur->name, mesh);
-		}
-		else if (ur->type == UnitRenderable::SPRITE)
-		{
-			SpriteResource* sr = (SpriteResource*) device()->resource_manager()->get(SPRITE_TYPE, ur->resource);
-			SpriteId sprite = m_world.render_world()->create_sprite(sr, m_scene_graph, ur->node);
-			add_sprite(ur->name, sprite);
-		}
-		else
-		{
-			CE_FATAL("Oops, bad renderable type");
-		}
+	for (uint32_t i = 0; i < ut.num_sprites; i++)
+	{
+		const TemplateRenderable& tr = ut.sprites[i];
+		add_sprite(tr.name, rw->create_sprite((SpriteResource*) tr.resource, m_scene_graph, tr.node));
 	}
 
-	for (uint32_t i = 0; i < num_materials(m_resource); i++)
+	for (uint32_t i = 0; i < ut.num_materials; i++)
 	{
-		const UnitMaterial* mat = get_material(m_resource, i);
-		add_material(string::murmur2_32("default", string::strlen("default"), 0), material_manager::get()->create_material(mat->id));
+		add_material(string::HASH32("default", 0x198ec3e3), material_manager::get()->create_material(ut.materials[i]));
 	}
 }
 
-void Unit::create_physics_objects()
+void Unit::create_physics_objects(const UnitTemplate& ut)
 {
-	using namespace unit_resource;
 	using namespace physics_resource;
-	if (unit_resource::physics_resource(m_resource) != 0)
+	const PhysicsResource* pr = ut.physics;
+	if (pr != NULL)
 	{
-		const PhysicsResource* pr = (PhysicsResource*) device()->resource_manager()->get(PHYSICS_TYPE, unit_resource::physics_resource(m_resource));
-
 		// Create controller if any
 		if (has_controller(pr))
 		{
@@ -215,11 +234,11 @@ void Unit::create_physics_objects()
 		}
 
 		// Create actors if any
-		for (uint32_t i = 0; i < num_actors(pr); i++)
+		for (uint32_t i = 0; i < ut.num_actors; i++)
 		{
 			const PhysicsActor* actor = physics_resource::actor(pr, i);
 
-			ActorId id = m_world.physics_world()->create_actor(pr, i, m_scene_graph, m_scene_graph.node(actor->node), m_id);
+			ActorId id = m_world.physics_world()->create_actor(pr, i, m_scene_graph, ut.actor_nodes[i], m_id);
 			add_actor(actor->name, id);
 		}
 
@@ -245,6 +264,12 @@ void Unit::set_default_material()
 		Sprite* s = m_world.render_world()->get_sprite(m_sprites[i].component);
 		s->set_material(m_materials[0].component);
 	}
+
+	for (uint32_t i = 0; i < m_num_meshes; i++)
+	{
+		Mesh* m = m_world.render_world()->get_mesh(m_meshes[i].component);
+		m->set_material(m_materials[0].component);
+	}
 }
 
 int32_t Unit::node(const char* name) const
@@ -252,11 +277,21 @@ int32_t Unit::node(const char* name) const
 	return m_scene_graph.node(name);
 }
 
+int32_t Unit::node(StringId32 name) const
+{
+	return m_scene_graph.node(name);
+}
+
 bool Unit::has_node(const char* name) const
 {
 	return m_scene_graph.has_node(name);
 }
 
+bool Unit::has_node(StringId32 name) const
+{
+	return m_scene_graph.has_node(name);
+}
+
 uint32_t Unit::num_nodes() const
 {
 	return m_scene_graph.num_nodes();
@@ -317,20 +352,13 @@ void Unit::unlink_node(int32_t child)
 	m_scene_graph.unlink(child);
 }
 
-void Unit::update()
-{
-	if (m_sprite_animation)
-	{
-		sprite(0u)->set_frame(m_sprite_animation->m_cur_frame);
-	}
-}
-
-void Unit::reload(UnitResource* new_ur)
+void Unit::reload(const UnitTemplate& ut)
 {
 	Matrix4x4 m = m_scene_graph.world_pose(0);
 	destroy_objects();
-	m_resource = new_ur;
-	create_objects(m);
+	m_resource = ut.resource;
+	m_scene_graph.create(m, ut.num_nodes, ut.nodes);
+	create_objects(ut, NULL);
 }
 
 void Unit::add_component(StringId32 name, Id component, uint32_t& size, Component* array)
@@ -526,19 +554,40 @@ Material* Unit::material(uint32_t i)
 
 bool Unit::is_a(const char* name)
 {
-	return m_resource_id == ResourceId("unit", name).name;
+	return m_resource_id == string::murmur2_64(name, string::strlen(name), 0);
 }
 
 void Unit::play_sprite_animation(const char* name, bool loop)
 {
-	if (m_sprite_animation)
-		m_sprite_animation->play(string::murmur2_32(name, string::strlen(name), 0), loop);
+	if (m_sprite_animation.id != INVALID_ID)
+		m_world.sprite_animation_player()->play(m_sprite_animation, string::murmur2_32(name, string::strlen(name), 0), loop);
 }
 
 void Unit::stop_sprite_animation()
 {
-	if (m_sprite_animation)
-		m_sprite_animation->stop();
+	if (m_sprite_animation.id != INVALID_ID)
+		m_world.sprite_animation_player()->stop(m_sprite_animation);
+}
+
+void Unit::play_animation(const char* name, bool loop, float blend_time)
+{
+	if (m_animation.id == INVALID_ID)
+		return;
+
+	const AnimationResource* ar = (AnimationResource*) device()->resource_manager()->get(ANIMATION_EXTENSION, name);
+	m_world.animation_player()->play(m_animation, ar, loop, blend_time);
+}
+
+void Unit::stop_animation()
+{
+	if (m_animation.id != INVALID_ID)
+		m_world.animation_player()->stop(m_animation);
+}
+
+void Unit::set_animation_speed(float speed)
+{
+	if (m_animation.id != INVALID_ID)
+		m_world.animation_player()->set_speed(m_animation, speed);
 }
 
 bool Unit::has_key(const char* k) const
@@ -35,7 +35,8 @@ OTHER DEALINGS IN THE SOFTWARE.
 #include "world_types.h"
 #include "render_world_types.h"
 #include "config.h"
-#include "sprite_animation.h"
+#include "sprite_animation_player.h"
+#include "animation_player.h"
 
 namespace crown
 {
@@ -71,13 +72,20 @@ struct Mesh;
 struct Sprite;
 struct Material;
 struct UnitResource;
+struct UnitTemplate;
 
 /// Represents a game entity.
 ///
 /// @ingroup World
 struct Unit
 {
-	Unit(World& w, UnitId unit_id, StringId64 resid, const UnitResource* ur, const Matrix4x4& pose);
+	/// Creates the unit @a unit_id from the template @a ut at the given @a pose.
+	Unit(World& w, UnitId unit_id, const UnitTemplate& ut, const Matrix4x4& pose);
+
+	/// Creates the unit @a unit_id from the template @a ut, around the scene graph @a sg
+	/// and the @a ut.num_meshes @a meshes already created by World::spawn_units().
+	/// The unit takes ownership of them.
+	Unit(World& w, UnitId unit_id, const UnitTemplate& ut, SceneGraph& sg, const MeshId* meshes);
 	~Unit();
 
 	void set_id(const UnitId id);
@@ -88,9 +96,15 @@ struct Unit
 	/// Returns the node @a name.
 	int32_t node(const char* name) const;
 
+	/// @copydoc Unit::node()
+	int32_t node(StringId32 name) const;
+
 	/// Returns whether the unit has the node @a name.
 	bool has_node(const char* name) const;
 
+	/// @copydoc Unit::has_node()
+	bool has_node(StringId32 name) const;
+
 	/// Returns the number of nodes of the unit.
 	uint32_t num_nodes() const;
 
@@ -129,8 +143,8 @@ struct Unit
 	/// Unlinks @a child from its parent, if any.
 	void unlink_node(int32_t child);
 
-	void update();
-	void reload(UnitResource* new_ur);
+	/// Recreates the objects of the unit from the template @a ut.
+	void reload(const UnitTemplate& ut);
 
 	void add_component(StringId32 name, Id component, uint32_t& size, Component* array);
 	Id find_component(const char* name, uint32_t size, Component* array);
@@ -167,6 +181,16 @@ struct Unit
 	void play_sprite_animation(const char* name, bool loop);
 	void stop_sprite_animation();
 
+	/// Plays the skeletal animation @a name, cross-fading from the
+	/// animation being played in @a blend_time seconds.
+	void play_animation(const char* name, bool loop, float blend_time);
+
+	/// Stops the skeletal animation, leaving the nodes in their current pose.
+	void stop_animation();
+
+	/// Sets the playback speed of the skeletal animation.
+	void set_animation_speed(float speed);
+
 	bool has_key(const char* k) const;
 	ValueType::Enum value_type(const char* k);
 	bool get_key(const char* k, bool& v) const;
@@ -180,18 +204,21 @@ struct Unit
 
 private:
 
-	void create_objects(const Matrix4x4& pose);
+	/// Creates the objects of the unit around its scene graph, which must
+	/// already be created. @a meshes, if not NULL, are used instead of creating new ones.
+	void create_objects(const UnitTemplate& ut, const MeshId* meshes);
 	void destroy_objects();
 	void create_camera_objects();
-	void create_renderable_objects();
-	void create_physics_objects();
+	void create_renderable_objects(const UnitTemplate& ut, const MeshId* meshes);
+	void create_physics_objects(const UnitTemplate& ut);
 	void set_default_material();
 
 public:
 
 	World& m_world;
 	SceneGraph& m_scene_graph;
-	SpriteAnimation* m_sprite_animation;
+	SpriteAnimationId m_sprite_animation;
+	AnimationId m_animation;
 	const StringId64 m_resource_id;
 	const UnitResource*	m_resource;
 	UnitId m_id;
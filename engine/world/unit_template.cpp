@@ -0,0 +1,134 @@
+/*
+Copyright (c) 2013 Daniele Bartolini, Michele Rossi
+Copyright (c) 2012 Daniele Bartolini, Simone Boscaratto
+
+Permission is hereby granted, free of charge, to any person
+obtaining a copy of this software and associated documentation
+files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use,
+copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following
+conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "unit_template.h"
+#include "unit_resource.h"
+#include "physics_resource.h"
+#include "mesh_resource.h"
+#include "sprite_resource.h"
+#include "device.h"
+#include "resource_manager.h"
+#include "vector3.h"
+#include "aabb.h"
+#include "matrix4x4.h"
+#include "assert.h"
+#include <string.h>
+
+namespace crown
+{
+
+namespace unit_template_internal
+{
+	/// Returns the radius of the sphere centered at the root node which
+	/// bounds @a box, given in the space of @a node.
+	static float bounding_radius(const UnitNode* nodes, int32_t node, const AABB& box)
+	{
+		// SceneGraph::create() places every node but the root at root * pose
+		const Matrix4x4 pose = node == 0 ? matrix4x4::IDENTITY : nodes[node].pose;
+
+		Vector3 vertices[8];
+		aabb::to_vertices(box, vertices);
+
+		float radius = 0.0f;
+		for (uint32_t i = 0; i < 8; i++)
+		{
+			radius = math::max(radius, vector3::length(pose * vertices[i]));
+		}
+		return radius;
+	}
+} // namespace unit_template_internal
+
+UnitTemplate::UnitTemplate(StringId64 name, const UnitResource* ur)
+	: name(name)
+	, resource(ur)
+	, num_nodes(unit_resource::num_scene_graph_nodes(ur))
+	, nodes(unit_resource::scene_graph_nodes(ur))
+	, num_meshes(0)
+	, num_sprites(0)
+	, num_materials(0)
+	, physics(NULL)
+	, num_actors(0)
+	, sprite_animation(NULL)
+	, skeleton(NULL)
+	, bounding_radius(0.0f)
+{
+	ResourceManager* rm = device()->resource_manager();
+
+	for (uint32_t i = 0; i < unit_resource::num_renderables(ur); i++)
+	{
+		const UnitRenderable* r = unit_resource::get_renderable(ur, i);
+
+		if (r->type == UnitRenderable::MESH)
+		{
+			CE_ASSERT(num_meshes < CE_MAX_MESH_COMPONENTS, "Max mesh components number reached");
+			TemplateRenderable& tr = meshes[num_meshes++];
+			tr.name = r->name;
+			tr.node = r->node;
+			tr.resource = rm->get(MESH_TYPE, r->resource);
+
+			const AABB& box = ((const MeshResource*) tr.resource)->aabb();
+			bounding_radius = math::max(bounding_radius, unit_template_internal::bounding_radius(nodes, tr.node, box));
+		}
+		else if (r->type == UnitRenderable::SPRITE)
+		{
+			CE_ASSERT(num_sprites < CE_MAX_SPRITE_COMPONENTS, "Max sprite components number reached");
+			TemplateRenderable& tr = sprites[num_sprites++];
+			tr.name = r->name;
+			tr.node = r->node;
+			tr.resource = rm->get(SPRITE_TYPE, r->resource);
+
+			const AABB& box = ((const SpriteResource*) tr.resource)->aabb;
+			bounding_radius = math::max(bounding_radius, unit_template_internal::bounding_radius(nodes, tr.node, box));
+		}
+		else
+		{
+			CE_FATAL("Oops, bad renderable type");
+		}
+	}
+
+	for (uint32_t i = 0; i < unit_resource::num_materials(ur); i++)
+	{
+		CE_ASSERT(num_materials < CE_MAX_MATERIAL_COMPONENTS, "Max material components number reached");
+		materials[num_materials++] = (MaterialResource*) rm->get(MATERIAL_TYPE, unit_resource::get_material(ur, i)->id);
+	}
+
+	if (unit_resource::physics_resource(ur) != 0)
+	{
+		physics = (PhysicsResource*) rm->get(PHYSICS_TYPE, unit_resource::physics_resource(ur));
+		num_actors = unit_resource::num_actor_nodes(ur);
+		CE_ASSERT(num_actors == physics_resource::num_actors(physics), "Unit and physics resources out of sync");
+		CE_ASSERT(num_actors <= CE_MAX_ACTOR_COMPONENTS, "Max actor components number reached");
+		memcpy(actor_nodes, unit_resource::actor_nodes(ur), sizeof(int32_t) * num_actors);
+	}
+
+	if (unit_resource::sprite_animation(ur) != 0)
+		sprite_animation = (SpriteAnimationResource*) rm->get(SPRITE_ANIMATION_TYPE, unit_resource::sprite_animation(ur));
+
+	if (unit_resource::skeleton(ur) != 0)
+		skeleton = (SkeletonResource*) rm->get(SKELETON_TYPE, unit_resource::skeleton(ur));
+}
+
+} // namespace crown
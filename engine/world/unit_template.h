@@ -0,0 +1,92 @@
+/*
+Copyright (c) 2013 Daniele Bartolini, Michele Rossi
+Copyright (c) 2012 Daniele Bartolini, Simone Boscaratto
+
+Permission is hereby granted, free of charge, to any person
+obtaining a copy of this software and associated documentation
+files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use,
+copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following
+conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+
+#include "types.h"
+#include "config.h"
+
+namespace crown
+{
+
+struct UnitResource;
+struct UnitNode;
+struct MeshResource;
+struct SpriteResource;
+struct MaterialResource;
+struct PhysicsResource;
+struct SpriteAnimationResource;
+struct SkeletonResource;
+
+/// A renderable of a unit template.
+struct TemplateRenderable
+{
+	StringId32 name;
+	int32_t node;
+	const void* resource; // MeshResource* or SpriteResource*
+};
+
+/// Everything a unit needs to be instantiated, resolved once from its
+/// UnitResource: resource pointers, node layout and node indices of the
+/// actors (the latter resolved by the unit compiler). Spawning from a template does not look up any resource or
+/// node by name, so many instances can be spawned in the same frame.
+///
+/// @note The template refers to the resources it was built from, it must
+/// not outlive them.
+///
+/// @ingroup World
+struct UnitTemplate
+{
+	/// Resolves the resources referenced by the unit @a ur named @a name.
+	UnitTemplate(StringId64 name, const UnitResource* ur);
+
+	StringId64 name;
+	const UnitResource* resource;
+
+	uint32_t num_nodes;
+	const UnitNode* nodes;
+
+	uint32_t num_meshes;
+	TemplateRenderable meshes[CE_MAX_MESH_COMPONENTS];
+
+	uint32_t num_sprites;
+	TemplateRenderable sprites[CE_MAX_SPRITE_COMPONENTS];
+
+	uint32_t num_materials;
+	const MaterialResource* materials[CE_MAX_MATERIAL_COMPONENTS];
+
+	const PhysicsResource* physics; // NULL if none
+	uint32_t num_actors;
+	int32_t actor_nodes[CE_MAX_ACTOR_COMPONENTS];
+
+	const SpriteAnimationResource* sprite_animation; // NULL if none
+	const SkeletonResource* skeleton; // NULL if none
+
+	/// Radius of the sphere, centered at the root node, bounding the meshes and sprites.
+	float bounding_radius;
+};
+
+} // namespace crown
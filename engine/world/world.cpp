@@ -34,6 +34,11 @@ OTHER DEALINGS IN THE SOFTWARE.
 #include "actor.h"
 #include "lua_environment.h"
 #include "level_resource.h"
+#include "matrix4x4.h"
+#include "vector3.h"
+#include "math_utils.h"
+#include "temp_allocator.h"
+#include "array.h"
 
 namespace crown
 {
@@ -42,6 +47,14 @@ World::World()
 	: m_unit_pool(default_allocator(), CE_MAX_UNITS, sizeof(Unit), CE_ALIGNOF(Unit))
 	, m_camera_pool(default_allocator(), CE_MAX_CAMERAS, sizeof(Camera), CE_ALIGNOF(Camera))
 	, m_physics_world(*this)
+	, m_sounds(default_allocator())
+	, m_spatial_index(default_allocator())
+	, m_graph_to_unit(default_allocator())
+	, m_unit_links(default_allocator())
+	, m_unit_link_index(default_allocator())
+	, m_command_buffer(*this)
+	, m_processing_physics_events(false)
+	, m_level_streamer(*this)
 	, m_events(default_allocator())
 {
 	m_id.id = INVALID_ID;
@@ -56,6 +69,11 @@ World::~World()
 		CE_DELETE(m_unit_pool, m_units[i]);
 	}
 
+	for (uint32_t i = 0; i < id_array::size(m_unit_templates); i++)
+	{
+		CE_DELETE(default_allocator(), m_unit_templates[i]);
+	}
+
 	SoundWorld::destroy(default_allocator(), m_sound_world);
 }
 
@@ -77,30 +95,145 @@ UnitId World::spawn_unit(const char* name, const Vector3& pos, const Quaternion&
 
 UnitId World::spawn_unit(StringId64 name, const Vector3& pos, const Quaternion& rot)
 {
-	UnitResource* ur = (UnitResource*)device()->resource_manager()->get(UNIT_TYPE, name);
+	const UnitTemplate ut(name, (UnitResource*) device()->resource_manager()->get(UNIT_TYPE, name));
+	return spawn_unit(ut, Matrix4x4(rot, pos));
+}
+
+UnitId World::spawn_unit(const UnitTemplate& ut, const Matrix4x4& pose)
+{
+	const UnitId unit_id = reserve_unit_id();
+	create_unit(unit_id, ut, pose);
+	return unit_id;
+}
+
+UnitId World::reserve_unit_id()
+{
+	ScopedMutex sm(m_units_mutex);
+	return id_array::reserve(m_units);
+}
 
+void World::create_unit(UnitId id, const UnitTemplate& ut, const Matrix4x4& pose, SceneGraph* sg, const MeshId* meshes)
+{
 	Unit* u = (Unit*) m_unit_pool.allocate(sizeof(Unit), CE_ALIGNOF(Unit));
-	const UnitId unit_id = id_array::create(m_units, u);
-	new (u) Unit(*this, unit_id, name, ur, Matrix4x4(rot, pos));
+	{
+		ScopedMutex sm(m_units_mutex);
+		id_array::insert(m_units, id, u);
+	}
 
-	post_unit_spawned_event(unit_id);
-	return unit_id;
+	if (sg != NULL)
+		new (u) Unit(*this, id, ut, *sg, meshes);
+	else
+		new (u) Unit(*this, id, ut, pose);
+
+	// The radius of the template is in the space of the root node
+	const float scale = math::max(vector3::length(matrix4x4::x(pose)), math::max(vector3::length(matrix4x4::y(pose)), vector3::length(matrix4x4::z(pose))));
+	m_spatial_index.insert(id, matrix4x4::translation(pose), ut.bounding_radius * scale);
+	hash::set(m_graph_to_unit, (uint64_t) (uintptr_t) &u->m_scene_graph, id);
+
+	post_unit_spawned_event(id);
+}
+
+UnitTemplateId World::create_unit_template(const char* name)
+{
+	const ResourceId id(UNIT_EXTENSION, name);
+	return create_unit_template(id.name);
+}
+
+UnitTemplateId World::create_unit_template(StringId64 name)
+{
+	UnitResource* ur = (UnitResource*) device()->resource_manager()->get(UNIT_TYPE, name);
+	UnitTemplate* ut = CE_NEW(default_allocator(), UnitTemplate)(name, ur);
+	return id_array::create(m_unit_templates, ut);
+}
+
+void World::destroy_unit_template(UnitTemplateId id)
+{
+	CE_DELETE(default_allocator(), id_array::get(m_unit_templates, id));
+	id_array::destroy(m_unit_templates, id);
+}
+
+void World::spawn_units(UnitTemplateId id, uint32_t count, const Matrix4x4* poses, UnitId* units)
+{
+	CE_ASSERT(id_array::size(m_units) + count <= CE_MAX_UNITS, "Max units number reached");
+	const UnitTemplate& ut = *id_array::get(m_unit_templates, id);
+	CE_ASSERT(ut.num_meshes <= CE_MAX_MESH_COMPONENTS, "Max mesh number reached");
+
+	TempAllocator4096 ta;
+	Array<SceneGraph*> graphs(ta);
+	Array<MeshId> meshes(ta);
+	array::resize(graphs, count);
+	array::resize(meshes, count * ut.num_meshes);
+
+	// Create the nodes and the meshes of all the instances at once.
+	// The ids of the i-th mesh of each instance are contiguous.
+	m_scenegraph_manager.create_scene_graphs(count, poses, ut.num_nodes, ut.nodes, array::begin(graphs));
+
+	for (uint32_t i = 0; i < ut.num_meshes; i++)
+	{
+		const TemplateRenderable& tr = ut.meshes[i];
+		m_render_world.create_meshes((MeshResource*) tr.resource, count, array::begin(graphs), tr.node, array::begin(meshes) + i * count);
+	}
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		MeshId unit_meshes[CE_MAX_MESH_COMPONENTS];
+		for (uint32_t j = 0; j < ut.num_meshes; j++)
+			unit_meshes[j] = meshes[j * count + i];
+
+		const UnitId unit_id = reserve_unit_id();
+		create_unit(unit_id, ut, poses[i], graphs[i], unit_meshes);
+
+		if (units != NULL)
+			units[i] = unit_id;
+	}
 }
 
 void World::destroy_unit(UnitId id)
 {
-	CE_DELETE(m_unit_pool, id_array::get(m_units, id));
-	id_array::destroy(m_units, id);
+	if (m_processing_physics_events)
+	{
+		m_command_buffer.destroy_unit(id);
+		return;
+	}
+
+	// The units linked to it stay where they are
+	unlink_unit(id);
+	for (uint32_t i = 0; i < array::size(m_unit_links); )
+	{
+		if (m_unit_links[i].parent == id)
+			remove_unit_link(i);
+		else
+			i++;
+	}
+
+	Unit* u = id_array::get(m_units, id);
+	m_spatial_index.remove(id);
+	hash::remove(m_graph_to_unit, (uint64_t) (uintptr_t) &u->m_scene_graph);
+
+	CE_DELETE(m_unit_pool, u);
+	{
+		ScopedMutex sm(m_units_mutex);
+		id_array::destroy(m_units, id);
+	}
 	post_unit_destroyed_event(id);
 }
 
 void World::reload_units(UnitResource* old_ur, UnitResource* new_ur)
 {
+	for (uint32_t i = 0; i < id_array::size(m_unit_templates); i++)
+	{
+		UnitTemplate* ut = m_unit_templates[i];
+		if (ut->resource == old_ur)
+			*ut = UnitTemplate(ut->name, new_ur);
+	}
+
 	for (uint32_t i = 0; i < id_array::size(m_units); i++)
 	{
 		if (m_units[i]->resource() == old_ur)
 		{
-			m_units[i]->reload(new_ur);
+			const UnitTemplate ut(m_units[i]->m_resource_id, new_ur);
+			m_units[i]->reload(ut);
+			m_spatial_index.update(m_units[i]->id(), m_units[i]->world_position(0), ut.bounding_radius);
 		}
 	}
 }
@@ -120,12 +253,64 @@ void World::units(Array<UnitId>& units) const
 
 void World::link_unit(UnitId child, UnitId parent, int32_t node)
 {
-	Unit* parent_unit = get_unit(parent);
-	parent_unit->link_node(0, node);
+	if (m_processing_physics_events)
+	{
+		m_command_buffer.link_unit(child, parent, node);
+		return;
+	}
+
+	CE_ASSERT(child != parent, "Unit cannot be linked to itself");
+	CE_ASSERT(node < (int32_t) get_unit(parent)->num_nodes(), "Node does not exist");
+
+	unlink_unit(child);
+
+#if defined(CROWN_DEBUG)
+	for (uint32_t i = hash::get(m_unit_link_index, parent.encode(), (uint32_t) NO_LINK); i != NO_LINK;
+		i = hash::get(m_unit_link_index, m_unit_links[i].parent.encode(), (uint32_t) NO_LINK))
+	{
+		CE_ASSERT(m_unit_links[i].parent != child, "Links must not form cycles");
+	}
+#endif // CROWN_DEBUG
+
+	UnitLink link;
+	link.child = child;
+	link.parent = parent;
+	link.node = node;
+	hash::set(m_unit_link_index, child.encode(), array::push_back(m_unit_links, link));
+}
+
+void World::unlink_unit(UnitId id)
+{
+	if (m_processing_physics_events)
+	{
+		m_command_buffer.unlink_unit(id);
+		return;
+	}
+
+	const uint32_t i = hash::get(m_unit_link_index, id.encode(), (uint32_t) NO_LINK);
+	if (i != NO_LINK)
+		remove_unit_link(i);
+}
+
+void World::unit_links(Array<UnitLink>& links) const
+{
+	array::push(links, array::begin(m_unit_links), array::size(m_unit_links));
+}
+
+void World::respawn_unit(UnitId id, StringId64 name, const Matrix4x4& pose)
+{
+	{
+		ScopedMutex sm(m_units_mutex);
+		id_array::reserve(m_units, id);
+	}
+
+	const UnitTemplate ut(name, (UnitResource*) device()->resource_manager()->get(UNIT_TYPE, name));
+	create_unit(id, ut, pose);
 }
 
-void World::unlink_unit(UnitId /*child*/)
+bool World::has_unit(UnitId id) const
 {
+	return id_array::has(m_units, id);
 }
 
 Unit* World::get_unit(UnitId id)
@@ -133,6 +318,26 @@ Unit* World::get_unit(UnitId id)
 	return id_array::get(m_units, id);
 }
 
+void World::set_spatial_index_type(SpatialIndexType::Enum type)
+{
+	m_spatial_index.set_type(type);
+}
+
+void World::query_sphere(const Vector3& center, float radius, Array<UnitId>& units) const
+{
+	m_spatial_index.query_sphere(center, radius, units);
+}
+
+void World::query_box(const AABB& box, Array<UnitId>& units) const
+{
+	m_spatial_index.query_box(box, units);
+}
+
+void World::query_nearest(const Vector3& point, uint32_t k, Array<UnitId>& units) const
+{
+	m_spatial_index.query_nearest(point, k, units);
+}
+
 Camera* World::get_camera(CameraId id)
 {
 	return id_array::get(m_cameras, id);
@@ -141,21 +346,23 @@ Camera* World::get_camera(CameraId id)
 void World::update_animations(float dt)
 {
 	m_sprite_animation_player.update(dt);
+	m_animation_player.update(dt);
 }
 
 void World::update_scene(float dt)
 {
+	m_level_streamer.update();
+
 	m_physics_world.update(dt);
+	update_unit_links();
 	m_scenegraph_manager.update();
-
-	for (uint32_t i = 0; i < id_array::size(m_units); i++)
-	{
-		m_units[i]->update();
-	}
+	update_spatial_index();
 
 	m_sound_world->update();
 
 	process_physics_events();
+
+	m_command_buffer.flush();
 }
 
 void World::update(float dt)
@@ -194,12 +401,42 @@ SoundInstanceId World::play_sound(const char* name, const bool loop, const float
 SoundInstanceId World::play_sound(StringId64 name, const bool loop, const float volume, const Vector3& pos, const float range)
 {
 	SoundResource* sr = (SoundResource*)device()->resource_manager()->get(SOUND_TYPE, name);
-	return m_sound_world->play(sr, loop, volume, pos);
+
+	// Forget the sounds which finished playing
+	for (uint32_t i = 0; i < array::size(m_sounds); )
+	{
+		if (m_sound_world->is_playing(m_sounds[i].id))
+		{
+			i++;
+			continue;
+		}
+
+		m_sounds[i] = array::back(m_sounds);
+		array::pop_back(m_sounds);
+	}
+
+	PlayingSound ps;
+	ps.id = m_sound_world->play(sr, loop, volume, pos);
+	ps.name = name;
+	ps.position = pos;
+	ps.range = range;
+	ps.volume = volume;
+	ps.loop = loop;
+	array::push_back(m_sounds, ps);
+
+	return ps.id;
 }
 
 void World::stop_sound(SoundInstanceId id)
 {
 	m_sound_world->stop(id);
+
+	PlayingSound* ps = find_sound(id);
+	if (ps != NULL)
+	{
+		*ps = array::back(m_sounds);
+		array::pop_back(m_sounds);
+	}
 }
 
 void World::link_sound(SoundInstanceId id, Unit* unit, int32_t node)
@@ -214,16 +451,48 @@ void World::set_listener_pose(const Matrix4x4& pose)
 void World::set_sound_position(SoundInstanceId id, const Vector3& pos)
 {
 	m_sound_world->set_sound_positions(1, &id, &pos);
+
+	PlayingSound* ps = find_sound(id);
+	if (ps != NULL)
+		ps->position = pos;
 }
 
 void World::set_sound_range(SoundInstanceId id, float range)
 {
 	m_sound_world->set_sound_ranges(1, &id, &range);
+
+	PlayingSound* ps = find_sound(id);
+	if (ps != NULL)
+		ps->range = range;
 }
 
 void World::set_sound_volume(SoundInstanceId id, float vol)
 {
 	m_sound_world->set_sound_volumes(1, &id, &vol);
+
+	PlayingSound* ps = find_sound(id);
+	if (ps != NULL)
+		ps->volume = vol;
+}
+
+void World::playing_sounds(Array<PlayingSound>& sounds)
+{
+	for (uint32_t i = 0; i < array::size(m_sounds); i++)
+	{
+		if (m_sound_world->is_playing(m_sounds[i].id))
+			array::push_back(sounds, m_sounds[i]);
+	}
+}
+
+PlayingSound* World::find_sound(SoundInstanceId id)
+{
+	for (uint32_t i = 0; i < array::size(m_sounds); i++)
+	{
+		if (m_sounds[i].id.id == id.id && m_sounds[i].id.index == id.index)
+			return &m_sounds[i];
+	}
+
+	return NULL;
 }
 
 GuiId World::create_window_gui(uint16_t width, uint16_t height, const char* material)
@@ -278,6 +547,22 @@ void World::load_level(const LevelResource* lr)
 	post_level_loaded_event();
 }
 
+void World::stream_level(const char* name)
+{
+	const LevelResource* lr = (LevelResource*) device()->resource_manager()->get(LEVEL_EXTENSION, name);
+	m_level_streamer.load(lr);
+}
+
+LevelStreamer* World::level_streamer()
+{
+	return &m_level_streamer;
+}
+
+CommandBuffer* World::command_buffer()
+{
+	return &m_command_buffer;
+}
+
 SceneGraphManager* World::scene_graph_manager()
 {
 	return &m_scenegraph_manager;
@@ -288,6 +573,11 @@ SpriteAnimationPlayer* World::sprite_animation_player()
 	return &m_sprite_animation_player;
 }
 
+AnimationPlayer* World::animation_player()
+{
+	return &m_animation_player;
+}
+
 RenderWorld* World::render_world()
 {
 	return &m_render_world;
@@ -323,10 +613,75 @@ void World::post_level_loaded_event()
 	event_stream::write(m_events, EventType::LEVEL_LOADED, ev);
 }
 
+void World::update_spatial_index()
+{
+	const UnitId invalid = { INVALID_ID, 0 };
+	const Array<ChangedNode>& changed = m_scenegraph_manager.changed_nodes();
+
+	for (uint32_t i = 0; i < array::size(changed); i++)
+	{
+		// Units are indexed by their root node
+		if (changed[i].node != 0)
+			continue;
+
+		const UnitId id = hash::get(m_graph_to_unit, (uint64_t) (uintptr_t) changed[i].graph, invalid);
+		if (id.id != INVALID_ID)
+			m_spatial_index.update(id, changed[i].graph->world_position(0));
+	}
+}
+
+void World::update_unit_links()
+{
+	for (uint32_t i = 0; i < array::size(m_unit_links); i++)
+	{
+		const UnitLink& link = m_unit_links[i];
+		get_unit(link.child)->set_local_pose(0, node_world_pose(link.parent, link.node));
+	}
+}
+
+Matrix4x4 World::node_world_pose(UnitId id, int32_t node)
+{
+	const SceneGraph& sg = get_unit(id)->m_scene_graph;
+
+	Matrix4x4 pose = matrix4x4::IDENTITY;
+	int32_t n = node;
+	for (int32_t p = sg.parent(n); p != -1; p = sg.parent(n))
+	{
+		pose = sg.local_pose(n) * pose;
+		n = p;
+	}
+
+	// Nodes without a parent have their local pose expressed in world space,
+	// unless the node is the root of a linked unit
+	const uint32_t link = n == 0 ? hash::get(m_unit_link_index, id.encode(), (uint32_t) NO_LINK) : (uint32_t) NO_LINK;
+	if (link != NO_LINK)
+		return node_world_pose(m_unit_links[link].parent, m_unit_links[link].node) * pose;
+
+	return sg.local_pose(n) * pose;
+}
+
+void World::remove_unit_link(uint32_t i)
+{
+	hash::remove(m_unit_link_index, m_unit_links[i].child.encode());
+
+	// Swap with last element
+	const uint32_t last = array::size(m_unit_links) - 1;
+	if (i != last)
+	{
+		m_unit_links[i] = m_unit_links[last];
+		hash::set(m_unit_link_index, m_unit_links[i].child.encode(), i);
+	}
+
+	array::pop_back(m_unit_links);
+}
+
 void World::process_physics_events()
 {
 	EventStream& events = m_physics_world.events();
 
+	// Units destroyed, linked or unlinked by the callbacks are changed after the loop
+	m_processing_physics_events = true;
+
 	// Read all events
 	const char* ee = array::begin(events);
 	while (ee != array::end(events))
@@ -390,6 +745,7 @@ void World::process_physics_events()
 		ee += sizeof(event_stream::Header) + h.size;
 	}
 
+	m_processing_physics_events = false;
 	array::clear(events);
 }
 
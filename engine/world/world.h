@@ -37,18 +37,48 @@ OTHER DEALINGS IN THE SOFTWARE.
 #include "scene_graph_manager.h"
 #include "types.h"
 #include "unit.h"
+#include "unit_template.h"
 #include "vector.h"
 #include "world_types.h"
 #include "sound_world.h"
 #include "event_stream.h"
 #include "sprite_animation_player.h"
+#include "animation_player.h"
 #include "resource_types.h"
+#include "spatial_index.h"
+#include "hash.h"
+#include "command_buffer.h"
+#include "level_streamer.h"
+#include "mutex.h"
 
 namespace crown
 {
 
 /// @defgroup World World
 
+/// Parameters of a sound played with World::play_sound().
+///
+/// @ingroup World
+struct PlayingSound
+{
+	SoundInstanceId id;
+	StringId64 name;
+	Vector3 position;
+	float range;
+	float volume;
+	bool loop;
+};
+
+/// A unit whose root follows the node of another unit, see World::link_unit().
+///
+/// @ingroup World
+struct UnitLink
+{
+	UnitId child;
+	UnitId parent;
+	int32_t node;
+};
+
 /// Represents a game world.
 ///
 /// @ingroup World
@@ -63,13 +93,34 @@ public:
 	void set_id(WorldId id);
 
 	/// Spawns a new instance of the unit @a name at the given @a position and @a rotation.
+	/// Unlike destroy_unit(), it takes effect at once also from a physics callback:
+	/// scripts use the unit right away, and spawning only adds to the containers
+	/// process_physics_events() does not iterate. New actors report their
+	/// contacts in the next simulation step.
 	UnitId spawn_unit(const char* name, const Vector3& position = vector3::ZERO, const Quaternion& rotation = quaternion::IDENTITY);
 	UnitId spawn_unit(StringId64 name, const Vector3& pos, const Quaternion& rot);
 
+	/// Creates a template of the unit @a name, to spawn many instances
+	/// of it without resolving its resources each time.
+	/// @note The template must be destroyed before the unit resource is unloaded.
+	UnitTemplateId create_unit_template(const char* name);
+	UnitTemplateId create_unit_template(StringId64 name);
+
+	/// Destroys the unit template @a id.
+	void destroy_unit_template(UnitTemplateId id);
+
+	/// Spawns @a count instances of the unit template @a id, the i-th at @a poses[i].
+	/// The ids of the new units are written to @a units, if not NULL.
+	/// The scene graphs and the meshes of all the instances are created in one
+	/// pass, the other components are still created per unit.
+	void spawn_units(UnitTemplateId id, uint32_t count, const Matrix4x4* poses, UnitId* units = NULL);
+
 	/// Destroys the unit with the given @a id.
+	/// When called from a physics callback, the unit is destroyed at the end
+	/// of update_scene() so that the remaining events can still refer to it.
 	void destroy_unit(UnitId id);
 
-	/// Reloads all the units with the associated resource @a old_ur.
+	/// Reloads all the units and unit templates with the associated resource @a old_ur.
 	void reload_units(UnitResource* old_ur, UnitResource* new_ur);
 
 	/// Returns the number of units in the world.
@@ -79,15 +130,45 @@ public:
 	void units(Array<UnitId>& units) const;
 
 	/// Links the unit @a child to the @a node of the unit @a parent.
-	/// After this call, @a child will follow the @a parent unit.
+	/// After this call, the root of @a child follows the @a node as if it was
+	/// its child with an identity local pose. A unit has at most one parent,
+	/// linking it again replaces the previous link.
+	/// When called from a physics callback, the link is made at the end of
+	/// update_scene(), in order with the units destroyed and unlinked there.
+	/// @note Links must not form cycles.
 	void link_unit(UnitId child, UnitId parent, int32_t node);
 
 	/// Unlinks the unit @a id from its parent if it has any.
+	/// The unit stays where it is. Deferred like link_unit().
 	void unlink_unit(UnitId id);
 
+	/// Returns all the links between units in the world.
+	void unit_links(Array<UnitLink>& links) const;
+
+	/// Spawns the unit @a name at the given @a pose with the given @a id,
+	/// which must not be in use. Used to recreate a unit with the id it had
+	/// before being destroyed.
+	void respawn_unit(UnitId id, StringId64 name, const Matrix4x4& pose);
+
+	/// Returns whether the unit @a id exists.
+	bool has_unit(UnitId id) const;
+
 	/// Returns the unit @a id.
 	Unit* get_unit(UnitId id);
 
+	/// Sets the structure used to index the units in space.
+	/// Use SpatialIndexType::GRID for 2D worlds and SpatialIndexType::OCTREE for 3D ones.
+	void set_spatial_index_type(SpatialIndexType::Enum type);
+
+	/// Appends to @a units the units whose bounds overlap the sphere (@a center, @a radius).
+	void query_sphere(const Vector3& center, float radius, Array<UnitId>& units) const;
+
+	/// Appends to @a units the units whose bounds overlap @a box.
+	void query_box(const AABB& box, Array<UnitId>& units) const;
+
+	/// Appends to @a units the @a k units nearest to @a point, nearest first.
+	void query_nearest(const Vector3& point, uint32_t k, Array<UnitId>& units) const;
+
 	/// Returns the camera @a id.
 	Camera* get_camera(CameraId id);
 
@@ -95,6 +176,8 @@ public:
 	void update_animations(float dt);
 
 	/// Update scene with @a dt.
+	/// The level_streamer() is updated first.
+	/// The commands recorded in the command_buffer() are applied at the end.
 	void update_scene(float dt);
 
 	/// Updates all units and sub-systems with the given @a dt delta time.
@@ -132,6 +215,9 @@ public:
 	/// Sets the @a volume of the sound @a id.
 	void set_sound_volume(SoundInstanceId id, float volume);
 
+	/// Appends to @a sounds the sounds which are still playing.
+	void playing_sounds(Array<PlayingSound>& sounds);
+
 	/// Creates a new window-space Gui of size @a width and @a height.
 	GuiId create_window_gui(uint16_t width, uint16_t height, const char* material);
 
@@ -152,8 +238,19 @@ public:
 	void load_level(const char* name);
 	void load_level(const LevelResource* lr);
 
+	/// Streams the level @a name into the world with the level_streamer().
+	/// The units are spawned over the following updates as they come into range.
+	void stream_level(const char* name);
+
+	/// Returns the streamer used to load levels incrementally around a focus point.
+	LevelStreamer* level_streamer();
+
+	/// Returns the buffer to record deferred changes to the world into.
+	CommandBuffer* command_buffer();
+
 	SceneGraphManager* scene_graph_manager();
 	SpriteAnimationPlayer* sprite_animation_player();
+	AnimationPlayer* animation_player();
 
 	/// Returns the rendering sub-world.
 	RenderWorld* render_world();
@@ -166,28 +263,76 @@ public:
 
 private:
 
+	UnitId spawn_unit(const UnitTemplate& ut, const Matrix4x4& pose);
+
+	/// Returns a new unit id without creating the unit.
+	/// Can be called from any thread.
+	UnitId reserve_unit_id();
+
+	/// Creates the unit @a id, previously returned by reserve_unit_id(),
+	/// from the template @a ut at the given @a pose.
+	/// If @a sg is not NULL, the unit is built around it and the @a meshes
+	/// created by spawn_units() instead, and @a pose is only used to size its bounds.
+	void create_unit(UnitId id, const UnitTemplate& ut, const Matrix4x4& pose, SceneGraph* sg = NULL, const MeshId* meshes = NULL);
+
 	void post_unit_spawned_event(UnitId id);
 	void post_unit_destroyed_event(UnitId id);
 	void post_level_loaded_event();
 	void process_physics_events();
 
+	/// Moves the units whose root node changed during the last scene update in the spatial index.
+	void update_spatial_index();
+
+	/// Moves the root of the linked units to the nodes they are linked to.
+	void update_unit_links();
+
+	/// Returns the world pose of the @a node of the unit @a id, composed from the
+	/// local poses up to the root and the units it is linked to, so that it is
+	/// current even before the scene graph is updated.
+	Matrix4x4 node_world_pose(UnitId id, int32_t node);
+
+	/// Removes the @a i-th link in m_unit_links.
+	void remove_unit_link(uint32_t i);
+
+	/// Returns the parameters of the sound @a id or NULL if it is not playing.
+	PlayingSound* find_sound(SoundInstanceId id);
+
 private:
 
 	PoolAllocator m_unit_pool;
 	PoolAllocator m_camera_pool;
 
+	Mutex m_units_mutex; // Guards the allocation of unit ids
 	IdArray<CE_MAX_UNITS, Unit*> m_units;
+	IdArray<CE_MAX_UNIT_TEMPLATES, UnitTemplate*> m_unit_templates;
 	IdArray<CE_MAX_CAMERAS, Camera*> m_cameras;
 
 	SceneGraphManager m_scenegraph_manager;
 	SpriteAnimationPlayer m_sprite_animation_player;
+	AnimationPlayer m_animation_player;
 	RenderWorld m_render_world;
 	PhysicsWorld m_physics_world;
 	SoundWorld* m_sound_world;
+	Array<PlayingSound> m_sounds;
+
+	SpatialIndex m_spatial_index;
+	Hash<UnitId> m_graph_to_unit; // SceneGraph* -> UnitId
+
+	enum { NO_LINK = 0xFFFFFFFFu };
+	Array<UnitLink> m_unit_links;
+	Hash<uint32_t> m_unit_link_index; // Child UnitId -> index in m_unit_links
+
+	CommandBuffer m_command_buffer;
+	bool m_processing_physics_events;
+
+	LevelStreamer m_level_streamer;
 
 	WorldId m_id;
 
 	EventStream m_events;
+
+	friend class CommandBuffer;
+	friend class LevelStreamer;
 };
 
 } // namespace crown
@@ -0,0 +1,577 @@
+/*
+Copyright (c) 2013 Daniele Bartolini, Michele Rossi
+Copyright (c) 2012 Daniele Bartolini, Simone Boscaratto
+
+Permission is hereby granted, free of charge, to any person
+obtaining a copy of this software and associated documentation
+files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use,
+copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following
+conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "world_snapshot.h"
+#include "world.h"
+#include "unit.h"
+#include "unit_resource.h"
+#include "actor.h"
+#include "array.h"
+#include "hash.h"
+#include "log.h"
+#include "matrix4x4.h"
+#include "quaternion.h"
+#include "vector3.h"
+#include "temp_allocator.h"
+#include <string.h>
+#include <algorithm>
+
+namespace crown
+{
+
+namespace world_snapshot
+{
+	const uint32_t MAGIC = 0x534e5043; // "CPNS"
+	const uint32_t VERSION = 1;
+
+	const uint32_t UNITS_VERSION = 2;
+	const uint32_t PHYSICS_VERSION = 1;
+	const uint32_t SOUNDS_VERSION = 1;
+	const uint32_t LINKS_VERSION = 1;
+
+	struct Header
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint32_t num_chunks;
+		uint32_t _pad;
+	};
+
+	struct ChunkHeader
+	{
+		uint32_t type;
+		uint32_t version;
+		uint32_t size; // Bytes following the header
+		uint32_t _pad;
+	};
+
+	// Followed by num_nodes NodeRecord and values_size bytes of values
+	struct UnitRecord
+	{
+		uint32_t id;
+		uint32_t num_nodes;
+		StringId64 resource;
+		uint32_t values_size;
+		uint32_t _pad;
+	};
+
+	struct NodeRecord
+	{
+		Vector3 position;
+		Quaternion rotation;
+		Vector3 scale;
+		int32_t parent;
+	};
+
+	struct LinkRecord
+	{
+		uint32_t child;
+		uint32_t parent;
+		int32_t node;
+	};
+
+	struct ActorRecord
+	{
+		Vector3 position;
+		Quaternion rotation;
+		Vector3 linear_velocity;
+		Vector3 angular_velocity;
+	};
+
+	struct SoundRecord
+	{
+		StringId64 name;
+		Vector3 position;
+		float range;
+		float volume;
+		uint32_t loop;
+	};
+
+	/// Reads consecutive values from a buffer, failing on overruns.
+	struct Reader
+	{
+		Reader(const char* data, uint32_t size)
+			: cur(data)
+			, end(data + size)
+		{
+		}
+
+		bool read(void* data, uint32_t size)
+		{
+			if (uint32_t(end - cur) < size)
+				return false;
+
+			memcpy(data, cur, size);
+			cur += size;
+			return true;
+		}
+
+		template <typename T>
+		bool read(T& data)
+		{
+			return read(&data, sizeof(T));
+		}
+
+		const char* cur;
+		const char* end;
+	};
+
+	template <typename T>
+	static void write(Array<char>& buf, const T& data)
+	{
+		array::push(buf, (const char*) &data, sizeof(T));
+	}
+
+	/// Writes the header of a chunk of the given @a type and @a version
+	/// and returns its offset, to be passed to end_chunk().
+	static uint32_t begin_chunk(Array<char>& buf, uint32_t type, uint32_t version)
+	{
+		const uint32_t offset = array::size(buf);
+
+		ChunkHeader ch;
+		ch.type = type;
+		ch.version = version;
+		ch.size = 0;
+		ch._pad = 0;
+		write(buf, ch);
+
+		return offset;
+	}
+
+	static void end_chunk(Array<char>& buf, uint32_t offset)
+	{
+		const uint32_t size = array::size(buf) - offset - sizeof(ChunkHeader);
+		memcpy(array::begin(buf) + offset + offsetof(ChunkHeader, size), &size, sizeof(size));
+	}
+
+	static bool unit_less(const UnitId& a, const UnitId& b)
+	{
+		return a.index < b.index;
+	}
+
+	static bool link_less(const UnitLink& a, const UnitLink& b)
+	{
+		return a.child.index < b.child.index;
+	}
+
+	static void save_units(World& w, const Array<UnitId>& units, Array<char>& buf)
+	{
+		const uint32_t chunk = begin_chunk(buf, SnapshotChunk::UNITS, UNITS_VERSION);
+		write(buf, array::size(units));
+
+		for (uint32_t i = 0; i < array::size(units); i++)
+		{
+			Unit* u = w.get_unit(units[i]);
+
+			UnitRecord ur;
+			ur.id = units[i].encode();
+			ur.num_nodes = u->num_nodes();
+			ur.resource = u->m_resource_id;
+			ur.values_size = unit_resource::values_size(u->resource());
+			ur._pad = 0;
+			write(buf, ur);
+
+			for (uint32_t n = 0; n < ur.num_nodes; n++)
+			{
+				NodeRecord nr;
+				nr.position = u->m_scene_graph.local_position(n);
+				nr.rotation = u->m_scene_graph.local_rotation(n);
+				nr.scale = u->m_scene_graph.local_scale(n);
+				nr.parent = u->m_scene_graph.parent(n);
+				write(buf, nr);
+			}
+
+			array::push(buf, u->m_values, ur.values_size);
+		}
+
+		end_chunk(buf, chunk);
+	}
+
+	static void save_physics(World& w, const Array<UnitId>& units, Array<char>& buf)
+	{
+		const uint32_t chunk = begin_chunk(buf, SnapshotChunk::PHYSICS, PHYSICS_VERSION);
+		write(buf, array::size(units));
+
+		for (uint32_t i = 0; i < array::size(units); i++)
+		{
+			Unit* u = w.get_unit(units[i]);
+			write(buf, u->m_num_actors);
+
+			for (uint32_t a = 0; a < u->m_num_actors; a++)
+			{
+				const Actor* actor = u->actor(a);
+
+				ActorRecord ar;
+				ar.position = actor->world_position();
+				ar.rotation = actor->world_rotation();
+				ar.linear_velocity = actor->linear_velocity();
+				ar.angular_velocity = actor->angular_velocity();
+				write(buf, ar);
+			}
+		}
+
+		end_chunk(buf, chunk);
+	}
+
+	static void save_sounds(World& w, Array<char>& buf)
+	{
+		TempAllocator1024 ta;
+		Array<PlayingSound> sounds(ta);
+		w.playing_sounds(sounds);
+
+		const uint32_t chunk = begin_chunk(buf, SnapshotChunk::SOUNDS, SOUNDS_VERSION);
+		write(buf, array::size(sounds));
+
+		for (uint32_t i = 0; i < array::size(sounds); i++)
+		{
+			SoundRecord sr;
+			sr.name = sounds[i].name;
+			sr.position = sounds[i].position;
+			sr.range = sounds[i].range;
+			sr.volume = sounds[i].volume;
+			sr.loop = sounds[i].loop ? 1 : 0;
+			write(buf, sr);
+		}
+
+		end_chunk(buf, chunk);
+	}
+
+	static void save_links(World& w, Array<char>& buf)
+	{
+		TempAllocator1024 ta;
+		Array<UnitLink> links(ta);
+		w.unit_links(links);
+		std::sort(array::begin(links), array::end(links), link_less);
+
+		const uint32_t chunk = begin_chunk(buf, SnapshotChunk::LINKS, LINKS_VERSION);
+		write(buf, array::size(links));
+
+		for (uint32_t i = 0; i < array::size(links); i++)
+		{
+			LinkRecord lr;
+			lr.child = links[i].child.encode();
+			lr.parent = links[i].parent.encode();
+			lr.node = links[i].node;
+			write(buf, lr);
+		}
+
+		end_chunk(buf, chunk);
+	}
+
+	void save(World& w, Array<char>& buf)
+	{
+		TempAllocator4096 ta;
+		Array<UnitId> units(ta);
+		w.units(units);
+		std::sort(array::begin(units), array::end(units), unit_less);
+
+		Header h;
+		h.magic = MAGIC;
+		h.version = VERSION;
+		h.num_chunks = 4;
+		h._pad = 0;
+		write(buf, h);
+
+		save_units(w, units, buf);
+		save_links(w, buf);
+		save_physics(w, units, buf);
+		save_sounds(w, buf);
+	}
+
+	/// Restores the units and appends them to @a units in snapshot order.
+	static bool restore_units(World& w, Reader r, Array<Unit*>& units)
+	{
+		uint32_t num;
+		if (!r.read(num))
+			return false;
+
+		// Find the units in the snapshot, to destroy the others first
+		Hash<StringId64> resources(default_allocator());
+		Reader scan = r;
+		for (uint32_t i = 0; i < num; i++)
+		{
+			UnitRecord ur;
+			if (!scan.read(ur) || uint32_t(scan.end - scan.cur) < ur.num_nodes * sizeof(NodeRecord) + ur.values_size)
+			{
+				return false;
+			}
+
+			scan.cur += ur.num_nodes * sizeof(NodeRecord) + ur.values_size;
+			hash::set(resources, ur.id, ur.resource);
+		}
+
+		TempAllocator4096 ta;
+		Array<UnitId> current(ta);
+		w.units(current);
+
+		for (uint32_t i = 0; i < array::size(current); i++)
+		{
+			const UnitId id = current[i];
+			if (hash::get(resources, id.encode(), StringId64(0)) != w.get_unit(id)->m_resource_id)
+				w.destroy_unit(id);
+		}
+
+		for (uint32_t i = 0; i < num; i++)
+		{
+			UnitRecord ur;
+			r.read(ur);
+
+			UnitId id;
+			id.decode(ur.id);
+
+			Unit* u = NULL;
+			if (w.has_unit(id))
+			{
+				u = w.get_unit(id);
+			}
+			else
+			{
+				NodeRecord root;
+				root.position = vector3::ZERO;
+				root.rotation = quaternion::IDENTITY;
+				if (ur.num_nodes > 0)
+					memcpy(&root, r.cur, sizeof(NodeRecord));
+
+				w.respawn_unit(id, ur.resource, Matrix4x4(root.rotation, root.position));
+				u = w.get_unit(id);
+			}
+
+			if (ur.num_nodes == u->num_nodes())
+			{
+				for (uint32_t n = 0; n < ur.num_nodes; n++)
+				{
+					NodeRecord nr;
+					r.read(nr);
+
+					if (nr.parent < -1 || nr.parent >= (int32_t) n)
+						return false;
+
+					// Linking resets the local pose, which is restored below
+					if (nr.parent != u->m_scene_graph.parent(n))
+					{
+						if (nr.parent == -1)
+							u->unlink_node(n);
+						else
+							u->link_node(n, nr.parent);
+					}
+
+					u->m_scene_graph.set_local_position(n, nr.position);
+					u->m_scene_graph.set_local_rotation(n, nr.rotation);
+					u->m_scene_graph.set_local_scale(n, nr.scale);
+				}
+			}
+			else
+			{
+				CE_LOGW("Snapshot: nodes of unit %.16"PRIx64" changed, skipping", ur.resource);
+				r.cur += ur.num_nodes * sizeof(NodeRecord);
+			}
+
+			if (ur.values_size == unit_resource::values_size(u->resource()))
+				memcpy(u->m_values, r.cur, ur.values_size);
+			r.cur += ur.values_size;
+
+			array::push_back(units, u);
+		}
+
+		return true;
+	}
+
+	static bool restore_links(World& w, Reader r)
+	{
+		uint32_t num;
+		if (!r.read(num))
+			return false;
+
+		TempAllocator1024 ta;
+		Array<UnitLink> links(ta);
+		w.unit_links(links);
+
+		for (uint32_t i = 0; i < array::size(links); i++)
+			w.unlink_unit(links[i].child);
+
+		for (uint32_t i = 0; i < num; i++)
+		{
+			LinkRecord lr;
+			if (!r.read(lr))
+				return false;
+
+			UnitId child;
+			UnitId parent;
+			child.decode(lr.child);
+			parent.decode(lr.parent);
+
+			if (!w.has_unit(child) || !w.has_unit(parent) || lr.node >= (int32_t) w.get_unit(parent)->num_nodes())
+				return false;
+
+			w.link_unit(child, parent, lr.node);
+		}
+
+		return true;
+	}
+
+	static bool restore_physics(Reader r, const Array<Unit*>& units)
+	{
+		uint32_t num;
+		if (!r.read(num) || num != array::size(units))
+			return false;
+
+		for (uint32_t i = 0; i < num; i++)
+		{
+			uint32_t num_actors;
+			if (!r.read(num_actors))
+				return false;
+
+			Unit* u = units[i];
+			for (uint32_t a = 0; a < num_actors; a++)
+			{
+				ActorRecord ar;
+				if (!r.read(ar))
+					return false;
+
+				if (a >= u->m_num_actors)
+					continue;
+
+				Actor* actor = u->actor(a);
+				actor->teleport_world_pose(Matrix4x4(ar.rotation, ar.position));
+
+				if (actor->is_nonkinematic())
+				{
+					actor->set_linear_velocity(ar.linear_velocity);
+					actor->set_angular_velocity(ar.angular_velocity);
+				}
+			}
+		}
+
+		return true;
+	}
+
+	static bool restore_sounds(World& w, Reader r)
+	{
+		uint32_t num;
+		if (!r.read(num))
+			return false;
+
+		TempAllocator1024 ta;
+		Array<PlayingSound> sounds(ta);
+		w.playing_sounds(sounds);
+
+		for (uint32_t i = 0; i < array::size(sounds); i++)
+			w.stop_sound(sounds[i].id);
+
+		// Sounds are restarted from the beginning
+		for (uint32_t i = 0; i < num; i++)
+		{
+			SoundRecord sr;
+			if (!r.read(sr))
+				return false;
+
+			w.play_sound(sr.name, sr.loop != 0, sr.volume, sr.position, sr.range);
+		}
+
+		return true;
+	}
+
+	bool restore(World& w, const char* data, uint32_t size)
+	{
+		Reader r(data, size);
+
+		Header h;
+		if (!r.read(h) || h.magic != MAGIC || h.version != VERSION)
+		{
+			CE_LOGE("Snapshot: bad header");
+			return false;
+		}
+
+		TempAllocator4096 ta;
+		Array<Unit*> units(ta);
+		bool has_units = false;
+
+		for (uint32_t i = 0; i < h.num_chunks; i++)
+		{
+			ChunkHeader ch;
+			if (!r.read(ch) || uint32_t(r.end - r.cur) < ch.size)
+				return false;
+
+			const Reader chunk(r.cur, ch.size);
+			r.cur += ch.size;
+
+			bool ok = true;
+			switch (ch.type)
+			{
+				case SnapshotChunk::UNITS:
+				{
+					if (ch.version != UNITS_VERSION)
+						break;
+
+					ok = restore_units(w, chunk, units);
+					has_units = ok;
+					break;
+				}
+				case SnapshotChunk::PHYSICS:
+				{
+					// Actors refer to the units in the units chunk
+					if (ch.version != PHYSICS_VERSION || !has_units)
+						break;
+
+					ok = restore_physics(chunk, units);
+					break;
+				}
+				case SnapshotChunk::LINKS:
+				{
+					// Links refer to the units in the units chunk
+					if (ch.version != LINKS_VERSION || !has_units)
+						break;
+
+					ok = restore_links(w, chunk);
+					break;
+				}
+				case SnapshotChunk::SOUNDS:
+				{
+					if (ch.version != SOUNDS_VERSION)
+						break;
+
+					ok = restore_sounds(w, chunk);
+					break;
+				}
+				default:
+				{
+					// Skip unknown chunks
+					break;
+				}
+			}
+
+			if (!ok)
+			{
+				CE_LOGE("Snapshot: bad chunk %d", ch.type);
+				return false;
+			}
+		}
+
+		return true;
+	}
+} // namespace world_snapshot
+
+} // namespace crown
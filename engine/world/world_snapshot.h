@@ -0,0 +1,72 @@
+/*
+Copyright (c) 2013 Daniele Bartolini, Michele Rossi
+Copyright (c) 2012 Daniele Bartolini, Simone Boscaratto
+
+Permission is hereby granted, free of charge, to any person
+obtaining a copy of this software and associated documentation
+files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use,
+copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following
+conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+
+#include "types.h"
+#include "container_types.h"
+
+namespace crown
+{
+
+class World;
+
+/// Chunks of a world snapshot, one per subsystem.
+///
+/// @ingroup World
+struct SnapshotChunk
+{
+	enum Enum
+	{
+		UNITS,		// Resource, local node poses and parents and key/values of each unit
+		PHYSICS,	// Pose and velocities of each actor
+		SOUNDS,		// Sounds being played
+		LINKS		// Links between units
+	};
+};
+
+/// Functions to capture and restore the state of a World.
+///
+/// A snapshot is a header followed by a sequence of chunks, each with
+/// its own type, version and size, so that readers can skip the chunks
+/// they do not know about.
+///
+/// @ingroup World
+namespace world_snapshot
+{
+	/// Appends a snapshot of the world @a w to @a buf.
+	/// Units are stored in the order of their ids, so that two worlds in the
+	/// same state give the same bytes.
+	void save(World& w, Array<char>& buf);
+
+	/// Restores the world @a w to the state in the snapshot @a data of @a size bytes.
+	/// Units which are not in the snapshot are destroyed. Units in the snapshot
+	/// which no longer exist are spawned again, with the ids they had.
+	/// Returns false if the snapshot is malformed, leaving the world partially restored.
+	bool restore(World& w, const char* data, uint32_t size);
+} // namespace world_snapshot
+
+} // namespace crown
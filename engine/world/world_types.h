@@ -32,6 +32,7 @@ namespace crown
 {
 
 typedef Id UnitId;
+typedef Id UnitTemplateId;
 typedef Id WorldId;
 typedef Id CameraId;
 
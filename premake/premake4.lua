@@ -55,6 +55,230 @@ if not CROWN_INSTALL_DIR then
 end
 CROWN_INSTALL_DIR = CROWN_INSTALL_DIR .. "/" -- Add slash to end string
 
+-------------------------------------------------------------------------------
+-- Engine include directories, shared by the projects which build engine sources
+CROWN_INCLUDE_DIRS = {
+	CROWN_SOURCE_DIR .. "/engine",
+	CROWN_SOURCE_DIR .. "/engine/core",
+	CROWN_SOURCE_DIR .. "/engine/core/bv",
+	CROWN_SOURCE_DIR .. "/engine/core/containers",
+	CROWN_SOURCE_DIR .. "/engine/core/filesystem",
+	CROWN_SOURCE_DIR .. "/engine/core/json",
+	CROWN_SOURCE_DIR .. "/engine/core/math",
+	CROWN_SOURCE_DIR .. "/engine/core/memory",
+	CROWN_SOURCE_DIR .. "/engine/core/network",
+	CROWN_SOURCE_DIR .. "/engine/core/settings",
+	CROWN_SOURCE_DIR .. "/engine/core/strings",
+	CROWN_SOURCE_DIR .. "/engine/core/thread",
+	CROWN_SOURCE_DIR .. "/engine/main",
+	CROWN_SOURCE_DIR .. "/engine/input",
+	CROWN_SOURCE_DIR .. "/engine/renderers",
+	CROWN_SOURCE_DIR .. "/engine/resource",
+	CROWN_SOURCE_DIR .. "/engine/lua",
+	CROWN_SOURCE_DIR .. "/engine/audio",
+	CROWN_SOURCE_DIR .. "/engine/compilers",
+	CROWN_SOURCE_DIR .. "/engine/physics",
+	CROWN_SOURCE_DIR .. "/engine/world"
+}
+
+-- Linux settings of the projects which build engine sources
+function linux_configuration()
+	configuration { "linux-*" }
+		kind "ConsoleApp"
+
+		buildoptions {
+			"-std=c++03",
+			"-Wall",
+			-- "-Wextra",
+			-- "-Werror",
+			-- "-pedantic",
+			"-Wno-unknown-pragmas",
+			"-Wno-unused-local-typedefs"
+		}
+		
+		linkoptions {
+			"-Wl,-rpath=\\$$ORIGIN",
+			"-Wl,--no-as-needed"
+		}
+
+		links {
+			"Xrandr",
+			"pthread",
+			"GL",
+			"X11",
+			"openal",
+			"luajit",
+			"dl",
+		}
+
+		includedirs {
+			CROWN_THIRD_DIR .. "luajit/src",
+			CROWN_THIRD_DIR .. "openal/include",
+			CROWN_THIRD_DIR .. "freetype",
+			CROWN_THIRD_DIR .. "stb_image",
+			CROWN_THIRD_DIR .. "stb_vorbis",
+			CROWN_THIRD_DIR .. "bgfx/src",
+			CROWN_THIRD_DIR .. "bgfx/include",
+			CROWN_THIRD_DIR .. "bx/include",
+			"$(PHYSX_SDK_LINUX)/Include",
+			"$(PHYSX_SDK_LINUX)/Include/common",
+			"$(PHYSX_SDK_LINUX)/Include/characterkinematic",
+			"$(PHYSX_SDK_LINUX)/Include/cloth",
+			"$(PHYSX_SDK_LINUX)/Include/common",
+			"$(PHYSX_SDK_LINUX)/Include/cooking",
+			"$(PHYSX_SDK_LINUX)/Include/extensions",
+			"$(PHYSX_SDK_LINUX)/Include/foundation",
+			"$(PHYSX_SDK_LINUX)/Include/geometry",
+			"$(PHYSX_SDK_LINUX)/Include/particles",
+			"$(PHYSX_SDK_LINUX)/Include/physxprofilesdk",
+			"$(PHYSX_SDK_LINUX)/Include/physxvisualdebuggersdk",
+			"$(PHYSX_SDK_LINUX)/Include/pvd",
+			"$(PHYSX_SDK_LINUX)/Include/pxtask",
+			"$(PHYSX_SDK_LINUX)/Include/RepX",
+			"$(PHYSX_SDK_LINUX)/Include/RepXUpgrader",
+			"$(PHYSX_SDK_LINUX)/Include/vehicle",
+		}
+		
+	configuration { "linux-*", "debug" }
+		buildoptions {
+			"-O0"
+		}
+
+		links {
+			"bgfxDebug"
+		}
+
+		linkoptions {
+			"-rdynamic",
+			"-Wl,--start-group $(addprefix -l," ..
+			"	LowLevelClothCHECKED" ..
+			"	PhysX3CHECKED " ..
+			"	PhysX3CommonCHECKED" ..
+			"	PxTaskCHECKED" ..
+			"	LowLevelCHECKED" ..
+			"	PhysX3CharacterKinematicCHECKED" ..
+			"	PhysX3CookingCHECKED" ..
+			"	PhysX3ExtensionsCHECKED" ..
+			"	PhysX3VehicleCHECKED" ..
+			"	PhysXProfileSDKCHECKED" ..
+			"	PhysXVisualDebuggerSDKCHECKED" ..
+			"	PvdRuntimeCHECKED" ..
+			"	SceneQueryCHECKED" ..
+			"	SimulationControllerCHECKED" ..
+			") -Wl,--end-group"
+		}
+
+	configuration { "linux-*", "development" }
+		buildoptions {
+			"-O2"
+		}
+
+		links {
+			"bgfxDebug"
+		}
+
+		linkoptions
+		{
+			"-rdynamic",
+			"-Wl,--start-group $(addprefix -l," ..
+			"	LowLevelClothPROFILE" ..
+			"	PhysX3PROFILE " ..
+			"	PhysX3CommonPROFILE" ..
+			"	PxTaskPROFILE" ..
+			"	LowLevelPROFILE" ..
+			"	PhysX3CharacterKinematicPROFILE" ..
+			"	PhysX3CookingPROFILE" ..
+			"	PhysX3ExtensionsPROFILE" ..
+			"	PhysX3VehiclePROFILE" ..
+			"	PhysXProfileSDKPROFILE" ..
+			"	PhysXVisualDebuggerSDKPROFILE" ..
+			"	PvdRuntimePROFILE" ..
+			"	SceneQueryPROFILE" ..
+			"	SimulationControllerPROFILE" ..
+			") -Wl,--end-group"
+		}
+
+	configuration { "linux-*", "release" }
+		buildoptions {
+			"-O2"
+		}
+
+		links {
+			"bgfxRelease"
+		}
+
+		linkoptions {
+			"-Wl,--start-group $(addprefix -l," ..
+			"	LowLevelCloth" ..
+			"	PhysX3 " ..
+			"	PhysX3Common" ..
+			"	PxTask" ..
+			"	LowLevel" ..
+			"	PhysX3CharacterKinematic" ..
+			"	PhysX3Cooking" ..
+			"	PhysX3Extensions" ..
+			"	PhysX3Vehicle" ..
+			"	PhysXProfileSDK" ..
+			"	PhysXVisualDebuggerSDK" ..
+			"	PvdRuntime" ..
+			"	SceneQuery" ..
+			"	SimulationController" ..
+			") -Wl,--end-group"
+		}
+
+	configuration { "linux-*", "x32" }
+		targetdir(CROWN_INSTALL_DIR .. "bin/linux32")
+	
+		buildoptions {
+			"-malign-double" -- Required by PhysX
+		}
+
+		libdirs {
+			CROWN_THIRD_DIR .. "luajit/src",
+			CROWN_THIRD_DIR .. "bgfx/.build/linux32_gcc/bin",
+			"$(PHYSX_SDK_LINUX)/Lib/linux32"
+		}
+
+		postbuildcommands {
+			"cp " .. CROWN_THIRD_DIR .. "luajit/src/luajit " .. CROWN_INSTALL_DIR .. "bin/linux32/",
+			"cp " .. CROWN_THIRD_DIR .. "luajit/src/jit " .. CROWN_INSTALL_DIR .. "bin/linux32/" .. " -r",
+		}
+
+	configuration { "linux-*", "x64" }
+		targetdir(CROWN_INSTALL_DIR .. "bin/linux64")
+
+		libdirs {
+			CROWN_THIRD_DIR .. "luajit/src",
+			CROWN_THIRD_DIR .. "bgfx/.build/linux64_gcc/bin",
+			"$(PHYSX_SDK_LINUX)/Lib/linux64"
+		}
+
+		postbuildcommands {
+			"cp " .. CROWN_THIRD_DIR .. "luajit/src/luajit " .. CROWN_INSTALL_DIR .. "bin/linux64/",
+			"cp " .. CROWN_THIRD_DIR .. "luajit/src/jit " .. CROWN_INSTALL_DIR .. "bin/linux64/" .. " -r",
+		}
+
+	configuration { "debug or development", "x32", "linux-*" }
+		postbuildcommands {
+			"cp " .. CROWN_THIRD_DIR .. "bgfx/.build/linux32_gcc/bin/shadercDebug " .. CROWN_INSTALL_DIR .. "bin/linux32/shaderc"
+		}
+
+	configuration { "release", "x32", "linux-*" }
+		postbuildcommands {
+			"cp " .. CROWN_THIRD_DIR .. "bgfx/.build/linux32_gcc/bin/shadercRelease " .. CROWN_INSTALL_DIR .. "bin/linux32/shaderc"
+		}
+
+	configuration { "debug or development", "x64", "linux-*" }
+		postbuildcommands {
+			"cp " .. CROWN_THIRD_DIR .. "bgfx/.build/linux64_gcc/bin/shadercDebug " .. CROWN_INSTALL_DIR .. "bin/linux64/shaderc"
+		}
+
+	configuration { "release", "x64", "linux-*" }
+		postbuildcommands {
+			"cp " .. CROWN_THIRD_DIR .. "bgfx/.build/linux64_gcc/bin/shadercRelease " .. CROWN_INSTALL_DIR .. "bin/linux64/shaderc"
+		}
+end
+
 -------------------------------------------------------------------------------
 -- Solution
 solution "crown"
@@ -160,229 +384,14 @@ solution "crown"
 	project "crown"
 		language "C++"
 
-		includedirs {
-			CROWN_SOURCE_DIR .. "/engine",
-			CROWN_SOURCE_DIR .. "/engine/core",
-			CROWN_SOURCE_DIR .. "/engine/core/bv",
-			CROWN_SOURCE_DIR .. "/engine/core/containers",
-			CROWN_SOURCE_DIR .. "/engine/core/filesystem",
-			CROWN_SOURCE_DIR .. "/engine/core/json",
-			CROWN_SOURCE_DIR .. "/engine/core/math",
-			CROWN_SOURCE_DIR .. "/engine/core/memory",
-			CROWN_SOURCE_DIR .. "/engine/core/network",
-			CROWN_SOURCE_DIR .. "/engine/core/settings",
-			CROWN_SOURCE_DIR .. "/engine/core/strings",
-			CROWN_SOURCE_DIR .. "/engine/core/thread",
-			CROWN_SOURCE_DIR .. "/engine/main",
-			CROWN_SOURCE_DIR .. "/engine/input",
-			CROWN_SOURCE_DIR .. "/engine/renderers",
-			CROWN_SOURCE_DIR .. "/engine/resource",
-			CROWN_SOURCE_DIR .. "/engine/lua",
-			CROWN_SOURCE_DIR .. "/engine/audio",
-			CROWN_SOURCE_DIR .. "/engine/compilers",
-			CROWN_SOURCE_DIR .. "/engine/physics",
-			CROWN_SOURCE_DIR .. "/engine/world"
-		}
+		includedirs(CROWN_INCLUDE_DIRS)
 
 		files {
 			CROWN_SOURCE_DIR .. "engine/**.h", 
 			CROWN_SOURCE_DIR .. "engine/**.cpp"
 		}
 
-		configuration { "linux-*" }
-			kind "ConsoleApp"
-
-			buildoptions {
-				"-std=c++03",
-				"-Wall",
-				-- "-Wextra",
-				-- "-Werror",
-				-- "-pedantic",
-				"-Wno-unknown-pragmas",
-				"-Wno-unused-local-typedefs"
-			}
-			
-			linkoptions {
-				"-Wl,-rpath=\\$$ORIGIN",
-				"-Wl,--no-as-needed"
-			}
-
-			links {
-				"Xrandr",
-				"pthread",
-				"GL",
-				"X11",
-				"openal",
-				"luajit",
-				"dl",
-			}
-
-			includedirs {
-				CROWN_THIRD_DIR .. "luajit/src",
-				CROWN_THIRD_DIR .. "openal/include",
-				CROWN_THIRD_DIR .. "freetype",
-				CROWN_THIRD_DIR .. "stb_image",
-				CROWN_THIRD_DIR .. "stb_vorbis",
-				CROWN_THIRD_DIR .. "bgfx/src",
-				CROWN_THIRD_DIR .. "bgfx/include",
-				CROWN_THIRD_DIR .. "bx/include",
-				"$(PHYSX_SDK_LINUX)/Include",
-				"$(PHYSX_SDK_LINUX)/Include/common",
-				"$(PHYSX_SDK_LINUX)/Include/characterkinematic",
-				"$(PHYSX_SDK_LINUX)/Include/cloth",
-				"$(PHYSX_SDK_LINUX)/Include/common",
-				"$(PHYSX_SDK_LINUX)/Include/cooking",
-				"$(PHYSX_SDK_LINUX)/Include/extensions",
-				"$(PHYSX_SDK_LINUX)/Include/foundation",
-				"$(PHYSX_SDK_LINUX)/Include/geometry",
-				"$(PHYSX_SDK_LINUX)/Include/particles",
-				"$(PHYSX_SDK_LINUX)/Include/physxprofilesdk",
-				"$(PHYSX_SDK_LINUX)/Include/physxvisualdebuggersdk",
-				"$(PHYSX_SDK_LINUX)/Include/pvd",
-				"$(PHYSX_SDK_LINUX)/Include/pxtask",
-				"$(PHYSX_SDK_LINUX)/Include/RepX",
-				"$(PHYSX_SDK_LINUX)/Include/RepXUpgrader",
-				"$(PHYSX_SDK_LINUX)/Include/vehicle",
-			}
-			
-		configuration { "linux-*", "debug" }
-			buildoptions {
-				"-O0"
-			}
-
-			links {
-				"bgfxDebug"
-			}
-
-			linkoptions {
-				"-rdynamic",
-				"-Wl,--start-group $(addprefix -l," ..
-				"	LowLevelClothCHECKED" ..
-				"	PhysX3CHECKED " ..
-				"	PhysX3CommonCHECKED" ..
-				"	PxTaskCHECKED" ..
-				"	LowLevelCHECKED" ..
-				"	PhysX3CharacterKinematicCHECKED" ..
-				"	PhysX3CookingCHECKED" ..
-				"	PhysX3ExtensionsCHECKED" ..
-				"	PhysX3VehicleCHECKED" ..
-				"	PhysXProfileSDKCHECKED" ..
-				"	PhysXVisualDebuggerSDKCHECKED" ..
-				"	PvdRuntimeCHECKED" ..
-				"	SceneQueryCHECKED" ..
-				"	SimulationControllerCHECKED" ..
-				") -Wl,--end-group"
-			}
-
-		configuration { "linux-*", "development" }
-			buildoptions {
-				"-O2"
-			}
-
-			links {
-				"bgfxDebug"
-			}
-
-			linkoptions
-			{
-				"-rdynamic",
-				"-Wl,--start-group $(addprefix -l," ..
-				"	LowLevelClothPROFILE" ..
-				"	PhysX3PROFILE " ..
-				"	PhysX3CommonPROFILE" ..
-				"	PxTaskPROFILE" ..
-				"	LowLevelPROFILE" ..
-				"	PhysX3CharacterKinematicPROFILE" ..
-				"	PhysX3CookingPROFILE" ..
-				"	PhysX3ExtensionsPROFILE" ..
-				"	PhysX3VehiclePROFILE" ..
-				"	PhysXProfileSDKPROFILE" ..
-				"	PhysXVisualDebuggerSDKPROFILE" ..
-				"	PvdRuntimePROFILE" ..
-				"	SceneQueryPROFILE" ..
-				"	SimulationControllerPROFILE" ..
-				") -Wl,--end-group"
-			}
-
-		configuration { "linux-*", "release" }
-			buildoptions {
-				"-O2"
-			}
-
-			links {
-				"bgfxRelease"
-			}
-
-			linkoptions {
-				"-Wl,--start-group $(addprefix -l," ..
-				"	LowLevelCloth" ..
-				"	PhysX3 " ..
-				"	PhysX3Common" ..
-				"	PxTask" ..
-				"	LowLevel" ..
-				"	PhysX3CharacterKinematic" ..
-				"	PhysX3Cooking" ..
-				"	PhysX3Extensions" ..
-				"	PhysX3Vehicle" ..
-				"	PhysXProfileSDK" ..
-				"	PhysXVisualDebuggerSDK" ..
-				"	PvdRuntime" ..
-				"	SceneQuery" ..
-				"	SimulationController" ..
-				") -Wl,--end-group"
-			}
-
-		configuration { "linux-*", "x32" }
-			targetdir(CROWN_INSTALL_DIR .. "bin/linux32")
-		
-			buildoptions {
-				"-malign-double" -- Required by PhysX
-			}
-
-			libdirs {
-				CROWN_THIRD_DIR .. "luajit/src",
-				CROWN_THIRD_DIR .. "bgfx/.build/linux32_gcc/bin",
-				"$(PHYSX_SDK_LINUX)/Lib/linux32"
-			}
-
-			postbuildcommands {
-				"cp " .. CROWN_THIRD_DIR .. "luajit/src/luajit " .. CROWN_INSTALL_DIR .. "bin/linux32/",
-				"cp " .. CROWN_THIRD_DIR .. "luajit/src/jit " .. CROWN_INSTALL_DIR .. "bin/linux32/" .. " -r",
-			}
-
-		configuration { "linux-*", "x64" }
-			targetdir(CROWN_INSTALL_DIR .. "bin/linux64")
-
-			libdirs {
-				CROWN_THIRD_DIR .. "luajit/src",
-				CROWN_THIRD_DIR .. "bgfx/.build/linux64_gcc/bin",
-				"$(PHYSX_SDK_LINUX)/Lib/linux64"
-			}
-
-			postbuildcommands {
-				"cp " .. CROWN_THIRD_DIR .. "luajit/src/luajit " .. CROWN_INSTALL_DIR .. "bin/linux64/",
-				"cp " .. CROWN_THIRD_DIR .. "luajit/src/jit " .. CROWN_INSTALL_DIR .. "bin/linux64/" .. " -r",
-			}
-
-		configuration { "debug or development", "x32", "linux-*" }
-			postbuildcommands {
-				"cp " .. CROWN_THIRD_DIR .. "bgfx/.build/linux32_gcc/bin/shadercDebug " .. CROWN_INSTALL_DIR .. "bin/linux32/shaderc"
-			}
-
-		configuration { "release", "x32", "linux-*" }
-			postbuildcommands {
-				"cp " .. CROWN_THIRD_DIR .. "bgfx/.build/linux32_gcc/bin/shadercRelease " .. CROWN_INSTALL_DIR .. "bin/linux32/shaderc"
-			}
-
-		configuration { "debug or development", "x64", "linux-*" }
-			postbuildcommands {
-				"cp " .. CROWN_THIRD_DIR .. "bgfx/.build/linux64_gcc/bin/shadercDebug " .. CROWN_INSTALL_DIR .. "bin/linux64/shaderc"
-			}
-
-		configuration { "release", "x64", "linux-*" }
-			postbuildcommands {
-				"cp " .. CROWN_THIRD_DIR .. "bgfx/.build/linux64_gcc/bin/shadercRelease " .. CROWN_INSTALL_DIR .. "bin/linux64/shaderc"
-			}
+		linux_configuration()
 
 		configuration { "android" }
 			kind "ConsoleApp"
@@ -697,3 +706,36 @@ solution "crown"
 				"PhysX3Extensions",
 				"bgfxRelease"
 			}
+
+	-------------------------------------------------------------------------------
+	-- Tests and benchmarks, run them with "/test:<name>" or all at once without arguments
+	if _OPTIONS["compiler"] == "linux-gcc" then
+
+	project "crown-tests"
+		language "C++"
+		kind "ConsoleApp"
+
+		includedirs(CROWN_INCLUDE_DIRS)
+		includedirs {
+			CROWN_SOURCE_DIR .. "/tests"
+		}
+
+		-- Lets the tests find their data in the source tree
+		defines {
+			"CROWN_SOURCE_DIR=\\\"" .. CROWN_SOURCE_DIR .. "\\\""
+		}
+
+		files {
+			CROWN_SOURCE_DIR .. "engine/**.h",
+			CROWN_SOURCE_DIR .. "engine/**.cpp",
+			CROWN_SOURCE_DIR .. "tests/**.h",
+			CROWN_SOURCE_DIR .. "tests/**.cpp"
+		}
+
+		excludes {
+			CROWN_SOURCE_DIR .. "engine/main/main_*.cpp"
+		}
+
+		linux_configuration()
+
+	end
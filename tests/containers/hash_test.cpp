@@ -0,0 +1,87 @@
+/*
+Copyright (c) 2013 Daniele Bartolini, Michele Rossi
+Copyright (c) 2012 Daniele Bartolini, Simone Boscaratto
+
+Permission is hereby granted, free of charge, to any person
+obtaining a copy of this software and associated documentation
+files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use,
+copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following
+conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "hash_test.h"
+#include "hash.h"
+#include "memory.h"
+#include <stdio.h>
+
+using namespace crown;
+
+static const uint64_t NUM_KEYS = 1000;
+
+// Keys sharing the same bucket chain, so that removals relink chains
+static uint64_t key(uint64_t i)
+{
+	return i * 7919;
+}
+
+/// Returns the number of errors found in @a h, where the keys with
+/// an odd index must have been removed.
+static int check(const Hash<uint64_t>& h, const char* when)
+{
+	int errors = 0;
+	for (uint64_t i = 0; i < NUM_KEYS; i++)
+	{
+		const bool removed = i % 2 == 1;
+		const uint64_t value = hash::get(h, key(i), UINT64_MAX);
+
+		if (removed && value != UINT64_MAX)
+			errors++;
+		if (!removed && value != i)
+			errors++;
+	}
+
+	const uint32_t num_entries = uint32_t(hash::end(h) - hash::begin(h));
+	if (num_entries != NUM_KEYS / 2)
+		errors++;
+
+	if (errors != 0)
+		printf("hash: %d errors %s\n", errors, when);
+
+	return errors;
+}
+
+int hash_test()
+{
+	Hash<uint64_t> h(default_allocator());
+
+	for (uint64_t i = 0; i < NUM_KEYS; i++)
+		hash::set(h, key(i), i);
+
+	// Remove from the front so that the last entry is moved in the hole every time
+	for (uint64_t i = 1; i < NUM_KEYS; i += 2)
+		hash::remove(h, key(i));
+
+	int result = check(h, "after remove");
+
+	// Stale entries would reappear once the table is rebuilt
+	hash::reserve(h, 4 * NUM_KEYS);
+	result |= check(h, "after reserve");
+
+	return result != 0 ? 1 : 0;
+}
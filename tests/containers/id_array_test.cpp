@@ -0,0 +1,88 @@
+/*
+Copyright (c) 2013 Daniele Bartolini, Michele Rossi
+Copyright (c) 2012 Daniele Bartolini, Simone Boscaratto
+
+Permission is hereby granted, free of charge, to any person
+obtaining a copy of this software and associated documentation
+files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use,
+copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following
+conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "id_array_test.h"
+#include "id_array.h"
+#include <stdio.h>
+
+using namespace crown;
+
+static const uint32_t MAX = 64;
+
+int id_array_test()
+{
+	IdArray<MAX, uint32_t> a;
+	int errors = 0;
+
+	Id ids[8];
+	for (uint32_t i = 0; i < 8; i++)
+		ids[i] = id_array::create(a, i);
+
+	// Slots 2 and 5 go to the free list
+	id_array::destroy(a, ids[2]);
+	id_array::destroy(a, ids[5]);
+
+	// A free slot and one past the never used ones
+	Id free_id = ids[2];
+	Id far_id;
+	far_id.id = 100;
+	far_id.index = 12;
+
+	id_array::reserve(a, free_id);
+	id_array::reserve(a, far_id);
+	id_array::insert(a, free_id, 102u);
+	id_array::insert(a, far_id, 112u);
+
+	if (!id_array::has(a, free_id) || id_array::get(a, free_id) != 102u)
+		errors++;
+	if (!id_array::has(a, far_id) || id_array::get(a, far_id) != 112u)
+		errors++;
+
+	// New ids fill the remaining slots without touching the reserved ones
+	bool used[MAX] = { false };
+	for (uint32_t i = 0; i < 8; i++)
+		used[ids[i].index] = i != 5;
+	used[far_id.index] = true;
+
+	for (uint32_t i = 0; i < 16; i++)
+	{
+		const Id id = id_array::create(a, 200u + i);
+		if (used[id.index])
+			errors++;
+		used[id.index] = true;
+	}
+
+	if (id_array::get(a, free_id) != 102u || id_array::get(a, far_id) != 112u)
+		errors++;
+	if (id_array::size(a) != 8 + 16)
+		errors++;
+
+	if (errors != 0)
+		printf("id_array: %d errors\n", errors);
+
+	return errors != 0 ? 1 : 0;
+}
@@ -0,0 +1,6 @@
+-- The world snapshot test drives the engine from C++
+function init()
+end
+
+function shutdown()
+end
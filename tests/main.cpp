@@ -0,0 +1,116 @@
+/*
+Copyright (c) 2013 Daniele Bartolini, Michele Rossi
+Copyright (c) 2012 Daniele Bartolini, Simone Boscaratto
+
+Permission is hereby granted, free of charge, to any person
+obtaining a copy of this software and associated documentation
+files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use,
+copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following
+conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+//Category 'containers'
+#include "containers/hash_test.h"
+#include "containers/id_array_test.h"
+
+//Category 'math'
+#include "math/matrix4x4_benchmark.h"
+
+//Category 'resource'
+#include "resource/texture_streamer_test.h"
+
+//Category 'world'
+#include "world/animation_test.h"
+#include "world/level_streaming_benchmark.h"
+#include "world/spatial_index_benchmark.h"
+#include "world/world_snapshot_test.h"
+
+#include "memory.h"
+#include "main.h"
+#include <stdio.h>
+#include <string.h>
+
+namespace crown
+{
+
+/// The tests run headless, without a window to receive events from.
+bool next_event(OsEvent& /*ev*/)
+{
+	return false;
+}
+
+} // namespace crown
+
+struct Test
+{
+	const char* name;
+	int (*run)();
+};
+
+static const Test s_tests[] =
+{
+	{ "animation_test", animation_test },
+	{ "hash_test", hash_test },
+	{ "id_array_test", id_array_test },
+	{ "level_streaming_benchmark", level_streaming_benchmark },
+	{ "matrix4x4_benchmark", matrix4x4_benchmark },
+	{ "spatial_index_benchmark", spatial_index_benchmark },
+	{ "texture_streamer_test", texture_streamer_test },
+	{ "world_snapshot_test", world_snapshot_test }
+};
+
+static const uint32_t NUM_TESTS = sizeof(s_tests) / sizeof(s_tests[0]);
+
+static int run(const Test& test)
+{
+	const int result = test.run();
+	printf("%s: %s\n", test.name, result == 0 ? "passed" : "failed");
+	return result;
+}
+
+/// Runs the test named by "/test:<name>", as tools/gui/crown-tests does, or all the tests.
+/// Returns 0 if the tests passed.
+int main(int argc, char** argv)
+{
+	using namespace crown;
+
+	memory_globals::init();
+
+	int result = 0;
+	if (argc < 2)
+	{
+		for (uint32_t i = 0; i < NUM_TESTS; i++)
+			result |= run(s_tests[i]);
+	}
+	else
+	{
+		result = -2;
+		for (uint32_t i = 0; i < NUM_TESTS; i++)
+		{
+			if (strncmp(argv[1], "/test:", 6) == 0 && strcmp(argv[1] + 6, s_tests[i].name) == 0)
+				result = run(s_tests[i]);
+		}
+
+		if (result == -2)
+			printf("Unknown test: %s\n", argv[1]);
+	}
+
+	memory_globals::shutdown();
+	return result;
+}
@@ -0,0 +1,156 @@
+/*
+Copyright (c) 2013 Daniele Bartolini, Michele Rossi
+Copyright (c) 2012 Daniele Bartolini, Simone Boscaratto
+
+Permission is hereby granted, free of charge, to any person
+obtaining a copy of this software and associated documentation
+files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use,
+copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following
+conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "matrix4x4_benchmark.h"
+#include "matrix4x4.h"
+#include "math_utils.h"
+#include "random.h"
+#include "memory.h"
+#include "test_utils.h"
+#include <stdio.h>
+
+using namespace crown;
+
+static const uint32_t NUM_MATRICES = 4096;
+static const uint32_t NUM_ITERATIONS = 100;
+
+static Matrix4x4 random_pose(Random& rnd)
+{
+	Vector3 axis(rnd.unit_float() + 0.1f, rnd.unit_float(), rnd.unit_float());
+	vector3::normalize(axis);
+	const Quaternion rot(axis, rnd.unit_float() * 6.28f);
+	const Vector3 pos(rnd.unit_float() * 100.0f, rnd.unit_float() * 100.0f, rnd.unit_float() * 100.0f);
+	return Matrix4x4(rot, pos);
+}
+
+/// Reference product, written out so that it never goes through the SIMD path.
+static void scalar_multiply(const Matrix4x4& a, const Matrix4x4& b, Matrix4x4& out)
+{
+	const float* ma = matrix4x4::to_float_ptr(a);
+	const float* mb = matrix4x4::to_float_ptr(b);
+	float* r = matrix4x4::to_float_ptr(out);
+
+	for (uint32_t col = 0; col < 4; col++)
+	{
+		for (uint32_t row = 0; row < 4; row++)
+		{
+			r[col * 4 + row] = ma[0 * 4 + row] * mb[col * 4 + 0]
+				+ ma[1 * 4 + row] * mb[col * 4 + 1]
+				+ ma[2 * 4 + row] * mb[col * 4 + 2]
+				+ ma[3 * 4 + row] * mb[col * 4 + 3];
+		}
+	}
+}
+
+static const char* simd_name()
+{
+#if CROWN_SIMD_SSE
+	return "SSE2";
+#elif CROWN_SIMD_NEON
+	return "NEON";
+#else
+	return "scalar";
+#endif
+}
+
+int matrix4x4_benchmark()
+{
+	Allocator& a = default_allocator();
+	Matrix4x4* ma = (Matrix4x4*) a.allocate(sizeof(Matrix4x4) * NUM_MATRICES);
+	Matrix4x4* mb = (Matrix4x4*) a.allocate(sizeof(Matrix4x4) * NUM_MATRICES);
+	Matrix4x4* out = (Matrix4x4*) a.allocate(sizeof(Matrix4x4) * NUM_MATRICES);
+	Vector3* points = (Vector3*) a.allocate(sizeof(Vector3) * NUM_MATRICES);
+
+	Random rnd(42);
+	for (uint32_t i = 0; i < NUM_MATRICES; i++)
+	{
+		ma[i] = random_pose(rnd);
+		mb[i] = random_pose(rnd);
+		points[i] = Vector3(rnd.unit_float(), rnd.unit_float(), rnd.unit_float());
+	}
+
+	// Check the products before timing them
+	int result = 0;
+	matrix4x4::multiply(ma, mb, out, NUM_MATRICES);
+	for (uint32_t i = 0; i < NUM_MATRICES && result == 0; i++)
+	{
+		Matrix4x4 expected;
+		scalar_multiply(ma[i], mb[i], expected);
+
+		const float* e = matrix4x4::to_float_ptr(expected);
+		const float* r = matrix4x4::to_float_ptr(out[i]);
+		for (uint32_t j = 0; j < 16; j++)
+		{
+			if (!math::equals(e[j], r[j], 0.001f))
+			{
+				printf("multiply: matrix %d differs from the scalar product\n", i);
+				result = 1;
+				break;
+			}
+		}
+	}
+
+	int64_t start = os::clocktime();
+	for (uint32_t it = 0; it < NUM_ITERATIONS; it++)
+		matrix4x4::multiply(ma, mb, out, NUM_MATRICES);
+	const double t_multiply = seconds_since(start);
+
+	start = os::clocktime();
+	for (uint32_t it = 0; it < NUM_ITERATIONS; it++)
+	{
+		for (uint32_t i = 0; i < NUM_MATRICES; i++)
+			scalar_multiply(ma[i], mb[i], out[i]);
+	}
+	const double t_scalar_multiply = seconds_since(start);
+
+	start = os::clocktime();
+	for (uint32_t it = 0; it < NUM_ITERATIONS; it++)
+	{
+		for (uint32_t i = 0; i < NUM_MATRICES; i++)
+		{
+			out[i] = ma[i];
+			matrix4x4::invert(out[i]);
+		}
+	}
+	const double t_invert = seconds_since(start);
+
+	start = os::clocktime();
+	for (uint32_t it = 0; it < NUM_ITERATIONS; it++)
+		matrix4x4::transform_points(ma[it], points, points, NUM_MATRICES);
+	const double t_transform = seconds_since(start);
+
+	printf("matrix4x4 (%s), %d matrices, ms per call:\n", simd_name(), NUM_MATRICES);
+	printf("  multiply:          %.3f (scalar reference %.3f)\n", t_multiply * 1000.0 / NUM_ITERATIONS, t_scalar_multiply * 1000.0 / NUM_ITERATIONS);
+	printf("  invert:            %.3f\n", t_invert * 1000.0 / NUM_ITERATIONS);
+	printf("  transform_points:  %.3f\n", t_transform * 1000.0 / NUM_ITERATIONS);
+
+	a.deallocate(points);
+	a.deallocate(out);
+	a.deallocate(mb);
+	a.deallocate(ma);
+	return result;
+}
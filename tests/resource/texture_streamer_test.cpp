@@ -0,0 +1,169 @@
+/*
+Copyright (c) 2013 Daniele Bartolini, Michele Rossi
+Copyright (c) 2012 Daniele Bartolini, Simone Boscaratto
+
+Permission is hereby granted, free of charge, to any person
+obtaining a copy of this software and associated documentation
+files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use,
+copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following
+conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "texture_streamer_test.h"
+#include "texture_streamer.h"
+#include "texture_resource.h"
+#include "bundle.h"
+#include "null_file.h"
+#include "memory.h"
+#include <stdio.h>
+
+using namespace crown;
+
+static const uint32_t NUM_TEXTURES = 4;
+static const uint32_t SIZE = 1024;
+static const uint32_t NUM_MIPS = 11;
+static const uint32_t MIN_MIP = 4; // 1024 >> 4 == CE_TEXTURE_STREAMING_MIN_SIZE
+static const uint32_t NUM_FRAMES = 200;
+
+/// Bundle whose textures read as zeros, the streamer only cares about their size.
+class NullBundle : public Bundle
+{
+public:
+
+	File* open(ResourceId /*name*/) { return CE_NEW(default_allocator(), NullFile)(FOM_READ); }
+	void close(File* resource) { CE_DELETE(default_allocator(), resource); }
+};
+
+/// Runs the frames of the game and of the loader thread, drawing the texture
+/// i @a usage[i] pixels wide. Returns the number of frames over @a budget.
+static int run_frames(TextureStreamer& ts, TextureResource* textures, const float* usage, uint32_t budget)
+{
+	int over = 0;
+
+	for (uint32_t f = 0; f < NUM_FRAMES; f++)
+	{
+		for (uint32_t i = 0; i < NUM_TEXTURES; i++)
+		{
+			if (usage[i] > 0.0f)
+				ts.record_usage(textures[i].handle.idx, usage[i]);
+		}
+
+		ts.update();
+		ts.process();
+
+		if (ts.memory_used() > budget)
+			over++;
+	}
+
+	return over;
+}
+
+int texture_streamer_test()
+{
+	NullBundle bundle;
+	NullTextureStreamerBackend backend;
+	int errors = 0;
+
+	TextureResource textures[NUM_TEXTURES];
+	for (uint32_t i = 0; i < NUM_TEXTURES; i++)
+	{
+		TextureResource& tr = textures[i];
+		tr.mem = NULL;
+		tr.handle.idx = backend.create_texture(NULL, 0);
+		tr.width = SIZE;
+		tr.height = SIZE;
+		tr.format = 0; // DXT1
+		tr.num_mips = NUM_MIPS;
+		tr.first_mip = MIN_MIP;
+	}
+
+	const uint32_t low = texture_resource::mips_size(textures[0], MIN_MIP);
+	const uint32_t full = texture_resource::mips_size(textures[0], 0);
+
+	// Without any budget only the low mips are resident, even when drawn at full size
+	{
+		TextureStreamer ts(bundle, backend, 0);
+		for (uint32_t i = 0; i < NUM_TEXTURES; i++)
+			ts.add(i, &textures[i]);
+
+		const float usage[NUM_TEXTURES] = { 1024.0f, 1024.0f, 1024.0f, 1024.0f };
+		run_frames(ts, textures, usage, 0);
+
+		if (ts.memory_used() != NUM_TEXTURES * low)
+			errors++;
+		for (uint32_t i = 0; i < NUM_TEXTURES; i++)
+			errors += ts.resident_mip(&textures[i]) != MIN_MIP;
+
+		for (uint32_t i = 0; i < NUM_TEXTURES; i++)
+			ts.remove(&textures[i]);
+	}
+
+	// The most used texture gets all of its mips, the others share what is left
+	{
+		const uint32_t budget = full + (NUM_TEXTURES - 1) * low + low;
+		TextureStreamer ts(bundle, backend, budget);
+		for (uint32_t i = 0; i < NUM_TEXTURES; i++)
+			ts.add(i, &textures[i]);
+
+		const float usage[NUM_TEXTURES] = { 1024.0f, 512.0f, 256.0f, 128.0f };
+		errors += run_frames(ts, textures, usage, budget);
+
+		if (ts.resident_mip(&textures[0]) != 0)
+			errors++;
+		for (uint32_t i = 1; i < NUM_TEXTURES; i++)
+			errors += ts.resident_mip(&textures[i]) == 0;
+
+		for (uint32_t i = 0; i < NUM_TEXTURES; i++)
+			ts.remove(&textures[i]);
+	}
+
+	// With plenty of budget usage loads the high mips, lack of usage evicts them
+	{
+		const uint32_t budget = NUM_TEXTURES * full;
+		TextureStreamer ts(bundle, backend, budget);
+		for (uint32_t i = 0; i < NUM_TEXTURES; i++)
+			ts.add(i, &textures[i]);
+
+		const float used[NUM_TEXTURES] = { 1024.0f, 256.0f, 0.0f, 0.0f };
+		errors += run_frames(ts, textures, used, budget);
+
+		errors += ts.resident_mip(&textures[0]) != 0;
+		errors += ts.resident_mip(&textures[1]) != 2;
+		errors += ts.resident_mip(&textures[2]) != MIN_MIP;
+		errors += ts.resident_mip(&textures[3]) != MIN_MIP;
+
+		const float unused[NUM_TEXTURES] = { 0.0f, 0.0f, 0.0f, 0.0f };
+		errors += run_frames(ts, textures, unused, budget);
+
+		if (ts.memory_used() != NUM_TEXTURES * low)
+			errors++;
+
+		for (uint32_t i = 0; i < NUM_TEXTURES; i++)
+			ts.remove(&textures[i]);
+	}
+
+	// Replaced textures must not leak
+	if (backend.num_textures() != NUM_TEXTURES)
+		errors++;
+
+	if (errors != 0)
+		printf("texture_streamer: %d errors\n", errors);
+
+	return errors != 0 ? 1 : 0;
+}
@@ -24,30 +24,19 @@ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
 OTHER DEALINGS IN THE SOFTWARE.
 */
 
+
 #pragma once
 
-#include "sprite_resource.h"
+#include "types.h"
+#include "os.h"
 
 namespace crown
 {
 
-struct SpriteAnimation
+/// Returns the seconds elapsed since @a start, a value of os::clocktime().
+inline double seconds_since(int64_t start)
 {
-	SpriteAnimation(const SpriteAnimationResource* sar);
-
-	void play(StringId32 name, bool loop);
-	void stop();
-
-	void update(float dt);
-
-public:
-
-	const SpriteAnimationResource* m_resource;
-	const SpriteAnimationData* m_animation;
-	const uint32_t* m_frames;
-	float m_cur_time;
-	uint32_t m_cur_frame;
-	bool m_loop;
-};
+	return double(os::clocktime() - start) / double(os::clockfrequency());
+}
 
 } // namespace crown
@@ -0,0 +1,469 @@
+/*
+Copyright (c) 2013 Daniele Bartolini, Michele Rossi
+Copyright (c) 2012 Daniele Bartolini, Simone Boscaratto
+
+Permission is hereby granted, free of charge, to any person
+obtaining a copy of this software and associated documentation
+files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use,
+copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following
+conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "animation_test.h"
+#include "animation.h"
+#include "animation_resource.h"
+#include "skeleton_resource.h"
+#include "compile_options.h"
+#include "disk_filesystem.h"
+#include "string_stream.h"
+#include "string_utils.h"
+#include "array.h"
+#include "memory.h"
+#include "matrix4x4.h"
+#include "quaternion.h"
+#include "vector3.h"
+#include "math_utils.h"
+#include "random.h"
+#include "os.h"
+#include <stdio.h>
+#include <math.h>
+
+using namespace crown;
+using namespace string_stream;
+
+#define BUILD_DIR CROWN_SOURCE_DIR ".build"
+#define TEST_DIR BUILD_DIR "/animation_test"
+
+static const float SAMPLE_RATE = 30.0f;
+static const uint32_t NUM_FRAMES = 31;
+
+// Keys are dropped within 0.001, quantization adds less than that
+static const float ROTATION_TOLERANCE = 0.005f;	// Radians
+static const float VECTOR3_TOLERANCE = 0.005f;
+static const float MATRIX_TOLERANCE = 0.0001f;
+
+enum { ROTATION = 1, POSITION = 2, SCALE = 4 };
+
+struct Bone
+{
+	const char* name;
+	const char* parent;
+	uint32_t channels;
+};
+
+// Children come before their parents so that the compiler has to sort them
+static const Bone BONES[] =
+{
+	{ "hand_l", "arm_l", ROTATION | POSITION },
+	{ "root", NULL, POSITION },
+	{ "spine", "root", ROTATION },
+	{ "arm_l", "spine", ROTATION | SCALE },
+	{ "arm_r", "spine", 0 }
+};
+
+static const uint32_t NUM_BONES = sizeof(BONES) / sizeof(BONES[0]);
+
+static Vector3 bind_position(uint32_t b)
+{
+	return string::strcmp(BONES[b].name, "root") == 0 ? Vector3(0, 0, 0) : Vector3(0, 1, 0);
+}
+
+static Quaternion bind_rotation(uint32_t b)
+{
+	return string::strcmp(BONES[b].name, "arm_r") == 0 ? Quaternion(Vector3(0, 0, 1), 0.5f) : quaternion::IDENTITY;
+}
+
+static Quaternion frame_rotation(uint32_t b, uint32_t f)
+{
+	Vector3 axis(1.0f, float(b + 1), 0.5f);
+	vector3::normalize(axis);
+	return Quaternion(axis, 0.8f * sinf(2.0f * f / SAMPLE_RATE + b));
+}
+
+static Vector3 frame_position(uint32_t b, uint32_t f)
+{
+	const float t = f / SAMPLE_RATE;
+	return Vector3(t + b, 0.5f * sinf(3.0f * t), 2.0f);
+}
+
+static Vector3 frame_scale(uint32_t /*b*/, uint32_t f)
+{
+	const float t = f / SAMPLE_RATE;
+	return Vector3(1.0f + 0.2f * t, 1.0f, 1.0f - 0.1f * t);
+}
+
+static Quaternion nlerp(const Quaternion& a, const Quaternion& b, float t)
+{
+	const float s = quaternion::dot(a, b) < 0.0f ? -1.0f : 1.0f;
+	const Quaternion q(a.x + (b.x * s - a.x) * t,
+		a.y + (b.y * s - a.y) * t,
+		a.z + (b.z * s - a.z) * t,
+		a.w + (b.w * s - a.w) * t);
+	return q * (1.0f / quaternion::length(q));
+}
+
+static float rotation_error(const Quaternion& a, const Quaternion& b)
+{
+	return 2.0f * math::acos(math::min(1.0f, math::abs(quaternion::dot(a, b))));
+}
+
+/// Returns the largest difference between the components of @a a and @a b,
+/// acos() being too coarse near 1 to compare nearly equal rotations.
+static float quaternion_difference(const Quaternion& a, const Quaternion& b)
+{
+	const float s = quaternion::dot(a, b) < 0.0f ? -1.0f : 1.0f;
+	float diff = 0.0f;
+	for (uint32_t i = 0; i < 4; i++)
+		diff = math::max(diff, math::abs(a[i] - b[i] * s));
+	return diff;
+}
+
+static Quaternion pose_rotation(const SkeletonPose& p, uint32_t i)
+{
+	return Quaternion(p.rx[i], p.ry[i], p.rz[i], p.rw[i]);
+}
+
+static Vector3 pose_position(const SkeletonPose& p, uint32_t i)
+{
+	return Vector3(p.tx[i], p.ty[i], p.tz[i]);
+}
+
+static Vector3 pose_scale(const SkeletonPose& p, uint32_t i)
+{
+	return Vector3(p.sx[i], p.sy[i], p.sz[i]);
+}
+
+/// Reference product, written out so that it never goes through the SIMD path.
+static Matrix4x4 scalar_multiply(const Matrix4x4& a, const Matrix4x4& b)
+{
+	const float* ma = matrix4x4::to_float_ptr(a);
+	const float* mb = matrix4x4::to_float_ptr(b);
+	float r[16];
+
+	for (uint32_t col = 0; col < 4; col++)
+	{
+		for (uint32_t row = 0; row < 4; row++)
+		{
+			r[col * 4 + row] = ma[0 * 4 + row] * mb[col * 4 + 0]
+				+ ma[1 * 4 + row] * mb[col * 4 + 1]
+				+ ma[2 * 4 + row] * mb[col * 4 + 2]
+				+ ma[3 * 4 + row] * mb[col * 4 + 3];
+		}
+	}
+
+	return Matrix4x4(r);
+}
+
+static bool matrix_equals(const Matrix4x4& a, const Matrix4x4& b)
+{
+	const float* ma = matrix4x4::to_float_ptr(a);
+	const float* mb = matrix4x4::to_float_ptr(b);
+
+	for (uint32_t i = 0; i < 16; i++)
+	{
+		if (math::abs(ma[i] - mb[i]) > MATRIX_TOLERANCE)
+			return false;
+	}
+
+	return true;
+}
+
+static void write_vector3(StringStream& ss, const Vector3& v)
+{
+	ss << "[";
+	stream_printf(ss, "%.6f", v.x) << ",";
+	stream_printf(ss, "%.6f", v.y) << ",";
+	stream_printf(ss, "%.6f", v.z) << "]";
+}
+
+static void write_quaternion(StringStream& ss, const Quaternion& q)
+{
+	ss << "[";
+	stream_printf(ss, "%.6f", q.x) << ",";
+	stream_printf(ss, "%.6f", q.y) << ",";
+	stream_printf(ss, "%.6f", q.z) << ",";
+	stream_printf(ss, "%.6f", q.w) << "]";
+}
+
+static void write_file(Filesystem& fs, const char* path, StringStream& ss)
+{
+	File* file = fs.open(path, FOM_WRITE);
+	file->write(c_str(ss), array::size(ss));
+	fs.close(file);
+}
+
+static void write_sources(Filesystem& fs)
+{
+	StringStream skeleton(default_allocator());
+	skeleton << "{\"bones\":[";
+	for (uint32_t b = 0; b < NUM_BONES; b++)
+	{
+		skeleton << (b ? "," : "") << "{\"name\":\"" << BONES[b].name << "\"";
+		if (BONES[b].parent)
+			skeleton << ",\"parent\":\"" << BONES[b].parent << "\"";
+		skeleton << ",\"position\":";
+		write_vector3(skeleton, bind_position(b));
+		skeleton << ",\"rotation\":";
+		write_quaternion(skeleton, bind_rotation(b));
+		skeleton << "}";
+	}
+	skeleton << "]}";
+	write_file(fs, "test.skeleton", skeleton);
+
+	StringStream animation(default_allocator());
+	animation << "{\"sample_rate\":" << SAMPLE_RATE << ",\"tracks\":[";
+	bool first_track = true;
+	for (uint32_t b = 0; b < NUM_BONES; b++)
+	{
+		if (BONES[b].channels == 0)
+			continue;
+
+		animation << (first_track ? "" : ",") << "{\"bone\":\"" << BONES[b].name << "\"";
+		first_track = false;
+
+		if (BONES[b].channels & ROTATION)
+		{
+			animation << ",\"rotations\":[";
+			for (uint32_t f = 0; f < NUM_FRAMES; f++)
+			{
+				animation << (f ? "," : "");
+				write_quaternion(animation, frame_rotation(b, f));
+			}
+			animation << "]";
+		}
+
+		if (BONES[b].channels & POSITION)
+		{
+			animation << ",\"positions\":[";
+			for (uint32_t f = 0; f < NUM_FRAMES; f++)
+			{
+				animation << (f ? "," : "");
+				write_vector3(animation, frame_position(b, f));
+			}
+			animation << "]";
+		}
+
+		if (BONES[b].channels & SCALE)
+		{
+			animation << ",\"scales\":[";
+			for (uint32_t f = 0; f < NUM_FRAMES; f++)
+			{
+				animation << (f ? "," : "");
+				write_vector3(animation, frame_scale(b, f));
+			}
+			animation << "]";
+		}
+
+		animation << "}";
+	}
+	animation << "]}";
+	write_file(fs, "test.animation", animation);
+}
+
+/// Compiles @a path to @a out and loads the result.
+static void* compile(Filesystem& fs, const char* path, const char* out, void (*compiler)(const char*, CompileOptions&),
+	void* (*loader)(File&, Allocator&))
+{
+	File* outf = fs.open(out, FOM_WRITE);
+	{
+		// Options must be destroyed before closing the file to flush the writes
+		CompileOptions opts(fs, outf, Platform::LINUX);
+		compiler(path, opts);
+	}
+	fs.close(outf);
+
+	File* inf = fs.open(out, FOM_READ);
+	void* res = loader(*inf, default_allocator());
+	fs.close(inf);
+	return res;
+}
+
+/// Returns the number of rotations which do not survive encoding within tolerance.
+static int check_encoding()
+{
+	Random rnd(7);
+	int errors = 0;
+
+	for (uint32_t i = 0; i < 1000; i++)
+	{
+		Vector3 axis(rnd.unit_float() - 0.5f, rnd.unit_float() - 0.5f, rnd.unit_float() - 0.5f);
+		vector3::normalize(axis);
+		const Quaternion q(axis, rnd.unit_float() * 2.0f * math::PI);
+
+		uint16_t v[3];
+		animation_resource::encode_rotation(q, v);
+		if (rotation_error(animation_resource::decode_rotation(v), q) > 0.001f)
+			errors++;
+	}
+
+	return errors;
+}
+
+/// Returns the number of bones of @a pose which differ from the clip at @a frame.
+static int check_sample(const SkeletonResource* sr, const SkeletonPose& pose, float frame)
+{
+	const uint32_t f0 = math::min(uint32_t(frame), NUM_FRAMES - 2);
+	const float alpha = frame - f0;
+	int errors = 0;
+
+	for (uint32_t b = 0; b < NUM_BONES; b++)
+	{
+		const uint32_t i = skeleton_resource::bone_index(sr, string::murmur2_32(BONES[b].name, string::strlen(BONES[b].name)));
+		const uint32_t ch = BONES[b].channels;
+
+		const Quaternion r = ch & ROTATION ? nlerp(frame_rotation(b, f0), frame_rotation(b, f0 + 1), alpha) : bind_rotation(b);
+		const Vector3 t = ch & POSITION ? frame_position(b, f0) + (frame_position(b, f0 + 1) - frame_position(b, f0)) * alpha : bind_position(b);
+		const Vector3 s = ch & SCALE ? frame_scale(b, f0) + (frame_scale(b, f0 + 1) - frame_scale(b, f0)) * alpha : Vector3(1, 1, 1);
+
+		if (rotation_error(pose_rotation(pose, i), r) > ROTATION_TOLERANCE
+			|| vector3::length(pose_position(pose, i) - t) > VECTOR3_TOLERANCE
+			|| vector3::length(pose_scale(pose, i) - s) > VECTOR3_TOLERANCE)
+		{
+			errors++;
+		}
+	}
+
+	return errors;
+}
+
+/// Returns the number of bones of @a out which are not the blend of @a a and @a b.
+static int check_blend(const SkeletonPose& a, const SkeletonPose& b, float weight, const SkeletonPose& out)
+{
+	int errors = 0;
+
+	for (uint32_t i = 0; i < a.num_bones; i++)
+	{
+		const Quaternion r = nlerp(pose_rotation(a, i), pose_rotation(b, i), weight);
+		const Vector3 t = pose_position(a, i) + (pose_position(b, i) - pose_position(a, i)) * weight;
+		const Vector3 s = pose_scale(a, i) + (pose_scale(b, i) - pose_scale(a, i)) * weight;
+
+		if (quaternion_difference(pose_rotation(out, i), r) > 0.0001f
+			|| vector3::length(pose_position(out, i) - t) > 0.0001f
+			|| vector3::length(pose_scale(out, i) - s) > 0.0001f)
+		{
+			errors++;
+		}
+	}
+
+	return errors;
+}
+
+/// Returns the number of bones whose model-space transform in @a model differs from @a pose.
+static int check_model(const SkeletonResource* sr, const SkeletonPose& pose, const Matrix4x4* model)
+{
+	const int32_t* parents = skeleton_resource::parents(sr);
+	Matrix4x4 ref[NUM_BONES];
+	int errors = 0;
+
+	for (uint32_t i = 0; i < pose.num_bones; i++)
+	{
+		const Vector3 s = pose_scale(pose, i);
+		Matrix4x4 local(pose_rotation(pose, i), pose_position(pose, i));
+		local.x *= s.x;
+		local.y *= s.y;
+		local.z *= s.z;
+
+		ref[i] = parents[i] == -1 ? local : scalar_multiply(ref[parents[i]], local);
+		if (!matrix_equals(model[i], ref[i]))
+			errors++;
+	}
+
+	return errors;
+}
+
+int animation_test()
+{
+	if (!os::exists(BUILD_DIR))
+		os::create_directory(BUILD_DIR);
+	if (!os::exists(TEST_DIR))
+		os::create_directory(TEST_DIR);
+
+	DiskFilesystem fs(TEST_DIR);
+	write_sources(fs);
+
+	SkeletonResource* sr = (SkeletonResource*) compile(fs, "test.skeleton", "test.skeleton.bin", skeleton_resource::compile, skeleton_resource::load);
+	AnimationResource* ar = (AnimationResource*) compile(fs, "test.animation", "test.animation.bin", animation_resource::compile, animation_resource::load);
+
+	int errors = 0;
+	errors += check_encoding();
+
+	if (skeleton_resource::num_bones(sr) != NUM_BONES || animation_resource::num_tracks(ar) != NUM_BONES - 1)
+		errors++;
+
+	// Parents come before their children
+	const int32_t* parents = skeleton_resource::parents(sr);
+	for (uint32_t i = 0; i < NUM_BONES; i++)
+		errors += parents[i] >= int32_t(i);
+
+	Array<int32_t> tracks(default_allocator());
+	animation::bind_tracks(sr, ar, tracks);
+
+	SkeletonPose a(default_allocator());
+	SkeletonPose b(default_allocator());
+	SkeletonPose out(default_allocator());
+	PoseSampler sampler(default_allocator());
+	animation::init(a, sr);
+	animation::init(b, sr);
+	animation::init(out, sr);
+
+	Matrix4x4 model[NUM_BONES];
+	Matrix4x4 palette[NUM_BONES];
+
+	// The bind pose skins to the identity
+	animation::to_model(sr, a, model);
+	animation::to_skinning_palette(sr, model, palette);
+	for (uint32_t i = 0; i < NUM_BONES; i++)
+		errors += !matrix_equals(palette[i], matrix4x4::IDENTITY);
+
+	// On and between the frames of the clip
+	for (uint32_t i = 0; i < 2 * (NUM_FRAMES - 1); i++)
+	{
+		const float frame = i * 0.5f + 0.1f * (i & 1);
+		animation::sample(sr, ar, array::begin(tracks), frame / SAMPLE_RATE, sampler, a);
+		errors += check_sample(sr, a, frame);
+
+		animation::to_model(sr, a, model);
+		errors += check_model(sr, a, model);
+	}
+
+	// Past the end the last frame is held
+	animation::sample(sr, ar, array::begin(tracks), 10.0f, sampler, a);
+	errors += check_sample(sr, a, float(NUM_FRAMES - 1));
+
+	const float weights[] = { 0.0f, 0.3f, 0.5f, 1.0f };
+	for (uint32_t i = 0; i < sizeof(weights) / sizeof(weights[0]); i++)
+	{
+		animation::sample(sr, ar, array::begin(tracks), 0.2f, sampler, a);
+		animation::sample(sr, ar, array::begin(tracks), 0.7f, sampler, b);
+		animation::blend(a, b, weights[i], out);
+		errors += check_blend(a, b, weights[i], out);
+
+		// The output can alias the inputs
+		animation::blend(a, b, weights[i], a);
+		errors += check_blend(out, out, 0.0f, a);
+	}
+
+	default_allocator().deallocate(ar);
+	default_allocator().deallocate(sr);
+
+	if (errors != 0)
+		printf("animation: %d errors\n", errors);
+
+	return errors != 0 ? 1 : 0;
+}
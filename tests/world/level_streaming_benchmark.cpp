@@ -0,0 +1,264 @@
+/*
+Copyright (c) 2013 Daniele Bartolini, Michele Rossi
+Copyright (c) 2012 Daniele Bartolini, Simone Boscaratto
+
+Permission is hereby granted, free of charge, to any person
+obtaining a copy of this software and associated documentation
+files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use,
+copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following
+conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "level_streaming_benchmark.h"
+#include "level_streamer.h"
+#include "world.h"
+#include "device.h"
+#include "bundle_compiler.h"
+#include "disk_filesystem.h"
+#include "console_server.h"
+#include "audio.h"
+#include "physics.h"
+#include "resource.h"
+#include "string_stream.h"
+#include "array.h"
+#include "memory.h"
+#include "vector3.h"
+#include "math_utils.h"
+#include "os.h"
+#include "test_utils.h"
+#include <bgfx.h>
+#include <stdio.h>
+
+using namespace crown;
+using namespace string_stream;
+
+#define BUILD_DIR CROWN_SOURCE_DIR ".build"
+#define DATA_DIR BUILD_DIR "/level_streaming_data"
+#define BUNDLE_DIR BUILD_DIR "/level_streaming_benchmark"
+
+static const uint32_t NUM_CELLS = 8;		// Per side
+static const uint32_t CELL_UNITS = 8;		// Per side of a cell
+static const float UNIT_SPACING = 4.0f;
+static const float CELL_SIZE = CELL_UNITS * UNIT_SPACING;
+static const float LOAD_RADIUS = 2.5f * CELL_SIZE;
+static const float UNLOAD_RADIUS = 3.0f * CELL_SIZE;
+static const float DT = 1.0f / 60.0f;
+static const double TIMEOUT = 30.0; // Seconds
+
+static void write_file(Filesystem& fs, const char* path, StringStream& ss)
+{
+	File* file = fs.open(path, FOM_WRITE);
+	file->write(c_str(ss), array::size(ss));
+	fs.close(file);
+}
+
+/// Writes the sources of the level, of a unit and a package per cell and of the boot package.
+static void write_sources()
+{
+	const char* dirs[] = { DATA_DIR, DATA_DIR "/lua", DATA_DIR "/units", DATA_DIR "/packages", DATA_DIR "/levels" };
+	for (uint32_t i = 0; i < sizeof(dirs) / sizeof(dirs[0]); i++)
+	{
+		if (!os::exists(dirs[i]))
+			os::create_directory(dirs[i]);
+	}
+
+	DiskFilesystem fs(DATA_DIR);
+
+	StringStream config(default_allocator());
+	config << "{\"boot_script\":\"lua/boot\",\"boot_package\":\"boot\",\"console_port\":10001,\"window_width\":800,\"window_height\":600}";
+	write_file(fs, "crown.config", config);
+
+	StringStream boot(default_allocator());
+	boot << "-- The level streaming benchmark drives the engine from C++\nfunction init()\nend\n\nfunction shutdown()\nend\n";
+	write_file(fs, "lua/boot.lua", boot);
+
+	StringStream boot_package(default_allocator());
+	boot_package << "{\"lua\":[\"lua/boot\"],\"level\":[\"levels/streaming\"]}";
+	write_file(fs, "boot.package", boot_package);
+
+	StringStream level(default_allocator());
+	level << "{\"cell_size\":" << CELL_SIZE << ",\"sounds\":[],\"units\":[";
+
+	for (uint32_t cy = 0; cy < NUM_CELLS; cy++)
+	{
+		for (uint32_t cx = 0; cx < NUM_CELLS; cx++)
+		{
+			char name[64];
+			char path[64];
+
+			StringStream unit(default_allocator());
+			unit << "{\"nodes\":{\"root\":{\"parent\":null,\"position\":[0,0,0],\"rotation\":[0,0,0,1]}}}";
+			snprintf(path, sizeof(path), "units/cell_%u_%u.unit", cx, cy);
+			write_file(fs, path, unit);
+
+			StringStream package(default_allocator());
+			snprintf(name, sizeof(name), "units/cell_%u_%u", cx, cy);
+			package << "{\"unit\":[\"" << name << "\"]}";
+			snprintf(path, sizeof(path), "packages/cell_%u_%u.package", cx, cy);
+			write_file(fs, path, package);
+
+			for (uint32_t i = 0; i < CELL_UNITS * CELL_UNITS; i++)
+			{
+				const float x = (cx * CELL_UNITS + i % CELL_UNITS) * UNIT_SPACING;
+				const float y = (cy * CELL_UNITS + i / CELL_UNITS) * UNIT_SPACING;
+
+				level << (cx == 0 && cy == 0 && i == 0 ? "" : ",") << "{\"name\":\"" << name << "\"";
+				level << ",\"package\":\"packages/cell_" << cx << "_" << cy << "\"";
+				level << ",\"position\":[" << x << "," << y << ",0],\"rotation\":[0,0,0,1]}";
+			}
+		}
+	}
+
+	level << "]}";
+	write_file(fs, "levels/streaming.level", level);
+}
+
+/// Returns the number of units in the cells within @a radius of @a focus.
+static uint32_t units_within(const Vector3& focus, float radius)
+{
+	uint32_t num = 0;
+
+	for (uint32_t cy = 0; cy < NUM_CELLS; cy++)
+	{
+		for (uint32_t cx = 0; cx < NUM_CELLS; cx++)
+		{
+			// Cells are bounded by the positions of their units
+			const Vector3 min(cx * CELL_SIZE, cy * CELL_SIZE, 0.0f);
+			const Vector3 max = min + Vector3(CELL_SIZE - UNIT_SPACING, CELL_SIZE - UNIT_SPACING, 0.0f);
+			const Vector3 closest(math::clamp(min.x, max.x, focus.x), math::clamp(min.y, max.y, focus.y), 0.0f);
+
+			if (vector3::length(focus - closest) <= radius)
+				num += CELL_UNITS * CELL_UNITS;
+		}
+	}
+
+	return num;
+}
+
+/// Streams around @a focus until every unit in range has been spawned.
+/// Returns the number of errors.
+static int stream(World& w, const Vector3& focus, const char* name)
+{
+	LevelStreamer& ls = *w.level_streamer();
+	ls.set_focus(focus);
+
+	uint32_t frames = 0;
+	float max_update = 0.0f;
+	float total_update = 0.0f;
+	const int64_t start = os::clocktime();
+
+	while (ls.progress() < 1.0f && seconds_since(start) < TIMEOUT)
+	{
+		device()->resource_manager()->complete_requests();
+		w.update_scene(DT);
+
+		max_update = math::max(max_update, ls.last_update_time());
+		total_update += ls.last_update_time();
+		frames++;
+	}
+
+	const double elapsed = seconds_since(start);
+
+	// Let the cells out of range finish unloading
+	for (uint32_t i = 0; i < 1000 && w.num_units() > units_within(focus, UNLOAD_RADIUS); i++)
+		w.update_scene(DT);
+
+	printf("  %-8s %4d units in range: %4d frames, %8.2f ms, streaming_time max %6.3f ms, total %8.2f ms, %4d units alive\n"
+		, name
+		, units_within(focus, LOAD_RADIUS)
+		, frames
+		, elapsed * 1000.0
+		, max_update * 1000.0f
+		, total_update * 1000.0f
+		, w.num_units()
+		);
+
+	int errors = 0;
+
+	if (ls.progress() < 1.0f)
+	{
+		printf("level_streaming: progress %.2f after %.0f s\n", ls.progress(), TIMEOUT);
+		errors++;
+	}
+
+	if (w.num_units() < units_within(focus, LOAD_RADIUS) || w.num_units() > units_within(focus, UNLOAD_RADIUS))
+	{
+		printf("level_streaming: %d units alive, %d to %d expected\n", w.num_units(), units_within(focus, LOAD_RADIUS), units_within(focus, UNLOAD_RADIUS));
+		errors++;
+	}
+
+	return errors;
+}
+
+int level_streaming_benchmark()
+{
+	if (!os::exists(BUILD_DIR))
+		os::create_directory(BUILD_DIR);
+	if (!os::exists(BUNDLE_DIR))
+		os::create_directory(BUNDLE_DIR);
+
+	write_sources();
+
+	console_server_globals::init();
+	bundle_compiler_globals::init(DATA_DIR, BUNDLE_DIR);
+	const bool compiled = bundle_compiler_globals::compiler()->compile_all(Platform::LINUX);
+	bundle_compiler_globals::shutdown();
+
+	if (!compiled)
+	{
+		printf("level_streaming: cannot compile %s\n", DATA_DIR);
+		console_server_globals::shutdown();
+		return 1;
+	}
+
+	// Boot the engine without a window
+	DiskFilesystem fs(BUNDLE_DIR);
+	audio_globals::init();
+	physics_globals::init();
+	bgfx::init(bgfx::RendererType::Null);
+	device_globals::init(fs, ResourceId("package", "boot").name, ResourceId("lua", "lua/boot").name);
+	device()->init();
+
+	World* w = CE_NEW(default_allocator(), World)();
+	w->level_streamer()->set_radius(LOAD_RADIUS, UNLOAD_RADIUS);
+	w->stream_level("levels/streaming");
+
+	printf("level streaming, %d units in %d cells of %.0f m, load radius %.0f m:\n"
+		, NUM_CELLS * NUM_CELLS * CELL_UNITS * CELL_UNITS
+		, NUM_CELLS * NUM_CELLS
+		, CELL_SIZE
+		, LOAD_RADIUS
+		);
+
+	const float far = NUM_CELLS * CELL_SIZE;
+	int errors = 0;
+	errors += stream(*w, Vector3(0, 0, 0), "corner");
+	errors += stream(*w, Vector3(far, far, 0), "opposite");
+
+	CE_DELETE(default_allocator(), w);
+
+	device()->shutdown();
+	device_globals::shutdown();
+	bgfx::shutdown();
+	physics_globals::shutdown();
+	audio_globals::shutdown();
+	console_server_globals::shutdown();
+
+	return errors != 0 ? 1 : 0;
+}
@@ -0,0 +1,230 @@
+/*
+Copyright (c) 2013 Daniele Bartolini, Michele Rossi
+Copyright (c) 2012 Daniele Bartolini, Simone Boscaratto
+
+Permission is hereby granted, free of charge, to any person
+obtaining a copy of this software and associated documentation
+files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use,
+copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following
+conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "spatial_index_benchmark.h"
+#include "spatial_index.h"
+#include "array.h"
+#include "vector3.h"
+#include "random.h"
+#include "memory.h"
+#include "test_utils.h"
+#include <algorithm>
+#include <stdio.h>
+
+using namespace crown;
+
+static const uint32_t NUM_QUERIES = 1000;
+static const float WORLD_SIZE = 1000.0f;
+static const float QUERY_RADIUS = 20.0f;
+static const uint32_t NEAREST_K = 8;
+
+struct Sphere
+{
+	Vector3 center;
+	float radius;
+};
+
+static bool unit_less(const UnitId& a, const UnitId& b)
+{
+	return a.index < b.index;
+}
+
+/// Returns the units in @a spheres overlapping the sphere (@a center, @a radius), sorted by index.
+static void brute_force(const Array<Sphere>& spheres, const Vector3& center, float radius, Array<UnitId>& units)
+{
+	for (uint32_t i = 0; i < array::size(spheres); i++)
+	{
+		const float r = spheres[i].radius + radius;
+		if (vector3::squared_length(spheres[i].center - center) <= r * r)
+		{
+			UnitId id;
+			id.id = 0;
+			id.index = uint16_t(i);
+			array::push_back(units, id);
+		}
+	}
+}
+
+/// Returns the squared distance from @a point of its @a k -th nearest center in @a spheres.
+/// The @a k nearest distances are kept in a max-heap in a single pass.
+static float brute_force_nearest(const Array<Sphere>& spheres, const Vector3& point, uint32_t k, Array<float>& distances)
+{
+	array::clear(distances);
+	for (uint32_t i = 0; i < array::size(spheres); i++)
+	{
+		const float dist = vector3::squared_length(spheres[i].center - point);
+
+		if (array::size(distances) < k)
+		{
+			array::push_back(distances, dist);
+			std::push_heap(array::begin(distances), array::end(distances));
+		}
+		else if (dist < distances[0])
+		{
+			std::pop_heap(array::begin(distances), array::end(distances));
+			array::back(distances) = dist;
+			std::push_heap(array::begin(distances), array::end(distances));
+		}
+	}
+
+	return distances[0];
+}
+
+/// Fills @a spheres with @a num units spread uniformly over the world, on
+/// the XY plane for the grid and in a cube for the octree.
+static void spawn(SpatialIndex& si, SpatialIndexType::Enum type, uint32_t num, Array<Sphere>& spheres)
+{
+	Random rnd(num);
+	const bool flat = type == SpatialIndexType::GRID;
+
+	array::resize(spheres, num);
+	for (uint32_t i = 0; i < num; i++)
+	{
+		Sphere& s = spheres[i];
+		s.center = Vector3(rnd.unit_float() * WORLD_SIZE, rnd.unit_float() * WORLD_SIZE, flat ? 0.0f : rnd.unit_float() * WORLD_SIZE);
+		s.radius = 0.5f + rnd.unit_float() * 1.5f;
+
+		UnitId id;
+		id.id = 0;
+		id.index = uint16_t(i);
+		si.insert(id, s.center, s.radius);
+	}
+}
+
+static int run(SpatialIndexType::Enum type, uint32_t num)
+{
+	SpatialIndex si(default_allocator());
+	si.set_type(type);
+
+	Array<Sphere> spheres(default_allocator());
+	spawn(si, type, num, spheres);
+
+	Random rnd(42);
+	Array<Vector3> queries(default_allocator());
+	array::resize(queries, NUM_QUERIES);
+	for (uint32_t i = 0; i < NUM_QUERIES; i++)
+	{
+		const float z = type == SpatialIndexType::GRID ? 0.0f : rnd.unit_float() * WORLD_SIZE;
+		queries[i] = Vector3(rnd.unit_float() * WORLD_SIZE, rnd.unit_float() * WORLD_SIZE, z);
+	}
+
+	Array<UnitId> units(default_allocator());
+	Array<UnitId> expected(default_allocator());
+
+	// Check the results before timing them
+	int result = 0;
+	for (uint32_t i = 0; i < NUM_QUERIES && result == 0; i++)
+	{
+		array::clear(units);
+		array::clear(expected);
+		si.query_sphere(queries[i], QUERY_RADIUS, units);
+		brute_force(spheres, queries[i], QUERY_RADIUS, expected);
+		std::sort(array::begin(units), array::end(units), unit_less);
+
+		bool same = array::size(units) == array::size(expected);
+		for (uint32_t j = 0; same && j < array::size(units); j++)
+			same = units[j].index == expected[j].index;
+
+		if (!same)
+		{
+			printf("query_sphere: query %d returned %d units, brute force %d\n", i, array::size(units), array::size(expected));
+			result = 1;
+		}
+	}
+
+	Array<float> distances(default_allocator());
+	for (uint32_t i = 0; i < NUM_QUERIES && result == 0; i++)
+	{
+		array::clear(units);
+		si.query_nearest(queries[i], NEAREST_K, units);
+
+		const float kth = brute_force_nearest(spheres, queries[i], NEAREST_K, distances);
+		const float last = vector3::squared_length(spheres[array::back(units).index].center - queries[i]);
+
+		if (array::size(units) != NEAREST_K || last != kth)
+		{
+			printf("query_nearest: query %d returned a different %d-th nearest unit than brute force\n", i, NEAREST_K);
+			result = 1;
+		}
+	}
+
+	uint32_t num_found = 0;
+	int64_t start = os::clocktime();
+	for (uint32_t i = 0; i < NUM_QUERIES; i++)
+	{
+		array::clear(units);
+		si.query_sphere(queries[i], QUERY_RADIUS, units);
+		num_found += array::size(units);
+	}
+	const double t_sphere = seconds_since(start);
+
+	start = os::clocktime();
+	for (uint32_t i = 0; i < NUM_QUERIES; i++)
+	{
+		array::clear(expected);
+		brute_force(spheres, queries[i], QUERY_RADIUS, expected);
+	}
+	const double t_brute = seconds_since(start);
+
+	start = os::clocktime();
+	for (uint32_t i = 0; i < NUM_QUERIES; i++)
+	{
+		array::clear(units);
+		si.query_nearest(queries[i], NEAREST_K, units);
+	}
+	const double t_nearest = seconds_since(start);
+
+	start = os::clocktime();
+	for (uint32_t i = 0; i < NUM_QUERIES; i++)
+		brute_force_nearest(spheres, queries[i], NEAREST_K, distances);
+	const double t_brute_nearest = seconds_since(start);
+
+	printf("  %-6s %5d units: query_sphere %7.2f ms (brute force %7.2f ms, %.1f units per query), query_nearest %7.2f ms (brute force %7.2f ms)\n"
+		, type == SpatialIndexType::GRID ? "grid" : "octree"
+		, num
+		, t_sphere * 1000.0
+		, t_brute * 1000.0
+		, float(num_found) / NUM_QUERIES
+		, t_nearest * 1000.0
+		, t_brute_nearest * 1000.0
+		);
+
+	return result;
+}
+
+int spatial_index_benchmark()
+{
+	printf("spatial index, %d queries of radius %.0f and %d nearest over a %.0f m world:\n", NUM_QUERIES, QUERY_RADIUS, NEAREST_K, WORLD_SIZE);
+
+	int result = 0;
+	for (uint32_t num = 10000; num <= 60000; num += 10000)
+	{
+		result |= run(SpatialIndexType::GRID, num);
+		result |= run(SpatialIndexType::OCTREE, num);
+	}
+	return result;
+}
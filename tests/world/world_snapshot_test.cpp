@@ -0,0 +1,220 @@
+/*
+Copyright (c) 2013 Daniele Bartolini, Michele Rossi
+Copyright (c) 2012 Daniele Bartolini, Simone Boscaratto
+
+Permission is hereby granted, free of charge, to any person
+obtaining a copy of this software and associated documentation
+files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use,
+copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following
+conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "world_snapshot_test.h"
+#include "world_snapshot.h"
+#include "world.h"
+#include "unit.h"
+#include "device.h"
+#include "bundle_compiler.h"
+#include "disk_filesystem.h"
+#include "console_server.h"
+#include "audio.h"
+#include "physics.h"
+#include "resource.h"
+#include "array.h"
+#include "memory.h"
+#include "vector3.h"
+#include "os.h"
+#include "test_utils.h"
+#include <bgfx.h>
+#include <stdio.h>
+#include <string.h>
+
+using namespace crown;
+
+#define DATA_DIR CROWN_SOURCE_DIR "tests/data/world_snapshot"
+#define BUILD_DIR CROWN_SOURCE_DIR ".build"
+#define BUNDLE_DIR BUILD_DIR "/world_snapshot_test"
+
+static const char* const UNIT_NAME = "units/snapshot_test";
+static const float DT = 1.0f / 60.0f;
+static const uint32_t NUM_TIMED = 10;
+
+static int round_trip(World& w)
+{
+	int errors = 0;
+
+	const UnitId a = w.spawn_unit(UNIT_NAME, Vector3(1, 2, 3));
+	const UnitId b = w.spawn_unit(UNIT_NAME, Vector3(4, 5, 6));
+	const UnitId c = w.spawn_unit(UNIT_NAME, Vector3(7, 8, 9));
+
+	Unit* ua = w.get_unit(a);
+	Unit* ub = w.get_unit(b);
+	ua->set_key("health", 50.0f);
+	ua->set_local_position(ua->node("arm"), Vector3(0, 2, 0));
+	ub->unlink_node(ub->node("hand"));
+	w.link_unit(c, a, ua->node("hand"));
+	w.update_scene(DT);
+
+	Array<char> saved(default_allocator());
+	world_snapshot::save(w, saved);
+
+	// Change every part of the state the snapshot covers
+	w.destroy_unit(b);
+	w.unlink_unit(c);
+	w.link_unit(a, c, 0);
+	ua->set_key("health", 0.0f);
+	ua->set_key("target", Vector3(1, 1, 1));
+	ua->set_local_position(ua->node("arm"), Vector3(0, 0, 0));
+	const UnitId d = w.spawn_unit(UNIT_NAME, Vector3(-1, -1, -1));
+	w.update_scene(DT);
+
+	if (!world_snapshot::restore(w, array::begin(saved), array::size(saved)))
+	{
+		printf("world_snapshot: restore failed\n");
+		errors++;
+	}
+
+	// Units are restored in place
+	if (!w.has_unit(a) || !w.has_unit(b) || !w.has_unit(c) || w.has_unit(d))
+	{
+		printf("world_snapshot: units not restored in place\n");
+		errors++;
+	}
+
+	Array<char> restored(default_allocator());
+	world_snapshot::save(w, restored);
+
+	if (array::size(saved) != array::size(restored)
+		|| memcmp(array::begin(saved), array::begin(restored), array::size(saved)) != 0)
+	{
+		printf("world_snapshot: snapshots differ after restore\n");
+		errors++;
+	}
+
+	return errors;
+}
+
+/// Times save() and restore() of a world of @a num units, restoring it
+/// unchanged and after half of the units are destroyed and the others moved.
+static int measure(uint32_t num)
+{
+	World* w = CE_NEW(default_allocator(), World)();
+	int errors = 0;
+
+	Array<UnitId> units(default_allocator());
+	for (uint32_t i = 0; i < num; i++)
+	{
+		const UnitId id = w->spawn_unit(UNIT_NAME, Vector3(float(i % 100), float(i / 100), 0.0f));
+		w->get_unit(id)->set_key("health", float(i));
+		array::push_back(units, id);
+	}
+	w->update_scene(DT);
+
+	Array<char> saved(default_allocator());
+	int64_t start = os::clocktime();
+	for (uint32_t i = 0; i < NUM_TIMED; i++)
+	{
+		array::clear(saved);
+		world_snapshot::save(*w, saved);
+	}
+	const double t_save = seconds_since(start) / NUM_TIMED;
+
+	start = os::clocktime();
+	for (uint32_t i = 0; i < NUM_TIMED; i++)
+		errors += !world_snapshot::restore(*w, array::begin(saved), array::size(saved));
+	const double t_restore = seconds_since(start) / NUM_TIMED;
+
+	double t_respawn = 0.0;
+	for (uint32_t i = 0; i < NUM_TIMED; i++)
+	{
+		for (uint32_t j = 0; j < num; j++)
+		{
+			if (j % 2)
+				w->destroy_unit(units[j]);
+			else
+				w->get_unit(units[j])->set_local_position(0, Vector3(0, 0, 1));
+		}
+		w->update_scene(DT);
+
+		start = os::clocktime();
+		errors += !world_snapshot::restore(*w, array::begin(saved), array::size(saved));
+		t_respawn += seconds_since(start);
+	}
+	t_respawn /= NUM_TIMED;
+
+	if (w->num_units() != num)
+		errors++;
+
+	printf("  %5d units, %5d KB: save %7.2f ms, restore %7.2f ms, restore respawning half %7.2f ms\n"
+		, num
+		, array::size(saved) / 1024
+		, t_save * 1000.0
+		, t_restore * 1000.0
+		, t_respawn * 1000.0
+		);
+
+	CE_DELETE(default_allocator(), w);
+	return errors;
+}
+
+int world_snapshot_test()
+{
+	// Compile the test data
+	if (!os::exists(BUILD_DIR))
+		os::create_directory(BUILD_DIR);
+	if (!os::exists(BUNDLE_DIR))
+		os::create_directory(BUNDLE_DIR);
+
+	console_server_globals::init();
+	bundle_compiler_globals::init(DATA_DIR, BUNDLE_DIR);
+	const bool compiled = bundle_compiler_globals::compiler()->compile_all(Platform::LINUX);
+	bundle_compiler_globals::shutdown();
+
+	if (!compiled)
+	{
+		printf("world_snapshot: cannot compile %s\n", DATA_DIR);
+		console_server_globals::shutdown();
+		return 1;
+	}
+
+	// Boot the engine without a window
+	DiskFilesystem fs(BUNDLE_DIR);
+	audio_globals::init();
+	physics_globals::init();
+	bgfx::init(bgfx::RendererType::Null);
+	device_globals::init(fs, ResourceId("package", "boot").name, ResourceId("lua", "lua/boot").name);
+	device()->init();
+
+	World* w = CE_NEW(default_allocator(), World)();
+	int errors = round_trip(*w);
+	CE_DELETE(default_allocator(), w);
+
+	printf("world snapshot, mean of %d saves and restores:\n", NUM_TIMED);
+	for (uint32_t num = 1000; num <= 16000; num *= 4)
+		errors += measure(num);
+
+	device()->shutdown();
+	device_globals::shutdown();
+	bgfx::shutdown();
+	physics_globals::shutdown();
+	audio_globals::shutdown();
+	console_server_globals::shutdown();
+
+	return errors != 0 ? 1 : 0;
+}